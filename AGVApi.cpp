@@ -0,0 +1,602 @@
+#include "AGVApi.h"
+#include "AGVScheduler.h"
+
+using namespace AGVCoreNetworkLib;
+
+#if AGVNET_ENABLE_API
+
+static_assert((int)AGV_API_QUEUE_FULL == (int)AGV_SUBMIT_QUEUE_FULL &&
+              (int)AGV_API_RATE_LIMITED == (int)AGV_SUBMIT_RATE_LIMITED,
+              "AGVApiResult must start with the AGVSubmitResult values");
+static_assert(AGV_API_BATCH_MAX <= 255, "batch results are counted in bytes");
+
+// Bodies of requests that already failed are read and dropped up to this
+// size; past it the connection is closed instead
+#define AGV_API_DISCARD_MAX 1024
+
+static const char* reasonPhrase(uint16_t status) {
+  switch (status) {
+    case 100: return "Continue";
+    case 200: return "OK";
+    case 400: return "Bad Request";
+    case 401: return "Unauthorized";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 411: return "Length Required";
+    case 413: return "Payload Too Large";
+    case 414: return "URI Too Long";
+    case 431: return "Request Header Fields Too Large";
+    case 503: return "Service Unavailable";
+  }
+  return "Internal Server Error";
+}
+
+// Commands are single lines of text
+static bool printable(const char* text, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    if ((uint8_t)text[i] < 0x20) return false;
+  }
+  return length > 0;
+}
+
+bool AGVApiServer::begin(uint16_t port, AGVMessagePool* pool, const AGVTelemetry* telemetry,
+                         const AGVTokenAuth* auth, AGVLock* authLock) {
+  if (listener) return true;
+  this->pool = pool;
+  this->telemetry = telemetry;
+  this->auth = auth;
+  this->authLock = authLock;
+  listener = new WiFiServer(port, AGV_API_CLIENTS + 1);
+  listener->begin();
+  listener->setNoDelay(true);
+  return true;
+}
+
+void AGVApiServer::stop() {
+  if (!listener) return;
+  for (uint8_t i = 0; i < AGV_API_CLIENTS; i++) {
+    if (connections[i].used) close(connections[i]);
+  }
+  listener->stop();
+  delete listener;
+  listener = nullptr;
+}
+
+void AGVApiServer::accept(uint32_t nowMs) {
+  if (!listener->hasClient()) return;
+  WiFiClient client = listener->available();
+  if (!client) return;
+
+  for (uint8_t i = 0; i < AGV_API_CLIENTS; i++) {
+    Connection& c = connections[i];
+    if (c.used) continue;
+    c.client = client;
+    c.client.setNoDelay(true);
+    c.used = true;
+    c.served = 0;
+    c.inLength = 0;
+    c.inPos = 0;
+    c.lastActiveMs = nowMs;
+    c.record = nullptr;
+    resetRequest(c);
+    stats.connections++;
+    return;
+  }
+
+  static const char busy[] =
+      "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+  client.write((const uint8_t*)busy, sizeof(busy) - 1);
+  client.stop();
+  stats.refused++;
+}
+
+void AGVApiServer::close(Connection& c) {
+  if (c.record) {
+    pool->release(c.record);
+    c.record = nullptr;
+  }
+  c.client.stop();
+  c.used = false;
+  c.awaiting = false;
+}
+
+void AGVApiServer::resetRequest(Connection& c) {
+  c.state = STATE_REQUEST_LINE;
+  c.lineLength = 0;
+  c.lineCut = false;
+  c.route = ROUTE_NONE;
+  c.post = false;
+  c.keepAlive = true;
+  c.authorized = !AGVNET_ENABLE_AUTH;
+  c.authBusy = false;
+  c.binary = false;
+  c.expectContinue = false;
+  c.chunked = false;
+  c.awaiting = false;
+  c.status = 0;
+  c.error = nullptr;
+  c.contentLength = 0;
+  c.bodyRead = 0;
+  c.json.reset();
+  c.commandDepth = 0;
+  c.commandsKey = false;
+  c.commandsDone = false;
+  c.recordHeaderRead = 0;
+  c.recordLength = 0;
+  c.recordRead = 0;
+  c.count = 0;
+  c.accepted = 0;
+}
+
+AGVMessage* AGVApiServer::receive(uint32_t nowMs, uint8_t& slot) {
+  if (!listener) return nullptr;
+  accept(nowMs);
+
+  // Round robin, so one busy PLC cannot starve the others
+  for (uint8_t n = 0; n < AGV_API_CLIENTS; n++) {
+    uint8_t i = (nextSlot + n) % AGV_API_CLIENTS;
+    Connection& c = connections[i];
+    if (!c.used || c.awaiting) continue;
+    AGVMessage* msg = process(c, nowMs);
+    if (msg) {
+      c.awaiting = true;
+      slot = i;
+      nextSlot = (i + 1) % AGV_API_CLIENTS;
+      return msg;
+    }
+  }
+  return nullptr;
+}
+
+void AGVApiServer::result(uint8_t slot, AGVApiResult result) {
+  if (slot >= AGV_API_CLIENTS) return;
+  Connection& c = connections[slot];
+  if (!c.used || !c.awaiting) return;
+  c.awaiting = false;
+  addResult(c, result);
+  // The command may have been the last thing in the body
+  if (c.state >= STATE_BODY_JSON && c.bodyRead >= c.contentLength) finish(c);
+}
+
+AGVMessage* AGVApiServer::process(Connection& c, uint32_t nowMs) {
+  // A few socket reads per call, then the other connections get a turn
+  for (uint8_t reads = 0; reads < 4;) {
+    if (c.inPos >= c.inLength) {
+      int available = c.client.available();
+      if (available <= 0) {
+        if (!c.client.connected() || nowMs - c.lastActiveMs > AGV_API_IDLE_MS) close(c);
+        return nullptr;
+      }
+      int length = c.client.read(c.in, available < (int)sizeof(c.in) ? available : sizeof(c.in));
+      if (length <= 0) return nullptr;
+      c.inLength = length;
+      c.inPos = 0;
+      c.lastActiveMs = nowMs;
+      reads++;
+    }
+
+    AGVMessage* msg = nullptr;
+    uint8_t byte = c.in[c.inPos++];
+    if (!step(c, byte, msg)) c.inPos--;  // held by the tokenizer: read it again
+    if (msg || !c.used) return msg;
+  }
+  return nullptr;
+}
+
+// One byte of the request; false if the same byte has to be stepped again
+bool AGVApiServer::step(Connection& c, uint8_t byte, AGVMessage*& out) {
+  switch (c.state) {
+    case STATE_REQUEST_LINE:
+    case STATE_HEADERS:
+      if (byte == '\n') {
+        if (c.lineLength > 0 && c.line[c.lineLength - 1] == '\r') c.lineLength--;
+        c.line[c.lineLength] = '\0';
+        if (c.state == STATE_HEADERS) {
+          if (c.lineLength == 0) {
+            headersDone(c);
+          } else {
+            header(c);
+          }
+        } else if (c.lineLength > 0) {
+          requestLine(c);  // blank lines before a request are allowed
+        }
+        c.lineLength = 0;
+        c.lineCut = false;
+      } else if (c.lineLength < sizeof(c.line) - 1) {
+        c.line[c.lineLength++] = (char)byte;
+      } else {
+        c.lineCut = true;
+      }
+      return true;
+
+    case STATE_BODY_JSON:
+      if (!bodyJson(c, (char)byte, out)) return false;
+      break;
+
+    case STATE_BODY_BINARY:
+      bodyBinary(c, byte, out);
+      break;
+
+    case STATE_BODY_DISCARD:
+      break;
+  }
+
+  c.bodyRead++;
+  // With a command out, the response waits for its result()
+  if (!out && c.bodyRead >= c.contentLength) finish(c);
+  return true;
+}
+
+void AGVApiServer::requestLine(Connection& c) {
+  stats.requests++;
+  if (c.served > 0) stats.reused++;
+  c.state = STATE_HEADERS;
+  if (c.lineCut) {
+    fail(c, 414, "request line too long");
+    return;
+  }
+
+  // METHOD SP target SP HTTP/1.x
+  char* target = strchr(c.line, ' ');
+  char* version = target ? strchr(target + 1, ' ') : nullptr;
+  if (!version || strncmp(version + 1, "HTTP/1.", 7) != 0) {
+    fail(c, 400, "malformed request line");
+    c.keepAlive = false;
+    return;
+  }
+  *target++ = '\0';
+  *version++ = '\0';
+  if (version[7] == '0') c.keepAlive = false;  // HTTP/1.0: only if asked for
+  char* query = strchr(target, '?');
+  if (query) *query = '\0';
+
+  c.post = strcmp(c.line, "POST") == 0;
+  if (strcmp(target, "/api/v1/commands") == 0) {
+    c.route = ROUTE_COMMANDS;
+    if (!c.post) fail(c, 405, "use POST");
+  } else if (strcmp(target, "/api/v1/telemetry") == 0) {
+    c.route = ROUTE_TELEMETRY;
+    if (strcmp(c.line, "GET") != 0) fail(c, 405, "use GET");
+  } else {
+    fail(c, 404, "not found");
+  }
+}
+
+void AGVApiServer::header(Connection& c) {
+  if (c.lineCut) {
+    fail(c, 431, "header too long");
+    return;
+  }
+  char* value = strchr(c.line, ':');
+  if (!value) return;
+  *value++ = '\0';
+  while (*value == ' ' || *value == '\t') value++;
+  const char* name = c.line;
+
+  if (strcasecmp(name, "Content-Length") == 0) {
+    c.contentLength = strtoul(value, nullptr, 10);
+  } else if (strcasecmp(name, "Transfer-Encoding") == 0) {
+    c.chunked = strcasecmp(value, "identity") != 0;
+  } else if (strcasecmp(name, "Connection") == 0) {
+    if (strcasecmp(value, "close") == 0) c.keepAlive = false;
+    if (strcasecmp(value, "keep-alive") == 0) c.keepAlive = true;
+  } else if (strcasecmp(name, "Content-Type") == 0) {
+    c.binary = strncasecmp(value, "application/octet-stream", 24) == 0;
+  } else if (strcasecmp(name, "Expect") == 0) {
+    c.expectContinue = strcasecmp(value, "100-continue") == 0;
+  }
+#if AGVNET_ENABLE_AUTH
+  else if (strcasecmp(name, "Authorization") == 0 && auth && authLock) {
+    if (!authLock->take(__LINE__)) {
+      c.authBusy = true;
+      return;
+    }
+    c.authorized = strncmp(value, "Bearer ", 7) == 0 &&
+                   auth->verify(value + 7, strlen(value + 7)) == AGV_AUTH_OK;
+    authLock->give();
+  }
+#endif
+}
+
+void AGVApiServer::headersDone(Connection& c) {
+  if (c.chunked) {
+    // No length to find the next request by
+    c.keepAlive = false;
+    respondError(c, 411, "send Content-Length, chunked bodies are not supported");
+    return;
+  }
+  if (c.route == ROUTE_COMMANDS && c.status == 0) {
+    if (!c.authorized && c.authBusy) {
+      fail(c, 503, "busy, retry");
+    } else if (!c.authorized) {
+      fail(c, 401, "missing or invalid token");
+    } else if (c.contentLength == 0) {
+      fail(c, 400, "empty body");
+    }
+  }
+
+  if (c.status == 0 && c.route == ROUTE_COMMANDS) {
+    c.state = c.binary ? STATE_BODY_BINARY : STATE_BODY_JSON;
+    if (c.expectContinue) {
+      static const char proceed[] = "HTTP/1.1 100 Continue\r\n\r\n";
+      c.client.write((const uint8_t*)proceed, sizeof(proceed) - 1);
+    }
+  } else {
+    c.state = STATE_BODY_DISCARD;
+    if (c.contentLength > AGV_API_DISCARD_MAX || c.expectContinue) {
+      c.keepAlive = false;
+      c.contentLength = 0;
+    }
+  }
+  if (c.contentLength == 0) finish(c);
+}
+
+bool AGVApiServer::bodyJson(Connection& c, char byte, AGVMessage*& out) {
+  AGVJsonTokenizer& json = c.json;
+  AGVJsonToken token = json.feed(byte);
+  bool inCommands = c.commandDepth != 0 && !c.commandsDone;
+
+  switch (token) {
+    case AGV_JSON_ERROR:
+      fail(c, 400, "malformed JSON");
+      return true;
+
+    case AGV_JSON_KEY:
+      if (json.depth() == 1) c.commandsKey = strcmp(json.text(), "commands") == 0;
+      break;
+
+    case AGV_JSON_ARRAY_START:
+      // ["CMD",...] or {"commands":["CMD",...]}
+      if (c.commandDepth == 0 && (json.depth() == 1 || (json.depth() == 2 && c.commandsKey))) {
+        c.commandDepth = json.depth();
+        break;
+      }
+      // fall through
+    case AGV_JSON_OBJECT_START:
+      if (inCommands && json.depth() == c.commandDepth + 1) addResult(c, AGV_API_INVALID);
+      break;
+
+    case AGV_JSON_ARRAY_END:
+      if (inCommands && json.depth() == c.commandDepth - 1) c.commandsDone = true;
+      break;
+
+    case AGV_JSON_STRING:
+      if (inCommands && json.depth() == c.commandDepth) {
+        out = command(c, json.text(), json.length(), json.truncated());
+      }
+      break;
+
+    case AGV_JSON_NUMBER:
+    case AGV_JSON_LITERAL:
+      if (inCommands && json.depth() == c.commandDepth) addResult(c, AGV_API_INVALID);
+      break;
+
+    default:
+      break;
+  }
+  return !json.held();
+}
+
+void AGVApiServer::bodyBinary(Connection& c, uint8_t byte, AGVMessage*& out) {
+  if (c.recordHeaderRead < 2) {
+    c.recordHeader[c.recordHeaderRead++] = byte;
+    if (c.recordHeaderRead < 2) return;
+    c.recordLength = c.recordHeader[0] | c.recordHeader[1] << 8;
+    c.recordRead = 0;
+    if (c.count >= AGV_API_BATCH_MAX) {
+      fail(c, 413, "too many commands");
+    } else if (c.recordLength == 0) {
+      addResult(c, AGV_API_INVALID);
+      c.recordHeaderRead = 0;
+    } else if (c.recordLength > pool->maxLength()) {
+      addResult(c, AGV_API_TOO_LONG);  // bytes are skipped
+    } else if ((c.record = pool->alloc(c.recordLength)) == nullptr) {
+      addResult(c, AGV_API_BUSY);
+    }
+    return;
+  }
+
+  if (c.record) c.record->text()[c.recordRead] = (char)byte;
+  if (++c.recordRead < c.recordLength) return;
+  c.recordHeaderRead = 0;
+  if (!c.record) return;
+
+  AGVMessage* msg = c.record;
+  c.record = nullptr;
+  if (!printable(msg->text(), msg->length)) {
+    pool->release(msg);
+    addResult(c, AGV_API_INVALID);
+    return;
+  }
+  msg->source = AGV_SOURCE_HTTP;
+  msg->client = (uint8_t)(&c - connections);  // own rate-limit bucket
+  out = msg;
+}
+
+AGVMessage* AGVApiServer::command(Connection& c, const char* text, size_t length, bool cut) {
+  if (c.count >= AGV_API_BATCH_MAX) {
+    fail(c, 413, "too many commands");
+    return nullptr;
+  }
+  if (cut || length > pool->maxLength()) {
+    addResult(c, AGV_API_TOO_LONG);
+    return nullptr;
+  }
+  if (!printable(text, length)) {
+    addResult(c, AGV_API_INVALID);
+    return nullptr;
+  }
+  AGVMessage* msg = pool->copy(text, length);
+  if (!msg) {
+    addResult(c, AGV_API_BUSY);
+    return nullptr;
+  }
+  msg->source = AGV_SOURCE_HTTP;
+  msg->client = (uint8_t)(&c - connections);  // own rate-limit bucket
+  return msg;
+}
+
+void AGVApiServer::addResult(Connection& c, AGVApiResult result) {
+  if (c.count >= AGV_API_BATCH_MAX) {
+    fail(c, 413, "too many commands");
+    return;
+  }
+  c.results[c.count++] = result;
+  stats.commands++;
+  if (result == AGV_API_ACCEPTED) {
+    c.accepted++;
+  } else {
+    stats.rejected++;
+  }
+}
+
+// Remember the first error; the rest of the body is read and dropped
+void AGVApiServer::fail(Connection& c, uint16_t status, const char* error) {
+  if (c.status == 0) {
+    c.status = status;
+    c.error = error;
+  }
+  if (c.state == STATE_BODY_JSON || c.state == STATE_BODY_BINARY) {
+    if (c.record) {
+      pool->release(c.record);
+      c.record = nullptr;
+    }
+    c.state = STATE_BODY_DISCARD;
+  }
+}
+
+void AGVApiServer::finish(Connection& c) {
+  if (c.route == ROUTE_COMMANDS && c.status == 0) {
+    if (c.binary ? c.recordHeaderRead != 0 : !c.json.complete()) {
+      fail(c, 400, c.binary ? "truncated record" : "incomplete JSON");
+    } else if (!c.binary && c.commandDepth == 0) {
+      fail(c, 400, "no command array");
+    }
+  }
+
+  if (c.status == 0 && c.route == ROUTE_TELEMETRY) {
+    respondTelemetry(c);
+  } else if (c.route == ROUTE_COMMANDS && (c.status == 0 || c.status == 400 || c.status == 413)) {
+    respondBatch(c);  // with the results of what was already run
+  } else {
+    respondError(c, c.status ? c.status : 500, c.error ? c.error : "internal error");
+  }
+}
+
+// The head is formatted last and copied in front of the body, so the whole
+// response goes out in one write
+void AGVApiServer::respond(Connection& c, uint16_t status, const char* type, char* frame, size_t bodyLength) {
+  char head[AGV_API_HEADER_RESERVE];
+  int length = snprintf(head, sizeof(head), "HTTP/1.1 %u %s\r\nContent-Type: %s\r\nContent-Length: %u\r\n%s",
+                        status, reasonPhrase(status), type, (unsigned)bodyLength,
+                        c.keepAlive ? "Connection: keep-alive\r\n" : "Connection: close\r\n\r\n");
+  if (c.keepAlive && length > 0 && (size_t)length < sizeof(head)) {
+    length += snprintf(head + length, sizeof(head) - length, "Keep-Alive: timeout=%u\r\n\r\n",
+                       (unsigned)(AGV_API_IDLE_MS / 1000));
+  }
+  if (length <= 0 || (size_t)length >= sizeof(head)) {
+    close(c);
+    return;
+  }
+
+  char* start = frame + AGV_API_HEADER_RESERVE - length;
+  memcpy(start, head, length);
+  c.client.write((const uint8_t*)start, length + bodyLength);
+  if (status >= 400) stats.errors++;
+  c.served++;
+
+  if (!c.keepAlive) {
+    close(c);
+    return;
+  }
+  // The next request is already here
+  if (c.inPos < c.inLength || c.client.available() > 0) stats.pipelined++;
+  resetRequest(c);
+}
+
+void AGVApiServer::respondBatch(Connection& c) {
+  char frame[AGV_API_HEADER_RESERVE + AGV_API_BATCH_MAX * 16 + 128];
+  char* body = frame + AGV_API_HEADER_RESERVE;
+  size_t room = sizeof(frame) - AGV_API_HEADER_RESERVE;
+  uint16_t status = c.status ? c.status : 200;
+
+  if (c.binary) {
+    memcpy(body, c.results, c.count);
+    respond(c, status, "application/octet-stream", frame, c.count);
+    return;
+  }
+
+  size_t at = 0;
+  int written = snprintf(body, room, "{");
+  if (written > 0) at += written;
+  if (c.error) {
+    written = snprintf(body + at, room - at, "\"error\":\"%s\",", c.error);
+    if (written > 0) at += written;
+  }
+  written = snprintf(body + at, room - at, "\"accepted\":%u,\"rejected\":%u,\"results\":[",
+                     c.accepted, c.count - c.accepted);
+  if (written > 0) at += written;
+  for (uint16_t i = 0; i < c.count && at < room; i++) {
+    written = snprintf(body + at, room - at, "%s\"%s\"", i ? "," : "",
+                       resultText((AGVApiResult)c.results[i]));
+    if (written > 0) at += written;
+  }
+  if (at < room) {
+    written = snprintf(body + at, room - at, "]}");
+    if (written > 0) at += written;
+  }
+  if (at >= room) {
+    respondError(c, 500, "response overflow");
+    return;
+  }
+  respond(c, status, "application/json", frame, at);
+}
+
+void AGVApiServer::respondError(Connection& c, uint16_t status, const char* error) {
+  char frame[AGV_API_HEADER_RESERVE + 96];
+  char* body = frame + AGV_API_HEADER_RESERVE;
+  int written = snprintf(body, sizeof(frame) - AGV_API_HEADER_RESERVE, "{\"error\":\"%s\"}", error);
+  if (written <= 0 || (size_t)written >= sizeof(frame) - AGV_API_HEADER_RESERVE) written = 0;
+  respond(c, status, "application/json", frame, written);
+}
+
+void AGVApiServer::respondTelemetry(Connection& c) {
+  // Telemetry reads are lock-free
+  char frame[AGV_API_HEADER_RESERVE + AGV_TELEMETRY_JSON_MAX];
+  size_t length = telemetry ? telemetry->toJson(frame + AGV_API_HEADER_RESERVE, AGV_TELEMETRY_JSON_MAX) : 0;
+  if (length == 0) {
+    respondError(c, 500, "telemetry overflow");
+    return;
+  }
+  respond(c, 200, "application/json", frame, length);
+}
+
+const char* AGVApiServer::resultText(AGVApiResult result) {
+  switch (result) {
+    case AGV_API_ACCEPTED:     return "accepted";
+    case AGV_API_RATE_LIMITED: return "rate limited";
+    case AGV_API_QUEUE_FULL:   return "queue full";
+    case AGV_API_BUSY:         return "busy";
+    case AGV_API_TOO_LONG:     return "too long";
+    case AGV_API_INVALID:      return "invalid";
+  }
+  return "unknown";
+}
+
+size_t AGVApiServer::toJson(char* buffer, size_t size) const {
+  uint8_t open = 0;
+  for (uint8_t i = 0; i < AGV_API_CLIENTS; i++) {
+    if (connections[i].used) open++;
+  }
+  int written = snprintf(buffer, size,
+                         "{\"active\":%s,\"open\":%u,\"connections\":%lu,\"refused\":%lu,\"requests\":%lu,"
+                         "\"reused\":%lu,\"pipelined\":%lu,\"commands\":%lu,\"rejected\":%lu,\"errors\":%lu}",
+                         listener ? "true" : "false", open, (unsigned long)stats.connections,
+                         (unsigned long)stats.refused, (unsigned long)stats.requests,
+                         (unsigned long)stats.reused, (unsigned long)stats.pipelined,
+                         (unsigned long)stats.commands, (unsigned long)stats.rejected,
+                         (unsigned long)stats.errors);
+  return (written > 0 && (size_t)written < size) ? (size_t)written : 0;
+}
+
+#endif
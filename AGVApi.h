@@ -0,0 +1,166 @@
+#ifndef AGVAPI_H
+#define AGVAPI_H
+
+#include <Arduino.h>
+#include <WiFiServer.h>
+#include <WiFiClient.h>
+#include "AGVCoreNetworkConfig.h"
+#include "AGVMessagePool.h"
+#include "AGVTelemetry.h"
+#include "AGVAuth.h"
+#include "AGVLock.h"
+#include "AGVJson.h"
+
+#define AGV_API_LINE_MAX 256        // request line or one header
+#define AGV_API_CHUNK 128           // bytes read from the socket at a time
+#define AGV_API_HEADER_RESERVE 192  // response head, written in front of the body
+
+namespace AGVCoreNetworkLib {
+
+// Per-command outcome; the first three match AGVSubmitResult
+typedef enum : uint8_t {
+  AGV_API_ACCEPTED = 0,
+  AGV_API_RATE_LIMITED,
+  AGV_API_QUEUE_FULL,
+  AGV_API_BUSY,            // no pool block free
+  AGV_API_TOO_LONG,        // longer than the largest pool block
+  AGV_API_INVALID          // empty, or not a string
+} AGVApiResult;
+
+typedef struct {
+  uint32_t connections;
+  uint32_t refused;        // all slots in use
+  uint32_t requests;
+  uint32_t reused;         // requests on an already used connection
+  uint32_t pipelined;      // requests that were already buffered
+  uint32_t commands;
+  uint32_t rejected;       // commands not accepted
+  uint32_t errors;         // 4xx/5xx responses
+} AGVApiStats;
+
+// REST command API for PLCs and MES on its own port, with persistent
+// connections: the WebServer on port 80 closes every connection after one
+// response, which at 20 Hz polling costs more in TCP setup than in work.
+//
+//   POST /api/v1/commands   batch of commands, one result each
+//   GET  /api/v1/telemetry  same document as GET /state
+//
+// A batch is either JSON - ["CMD",...] or {"commands":["CMD",...]} - or,
+// with Content-Type application/octet-stream, records of u16 length (LE)
+// and command bytes. Bodies are parsed as they arrive with a fixed amount
+// of memory per connection: JSON through AGVJsonTokenizer, binary records
+// straight into pool blocks. Each command is handed out with receive() and
+// its outcome reported back with result() before the next one is parsed,
+// so the answer lists results in request order: {"accepted":N,
+// "rejected":M,"results":["accepted",...]} or one AGVApiResult byte per
+// command. Commands are queued like any other source; "AT" envelopes and
+// telemetry queries are not interpreted here. Each connection has its own
+// rate-limit bucket, large enough for a full batch (tools/api_smoke.sh
+// checks that two concurrent full batches are accepted completely).
+//
+// HTTP/1.1 keep-alive is the default and requests may be pipelined;
+// errors that leave the stream in step (401, 404, 400 with the results so
+// far) keep the connection. Chunked bodies are refused and the connection
+// is closed. With AGVNET_ENABLE_AUTH, POST needs "Authorization: Bearer
+// <token>" from POST /login; the token is verified within authLock (the
+// key can be rotated from other paths), and a request that cannot get it
+// is answered 503.
+//
+// Not thread-safe - use from the network task.
+class AGVApiServer {
+public:
+  bool begin(uint16_t port, AGVMessagePool* pool, const AGVTelemetry* telemetry,
+             const AGVTokenAuth* auth, AGVLock* authLock);
+  void stop();
+  bool active() const { return listener != nullptr; }
+
+  // Accept, read and parse until a command is complete (nullptr: nothing
+  // complete yet). The caller owns the message and must report its
+  // outcome with result(slot, ...) before calling receive() again.
+  AGVMessage* receive(uint32_t nowMs, uint8_t& slot);
+  void result(uint8_t slot, AGVApiResult result);
+
+  size_t toJson(char* buffer, size_t size) const;
+  static const char* resultText(AGVApiResult result);
+
+private:
+  typedef enum : uint8_t {
+    STATE_REQUEST_LINE, STATE_HEADERS, STATE_BODY_JSON, STATE_BODY_BINARY, STATE_BODY_DISCARD
+  } State;
+  typedef enum : uint8_t { ROUTE_NONE, ROUTE_COMMANDS, ROUTE_TELEMETRY } Route;
+
+  struct Connection {
+    WiFiClient client;
+    bool used = false;
+    State state;
+    uint32_t lastActiveMs;
+    uint8_t in[AGV_API_CHUNK];
+    uint16_t inLength;
+    uint16_t inPos;
+    char line[AGV_API_LINE_MAX];
+    uint16_t lineLength;
+    bool lineCut;
+
+    // Current request
+    Route route;
+    bool post;
+    bool keepAlive;
+    bool authorized;
+    bool authBusy;           // authLock timed out
+    bool binary;
+    bool expectContinue;
+    bool chunked;
+    bool awaiting;           // a command is out, waiting for result()
+    uint16_t served;         // requests answered on this connection
+    uint16_t status;         // response code if the request already failed
+    const char* error;
+    uint32_t contentLength;
+    uint32_t bodyRead;
+
+    // Batch
+    AGVJsonTokenizer json;
+    uint8_t commandDepth;    // depth of the command array (0 = not found yet)
+    bool commandsKey;        // last top-level key was "commands"
+    bool commandsDone;       // command array closed
+    uint8_t recordHeader[2];
+    uint8_t recordHeaderRead;
+    uint16_t recordLength;
+    uint16_t recordRead;
+    AGVMessage* record;      // binary record being filled (nullptr: skip it)
+    uint8_t results[AGV_API_BATCH_MAX];
+    uint16_t count;          // results so far
+    uint16_t accepted;
+  };
+
+  WiFiServer* listener = nullptr;
+  AGVMessagePool* pool = nullptr;
+  const AGVTelemetry* telemetry = nullptr;
+  const AGVTokenAuth* auth = nullptr;
+  AGVLock* authLock = nullptr;
+  Connection connections[AGV_API_CLIENTS];
+  uint8_t nextSlot = 0;
+  AGVApiStats stats = {};
+
+  void accept(uint32_t nowMs);
+  void close(Connection& c);
+  void resetRequest(Connection& c);
+  AGVMessage* process(Connection& c, uint32_t nowMs);
+  bool step(Connection& c, uint8_t byte, AGVMessage*& out);
+  void requestLine(Connection& c);
+  void header(Connection& c);
+  void headersDone(Connection& c);
+  bool bodyJson(Connection& c, char byte, AGVMessage*& out);
+  void bodyBinary(Connection& c, uint8_t byte, AGVMessage*& out);
+  AGVMessage* command(Connection& c, const char* text, size_t length, bool cut);
+  void addResult(Connection& c, AGVApiResult result);
+  void fail(Connection& c, uint16_t status, const char* error);
+  void finish(Connection& c);
+  void respond(Connection& c, uint16_t status, const char* type, char* frame, size_t bodyLength);
+  void respondBatch(Connection& c);
+  void respondError(Connection& c, uint16_t status, const char* error);
+  void respondTelemetry(Connection& c);
+};
+
+} // namespace AGVCoreNetworkLib
+
+#endif
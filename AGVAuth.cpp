@@ -0,0 +1,150 @@
+#include "AGVAuth.h"
+#include <mbedtls/version.h>
+#include <esp_timer.h>
+
+using namespace AGVCoreNetworkLib;
+
+#if AGVNET_ENABLE_AUTH
+
+// mbedtls 3 dropped the _ret suffixes (arduino-esp32 3.x)
+#if MBEDTLS_VERSION_NUMBER >= 0x03000000
+#define agv_sha256_starts(ctx) mbedtls_sha256_starts(ctx, 0)
+#define agv_sha256_update mbedtls_sha256_update
+#define agv_sha256_finish mbedtls_sha256_finish
+#else
+#define agv_sha256_starts(ctx) mbedtls_sha256_starts_ret(ctx, 0)
+#define agv_sha256_update mbedtls_sha256_update_ret
+#define agv_sha256_finish mbedtls_sha256_finish_ret
+#endif
+
+AGVTokenAuth::AGVTokenAuth() {
+  mbedtls_sha256_init(&inner);
+  mbedtls_sha256_init(&outer);
+}
+
+AGVTokenAuth::~AGVTokenAuth() {
+  mbedtls_sha256_free(&inner);
+  mbedtls_sha256_free(&outer);
+}
+
+void AGVTokenAuth::rotateKey() {
+  uint8_t key[32];
+  for (size_t i = 0; i < sizeof(key); i += 4) {
+    uint32_t r = esp_random();
+    memcpy(key + i, &r, 4);
+  }
+
+  // HMAC: precompute H(K ^ ipad) and H(K ^ opad) so signing is two clones
+  uint8_t pad[64];
+  memset(pad, 0x36, sizeof(pad));
+  for (size_t i = 0; i < sizeof(key); i++) pad[i] ^= key[i];
+  agv_sha256_starts(&inner);
+  agv_sha256_update(&inner, pad, sizeof(pad));
+
+  memset(pad, 0x5C, sizeof(pad));
+  for (size_t i = 0; i < sizeof(key); i++) pad[i] ^= key[i];
+  agv_sha256_starts(&outer);
+  agv_sha256_update(&outer, pad, sizeof(pad));
+
+  memset(key, 0, sizeof(key));
+  memset(pad, 0, sizeof(pad));
+  ready = true;
+}
+
+void AGVTokenAuth::sign(const char* data, size_t length, uint8_t mac[16]) const {
+  uint8_t digest[32];
+  mbedtls_sha256_context ctx;
+  mbedtls_sha256_init(&ctx);
+
+  mbedtls_sha256_clone(&ctx, &inner);
+  agv_sha256_update(&ctx, (const uint8_t*)data, length);
+  agv_sha256_finish(&ctx, digest);
+
+  mbedtls_sha256_clone(&ctx, &outer);
+  agv_sha256_update(&ctx, digest, sizeof(digest));
+  agv_sha256_finish(&ctx, digest);
+
+  mbedtls_sha256_free(&ctx);
+  memcpy(mac, digest, 16);
+}
+
+uint32_t AGVTokenAuth::nowSeconds() {
+  return (uint32_t)(esp_timer_get_time() / 1000000);
+}
+
+bool AGVTokenAuth::issue(char* out, size_t size, uint32_t ttlSeconds) {
+  if (!ready || size <= AGV_TOKEN_LENGTH) return false;
+
+  snprintf(out, size, "%08lx.%08lx.", (unsigned long)(nowSeconds() + ttlSeconds),
+           (unsigned long)esp_random());
+  uint8_t mac[16];
+  sign(out, AGV_TOKEN_SIGNED_LENGTH, mac);
+  for (uint8_t i = 0; i < sizeof(mac); i++) {
+    snprintf(out + AGV_TOKEN_SIGNED_LENGTH + 1 + i * 2, 3, "%02x", mac[i]);
+  }
+  return true;
+}
+
+static int hexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+AGVAuthResult AGVTokenAuth::verify(const char* token, size_t length) const {
+  if (!token || length == 0) return AGV_AUTH_MISSING;
+  if (!ready || length != AGV_TOKEN_LENGTH || token[8] != '.' || token[17] != '.') {
+    return AGV_AUTH_MALFORMED;
+  }
+
+  uint32_t expiry = 0;
+  for (uint8_t i = 0; i < 8; i++) {
+    int v = hexValue(token[i]);
+    if (v < 0 || hexValue(token[9 + i]) < 0) return AGV_AUTH_MALFORMED;
+    expiry = (expiry << 4) | v;
+  }
+
+  uint8_t given[16];
+  for (uint8_t i = 0; i < sizeof(given); i++) {
+    int hi = hexValue(token[18 + i * 2]);
+    int lo = hexValue(token[19 + i * 2]);
+    if (hi < 0 || lo < 0) return AGV_AUTH_MALFORMED;
+    given[i] = (uint8_t)((hi << 4) | lo);
+  }
+
+  // Constant time: the position of the first mismatch must not leak
+  uint8_t expected[16];
+  sign(token, AGV_TOKEN_SIGNED_LENGTH, expected);
+  volatile uint8_t diff = 0;
+  for (uint8_t i = 0; i < sizeof(expected); i++) {
+    diff |= expected[i] ^ given[i];
+  }
+  if (diff != 0) return AGV_AUTH_BAD_SIGNATURE;
+
+  if ((int32_t)(expiry - nowSeconds()) <= 0) return AGV_AUTH_EXPIRED;
+  return AGV_AUTH_OK;
+}
+
+AGVAuthResult AGVTokenAuth::verifyProtocolHeader(const char* value) const {
+  const char* start = value ? strstr(value, AGV_WS_TOKEN_PREFIX) : nullptr;
+  if (!start) return AGV_AUTH_MISSING;
+  start += sizeof(AGV_WS_TOKEN_PREFIX) - 1;
+
+  size_t length = 0;
+  while (start[length] && start[length] != ',' && start[length] != ' ') length++;
+  return verify(start, length);
+}
+
+const char* AGVTokenAuth::resultText(AGVAuthResult result) {
+  switch (result) {
+    case AGV_AUTH_OK:            return "ok";
+    case AGV_AUTH_MISSING:       return "no token";
+    case AGV_AUTH_MALFORMED:     return "malformed token";
+    case AGV_AUTH_BAD_SIGNATURE: return "bad signature";
+    case AGV_AUTH_EXPIRED:       return "token expired";
+  }
+  return "unknown";
+}
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef AGVAUTH_H
+#define AGVAUTH_H
+
+#include <Arduino.h>
+#include "AGVCoreNetworkConfig.h"
+#include <mbedtls/sha256.h>
+
+// Token: "<expiry>.<nonce>.<mac>" = 8 hex + '.' + 8 hex + '.' + 32 hex
+#define AGV_TOKEN_LENGTH 50
+#define AGV_TOKEN_SIGNED_LENGTH 17
+
+// WebSocket subprotocol the server answers with; browsers send the token
+// as a second offered subprotocol "agv-token.<token>"
+#define AGV_WS_PROTOCOL "agv.v1"
+#define AGV_WS_TOKEN_PREFIX "agv-token."
+
+namespace AGVCoreNetworkLib {
+
+typedef enum : uint8_t {
+  AGV_AUTH_OK = 0,
+  AGV_AUTH_MISSING,
+  AGV_AUTH_MALFORMED,
+  AGV_AUTH_BAD_SIGNATURE,
+  AGV_AUTH_EXPIRED
+} AGVAuthResult;
+
+// Stateless session tokens: the expiry and a nonce signed with
+// HMAC-SHA256 (truncated to 128 bits) under a key drawn at boot. Any
+// number of sessions can be live at once without a server-side table;
+// rotating the key (or rebooting) revokes them all. Verification uses
+// only the stack and compares in constant time.
+//
+// On the WebSocket port the token is checked from the upgrade headers.
+// The socket holds a client slot by then; AGVWsServer caps how many slots
+// open handshakes may hold and closes the ones that stall.
+class AGVTokenAuth {
+public:
+  AGVTokenAuth();
+  ~AGVTokenAuth();
+
+  // Draw a new random key; every outstanding token becomes invalid
+  void rotateKey();
+
+  // Writes a NUL-terminated token valid for ttlSeconds (size > AGV_TOKEN_LENGTH)
+  bool issue(char* out, size_t size, uint32_t ttlSeconds);
+
+  AGVAuthResult verify(const char* token, size_t length) const;
+
+  // Finds "agv-token.<token>" in a Sec-WebSocket-Protocol value
+  AGVAuthResult verifyProtocolHeader(const char* value) const;
+
+  static const char* resultText(AGVAuthResult result);
+
+private:
+  // SHA-256 state after absorbing the key xor ipad / opad blocks
+  mbedtls_sha256_context inner;
+  mbedtls_sha256_context outer;
+  bool ready = false;
+
+  void sign(const char* data, size_t length, uint8_t mac[16]) const;
+  static uint32_t nowSeconds();
+};
+
+} // namespace AGVCoreNetworkLib
+
+#endif
@@ -0,0 +1,121 @@
+#include "AGVCapture.h"
+
+using namespace AGVCoreNetworkLib;
+
+#if AGVNET_ENABLE_CAPTURE
+
+// Download header (little endian), followed by `bytes` of records
+typedef struct {
+  uint32_t magic;
+  uint8_t version;
+  uint8_t reserved;
+  uint16_t recordHeader;  // bytes before each payload
+  uint32_t records;
+  uint32_t bytes;
+  uint32_t lost;
+  uint32_t durationUs;
+} CaptureHeader;
+
+#define AGV_CAPTURE_RECORD_HEADER 8
+
+static_assert(sizeof(CaptureHeader) == 24, "CaptureHeader layout is part of the download format");
+
+bool AGVCapture::start() {
+  if (!data) {
+    // Allocated once and kept: no heap churn between captures
+    data = (uint8_t*)malloc(AGV_CAPTURE_BYTES);
+    if (!data) return false;
+  }
+  used = 0;
+  records = 0;
+  lost = 0;
+  startUs = micros();
+  running = true;
+  return true;
+}
+
+void AGVCapture::stop() {
+  if (!running) return;
+  stopUs = micros();
+  running = false;
+}
+
+bool AGVCapture::reserve(AGVCaptureKind kind, uint8_t source, size_t length, uint8_t*& payload) {
+  if (!running) return false;
+  if (length > 0xFFFF || used + AGV_CAPTURE_RECORD_HEADER + length > AGV_CAPTURE_BYTES) {
+    lost++;
+    return false;
+  }
+  uint8_t* record = data + used;
+  uint32_t timeUs = micros() - startUs;
+  uint16_t size = (uint16_t)length;
+  memcpy(record, &timeUs, sizeof(timeUs));
+  record[4] = kind;
+  record[5] = source;
+  memcpy(record + 6, &size, sizeof(size));
+  payload = record + AGV_CAPTURE_RECORD_HEADER;
+  return true;
+}
+
+void AGVCapture::add(AGVCaptureKind kind, uint8_t source, const char* text, size_t length) {
+  uint8_t* payload;
+  if (!reserve(kind, source, length, payload)) return;
+  memcpy(payload, text, length);
+  records++;
+  used += AGV_CAPTURE_RECORD_HEADER + (uint32_t)length;
+}
+
+void AGVCapture::addExec(uint8_t source, uint32_t waitUs, uint32_t runUs, const char* text, size_t length) {
+  uint8_t* payload;
+  if (!reserve(AGV_CAPTURE_EXEC, source, 8 + length, payload)) return;
+  memcpy(payload, &waitUs, sizeof(waitUs));
+  memcpy(payload + 4, &runUs, sizeof(runUs));
+  memcpy(payload + 8, text, length);
+  records++;
+  used += AGV_CAPTURE_RECORD_HEADER + 8 + (uint32_t)length;
+}
+
+size_t AGVCapture::downloadSize() const {
+  return sizeof(CaptureHeader) + used;
+}
+
+size_t AGVCapture::read(size_t offset, uint8_t* buffer, size_t size) const {
+  size_t total = downloadSize();
+  if (offset >= total) return 0;
+
+  size_t written = 0;
+  if (offset < sizeof(CaptureHeader)) {
+    CaptureHeader header;
+    header.magic = AGV_CAPTURE_MAGIC;
+    header.version = AGV_CAPTURE_VERSION;
+    header.reserved = 0;
+    header.recordHeader = AGV_CAPTURE_RECORD_HEADER;
+    header.records = records;
+    header.bytes = total - sizeof(CaptureHeader);
+    header.lost = lost;
+    header.durationUs = (running ? micros() : stopUs) - startUs;
+
+    size_t n = sizeof(header) - offset;
+    if (n > size) n = size;
+    memcpy(buffer, (const uint8_t*)&header + offset, n);
+    written = n;
+    if (written == size) return written;
+  }
+
+  size_t dataOffset = offset + written - sizeof(CaptureHeader);
+  size_t n = size - written;
+  if (n > total - sizeof(CaptureHeader) - dataOffset) n = total - sizeof(CaptureHeader) - dataOffset;
+  memcpy(buffer + written, data + dataOffset, n);
+  return written + n;
+}
+
+size_t AGVCapture::toJson(char* buffer, size_t size) const {
+  int written = snprintf(buffer, size,
+                         "{\"active\":%s,\"records\":%lu,\"bytes\":%lu,\"capacity\":%u,\"lost\":%lu}",
+                         running ? "true" : "false", (unsigned long)records,
+                         (unsigned long)used,
+                         (unsigned)AGV_CAPTURE_BYTES, (unsigned long)lost);
+  return (written > 0 && (size_t)written < size) ? (size_t)written : 0;
+}
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef AGVCAPTURE_H
+#define AGVCAPTURE_H
+
+#include <Arduino.h>
+#include "AGVCoreNetworkConfig.h"
+
+#define AGV_CAPTURE_MAGIC 0x43564741u  // "AGVC"
+#define AGV_CAPTURE_VERSION 1
+
+namespace AGVCoreNetworkLib {
+
+typedef enum : uint8_t {
+  AGV_CAPTURE_RX = 1,         // inbound command frame, payload = text
+  AGV_CAPTURE_STATUS,         // status broadcast, payload = text
+  AGV_CAPTURE_EMERGENCY,      // emergency broadcast, payload = text
+  AGV_CAPTURE_EXEC            // command run by the scheduler, payload = waitUs, runUs (u32 each) + text
+} AGVCaptureKind;
+
+// Session capture for replay (tools/agv_replay.py). Every inbound frame,
+// outbound broadcast and command execution is appended as a record
+//
+//   u32 timeUs (since start), u8 kind, u8 source, u16 length, payload
+//
+// to a byte buffer allocated on the first start. The buffer is not a ring:
+// a capture is one contiguous session, and when it is full further records
+// are counted as lost. The download is a 24-byte header and the records.
+//
+// Not thread-safe - call within the commands lock. Stop before reading the
+// download.
+class AGVCapture {
+public:
+  // Clear and start capturing (false if the buffer cannot be allocated)
+  bool start();
+  void stop();
+  bool active() const { return running; }
+
+  void add(AGVCaptureKind kind, uint8_t source, const char* text, size_t length);
+  void addExec(uint8_t source, uint32_t waitUs, uint32_t runUs, const char* text, size_t length);
+
+  // Serialize header + records into buffer, starting at byte `offset` of
+  // the download. Returns bytes written; 0 at the end.
+  size_t read(size_t offset, uint8_t* buffer, size_t size) const;
+  size_t downloadSize() const;
+
+  size_t toJson(char* buffer, size_t size) const;
+
+private:
+  uint8_t* data = nullptr;
+  uint32_t used = 0;
+  uint32_t records = 0;
+  uint32_t lost = 0;
+  uint32_t startUs = 0;
+  uint32_t stopUs = 0;
+  bool running = false;
+
+  bool reserve(AGVCaptureKind kind, uint8_t source, size_t length, uint8_t*& payload);
+};
+
+} // namespace AGVCoreNetworkLib
+
+#endif
@@ -0,0 +1,189 @@
+#include "AGVClock.h"
+
+using namespace AGVCoreNetworkLib;
+
+static_assert(AGV_TIMER_MAX < AGV_TIMER_NONE, "AGV_TIMER_MAX must fit a uint8_t index");
+static_assert(AGV_TIMER_MAX_DELAY_MS < (1UL << (AGV_WHEEL_BITS * AGV_WHEEL_LEVELS)),
+              "AGV_TIMER_MAX_DELAY_MS exceeds the wheel range");
+static_assert(AGV_TSYNC_MIN_SAMPLES >= 1 && AGV_TSYNC_MIN_SAMPLES <= AGV_TSYNC_SAMPLES,
+              "AGV_TSYNC_MIN_SAMPLES out of range");
+
+// ---- Clock sync ----
+
+void AGVClockSync::reset() {
+  next = 0;
+  count = 0;
+  total = 0;
+  bestOffset = 0;
+  bestDelay = 0;
+  probeUs = 0;
+  enabled = false;
+}
+
+bool AGVClockSync::addSample(int64_t t1, int64_t t2, int64_t t3, int64_t t4) {
+  if (probeUs == 0 || t1 != probeUs || t4 < t1) return false;
+  probeUs = 0;
+
+  // Round trip minus the peer's turnaround; offset assumes symmetric paths
+  int64_t delay = (t4 - t1) - (t3 - t2);
+  if (delay < 0) delay = 0;
+  window[next].offset = ((t2 - t1) + (t3 - t4)) / 2;
+  window[next].delay = (uint32_t)delay;
+  next = (next + 1) % AGV_TSYNC_SAMPLES;
+  if (count < AGV_TSYNC_SAMPLES) count++;
+  total++;
+
+  uint8_t best = 0;
+  for (uint8_t i = 1; i < count; i++) {
+    if (window[i].delay < window[best].delay) best = i;
+  }
+  bestOffset = window[best].offset;
+  bestDelay = window[best].delay;
+  return true;
+}
+
+// ---- Timer wheel ----
+
+AGVTimerWheel::AGVTimerWheel() {
+  memset(slots, AGV_TIMER_NONE, sizeof(slots));
+  for (uint8_t i = 0; i < AGV_TIMER_MAX; i++) {
+    timers[i].message = nullptr;
+    timers[i].next = freeList;
+    freeList = i;
+  }
+}
+
+bool AGVTimerWheel::schedule(AGVMessage* message, int64_t deadlineUs, int64_t nowUs) {
+  if (freeList == AGV_TIMER_NONE ||
+      deadlineUs - nowUs > (int64_t)AGV_TIMER_MAX_DELAY_MS * 1000) {
+    stats.rejected++;
+    return false;
+  }
+
+  // An empty wheel can jump straight to the present
+  if (!started || active == 0) {
+    currentTick = (uint64_t)nowUs / 1000;
+    started = true;
+  }
+
+  uint8_t index = freeList;
+  freeList = timers[index].next;
+  timers[index].message = message;
+  timers[index].deadlineUs = deadlineUs;
+  active++;
+  stats.scheduled++;
+
+  place(index);
+  return true;
+}
+
+// File a timer at the lowest level whose current revolution contains its tick
+void AGVTimerWheel::place(uint8_t index) {
+  Timer& timer = timers[index];
+  uint64_t tick = (uint64_t)timer.deadlineUs / 1000;
+  uint64_t now = currentTick;
+  uint8_t* list;
+
+  if (tick <= now) {
+    makeReady(index);
+    return;
+  } else if ((tick >> AGV_WHEEL_BITS) == (now >> AGV_WHEEL_BITS)) {
+    list = &slots[0][tick & (AGV_WHEEL_SLOTS - 1)];
+  } else if ((tick >> (2 * AGV_WHEEL_BITS)) == (now >> (2 * AGV_WHEEL_BITS))) {
+    list = &slots[1][(tick >> AGV_WHEEL_BITS) & (AGV_WHEEL_SLOTS - 1)];
+  } else if ((tick >> (3 * AGV_WHEEL_BITS)) == (now >> (3 * AGV_WHEEL_BITS))) {
+    list = &slots[2][(tick >> (2 * AGV_WHEEL_BITS)) & (AGV_WHEEL_SLOTS - 1)];
+  } else {
+    list = &overflow;
+  }
+
+  timer.next = *list;
+  *list = index;
+}
+
+void AGVTimerWheel::cascade(uint8_t& list) {
+  uint8_t index = list;
+  list = AGV_TIMER_NONE;
+  while (index != AGV_TIMER_NONE) {
+    uint8_t next = timers[index].next;
+    place(index);
+    index = next;
+  }
+}
+
+// Insert into the ready list, keeping it sorted by deadline
+void AGVTimerWheel::makeReady(uint8_t index) {
+  uint8_t* link = &ready;
+  while (*link != AGV_TIMER_NONE && timers[*link].deadlineUs <= timers[index].deadlineUs) {
+    link = &timers[*link].next;
+  }
+  timers[index].next = *link;
+  *link = index;
+}
+
+AGVMessage* AGVTimerWheel::expire(int64_t horizonUs, int64_t& deadlineUs) {
+  if (active == 0) return nullptr;
+
+  uint64_t target = (uint64_t)horizonUs / 1000;
+  const uint64_t mask = AGV_WHEEL_SLOTS - 1;
+  while (currentTick < target) {
+    uint64_t tick = ++currentTick;
+
+    // Higher levels first, so cascaded timers can land in this tick's slot
+    if ((tick & ((1ULL << (3 * AGV_WHEEL_BITS)) - 1)) == 0) {
+      cascade(overflow);
+    }
+    if ((tick & ((1ULL << (2 * AGV_WHEEL_BITS)) - 1)) == 0) {
+      cascade(slots[2][(tick >> (2 * AGV_WHEEL_BITS)) & mask]);
+    }
+    if ((tick & mask) == 0) {
+      cascade(slots[1][(tick >> AGV_WHEEL_BITS) & mask]);
+    }
+    cascade(slots[0][tick & mask]);
+  }
+
+  // A tick covers 1 ms; only hand out timers that are due by the horizon
+  if (ready == AGV_TIMER_NONE || timers[ready].deadlineUs > horizonUs) return nullptr;
+
+  uint8_t index = ready;
+  Timer& timer = timers[index];
+  ready = timer.next;
+  AGVMessage* message = timer.message;
+  deadlineUs = timer.deadlineUs;
+
+  timer.message = nullptr;
+  timer.next = freeList;
+  freeList = index;
+  active--;
+  return message;
+}
+
+void AGVTimerWheel::requeue(AGVMessage* message, int64_t deadlineUs) {
+  uint8_t index = freeList;  // expire() has just freed one
+  freeList = timers[index].next;
+  timers[index].message = message;
+  timers[index].deadlineUs = deadlineUs;
+  active++;
+  makeReady(index);
+}
+
+void AGVTimerWheel::noteFired(int32_t skewUs) {
+  if (stats.fired == 0 || skewUs < stats.minSkewUs) stats.minSkewUs = skewUs;
+  if (stats.fired == 0 || skewUs > stats.maxSkewUs) stats.maxSkewUs = skewUs;
+  stats.lastSkewUs = skewUs;
+  stats.sumSkewUs += skewUs;
+  stats.fired++;
+  if (skewUs > AGV_TIMER_LATE_US) stats.late++;
+}
+
+size_t AGVTimerWheel::toJson(char* buffer, size_t size) const {
+  int32_t average = stats.fired ? (int32_t)(stats.sumSkewUs / stats.fired) : 0;
+  int written = snprintf(buffer, size,
+                         "{\"scheduled\":%lu,\"pending\":%u,\"fired\":%lu,\"late\":%lu,\"rejected\":%lu,"
+                         "\"skewUs\":{\"min\":%ld,\"max\":%ld,\"avg\":%ld,\"last\":%ld}}",
+                         (unsigned long)stats.scheduled, active, (unsigned long)stats.fired,
+                         (unsigned long)stats.late, (unsigned long)stats.rejected,
+                         (long)stats.minSkewUs, (long)stats.maxSkewUs, (long)average,
+                         (long)stats.lastSkewUs);
+  return (written > 0 && (size_t)written < size) ? (size_t)written : 0;
+}
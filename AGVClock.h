@@ -0,0 +1,115 @@
+#ifndef AGVCLOCK_H
+#define AGVCLOCK_H
+
+#include <Arduino.h>
+#include "AGVCoreNetworkConfig.h"
+#include "AGVMessagePool.h"
+
+#define AGV_WHEEL_BITS 6
+#define AGV_WHEEL_SLOTS (1 << AGV_WHEEL_BITS)
+#define AGV_WHEEL_LEVELS 3
+#define AGV_TIMER_NONE 0xFF
+
+namespace AGVCoreNetworkLib {
+
+// NTP-style offset estimate between a remote clock and esp_timer time.
+// The vehicle sends "TSYNC <t1>"; the peer answers "TSYNC <t1> <t2> <t3>"
+// with its own receive/transmit times (all in microseconds) and the reply
+// arrives at t4. Of the last AGV_TSYNC_SAMPLES exchanges the one with the
+// smallest round trip is trusted, since queuing delay only ever adds.
+class AGVClockSync {
+public:
+  void reset();
+
+  bool addSample(int64_t t1, int64_t t2, int64_t t3, int64_t t4);
+  bool synced() const { return count >= AGV_TSYNC_MIN_SAMPLES; }
+
+  // Remote clock minus local clock, and the round trip it was measured with.
+  // Half the round trip bounds the error of the offset.
+  int64_t offsetUs() const { return bestOffset; }
+  uint32_t delayUs() const { return bestDelay; }
+  uint32_t samples() const { return total; }
+
+  int64_t toLocal(int64_t remoteUs) const { return remoteUs - bestOffset; }
+
+  // Outstanding probe; replies to anything else are ignored
+  int64_t probeUs = 0;
+  bool enabled = false;
+
+private:
+  typedef struct {
+    int64_t offset;
+    uint32_t delay;
+  } Sample;
+
+  Sample window[AGV_TSYNC_SAMPLES];
+  uint8_t next = 0;
+  uint8_t count = 0;
+  uint32_t total = 0;
+  int64_t bestOffset = 0;
+  uint32_t bestDelay = 0;
+};
+
+typedef struct {
+  uint32_t scheduled;
+  uint32_t fired;
+  uint32_t late;        // fired more than AGV_TIMER_LATE_US after the target
+  uint32_t rejected;    // past, too far ahead or no free timer
+  int32_t minSkewUs;    // fired - target
+  int32_t maxSkewUs;
+  int32_t lastSkewUs;
+  int64_t sumSkewUs;
+} AGVSkewStats;
+
+// Hierarchical timer wheel with 1 ms ticks for time-triggered commands:
+// three levels of 64 slots (64 ms, 4.1 s, 262 s per revolution) plus an
+// overflow list. Insert and expiry are O(1) per timer; entries cascade
+// toward level 0 as their time approaches. Fixed capacity, no heap.
+// Not thread-safe - use from the network task only.
+class AGVTimerWheel {
+public:
+  AGVTimerWheel();
+
+  // Takes ownership of the message when it returns true
+  bool schedule(AGVMessage* message, int64_t deadlineUs, int64_t nowUs);
+
+  // Advance to horizonUs and return the earliest timer due by then (the
+  // caller owns the message), or nullptr
+  AGVMessage* expire(int64_t horizonUs, int64_t& deadlineUs);
+
+  // Give back a timer from expire() that could not run yet (takes ownership);
+  // it is handed out again first
+  void requeue(AGVMessage* message, int64_t deadlineUs);
+
+  uint8_t pending() const { return active; }
+
+  void noteRejected() { stats.rejected++; }
+  void noteFired(int32_t skewUs);
+  const AGVSkewStats& getStats() const { return stats; }
+  size_t toJson(char* buffer, size_t size) const;
+
+private:
+  typedef struct {
+    AGVMessage* message;
+    int64_t deadlineUs;
+    uint8_t next;
+  } Timer;
+
+  Timer timers[AGV_TIMER_MAX];
+  uint8_t slots[AGV_WHEEL_LEVELS][AGV_WHEEL_SLOTS];
+  uint8_t overflow = AGV_TIMER_NONE;
+  uint8_t ready = AGV_TIMER_NONE;     // expired, sorted by deadline
+  uint8_t freeList = AGV_TIMER_NONE;
+  uint8_t active = 0;
+  uint64_t currentTick = 0;           // last processed 1 ms tick
+  bool started = false;
+  AGVSkewStats stats = {};
+
+  void place(uint8_t index);
+  void cascade(uint8_t& list);
+  void makeReady(uint8_t index);
+};
+
+} // namespace AGVCoreNetworkLib
+
+#endif
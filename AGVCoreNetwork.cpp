@@ -1,10 +1,58 @@
 #include "AGVCoreNetwork.h"
 #include "AGVCoreNetwork_Resources.h"
+#include <esp_timer.h>
 
 using namespace AGVCoreNetworkLib;
 
 AGVCoreNetwork agvNetwork; // Global instance
 
+#if AGVNET_ENABLE_RECORDER
+#define AGV_RECORD(...) recorder.record(__VA_ARGS__)
+#define AGV_RECORD_TEXT(...) recorder.recordText(__VA_ARGS__)
+#else
+#define AGV_RECORD(...) do {} while (0)
+#define AGV_RECORD_TEXT(...) do {} while (0)
+#endif
+
+// Session capture calls are made within the commands lock
+#if AGVNET_ENABLE_CAPTURE
+#define AGV_CAPTURE(...) capture.add(__VA_ARGS__)
+#else
+#define AGV_CAPTURE(...) do {} while (0)
+#endif
+
+// Out-of-line definitions for the configuration constants (C++11)
+constexpr bool AGVNetConfig::wifi;
+constexpr bool AGVNetConfig::http;
+constexpr bool AGVNetConfig::webSocket;
+constexpr bool AGVNetConfig::webUI;
+constexpr bool AGVNetConfig::apPortal;
+constexpr bool AGVNetConfig::mdns;
+constexpr bool AGVNetConfig::mission;
+constexpr bool AGVNetConfig::recorder;
+constexpr bool AGVNetConfig::timed;
+constexpr bool AGVNetConfig::auth;
+constexpr bool AGVNetConfig::selfTest;
+constexpr bool AGVNetConfig::mqtt;
+constexpr bool AGVNetConfig::routing;
+constexpr bool AGVNetConfig::isrEvents;
+constexpr bool AGVNetConfig::journal;
+constexpr bool AGVNetConfig::dispatch;
+constexpr bool AGVNetConfig::capture;
+constexpr bool AGVNetConfig::discovery;
+constexpr bool AGVNetConfig::events;
+constexpr bool AGVNetConfig::delta;
+constexpr bool AGVNetConfig::provision;
+constexpr bool AGVNetConfig::api;
+constexpr bool AGVNetConfig::fleet;
+constexpr uint16_t AGVNetConfig::httpPort;
+constexpr uint16_t AGVNetConfig::wsPort;
+constexpr uint16_t AGVNetConfig::apiPort;
+constexpr uint32_t AGVNetConfig::taskStack;
+constexpr uint8_t AGVNetConfig::taskPriority;
+constexpr int8_t AGVNetConfig::taskCore;
+
+#if AGVNET_ENABLE_WEBSOCKET
 // Forward declarations
 void webSocketEventHandler(uint8_t num, WStype_t type, uint8_t * payload, size_t length);
 
@@ -12,12 +60,25 @@ void webSocketEventHandler(uint8_t num, WStype_t type, uint8_t * payload, size_t
 void webSocketEventHandler(uint8_t num, WStype_t type, uint8_t * payload, size_t length) {
   agvNetwork.webSocketEvent(num, type, payload, length);
 }
+#endif
 
 void AGVCoreNetwork::begin(const char* deviceName, const char* adminUser, const char* adminPass) {
   Serial.println("\n[AGVNET] Initializing AGV Core Network System...");
   
-  // Initialize mutex for thread safety
-  mutex = xSemaphoreCreateMutex();
+  // Lock domains for state shared with the application's tasks
+  commandLock.begin("commands");
+  clientLock.begin("clients");
+  configLock.begin("config");
+  
+  // Status messages travel to the network task by pointer into the message pool
+  statusQueue = xQueueCreate(AGV_STATUS_QUEUE_LEN, sizeof(AGVMessage*));
+#if AGVNET_ENABLE_MQTT || AGVNET_ENABLE_CAPTURE
+  mirrorQueue = xQueueCreate(AGV_STATUS_QUEUE_LEN, sizeof(AGVMessage*));
+#endif
+  
+#if AGVNET_ENABLE_DISPATCH
+  dispatcher.begin(&messagePool);
+#endif
   
   // Store configuration
   this->mdnsName = deviceName;
@@ -28,14 +89,51 @@ void AGVCoreNetwork::begin(const char* deviceName, const char* adminUser, const
   Serial.begin(115200);
   delay(500);
   
+#if AGVNET_ENABLE_RECORDER
+  recorder.begin();
+#endif
+  
+#if AGVNET_ENABLE_JOURNAL
+  // Before the network task starts, so nothing else touches the missions yet
+  if (journal.begin(AGV_JOURNAL_PARTITION, &missions[0])) {
+    const AGVJournalState& state = journal.state();
+    commandSeq = state.commandSeq;
+    if (state.missionId != 0) {
+      missionSeq = state.missionId;
+      missionStaging = 1;  // missions[0] holds the recovered mission
+      missionRecovered = true;
+      missionProgress = (uint32_t)state.loop << 16 | state.waypoint;
+      Serial.printf("[JOURNAL] ✅ Recovered mission #%lu (%u waypoints) at loop %u, waypoint %u in %lu us\n",
+                    (unsigned long)state.missionId, missions[0].count, state.loop, state.waypoint,
+                    (unsigned long)journal.getStats().recoverUs);
+    } else {
+      Serial.printf("[JOURNAL] ✅ No active mission, command sequence %lu\n", (unsigned long)commandSeq);
+    }
+  }
+#endif
+  
+#if AGVNET_ENABLE_AUTH
+  // Per-boot signing key: sessions do not survive a restart
+  auth.rotateKey();
+#endif
+  
+#if AGVNET_ENABLE_WIFI
   // Initialize preferences
   preferences.begin("agvnet", false);
   stored_ssid = preferences.getString("ssid", "");
   stored_password = preferences.getString("password", "");
+  stored_name = preferences.getString("name", "");
   preferences.end();
+  if (stored_name.length() > 0) {
+    mdnsName = stored_name.c_str();
+  }
   
   // Setup WiFi based on stored credentials
   setupWiFi();
+#else
+  isAPMode = false;
+  Serial.println("[AGVNET] WiFi disabled at build time - serial control only");
+#endif
   
   // Start Core 0 task (handles all communication)
   xTaskCreatePinnedToCore(
@@ -44,79 +142,440 @@ void AGVCoreNetwork::begin(const char* deviceName, const char* adminUser, const
       net->core0Task(NULL);
     },
     "AGVNetCore0",
-    16384,  // Stack size
+    AGVNetConfig::taskStack,
     this,
-    1,      // Priority
+    AGVNetConfig::taskPriority,
     &core0TaskHandle,
-    0       // Core 0
+    AGVNetConfig::taskCore
   );
   
-  Serial.println("[AGVNET] ✅ Network System started on Core 0");
+  Serial.printf("[AGVNET] ✅ Network System started on Core %d\n", AGVNetConfig::taskCore);
 }
 
 void AGVCoreNetwork::setCommandCallback(CommandCallback callback) {
-  if (xSemaphoreTake(mutex, pdMS_TO_TICKS(100)) == pdPASS) {
+  if (takeLock(commandLock, __LINE__)) {
     this->commandCallback = callback;
-    xSemaphoreGive(mutex);
+    commandLock.give();
     Serial.println("[AGVNET] Command callback registered");
   }
 }
 
+#if AGVNET_ENABLE_DISPATCH
+bool AGVCoreNetwork::on(const char* verb, AGVVerbHandler handler, AGVHandlerContext context) {
+  bool registered = false;
+  if (takeLock(commandLock, __LINE__)) {
+    registered = dispatcher.on(verb, handler, context);
+    commandLock.give();
+  }
+  if (registered) {
+    Serial.printf("[DISPATCH] Verb '%s' -> %s\n", verb,
+                  handler ? AGVDispatcher::contextName(context) : "removed");
+  } else {
+    Serial.printf("[DISPATCH] ❌ Cannot register verb '%s' (max %u verbs of %u chars, "
+                  "context fixed while jobs are queued)\n",
+                  verb ? verb : "", (unsigned)AGV_DISPATCH_MAX_VERBS, (unsigned)AGV_DISPATCH_VERB_LEN - 1);
+  }
+  return registered;
+}
+
+// Control loop: run handlers registered with AGV_CONTEXT_CORE1
+uint8_t AGVCoreNetwork::runQueuedCommands(uint8_t max) {
+  return dispatcher.runCore1(max);
+}
+#endif
+
+bool AGVCoreNetwork::setCommandClass(const char* pattern, AGVCommandClass cls) {
+  bool ok = false;
+  if (takeLock(commandLock, __LINE__)) {
+    ok = scheduler.addRule(pattern, cls);
+    commandLock.give();
+  }
+  return ok;
+}
+
+void AGVCoreNetwork::setClassWeight(AGVCommandClass cls, uint8_t weight) {
+  if (takeLock(commandLock, __LINE__)) {
+    scheduler.setWeight(cls, weight);
+    commandLock.give();
+  }
+}
+
+void AGVCoreNetwork::setRateLimit(uint16_t perSecond, uint16_t burst) {
+  if (takeLock(commandLock, __LINE__)) {
+    scheduler.setRateLimit(perSecond, burst);
+    commandLock.give();
+    Serial.printf("[AGVNET] Rate limit: %u commands/s per source, burst %u\n", perSecond, burst);
+  }
+}
+
+void AGVCoreNetwork::setMissionCallback(MissionCallback callback) {
+  if (takeLock(commandLock, __LINE__)) {
+    this->missionCallback = callback;
+    commandLock.give();
+    Serial.println("[AGVNET] Mission callback registered");
+  }
+}
+
+void AGVCoreNetwork::setLinkCallback(LinkCallback callback) {
+  if (takeLock(clientLock, __LINE__)) {
+    this->linkCallback = callback;
+    clientLock.give();
+    Serial.println("[AGVNET] Link callback registered");
+  }
+}
+
+void AGVCoreNetwork::setHeartbeat(uint16_t pingIntervalMs, uint16_t linkLossMs, uint16_t dropAfterMs) {
+  this->heartbeatIntervalMs = pingIntervalMs > 0 ? pingIntervalMs : 1;
+  this->linkLossMs = linkLossMs;
+  this->linkDropMs = dropAfterMs > linkLossMs ? dropAfterMs : linkLossMs;
+  Serial.printf("[AGVNET] Heartbeat: ping %u ms, link loss %u ms, drop %u ms\n",
+                pingIntervalMs, linkLossMs, this->linkDropMs);
+}
+
+uint32_t AGVCoreNetwork::getClientRtt(uint8_t num) const {
+#if AGVNET_ENABLE_WEBSOCKET
+  if (num >= WEBSOCKETS_SERVER_CLIENT_MAX || !clientLinks[num].connected) return 0;
+  return clientLinks[num].rttAvgUs;
+#else
+  return 0;
+#endif
+}
+
 void AGVCoreNetwork::sendStatus(const char* status) {
   if (!status || strlen(status) == 0) return;
   
-  if (xSemaphoreTake(mutex, pdMS_TO_TICKS(100)) == pdPASS) {
-    if (!isAPMode && webSocket) {
-      webSocket->broadcastTXT(status);
+  // Hand the status to the network task - Core 1 never waits for a lock
+  size_t length = strlen(status);
+  AGV_RECORD_TEXT(AGV_EVT_STATUS, AGV_SOURCE_INTERNAL, status, length);
+  if (statusQueue && length <= AGVMessagePool::maxLength()) {
+    AGVMessage* msg = messagePool.copy(status, length);
+    if (msg) {
+      if (xQueueSend(statusQueue, &msg, 0) == pdPASS) return;
+      messagePool.release(msg);
     }
-    xSemaphoreGive(mutex);
   }
-  Serial.printf("[STATUS] %s\n", status);
+  
+  // Pool or queue exhausted: publish synchronously
+  statusFallbacks++;
+  publishStatus(status, length);
 }
 
 void AGVCoreNetwork::broadcastEmergency(const char* message) {
   if (!message || strlen(message) == 0) return;
-  
-  if (xSemaphoreTake(mutex, pdMS_TO_TICKS(100)) == pdPASS) {
+  AGV_RECORD_TEXT(AGV_EVT_EMERGENCY, AGV_SOURCE_INTERNAL, message, strlen(message));
+  publishEmergency(message, strlen(message));
+}
+
+// Broadcast a status to WebSocket clients and SSE viewers, queue it for
+// MQTT and capture, and log it. Takes no commands lock: callers may be
+// Core 1 or a command handler.
+void AGVCoreNetwork::publishStatus(const char* text, size_t length) {
+#if AGVNET_ENABLE_MQTT || AGVNET_ENABLE_CAPTURE
+  mirror(text, length, AGV_PRIORITY_NORMAL);
+#endif
+#if AGVNET_ENABLE_WEBSOCKET || AGVNET_ENABLE_EVENTS
+  if (takeLock(clientLock, __LINE__)) {
+#if AGVNET_ENABLE_EVENTS
+    events.publish("status", text, length);
+#endif
+#if AGVNET_ENABLE_WEBSOCKET
+    if (!isAPMode && webSocket) {
+      webSocket->broadcastTXT(text, length);
+    }
+#endif
+    clientLock.give();
+  }
+#endif
+  Serial.printf("[STATUS] %s\n", text);
+}
+
+// Viewers first: an emergency never waits behind command processing
+void AGVCoreNetwork::publishEmergency(const char* text, size_t length) {
+#if AGVNET_ENABLE_WEBSOCKET || AGVNET_ENABLE_EVENTS
+  if (takeLock(clientLock, __LINE__)) {
+#if AGVNET_ENABLE_EVENTS
+    events.publish("emergency", text, length);
+#endif
+#if AGVNET_ENABLE_WEBSOCKET
     if (!isAPMode && webSocket) {
-      webSocket->broadcastTXT(String("EMERGENCY: ") + message);
+      sendPrefixed(-1, "EMERGENCY: ", text, length);
+    }
+#endif
+    clientLock.give();
+  }
+#endif
+#if AGVNET_ENABLE_CAPTURE
+  mirror(text, length, AGV_PRIORITY_HIGH);
+#endif
+  Serial.printf("!!! EMERGENCY: %s\n", text);
+}
+
+#if AGVNET_ENABLE_MQTT || AGVNET_ENABLE_CAPTURE
+// MQTT and capture belong to the commands lock, which publishers must not
+// wait for: copy the text for the network task (emergencies at high priority)
+void AGVCoreNetwork::mirror(const char* text, size_t length, uint8_t priority) {
+  bool wanted = false;
+#if AGVNET_ENABLE_MQTT
+  wanted = wanted || (priority == AGV_PRIORITY_NORMAL && mqtt.active());
+#endif
+#if AGVNET_ENABLE_CAPTURE
+  wanted = wanted || capture.active();
+#endif
+  if (!wanted || !mirrorQueue) return;
+  
+  AGVMessage* msg = length <= AGVMessagePool::maxLength() ? messagePool.copy(text, length) : nullptr;
+  if (msg) {
+    msg->priority = priority;
+    if (xQueueSend(mirrorQueue, &msg, 0) == pdPASS) return;
+    messagePool.release(msg);
+  }
+  __atomic_add_fetch(&mirrorDrops, 1, __ATOMIC_RELAXED);
+}
+
+// Network task: append mirrored statuses and emergencies in one lock hold
+void AGVCoreNetwork::serviceMirror() {
+  if (!mirrorQueue || uxQueueMessagesWaiting(mirrorQueue) == 0) return;
+  if (!takeLock(commandLock, __LINE__)) return;  // kept for the next pass
+  
+  AGVMessage* msg;
+  while (xQueueReceive(mirrorQueue, &msg, 0) == pdPASS) {
+    if (msg->priority == AGV_PRIORITY_HIGH) {
+      AGV_CAPTURE(AGV_CAPTURE_EMERGENCY, AGV_SOURCE_INTERNAL, msg->text(), msg->length);
+    } else {
+      AGV_CAPTURE(AGV_CAPTURE_STATUS, AGV_SOURCE_INTERNAL, msg->text(), msg->length);
+#if AGVNET_ENABLE_MQTT
+      mqtt.addStatus(msg->text(), msg->length);
+#endif
+    }
+    messagePool.release(msg);
+  }
+  commandLock.give();
+}
+#endif
+
+#if AGVNET_ENABLE_ISR_EVENTS
+bool IRAM_ATTR AGVCoreNetwork::sendStatusFromISR(const char* status) {
+  return postFromISR(AGV_ISR_STATUS, status, 0);
+}
+
+bool IRAM_ATTR AGVCoreNetwork::broadcastEmergencyFromISR(const char* message) {
+  return postFromISR(AGV_ISR_EMERGENCY, message, 0);
+}
+
+bool IRAM_ATTR AGVCoreNetwork::setTelemetryFromISR(const char* key, int32_t value) {
+  return postFromISR(AGV_ISR_TELEMETRY, key, value);
+}
+
+// Copy into the ring and wake the network task, switching to it right away
+// if it outranks the interrupted task
+bool IRAM_ATTR AGVCoreNetwork::postFromISR(AGVIsrKind kind, const char* text, int32_t value) {
+  if (!text || !text[0] || !isrQueue.post(kind, text, value)) return false;
+  if (core0TaskHandle) {
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(core0TaskHandle, &woken);
+    if (woken) portYIELD_FROM_ISR();
+  }
+  return true;
+}
+
+// Publish events posted by interrupt handlers, oldest first
+void AGVCoreNetwork::serviceIsrEvents() {
+  AGVIsrEvent event;
+  while (isrQueue.take(event)) {
+    switch (event.kind) {
+      case AGV_ISR_EMERGENCY:
+        AGV_RECORD_TEXT(AGV_EVT_EMERGENCY, AGV_SOURCE_INTERNAL, event.text, event.length);
+        publishEmergency(event.text, event.length);
+        break;
+      case AGV_ISR_STATUS:
+        AGV_RECORD_TEXT(AGV_EVT_STATUS, AGV_SOURCE_INTERNAL, event.text, event.length);
+        publishStatus(event.text, event.length);
+        break;
+      case AGV_ISR_TELEMETRY:
+        telemetry.setInt(event.text, event.value);
+        break;
     }
-    xSemaphoreGive(mutex);
+    isrQueue.notePublished(micros() - event.postedUs);
+  }
+  
+  uint32_t overflows = isrQueue.overflows();
+  if (overflows != isrOverflowsSeen) {
+    AGV_RECORD(AGV_EVT_ISR_OVERFLOW, AGV_SOURCE_INTERNAL, 0, overflows - isrOverflowsSeen);
+    Serial.printf("[ISR] ❌ %lu event(s) lost - ring full (AGV_ISR_QUEUE_LEN %u)\n",
+                  (unsigned long)(overflows - isrOverflowsSeen), (unsigned)AGV_ISR_QUEUE_LEN);
+    isrOverflowsSeen = overflows;
+  }
+}
+#endif
+
+#if AGVNET_ENABLE_AUTH
+void AGVCoreNetwork::setSessionTtl(uint32_t seconds) {
+  if (takeLock(configLock, __LINE__)) {
+    sessionTtlS = seconds;
+    configLock.give();
+  }
+}
+
+void AGVCoreNetwork::revokeSessions() {
+  if (takeLock(configLock, __LINE__)) {
+    auth.rotateKey();
+    configLock.give();
+    Serial.println("[AUTH] All sessions revoked");
+  }
+}
+
+bool AGVCoreNetwork::issueSessionToken(char* out, size_t size) {
+  bool issued = false;
+  if (takeLock(configLock, __LINE__)) {
+    issued = auth.issue(out, size, sessionTtlS);
+    configLock.give();
   }
-  Serial.printf("!!! EMERGENCY: %s\n", message);
+  return issued;
+}
+
+#if AGVNET_ENABLE_WEBSOCKET
+// Handshake header check, called by the WebSocket server for every header
+bool AGVCoreNetwork::validateWsHeader(const String& name, const String& value) {
+  if (!name.equalsIgnoreCase("Sec-WebSocket-Protocol")) return true;
+  
+  AGVAuthResult result = AGV_AUTH_MISSING;
+  if (takeLock(configLock, __LINE__)) {
+    result = auth.verifyProtocolHeader(value.c_str());
+    configLock.give();
+  }
+  if (result != AGV_AUTH_OK) {
+    AGV_RECORD(AGV_EVT_AUTH_REJECT, AGV_SOURCE_WEBSOCKET, result, 0);
+    Serial.printf("[AUTH] ❌ WebSocket upgrade rejected: %s\n", AGVTokenAuth::resultText(result));
+  }
+  return result == AGV_AUTH_OK;
+}
+#endif
+#endif
+
+// Static memory reserved by the compiled-in subsystems (see AGVCoreNetworkConfig.h)
+void AGVCoreNetwork::printFootprint() {
+  Serial.println("\n[AGVNET] Build footprint:");
+  Serial.printf("  wifi=%d http=%d ws=%d webui=%d portal=%d mdns=%d mission=%d\n",
+                AGVNET_ENABLE_WIFI, AGVNET_ENABLE_HTTP, AGVNET_ENABLE_WEBSOCKET,
+                AGVNET_ENABLE_WEBUI, AGVNET_ENABLE_AP_PORTAL, AGVNET_ENABLE_MDNS,
+                AGVNET_ENABLE_MISSION);
+  Serial.printf("  AGVCoreNetwork object   %6u B RAM\n", (unsigned)sizeof(AGVCoreNetwork));
+  Serial.printf("    message pool          %6u B\n", (unsigned)sizeof(messagePool));
+  Serial.printf("    scheduler             %6u B\n", (unsigned)sizeof(scheduler));
+  Serial.printf("    telemetry             %6u B\n", (unsigned)sizeof(telemetry));
+  Serial.printf("    lock domains (x3)     %6u B\n", (unsigned)(sizeof(commandLock) * 3));
+#if AGVNET_ENABLE_MISSION
+  Serial.printf("    missions (x2)         %6u B\n", (unsigned)(sizeof(missions) + sizeof(missionParser)));
+#endif
+#if AGVNET_ENABLE_WEBSOCKET
+  Serial.printf("    client links          %6u B\n", (unsigned)sizeof(clientLinks));
+#endif
+#if AGVNET_ENABLE_TIMED
+  Serial.printf("    timer wheel           %6u B\n", (unsigned)sizeof(timerWheel));
+#endif
+#if AGVNET_ENABLE_AUTH
+  Serial.printf("    session keys          %6u B\n", (unsigned)sizeof(auth));
+#endif
+#if AGVNET_ENABLE_SELFTEST
+  Serial.printf("    self-test             %6u B\n", (unsigned)sizeof(selfTest));
+#endif
+#if AGVNET_ENABLE_MQTT
+  Serial.printf("    MQTT bridge           %6u B\n", (unsigned)sizeof(mqtt));
+#endif
+#if AGVNET_ENABLE_DISPATCH
+  Serial.printf("    verb table            %6u B\n", (unsigned)sizeof(dispatcher));
+#endif
+#if AGVNET_ENABLE_EVENTS
+  Serial.printf("    SSE replay ring       %6u B\n", (unsigned)sizeof(events));
+#endif
+#if AGVNET_ENABLE_PROVISION
+  Serial.printf("    provisioning          %6u B\n", (unsigned)sizeof(provisioner));
+#endif
+#if AGVNET_ENABLE_API
+  Serial.printf("    REST API connections  %6u B\n", (unsigned)sizeof(api));
+#endif
+#if AGVNET_ENABLE_DELTA
+  Serial.printf("    delta telemetry       %6u B\n", (unsigned)sizeof(deltaEncoder));
+#endif
+#if AGVNET_ENABLE_DISCOVERY
+  Serial.printf("    fleet discovery       %6u B\n", (unsigned)sizeof(discovery));
+#endif
+#if AGVNET_ENABLE_CAPTURE
+  Serial.printf("    capture buffer        %6u B heap, on first start\n", (unsigned)AGV_CAPTURE_BYTES);
+#endif
+#if AGVNET_ENABLE_JOURNAL
+  Serial.printf("    journal               %6u B\n", (unsigned)sizeof(journal));
+#endif
+#if AGVNET_ENABLE_ISR_EVENTS
+  Serial.printf("    ISR event ring        %6u B\n", (unsigned)sizeof(isrQueue));
+#endif
+#if AGVNET_ENABLE_ROUTING
+  Serial.printf("    grid map + routes     %6u B\n", (unsigned)sizeof(router));
+#endif
+  Serial.printf("  Status queue            %6u B RAM\n",
+                (unsigned)(AGV_STATUS_QUEUE_LEN * sizeof(AGVMessage*)));
+  Serial.printf("  Network task stack      %6u B RAM\n", (unsigned)AGVNetConfig::taskStack);
+#if AGVNET_ENABLE_RECORDER
+  Serial.printf("  Flight recorder         %6u B RTC\n",
+                (unsigned)(AGV_RECORDER_EVENTS * sizeof(AGVEvent)));
+#endif
+#if AGVNET_ENABLE_WEBUI
+  Serial.printf("  Web UI pages            %6u B flash\n", (unsigned)(sizeof(loginPage) + sizeof(mainPage)));
+#endif
+#if AGVNET_ENABLE_FLEET
+  Serial.printf("  Fleet page and worker   %6u B flash\n", (unsigned)(sizeof(fleetPage) + sizeof(fleetWorker)));
+#endif
+#if AGVNET_ENABLE_AP_PORTAL
+  Serial.printf("  Setup portal page       %6u B flash\n", (unsigned)sizeof(wifiSetupPage));
+#endif
+  Serial.printf("  Free heap now           %6u B\n", (unsigned)ESP.getFreeHeap());
 }
 
 void AGVCoreNetwork::cleanupServer() {
+#if AGVNET_ENABLE_HTTP
   if (server) {
     delete server;
     server = nullptr;
   }
+#endif
 }
 
 void AGVCoreNetwork::cleanupWebSocket() {
+#if AGVNET_ENABLE_WEBSOCKET
   if (webSocket) {
     delete webSocket;
     webSocket = nullptr;
   }
+#endif
 }
 
 void AGVCoreNetwork::cleanupDNSServer() {
+#if AGVNET_ENABLE_AP_PORTAL
   if (dnsServer) {
     dnsServer->stop();
     delete dnsServer;
     dnsServer = nullptr;
   }
+#endif
 }
 
+#if AGVNET_ENABLE_WIFI
 void AGVCoreNetwork::setupWiFi() {
   if (stored_ssid.length() > 0) {
     Serial.println("[AGVNET] Found saved WiFi credentials, attempting connection...");
     startStationMode();
   } else {
+#if AGVNET_ENABLE_AP_PORTAL
     Serial.println("[AGVNET] No saved credentials, starting AP mode...");
     startAPMode();
+#else
+    Serial.println("[AGVNET] ❌ No saved WiFi credentials and setup portal disabled - staying offline");
+#endif
   }
 }
+#endif
+
+#if AGVNET_ENABLE_AP_PORTAL
 
 void AGVCoreNetwork::startAPMode() {
   Serial.println("\n[AGVNET] 📡 Starting Access Point Mode");
@@ -138,7 +597,7 @@ void AGVCoreNetwork::startAPMode() {
   isAPMode = true;
   
   // Setup web server - CRITICAL ORDER FOR CAPTIVE PORTAL
-  server = new WebServer(80);
+  server = new WebServer(AGVNetConfig::httpPort);
   
   // Setup routes for AP mode - IMPORTANT ORDER (onNotFound FIRST!)
   server->onNotFound([this](){ this->handleNotFound(); });
@@ -160,53 +619,194 @@ void AGVCoreNetwork::startAPMode() {
   Serial.println("[AGVNET] ✅ AP Mode Web Server Started");
   Serial.println("[AGVNET] ✅ Captive portal enabled - all requests redirected to setup");
 }
+#endif
 
-void AGVCoreNetwork::startStationMode() {
-  Serial.println("\n[AGVNET] 🌐 Starting Station Mode");
+#if AGVNET_ENABLE_PROVISION
+// Listen for provisioning while in setup mode or without credentials. With
+// a commissioning network configured, join it next to the setup AP so one
+// tool reaches every vehicle at once.
+void AGVCoreNetwork::serviceProvisioning() {
+  if (!provisioner.enabled()) return;
+  if (!isAPMode && stored_ssid.length() > 0) {
+    if (provisioner.active()) provisioner.stop();
+    return;
+  }
   
-  WiFi.mode(WIFI_STA);
-  WiFi.begin(stored_ssid.c_str(), stored_password.c_str());
+  if (!provisioner.active()) {
+    if (AGVNET_PROVISION_SSID[0] != '\0' && !WiFi.isConnected()) {
+      WiFi.mode(isAPMode ? WIFI_AP_STA : WIFI_STA);
+      WiFi.begin(AGVNET_PROVISION_SSID, AGVNET_PROVISION_PASSWORD);
+    }
+    if (!provisioner.begin(AGV_PROVISION_PORT, mdnsName)) return;
+    Serial.printf("[PROVISION] Waiting for provisioning on UDP %u%s%s\n", (unsigned)AGV_PROVISION_PORT,
+                  AGVNET_PROVISION_SSID[0] ? " and network " : "", AGVNET_PROVISION_SSID);
+  }
   
-  Serial.printf("[AGVNET] Connecting to: %s\n", stored_ssid.c_str());
+  AGVProvisionRequest request;
+  if (provisioner.service(millis(), request) && storeProvisioning(request)) {
+    provisioner.acknowledge(AGV_PROVISION_OK);
+    applyProvisioning();
+  }
+}
+
+// Store the credentials and name. Not acknowledged on failure, so the tool
+// sends the config again.
+bool AGVCoreNetwork::storeProvisioning(const AGVProvisionRequest& request) {
+  if (!takeLock(configLock, __LINE__)) {
+    Serial.println("[PROVISION] ❌ Config busy - not applied");
+    return false;
+  }
+  preferences.begin("agvnet", false);
+  preferences.putString("ssid", request.ssid);
+  preferences.putString("password", request.password);
+  preferences.putString("name", request.name);
+  preferences.end();
+  
+  stored_ssid = request.ssid;
+  stored_password = request.password;
+  stored_name = request.name;
+  mdnsName = stored_name.c_str();
+  configLock.give();
   
-  int attempts = 0;
-  while (WiFi.status() != WL_CONNECTED && attempts < 20) {
+  Serial.printf("[PROVISION] ✅ Provisioned as '%s' for network '%s'\n", request.name, request.ssid);
+  provisioner.renewNonce();  // the accepted config cannot be replayed
+  return true;
+}
+
+// Join the stored network in place of the setup AP without waiting for it:
+// the network task finishes the join, then the web server, WebSocket and
+// mDNS come up as after a restart
+void AGVCoreNetwork::applyProvisioning() {
+  delay(100);                // let the acknowledgement leave
+  provisioner.stop();
+  
+#if AGVNET_ENABLE_AP_PORTAL
+  if (isAPMode) {
+    cleanupDNSServer();
+    if (server) {
+      server->stop();
+      delete server;
+      server = nullptr;
+    }
+    WiFi.softAPdisconnect(true);
+  }
+#endif
+  WiFi.disconnect();  // leave the commissioning network
+  isAPMode = false;
+  beginStationJoin();
+}
+#endif
+
+#if AGVNET_ENABLE_WIFI
+// At boot: wait for the join here, nothing else is running yet
+void AGVCoreNetwork::startStationMode() {
+  beginStationJoin();
+  while (WiFi.status() != WL_CONNECTED && millis() - stationJoinStartMs < AGVNET_WIFI_JOIN_MS) {
     delay(500);
     Serial.print(".");
-    attempts++;
   }
+  stationJoining = false;
+  finishStationMode(WiFi.status() == WL_CONNECTED);
+}
+
+void AGVCoreNetwork::beginStationJoin() {
+  Serial.println("\n[AGVNET] 🌐 Starting Station Mode");
+  
+  WiFi.mode(WIFI_STA);
+  WiFi.begin(stored_ssid.c_str(), stored_password.c_str());
   
-  if (WiFi.status() == WL_CONNECTED) {
+  Serial.printf("[AGVNET] Connecting to: %s\n", stored_ssid.c_str());
+  stationJoinStartMs = millis();
+  stationJoining = true;
+}
+
+// Network task: finish a join started at runtime once it connects or times out
+void AGVCoreNetwork::serviceStationJoin() {
+  if (!stationJoining) return;
+  bool connected = WiFi.status() == WL_CONNECTED;
+  if (!connected && millis() - stationJoinStartMs < AGVNET_WIFI_JOIN_MS) return;
+  stationJoining = false;
+  finishStationMode(connected);
+}
+
+void AGVCoreNetwork::finishStationMode(bool connected) {
+  if (connected) {
     Serial.println("\n[AGVNET] ✅ WiFi Connected!");
     Serial.printf("[AGVNET] IP Address: %s\n", WiFi.localIP().toString().c_str());
     
+#if AGVNET_ENABLE_MDNS
     // Start mDNS
     if (MDNS.begin(mdnsName)) {
-      MDNS.addService("http", "tcp", 80);
+      MDNS.addService("http", "tcp", AGVNetConfig::httpPort);
       Serial.printf("[AGVNET] ✅ mDNS started: http://%s.local\n", mdnsName);
+#if AGVNET_ENABLE_DISCOVERY
+      if (discovery.begin(AGVNetConfig::httpPort, firmwareVersion)) {
+        Serial.println("[AGVNET] ✅ Fleet discovery: _agv._tcp (tools/agv_scan.py)");
+      }
+#endif
     }
-    
-    isAPMode = false;
-    
-    // Setup web server
-    server = new WebServer(80);
-    webSocket = new WebSocketsServer(81);
-    webSocket->begin();
-    webSocket->onEvent(webSocketEventHandler);
-    
-    setupRoutes();
-    server->begin();
-    
-    Serial.println("[AGVNET] ✅ Station Mode Web Server Started");
-    Serial.println("[AGVNET] ✅ WebSocket Server Started (Port 81)");
-    
+#endif
   } else {
     Serial.println("\n[AGVNET] ❌ WiFi connection failed");
+#if AGVNET_ENABLE_AP_PORTAL
     Serial.println("[AGVNET] Falling back to AP mode...");
     startAPMode();
+    return;
+#else
+    // No setup portal to fall back to: serve anyway, WiFi keeps reconnecting
+    Serial.println("[AGVNET] Setup portal disabled - retrying in background");
+#endif
   }
+  
+  isAPMode = false;
+  
+#if AGVNET_ENABLE_HTTP
+  // Setup web server
+  server = new WebServer(AGVNetConfig::httpPort);
+#if AGVNET_ENABLE_AUTH || AGVNET_ENABLE_EVENTS
+  static const char* httpHeaders[] = {
+#if AGVNET_ENABLE_AUTH
+    "Authorization",
+#endif
+#if AGVNET_ENABLE_EVENTS
+    "Last-Event-ID",
+#endif
+  };
+  server->collectHeaders(httpHeaders, sizeof(httpHeaders) / sizeof(httpHeaders[0]));
+#endif
+  setupRoutes();
+  server->begin();
+  Serial.printf("[AGVNET] ✅ Station Mode Web Server Started (Port %u)\n", AGVNetConfig::httpPort);
+#endif
+  
+#if AGVNET_ENABLE_WEBSOCKET
+  webSocket = new AGVWsServer(AGVNetConfig::wsPort, "", AGV_WS_PROTOCOL);
+#if AGVNET_ENABLE_AUTH
+  // Clients without a valid token are refused during the upgrade handshake,
+  // before they connect or reach command parsing (AGVWsServer limits the
+  // slots open handshakes can hold)
+  static const char* wsAuthHeaders[] = { "Sec-WebSocket-Protocol" };
+  webSocket->onValidateHttpHeader([this](String name, String value) {
+    return this->validateWsHeader(name, value);
+  }, wsAuthHeaders, 1);
+#endif
+  webSocket->begin();
+  webSocket->onEvent(webSocketEventHandler);
+  Serial.printf("[AGVNET] ✅ WebSocket Server Started (Port %u)\n", AGVNetConfig::wsPort);
+#endif
+  
+#if AGVNET_ENABLE_API
+#if AGVNET_ENABLE_AUTH
+  api.begin(AGVNetConfig::apiPort, &messagePool, &telemetry, &auth, &configLock);
+#else
+  api.begin(AGVNetConfig::apiPort, &messagePool, &telemetry, nullptr, nullptr);
+#endif
+  Serial.printf("[AGVNET] ✅ REST API Started (Port %u, /api/v1/commands)\n", AGVNetConfig::apiPort);
+#endif
 }
+#endif
 
+#if AGVNET_ENABLE_HTTP
 void AGVCoreNetwork::setupRoutes() {
   if (!server) return;
   
@@ -215,285 +815,2015 @@ void AGVCoreNetwork::setupRoutes() {
     return;
   } else {
     // Station Mode routes (control interface)
+#if AGVNET_ENABLE_WEBUI
     server->on("/", HTTP_GET, [this](){ this->handleRoot(); });
-    server->on("/login", HTTP_POST, [this](){ this->handleLogin(); });
     server->on("/dashboard", HTTP_GET, [this](){ this->handleDashboard(); });
+    server->on("/delta.js", HTTP_GET, [this](){ this->handleDeltaDecoder(); });
+#endif
+#if AGVNET_ENABLE_FLEET
+    server->on("/fleet", HTTP_GET, [this](){ this->handleFleet(); });
+    server->on("/fleet.js", HTTP_GET, [this](){ this->handleFleetWorker(); });
+#endif
+    server->on("/login", HTTP_POST, [this](){ this->handleLogin(); });
+#if AGVNET_ENABLE_AUTH
+    server->on("/session", HTTP_GET, [this](){ this->handleSession(); });
+#endif
+    server->on("/state", HTTP_GET, [this](){ this->handleState(); });
+    server->on("/stats", HTTP_GET, [this](){ this->handleStats(); });
+#if AGVNET_ENABLE_RECORDER
+    server->on("/recorder", HTTP_GET, [this](){ this->handleRecorder(); });
+#endif
+#if AGVNET_ENABLE_EVENTS
+    server->on("/events", HTTP_GET, [this](){ this->handleEvents(); });
+#endif
+#if AGVNET_ENABLE_CAPTURE
+    server->on("/capture", HTTP_GET, [this](){ this->handleCapture(); });
+    server->on("/capture", HTTP_POST, [this](){ this->handleCaptureControl(); });
+#endif
+#if AGVNET_ENABLE_SELFTEST
+    server->on("/selftest", HTTP_GET, [this](){ this->handleSelfTest(); });
+    server->on("/selftest", HTTP_POST, [this](){ this->handleSelfTestStart(); });
+#endif
+#if AGVNET_ENABLE_MISSION
+    server->on("/mission", HTTP_POST, [this](){ this->handleMissionDone(); },
+                                      [this](){ this->handleMissionUpload(); });
+#endif
+#if AGVNET_ENABLE_ROUTING
+    server->on("/map", HTTP_GET, [this](){ this->handleMap(); });
+    server->on("/map", HTTP_POST, [this](){ this->handleMapUpload(); });
+#endif
     server->onNotFound([this](){ this->handleNotFound(); });
   }
 }
+#endif
 
 void AGVCoreNetwork::core0Task(void *parameter) {
   Serial.println("[CORE0] AGV Network task started on Core 0");
+#if AGVNET_ENABLE_ISR_EVENTS
+  bool wokenEarly = false;
+#endif
   
   while(1) {
+#if AGVNET_ENABLE_RECORDER
+    uint32_t loopStartMs = millis();
+#endif
+#if AGVNET_ENABLE_WIFI
+    serviceStationJoin();
+#endif
+#if AGVNET_ENABLE_ISR_EVENTS
+    serviceIsrEvents();
+#endif
+    
+#if AGVNET_ENABLE_AP_PORTAL
     if (isAPMode && dnsServer) {
       dnsServer->processNextRequest();
     }
+#endif
     
+#if AGVNET_ENABLE_PROVISION
+    serviceProvisioning();
+    if (isAPMode) {
+      processSerialInput();  // PROVISION lines only
+    }
+#endif
+    
+#if AGVNET_ENABLE_HTTP
     if (server) {
       server->handleClient();
     }
+#endif
     
     if (!isAPMode) {
+#if AGVNET_ENABLE_TIMED
+      // Checked between the steps that can block, to keep AT commands on time
+      serviceTimers();
+#endif
+#if AGVNET_ENABLE_WEBSOCKET
       if (webSocket) {
         webSocket->loop();
+#if AGVNET_ENABLE_ISR_EVENTS
+        serviceIsrEvents();
+#endif
+        serviceHeartbeat();
+        serviceLinkResets();
+#if AGVNET_ENABLE_TIMED
+        serviceClockSync();
+#endif
       }
+#endif
+#if AGVNET_ENABLE_TIMED
+      serviceTimers();
+#endif
+      publishPendingStatus();
+#if AGVNET_ENABLE_MQTT || AGVNET_ENABLE_CAPTURE
+      serviceMirror();
+#endif
+#if AGVNET_ENABLE_MQTT
+      serviceMqtt();
+#endif
+#if AGVNET_ENABLE_API
+      serviceApi();
+#endif
+      dispatchCommands();
       processSerialInput();
+#if AGVNET_ENABLE_JOURNAL
+      serviceJournal();
+#endif
+#if AGVNET_ENABLE_EVENTS
+      serviceEvents();
+#endif
+#if AGVNET_ENABLE_DELTA
+      serviceDelta();
+#endif
+#if AGVNET_ENABLE_DISCOVERY
+      discovery.service(millis(), telemetry, controlLinkUp);
+#endif
+#if AGVNET_ENABLE_SELFTEST
+      serviceSelfTest();
+#endif
+    }
+    
+#if AGVNET_ENABLE_RECORDER
+    uint32_t loopMs = millis() - loopStartMs;
+    if (loopMs > AGV_RECORDER_STALL_MS) {
+      AGV_RECORD(AGV_EVT_LOOP_STALL, AGV_SOURCE_INTERNAL, 0, loopMs);
     }
+#endif
     
+#if AGVNET_ENABLE_ISR_EVENTS
+    // Sleep a tick unless an ISR posts an event; never two short sleeps in
+    // a row, so an interrupt storm cannot starve the idle task
+    if (wokenEarly) {
+      delay(1);
+      wokenEarly = false;
+    } else {
+      wokenEarly = ulTaskNotifyTake(pdTRUE, 1) > 0;
+    }
+#else
     delay(1);  // Short delay for responsiveness
+#endif
   }
 }
 
 void AGVCoreNetwork::processSerialInput() {
-  static char serialBuffer[64];
-  static int bufferIndex = 0;
+  static char serialBuffer[AGV_POOL_LARGE_SIZE];
+  static size_t bufferIndex = 0;
+  static bool overflow = false;
   
   while (Serial.available() > 0) {
     char c = Serial.read();
     
     if (c == '\n' || c == '\r') {
-      if (bufferIndex > 0) {
+      if (overflow) {
+        Serial.printf("\n[SERIAL] ❌ Command longer than %u bytes discarded\n",
+                      (unsigned)AGVMessagePool::maxLength());
+        overflow = false;
+        bufferIndex = 0;
+      } else if (bufferIndex > 0) {
         serialBuffer[bufferIndex] = '\0';
-        String cmd = String(serialBuffer);
-        cmd.trim();
+        bufferIndex = 0;
         
-        if (cmd.length() > 0) {
-          Serial.printf("\n[SERIAL] Command received: '%s'\n", cmd.c_str());
-          
-          // Determine priority (emergency commands get high priority)
-          uint8_t priority = 0;
-          if (cmd.equalsIgnoreCase("STOP") || cmd.equalsIgnoreCase("ABORT") || 
-              cmd.equalsIgnoreCase("EMERGENCY")) {
-            priority = 1;
-          }
-          
-          // Process command with mutex protection
-          if (xSemaphoreTake(mutex, pdMS_TO_TICKS(100)) == pdPASS) {
-            processCommandUnsafe(serialBuffer, 1); // source=1 (serial)
-            xSemaphoreGive(mutex);
-          }
-          
-          // Echo back to serial
-          Serial.printf("[SERIAL] Executed: %s\n", serialBuffer);
+        // Trim in place
+        char* cmd = serialBuffer;
+        while (*cmd == ' ' || *cmd == '\t') cmd++;
+        size_t length = strlen(cmd);
+        while (length > 0 && (cmd[length - 1] == ' ' || cmd[length - 1] == '\t')) {
+          cmd[--length] = '\0';
+        }
+        
+        char reply[AGV_TELEMETRY_JSON_MAX];
+#if AGVNET_ENABLE_PROVISION
+        AGVProvisionRequest request;
+        bool accepted = false;
+        if ((isAPMode || stored_ssid.length() == 0) &&
+            provisioner.handleSerial(cmd, reply, sizeof(reply), request, accepted)) {
+          Serial.printf("[SERIAL] %s\n", reply);
+          if (accepted && storeProvisioning(request)) applyProvisioning();
+        } else if (isAPMode && length > 0) {
+          Serial.println("[SERIAL] ❌ Setup mode - only PROVISION commands are accepted");
+        } else
+#endif
+        if (handleTelemetryQuery(cmd, reply, sizeof(reply))) {
+          Serial.printf("[SERIAL] %s\n", reply);
+#if AGVNET_ENABLE_SELFTEST
+        } else if (strcasecmp(cmd, "SELFTEST") == 0) {
+          startSelfTest();
+#endif
+        } else if (length > 0) {
+          Serial.printf("\n[SERIAL] Command received: '%s'\n", cmd);
           
-          // Broadcast to web clients
-          if (xSemaphoreTake(mutex, pdMS_TO_TICKS(100)) == pdPASS) {
-            if (!isAPMode && webSocket) {
-              webSocket->broadcastTXT(String("SERIAL: ") + serialBuffer);
+          AGV_RECORD_TEXT(AGV_EVT_CMD_RX, AGV_SOURCE_SERIAL, cmd, length);
+          AGVMessage* msg = messagePool.copy(cmd, length);
+          if (!msg) {
+            AGV_RECORD(AGV_EVT_CMD_DROP, AGV_SOURCE_SERIAL, AGV_DROP_NO_BLOCK, AGVRecorder::head(cmd, length));
+            Serial.println("[SERIAL] ❌ Message pool exhausted - command dropped");
+          } else {
+            msg->source = AGV_SOURCE_SERIAL;
+            
+            if (takeLock(commandLock, __LINE__)) {
+              AGV_CAPTURE(AGV_CAPTURE_RX, AGV_SOURCE_SERIAL, cmd, length);
+#if AGVNET_ENABLE_WEBSOCKET
+              // Broadcast to web clients
+              if (!isAPMode && webSocket && takeLock(clientLock, __LINE__)) {
+                sendPrefixed(-1, "SERIAL: ", cmd, length);
+                clientLock.give();
+              }
+#endif
+              
+#if AGVNET_ENABLE_TIMED
+              // AT envelopes go to the timer wheel
+              if (scheduleTimed(msg, reply, sizeof(reply))) {
+                Serial.printf("[SERIAL] %s\n", reply);
+              } else
+#endif
+              // Queue for dispatch (ownership passes to the scheduler)
+              submitCommand(msg);
+              commandLock.give();
+            } else {
+              messagePool.release(msg);
             }
-            xSemaphoreGive(mutex);
           }
         }
-        
-        bufferIndex = 0;
       }
     } else if (bufferIndex < sizeof(serialBuffer) - 1) {
       serialBuffer[bufferIndex++] = c;
+    } else {
+      overflow = true;
     }
     
     vTaskDelay(pdMS_TO_TICKS(1));
   }
 }
 
-String AGVCoreNetwork::getSessionToken() {
-  String token = "";
-  for(int i = 0; i < 32; i++) {
-    token += String(random(0, 16), HEX);
-  }
-  return token;
+// Rate limit a frame before it is logged or echoed, so a flooding client
+// costs one token check per frame. Releases msg when it is refused.
+// Called within the commands lock.
+bool AGVCoreNetwork::admitCommand(AGVMessage* msg) {
+  if (scheduler.admit(msg)) return true;
+  AGV_RECORD(AGV_EVT_CMD_DROP, msg->source, AGV_SUBMIT_RATE_LIMITED, AGVRecorder::head(msg->text(), msg->length));
+  messagePool.release(msg);
+  return false;
 }
 
-// Command processing without mutex (called from within mutex-protected context)
-void AGVCoreNetwork::processCommandUnsafe(const char* cmd, uint8_t source) {
-  // Determine priority
-  uint8_t priority = 0;
-  String cmdStr = String(cmd);
-  if (cmdStr.equalsIgnoreCase("STOP") || cmdStr.equalsIgnoreCase("ABORT") || 
-      cmdStr.startsWith("PATH:") || cmdStr.equalsIgnoreCase("START")) {
-    priority = 1;
-  }
-  
-  // Send to command callback if registered
-  if (commandCallback) {
-    commandCallback(cmd, source, priority);
+// Classify, rate limit and queue a command (just queue it if it was already
+// admitted). Takes ownership of msg.
+// Called within the commands lock (scheduler rules can be changed from Core 1).
+AGVSubmitResult AGVCoreNetwork::submitCommand(AGVMessage* msg, bool admitted) {
+  AGVSubmitResult result = admitted ? scheduler.enqueue(msg) : scheduler.submit(msg);
+  if (result != AGV_SUBMIT_ACCEPTED) {
+    AGV_RECORD(AGV_EVT_CMD_DROP, msg->source, result, AGVRecorder::head(msg->text(), msg->length));
+    Serial.printf("[SCHED] ❌ Dropped '%s' (%s)\n", msg->text(),
+                  result == AGV_SUBMIT_RATE_LIMITED ? "rate limited" : "queue full");
+    messagePool.release(msg);
   }
+  return result;
 }
 
-// WebSocket event handler - FIXED IMPLEMENTATION
-void AGVCoreNetwork::webSocketEvent(uint8_t num, WStype_t type, uint8_t * payload, size_t length) {
-  if (xSemaphoreTake(mutex, pdMS_TO_TICKS(100)) != pdPASS) return;
+// One weighted round-robin pass over the class queues
+void AGVCoreNetwork::dispatchCommands() {
+  if (scheduler.pending() == 0) return;
+  if (!takeLock(commandLock, __LINE__)) return;
+  runDispatchPass();
+  commandLock.give();
+}
+
+// Called within the commands lock
+void AGVCoreNetwork::runDispatchPass() {
+  scheduler.beginPass();
   
-  switch(type) {
-    case WStype_DISCONNECTED:
-      Serial.printf("[WS] Client #%u disconnected\n", num);
-      break;
-      
-    case WStype_CONNECTED:
-      {
-        if (webSocket) {
-          IPAddress ip = webSocket->remoteIP(num);
-          Serial.printf("[WS] Client #%u connected from %d.%d.%d.%d\n", 
-                       num, ip[0], ip[1], ip[2], ip[3]);
-          webSocket->sendTXT(num, "AGV Connected - Ready for commands");
-        }
-      }
-      break;
-      
-    case WStype_TEXT:
-      {
-        char cmd[65];
-        snprintf(cmd, sizeof(cmd), "%.*s", length, (char*)payload);
-        
-        Serial.printf("\n[WS] Command received from client #%u: '%s'\n", num, cmd);
-        
-        // Process command immediately
-        processCommandUnsafe(cmd, 0);  // 0 = WebSocket source
-        
-        // Echo back to sender
-        if (webSocket) {
-          String response = "Received: " + String(cmd);
-          webSocket->sendTXT(num, response);
-          
-          // Broadcast to all other clients
-          String broadcastMsg = "CLIENT: " + String(cmd);
-          webSocket->broadcastTXT(broadcastMsg);
-        }
-      }
-      break;
+  AGVMessage* msg;
+  while ((msg = scheduler.next()) != nullptr) {
+    AGV_RECORD(AGV_EVT_CMD_EXEC, msg->source, msg->priority | (msg->cls << 8),
+               AGVRecorder::head(msg->text(), msg->length));
+#if AGVNET_ENABLE_CAPTURE
+    uint32_t startUs = micros();
+    processCommandUnsafe(msg);
+    capture.addExec(msg->source, startUs - msg->queuedUs, micros() - startUs, msg->text(), msg->length);
+#else
+    processCommandUnsafe(msg);
+#endif
+    
+    if (msg->source == AGV_SOURCE_SERIAL) {
+      // Echo back to serial
+      Serial.printf("[SERIAL] Executed: %s\n", msg->text());
+    }
+    messagePool.release(msg);
   }
-  
-  xSemaphoreGive(mutex);
 }
 
-// Web route handlers (SPECIAL HANDLING FOR AP MODE)
-void AGVCoreNetwork::handleRoot() {
-  if (isAPMode) {
-    // In AP mode, no mutex protection needed for redirect
-    server->sendHeader("Location", "/setup", true);
-    server->send(302, "text/plain", "");
-  } else {
-    if (xSemaphoreTake(mutex, pdMS_TO_TICKS(100)) != pdPASS) return;
-    server->send_P(200, "text/html", loginPage);
-    xSemaphoreGive(mutex);
+// Drain statuses queued by sendStatus() and broadcast them
+void AGVCoreNetwork::publishPendingStatus() {
+  AGVMessage* msg;
+  while (xQueueReceive(statusQueue, &msg, 0) == pdPASS) {
+    publishStatus(msg->text(), msg->length);
+    messagePool.release(msg);
   }
 }
 
-void AGVCoreNetwork::handleRootRedirect() {
-  // In AP mode, no mutex protection needed for redirect
-  server->sendHeader("Location", "/setup", true);
-  server->send(302, "text/plain", "");
+#if AGVNET_ENABLE_WEBSOCKET
+// Compose "<prefix><text>" in a pool block and send it to one client (num >= 0)
+// or broadcast it (num < 0). Called within the clients lock.
+void AGVCoreNetwork::sendPrefixed(int16_t num, const char* prefix, const char* text, size_t length) {
+  size_t prefixLength = strlen(prefix);
+  AGVMessage* out = messagePool.alloc(prefixLength + length);
+  if (!out) return;  // counted as exhaustion in the pool stats
+  
+  memcpy(out->text(), prefix, prefixLength);
+  memcpy(out->text() + prefixLength, text, length);
+  if (num < 0) {
+    webSocket->broadcastTXT(out->text(), out->length);
+  } else {
+    webSocket->sendTXT((uint8_t)num, out->text(), out->length);
+  }
+  messagePool.release(out);
 }
 
-void AGVCoreNetwork::handleLogin() {
-  if (xSemaphoreTake(mutex, pdMS_TO_TICKS(100)) != pdPASS) return;
+// Heartbeat: ping every client, measure RTT from the echoed timestamp and
+// evaluate operator presence on every pass so link loss is reported within
+// linkLossMs regardless of the ping period.
+void AGVCoreNetwork::serviceHeartbeat() {
+  uint32_t now = millis();
+  uint8_t operators = 0;
+  uint8_t dropped[WEBSOCKETS_SERVER_CLIENT_MAX];
+  uint8_t dropCount = 0;
   
-  if (!server || server->method() != HTTP_POST) {
-    xSemaphoreGive(mutex);
-    return;
+  for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+    AGVClientLink& link = clientLinks[num];
+    if (!link.connected) continue;
+    
+    uint32_t silentMs = now - link.lastSeenMs;
+    if (silentMs > linkDropMs) {
+      link.connected = false;
+      link.alive = false;
+      dropped[dropCount++] = num;
+      continue;
+    }
+    
+    bool alive = silentMs <= linkLossMs;
+    if (link.alive && !alive) {
+      Serial.printf("[WS] Client #%u missed heartbeat (%lu ms silent)\n", num, (unsigned long)silentMs);
+    }
+    link.alive = alive;
+    if (alive) operators++;
   }
   
-  String body = server->arg("plain");
-  
-  int userStart = body.indexOf("\"username\":\"") + 12;
-  int userEnd = body.indexOf("\"", userStart);
-  String username = "";
-  if (userStart > 12 && userEnd > userStart && userEnd < (int)body.length()) {
-    username = body.substring(userStart, userEnd);
+  // Drop dead clients outside the clients lock - disconnect() re-enters webSocketEvent
+  for (uint8_t i = 0; i < dropCount; i++) {
+    Serial.printf("[WS] Client #%u unresponsive - dropping\n", dropped[i]);
+    webSocket->disconnect(dropped[i]);
   }
   
-  int passStart = body.indexOf("\"password\":\"") + 12;
-  int passEnd = body.indexOf("\"", passStart);
-  String password = "";
-  if (passStart > 12 && passEnd > passStart && passEnd < (int)body.length()) {
-    password = body.substring(passStart, passEnd);
+  bool linkUp = operators > 0;
+  if (linkUp != controlLinkUp) {
+    controlLinkUp = linkUp;
+    AGV_RECORD(AGV_EVT_LINK, AGV_SOURCE_WEBSOCKET, operators, linkUp ? 1 : 0);
+    Serial.printf("[LINK] %s (%u operators)\n",
+                  linkUp ? "✅ Control link up" : "❌ Control link lost", operators);
+    
+    LinkCallback callback = nullptr;
+    if (takeLock(clientLock, __LINE__)) {
+      callback = linkCallback;
+      clientLock.give();
+    }
+    if (callback) {
+      callback(linkUp, operators);
+    }
   }
   
-  Serial.printf("\n[AUTH] Login attempt: '%s'\n", username.c_str());
+  if (now - lastHeartbeatMs < heartbeatIntervalMs) return;
+  lastHeartbeatMs = now;
   
-  if (username == admin_username && password == admin_password) {
-    sessionToken = getSessionToken();
-    String response = "{\"success\":true,\"token\":\"" + sessionToken + "\"}";
-    server->send(200, "application/json", response);
-    Serial.println("[AUTH] ✅ Login successful");
-  } else {
-    server->send(200, "application/json", "{\"success\":false}");
-    Serial.println("[AUTH] ❌ Login failed");
+  if (!takeLock(clientLock, __LINE__)) return;
+  for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+    if (!clientLinks[num].connected) continue;
+    // Pong echoes the payload, so the send timestamp travels with the ping
+    uint32_t stamp = micros();
+    clientLinks[num].lastPingMs = now;
+    webSocket->sendPing(num, (uint8_t*)&stamp, sizeof(stamp));
   }
-  
-  xSemaphoreGive(mutex);
+  clientLock.give();
 }
+#endif
 
-void AGVCoreNetwork::handleDashboard() {
-  if (xSemaphoreTake(mutex, pdMS_TO_TICKS(100)) != pdPASS) return;
+// Telemetry queries are answered by the network task from the registry
+// without involving the command callback: "GET" or "GET <key>".
+bool AGVCoreNetwork::handleTelemetryQuery(const char* cmd, char* reply, size_t size) {
+  if (strncasecmp(cmd, "GET", 3) != 0 || (cmd[3] != '\0' && cmd[3] != ' ')) return false;
   
-  if (server) {
-    server->send_P(200, "text/html", mainPage);
+  const char* key = cmd + 3;
+  while (*key == ' ') key++;
+  
+  static const char prefix[] = "STATE: ";
+  size_t len;
+  if (*key == '\0') {
+    len = telemetry.toJson(reply + sizeof(prefix) - 1, size - sizeof(prefix) + 1);
+  } else {
+    len = telemetry.keyToJson(key, reply + sizeof(prefix) - 1, size - sizeof(prefix) + 1);
   }
   
-  xSemaphoreGive(mutex);
+  if (len > 0) {
+    memcpy(reply, prefix, sizeof(prefix) - 1);
+  } else {
+    snprintf(reply, size, "ERROR: unknown telemetry key '%s'", key);
+  }
+  return true;
 }
 
-void AGVCoreNetwork::handleWiFiSetup() {
-  // In AP mode, no mutex protection needed for page serving
-  if (server) {
-    server->send_P(200, "text/html", wifiSetupPage);
-  }
+#if AGVNET_ENABLE_MISSION
+void AGVCoreNetwork::beginMission(uint8_t source, uint8_t owner) {
+  missionParser.begin(&missions[missionStaging], source);
+  missionOwner = owner;
 }
 
-void AGVCoreNetwork::handleScan() {
-  if (xSemaphoreTake(mutex, pdMS_TO_TICKS(100)) != pdPASS) return;
+// Validate the parsed mission and hand it to Core 1 (called within the commands lock)
+AGVMissionError AGVCoreNetwork::finishMission() {
+  AGVMissionError result = missionParser.finish();
   
-  if (!server) {
-    xSemaphoreGive(mutex);
-    return;
+  if (result != AGV_MISSION_OK) {
+    Serial.printf("[MISSION] ❌ Rejected: %s at byte %u\n",
+                  AGVMissionParser::errorText(result), (unsigned)missionParser.errorOffset());
+    return result;
   }
   
-  Serial.println("[WIFI] Scanning networks...");
-  int n = WiFi.scanNetworks();
-  String json = "[";
+  deliverMission();
+  return AGV_MISSION_OK;
+}
+
+// Hand the staged mission to Core 1 (called within the commands lock)
+void AGVCoreNetwork::deliverMission() {
+  AGVMission& mission = missions[missionStaging];
+  mission.id = ++missionSeq;
+  missionStaging ^= 1;  // next upload parses into the other buffer
+  AGV_RECORD(AGV_EVT_MISSION, mission.source, mission.count, mission.id);
   
-  for (int i = 0; i < n; i++) {
-    if (i > 0) json += ",";
-    json += "{";
-    json += "\"ssid\":\"" + WiFi.SSID(i) + "\",";
-    json += "\"rssi\":" + String(WiFi.RSSI(i)) + ",";
-    json += "\"secured\":" + String(WiFi.encryptionType(i) != WIFI_AUTH_OPEN ? "true" : "false");
-    json += "}";
-  }
+  Serial.printf("[MISSION] ✅ Mission #%lu: %u waypoints, %s x%u\n",
+                (unsigned long)mission.id, mission.count,
+                mission.mode == AGV_MISSION_LOOP ? "LOOP" : "ONCE", mission.loops);
   
-  json += "]";
-  server->send(200, "application/json", json);
-  Serial.printf("[WIFI] Found %d networks\n", n);
+#if AGVNET_ENABLE_JOURNAL
+  journal.noteMission(&mission);
+  missionRecovered = false;
+  __atomic_store_n(&missionProgress, 0, __ATOMIC_RELAXED);
+#endif
   
-  xSemaphoreGive(mutex);
+  if (missionCallback) {
+    missionCallback(mission);
+  }
 }
+#endif
 
-void AGVCoreNetwork::handleSaveWiFi() {
-  if (xSemaphoreTake(mutex, pdMS_TO_TICKS(100)) != pdPASS) return;
+#if AGVNET_ENABLE_JOURNAL
+void AGVCoreNetwork::setMissionProgress(uint16_t loop, uint16_t waypoint) {
+  __atomic_store_n(&missionProgress, (uint32_t)loop << 16 | waypoint, __ATOMIC_RELAXED);
+}
+
+void AGVCoreNetwork::clearMission() {
+  if (takeLock(commandLock, __LINE__)) {
+    journal.noteMission(nullptr);
+    missionRecovered = false;
+    __atomic_store_n(&missionProgress, 0, __ATOMIC_RELAXED);
+    commandLock.give();
+  }
+}
+
+const AGVMission* AGVCoreNetwork::getRecoveredMission(uint16_t& loop, uint16_t& waypoint) {
+  const AGVMission* recovered = nullptr;
+  if (takeLock(commandLock, __LINE__)) {
+    if (missionRecovered) {
+      uint32_t progress = __atomic_load_n(&missionProgress, __ATOMIC_RELAXED);
+      loop = progress >> 16;
+      waypoint = progress & 0xFFFF;
+      recovered = &missions[0];
+    }
+    commandLock.give();
+  }
+  return recovered;
+}
+
+// Hand the latest progress to the journal; it writes when a batch is due
+void AGVCoreNetwork::serviceJournal() {
+  if (!journal.ready()) return;
+  uint32_t progress = __atomic_load_n(&missionProgress, __ATOMIC_RELAXED);
+  if (!takeLock(commandLock, __LINE__)) return;
+  journal.noteProgress(progress >> 16, progress & 0xFFFF);
+  journal.service(millis());
+  commandLock.give();
+}
+#endif
+
+#if AGVNET_ENABLE_ROUTING
+bool AGVCoreNetwork::loadMap(const char* rows) {
+  bool loaded = false;
+  if (takeLock(commandLock, __LINE__)) {
+    loaded = router.map().load(rows);
+    commandLock.give();
+  }
+  if (loaded) {
+    Serial.printf("[ROUTE] ✅ Map loaded: %ux%u, %u obstacles\n", router.map().getWidth(),
+                  router.map().getHeight(), router.map().blockedCount());
+  } else {
+    Serial.printf("[ROUTE] ❌ Map rejected (empty or more than %u cells)\n", (unsigned)AGV_GRID_MAX_CELLS);
+  }
+  return loaded;
+}
+
+bool AGVCoreNetwork::setObstacle(uint8_t x, uint8_t y, bool blocked) {
+  bool changed = false;
+  if (takeLock(commandLock, __LINE__)) {
+    changed = router.map().setBlocked(x, y, blocked);
+    commandLock.give();
+  }
+  return changed;
+}
+
+// "PATH:sx,sy,dx,dy:ONCE|LOOP:n" is planned on the grid map and delivered
+// as a waypoint mission. Returns false - the command goes to the command
+// callback unchanged - without a map or mission callback, while an upload
+// owns the staging buffer, or if it does not parse. Called within the
+// commands lock.
+bool AGVCoreNetwork::expandPath(AGVMessage* msg) {
+  const char* text = msg->text();
+  if (strncasecmp(text, "PATH:", 5) != 0) return false;
+  if (!router.map().loaded() || !missionCallback || missionParser.isActive()) return false;
+  
+  int sx, sy, dx, dy, consumed = 0;
+  if (sscanf(text + 5, "%d,%d,%d,%d:%n", &sx, &sy, &dx, &dy, &consumed) != 4 || consumed == 0) {
+    return false;
+  }
+  const char* mode = text + 5 + consumed;
+  AGVMissionMode missionMode = AGV_MISSION_ONCE;
+  long loops = 1;
+  if (strncasecmp(mode, "LOOP:", 5) == 0) {
+    char* end;
+    loops = strtol(mode + 5, &end, 10);
+    if (*end != '\0' || loops < 1 || loops > 0xFFFF) return false;
+    missionMode = AGV_MISSION_LOOP;
+  } else if (strcasecmp(mode, "ONCE") != 0) {
+    return false;
+  }
+  
+  AGVMission& mission = missions[missionStaging];
+  uint16_t count;
+  bool cached;
+  AGVRouteResult result = router.route(sx, sy, dx, dy, mission.waypoints, AGV_MISSION_MAX_WAYPOINTS,
+                                       count, cached);
+  char reply[96];
+  if (result != AGV_ROUTE_OK) {
+    snprintf(reply, sizeof(reply), "ERROR: no route %d,%d -> %d,%d - %s",
+             sx, sy, dx, dy, AGVRouter::resultText(result));
+    Serial.printf("[ROUTE] ❌ %s\n", reply + 7);
+    replyTo(msg, reply);
+    return true;
+  }
+  
+  mission.source = msg->source;
+  mission.mode = missionMode;
+  mission.loops = (uint16_t)loops;
+  mission.count = count;
+  deliverMission();
+  
+  const AGVRouteStats& stats = router.getStats();
+  if (cached) {
+    snprintf(reply, sizeof(reply), "ROUTE: mission #%lu, %u waypoints (cached)",
+             (unsigned long)missionSeq, count);
+  } else {
+    snprintf(reply, sizeof(reply), "ROUTE: mission #%lu, %u waypoints (planned in %lu us, %u cells)",
+             (unsigned long)missionSeq, count, (unsigned long)stats.lastPlanUs, stats.lastExpanded);
+  }
+  Serial.printf("[ROUTE] %s\n", reply + 7);
+  replyTo(msg, reply);
+  return true;
+}
+
+// Answer the sender of a command; serial senders read the log. Called
+// within the commands lock, takes the clients lock for the send.
+void AGVCoreNetwork::replyTo(const AGVMessage* msg, const char* text) {
+#if AGVNET_ENABLE_WEBSOCKET
+  if (msg->source == AGV_SOURCE_WEBSOCKET && msg->client < WEBSOCKETS_SERVER_CLIENT_MAX &&
+      takeLock(clientLock, __LINE__)) {
+    if (clientLinks[msg->client].connected && webSocket) {
+      webSocket->sendTXT(msg->client, text);
+    }
+    clientLock.give();
+  }
+#endif
+#if AGVNET_ENABLE_MQTT
+  if (msg->source == AGV_SOURCE_MQTT) {
+    mqtt.publishReply(text);
+  }
+#endif
+}
+#endif
+
+#if AGVNET_ENABLE_WEBSOCKET && AGVNET_ENABLE_MISSION
+// Binary WebSocket messages carry missions, possibly split into fragments
+void AGVCoreNetwork::handleMissionFrame(uint8_t num, WStype_t type, uint8_t* payload, size_t length) {
+  if (type == WStype_BIN || type == WStype_FRAGMENT_BIN_START) {
+    if (missionParser.isActive() && missionOwner != num) {
+      if (webSocket) webSocket->sendTXT(num, "ERROR: mission upload busy");
+      return;
+    }
+    beginMission(AGV_SOURCE_WEBSOCKET, num);
+  } else if (!missionParser.isActive() || missionOwner != num) {
+    return;  // continuation of a frame we are not parsing
+  }
+  
+  missionParser.feed(payload, length);
+  if (type == WStype_FRAGMENT_BIN_START || type == WStype_FRAGMENT) return;
+  
+  AGVMissionError result = finishMission();
+  if (!webSocket) return;
+  
+  char reply[96];
+  if (result == AGV_MISSION_OK) {
+    const AGVMission& mission = missions[missionStaging ^ 1];
+    snprintf(reply, sizeof(reply), "MISSION: accepted #%lu (%u waypoints)",
+             (unsigned long)mission.id, mission.count);
+  } else {
+    snprintf(reply, sizeof(reply), "ERROR: mission rejected - %s at byte %u",
+             AGVMissionParser::errorText(result), (unsigned)missionParser.errorOffset());
+  }
+  webSocket->sendTXT(num, reply);
+}
+#endif
+
+#if AGVNET_ENABLE_TIMED
+// "AT <time> <command>" runs the command at an absolute time on the sender's
+// clock (WebSocket clients must be synchronised with TSYNC first; serial
+// times are esp_timer microseconds). "AT +<us> <command>" is relative to
+// now. Returns false for anything else; otherwise takes ownership of msg
+// and leaves the answer in reply. Called within the commands lock.
+bool AGVCoreNetwork::scheduleTimed(AGVMessage* msg, char* reply, size_t size) {
+  char* text = msg->text();
+  if (strncasecmp(text, "AT ", 3) != 0) return false;
+  
+  int64_t nowUs = esp_timer_get_time();
+  const char* p = text + 3;
+  while (*p == ' ') p++;
+  bool relative = (*p == '+');
+  if (relative) p++;
+  
+  char* end;
+  long long value = strtoll(p, &end, 10);
+  while (end != p && *end == ' ') end++;
+  size_t length = msg->length - (end - text);
+  if (end == p || length == 0 || end[-1] != ' ') {
+    snprintf(reply, size, "ERROR: usage AT <time_us>|+<delay_us> <command>");
+    timerWheel.noteRejected();
+    messagePool.release(msg);
+    return true;
+  }
+  
+  int64_t deadlineUs = relative ? nowUs + value : value;
+#if AGVNET_ENABLE_WEBSOCKET
+  if (!relative && msg->source == AGV_SOURCE_WEBSOCKET) {
+    if (msg->client >= WEBSOCKETS_SERVER_CLIENT_MAX || !clockSync[msg->client].synced()) {
+      snprintf(reply, size, "ERROR: AT needs clock sync - send TSYNC first");
+      timerWheel.noteRejected();
+      messagePool.release(msg);
+      return true;
+    }
+    deadlineUs = clockSync[msg->client].toLocal(value);
+  }
+#endif
+  
+  if (deadlineUs < nowUs) {
+    snprintf(reply, size, "ERROR: AT time passed %lld us ago", (long long)(nowUs - deadlineUs));
+    timerWheel.noteRejected();
+    messagePool.release(msg);
+    return true;
+  }
+  
+  // Unwrap the command and classify it like any other
+  memmove(text, end, length + 1);
+  msg->length = length;
+  msg->cls = scheduler.classify(text);
+  msg->priority = msg->cls <= AGV_CLASS_CONTROL ? AGV_PRIORITY_HIGH : AGV_PRIORITY_NORMAL;
+  
+  if (!timerWheel.schedule(msg, deadlineUs, nowUs)) {
+    snprintf(reply, size, "ERROR: AT rejected - no free timer or more than %u ms ahead",
+             (unsigned)AGV_TIMER_MAX_DELAY_MS);
+    messagePool.release(msg);
+    return true;
+  }
+  
+  snprintf(reply, size, "AT: '%s' scheduled in %lld us", text, (long long)(deadlineUs - nowUs));
+  Serial.printf("[TIMER] %s\n", reply);
+  return true;
+}
+
+// Fire due AT commands. The last AGV_TIMER_SPIN_US before a target are
+// spun out, so commands start within microseconds of it as long as the
+// loop comes around in time; the achieved skew is kept in the wheel stats.
+// The spin happens before the commands lock is taken, so Core 1 calls
+// that need the lock are not held up by it.
+void AGVCoreNetwork::serviceTimers() {
+  if (timerWheel.pending() == 0) return;
+  
+  int64_t deadlineUs;
+  AGVMessage* msg;
+  while ((msg = timerWheel.expire(esp_timer_get_time() + AGV_TIMER_SPIN_US, deadlineUs)) != nullptr) {
+    while (esp_timer_get_time() < deadlineUs) {
+      // spin
+    }
+    if (!takeLock(commandLock, __LINE__)) {
+      // Late, but not lost: retried on the next pass
+      Serial.printf("[TIMER] ❌ '%s' delayed - commands lock busy\n", msg->text());
+      timerWheel.requeue(msg, deadlineUs);
+      break;
+    }
+    
+    int32_t skewUs = (int32_t)(esp_timer_get_time() - deadlineUs);
+    processCommandUnsafe(msg);
+    timerWheel.noteFired(skewUs);
+    AGV_RECORD(AGV_EVT_TIMED_EXEC, msg->source, msg->priority | (msg->cls << 8), (uint32_t)skewUs);
+    
+    char reply[96];
+    snprintf(reply, sizeof(reply), "AT: executed '%s' (skew %+ld us)", msg->text(), (long)skewUs);
+#if AGVNET_ENABLE_WEBSOCKET
+    if (msg->source == AGV_SOURCE_WEBSOCKET && msg->client < WEBSOCKETS_SERVER_CLIENT_MAX &&
+        takeLock(clientLock, __LINE__)) {
+      if (clientLinks[msg->client].connected && webSocket) {
+        webSocket->sendTXT(msg->client, reply);
+      }
+      clientLock.give();
+    }
+#endif
+#if AGVNET_ENABLE_MQTT
+    if (msg->source == AGV_SOURCE_MQTT) {
+      mqtt.publishReply(reply);
+    }
+#endif
+    commandLock.give();
+    
+    Serial.printf("[TIMER] %s\n", reply);
+    messagePool.release(msg);
+  }
+}
+
+#if AGVNET_ENABLE_WEBSOCKET
+// "TSYNC" opts a client into clock sync; "TSYNC <t1> <t2> <t3>" answers a
+// probe. Called within the clients lock with the frame's arrival time.
+bool AGVCoreNetwork::handleClockSync(uint8_t num, const char* text, size_t length, int64_t receivedUs) {
+  if (length < 5 || strncasecmp(text, "TSYNC", 5) != 0 || (length > 5 && text[5] != ' ')) return false;
+  if (num >= WEBSOCKETS_SERVER_CLIENT_MAX || length >= 80) return true;
+  
+  char line[80];
+  memcpy(line, text, length);
+  line[length] = '\0';
+  
+  AGVClockSync& sync = clockSync[num];
+  long long t1, t2, t3;
+  if (sscanf(line + 5, "%lld %lld %lld", &t1, &t2, &t3) == 3) {
+    bool wasSynced = sync.synced();
+    if (sync.addSample(t1, t2, t3, receivedUs) && !wasSynced && sync.synced()) {
+      char reply[80];
+      snprintf(reply, sizeof(reply), "TSYNC: synced, offset %lld us +/- %lu us",
+               (long long)sync.offsetUs(), (unsigned long)(sync.delayUs() / 2));
+      Serial.printf("[TSYNC] Client #%u %s\n", num, reply + 7);
+      if (webSocket) webSocket->sendTXT(num, reply);
+    }
+  } else if (!sync.enabled) {
+    sync.enabled = true;
+    lastClockSyncMs = 0;  // probe right away
+    Serial.printf("[TSYNC] Client #%u requested clock sync\n", num);
+  }
+  return true;
+}
+
+// Probe every client that asked for clock sync
+void AGVCoreNetwork::serviceClockSync() {
+  uint32_t now = millis();
+  if (now - lastClockSyncMs < AGV_TSYNC_INTERVAL_MS) return;
+  lastClockSyncMs = now;
+  
+  if (!takeLock(clientLock, __LINE__)) return;
+  for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+    if (!clientLinks[num].connected || !clockSync[num].enabled) continue;
+    char probe[32];
+    int64_t t1 = esp_timer_get_time();
+    clockSync[num].probeUs = t1;
+    snprintf(probe, sizeof(probe), "TSYNC %lld", (long long)t1);
+    webSocket->sendTXT(num, probe);
+  }
+  clientLock.give();
+}
+#endif
+#endif
+
+#if AGVNET_ENABLE_DELTA
+// "TELEMETRY DELTA" subscribes a client to the binary delta stream,
+// "TELEMETRY OFF" ends it, "RESYNC" asks for a keyframe after a sequence
+// gap. Called within the clients lock.
+bool AGVCoreNetwork::handleDeltaControl(uint8_t num, const char* text, size_t length) {
+  if (num >= WEBSOCKETS_SERVER_CLIENT_MAX) return false;
+  AGVClientLink& link = clientLinks[num];
+  
+  if (length == 15 && strncasecmp(text, "TELEMETRY DELTA", 15) == 0) {
+    if (!link.deltaTelemetry) {
+      link.deltaTelemetry = true;
+      Serial.printf("[DELTA] Client #%u subscribed\n", num);
+    }
+    sendDeltaKeyframe(num, false);
+  } else if (length == 13 && strncasecmp(text, "TELEMETRY OFF", 13) == 0) {
+    link.deltaTelemetry = false;
+  } else if (length == 6 && strncasecmp(text, "RESYNC", 6) == 0) {
+    if (link.deltaTelemetry) sendDeltaKeyframe(num, true);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void AGVCoreNetwork::sendDeltaKeyframe(uint8_t num, bool resync) {
+  uint8_t frame[AGV_DELTA_FRAME_MAX];
+  size_t length = deltaEncoder.keyframe(frame, sizeof(frame), resync);
+  if (length > 0 && webSocket) {
+    webSocket->sendBIN(num, frame, length);
+  }
+}
+
+// Encode the changed fields once and send the frame to every subscriber
+void AGVCoreNetwork::serviceDelta() {
+  uint32_t now = millis();
+  if (now - lastDeltaMs < AGV_DELTA_INTERVAL_MS) return;
+  lastDeltaMs = now;
+  if (!webSocket || !takeLock(clientLock, __LINE__)) return;
+  
+  bool subscribed = false;
+  for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX && !subscribed; num++) {
+    subscribed = clientLinks[num].connected && clientLinks[num].deltaTelemetry;
+  }
+  if (subscribed) {
+    uint8_t frame[AGV_DELTA_FRAME_MAX];
+    size_t length = deltaEncoder.update(telemetry, now, frame, sizeof(frame));
+    for (uint8_t num = 0; length > 0 && num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+      if (clientLinks[num].connected && clientLinks[num].deltaTelemetry) {
+        webSocket->sendBIN(num, frame, length);
+      }
+    }
+  }
+  clientLock.give();
+}
+#endif
+
+#if AGVNET_ENABLE_MQTT
+bool AGVCoreNetwork::beginMqtt(const char* brokerUri, const char* username, const char* password) {
+  if (isAPMode) {
+    Serial.println("[MQTT] ❌ Not available in setup (AP) mode");
+    return false;
+  }
+  
+  bool started = false;
+  if (takeLock(commandLock, __LINE__)) {
+    started = mqtt.begin(mdnsName, brokerUri, username, password, &messagePool);
+    commandLock.give();
+  }
+  if (started) {
+    Serial.printf("[MQTT] ✅ Client started: %s, commands on agv/%s/cmd\n", brokerUri, mdnsName);
+  } else {
+    Serial.printf("[MQTT] ❌ Could not start client for '%s'\n", brokerUri ? brokerUri : "");
+  }
+  return started;
+}
+
+void AGVCoreNetwork::setMqttQos(uint8_t commandQos, uint8_t statusQos, uint8_t telemetryQos) {
+  if (takeLock(commandLock, __LINE__)) {
+    mqtt.setQos(commandQos, statusQos, telemetryQos);
+    commandLock.give();
+  }
+}
+
+void AGVCoreNetwork::setMqttBatch(uint16_t intervalMs) {
+  if (takeLock(commandLock, __LINE__)) {
+    mqtt.setBatchInterval(intervalMs);
+    commandLock.give();
+  }
+}
+
+// Commands from the broker take the same path as WebSocket and serial ones;
+// answers go to agv/<name>/reply. Then batches and telemetry are published.
+void AGVCoreNetwork::serviceMqtt() {
+  if (!mqtt.active()) return;
+  
+  AGVMessage* msg;
+  while ((msg = mqtt.receive()) != nullptr) {
+    const char* cmd = msg->text();
+    AGV_RECORD_TEXT(AGV_EVT_CMD_RX, AGV_SOURCE_MQTT, cmd, msg->length);
+    if (!takeLock(commandLock, __LINE__)) {
+      messagePool.release(msg);
+      continue;
+    }
+    AGV_CAPTURE(AGV_CAPTURE_RX, AGV_SOURCE_MQTT, cmd, msg->length);
+    
+    char reply[AGV_TELEMETRY_JSON_MAX];
+    if (handleTelemetryQuery(cmd, reply, sizeof(reply))) {
+      mqtt.publishReply(reply);
+      messagePool.release(msg);
+    } else if (!admitCommand(msg)) {
+      mqtt.publishReply("ERROR: rate limited - command dropped");
+    } else {
+      Serial.printf("\n[MQTT] Command received: '%s'\n", cmd);
+#if AGVNET_ENABLE_WEBSOCKET
+      if (webSocket && takeLock(clientLock, __LINE__)) {
+        sendPrefixed(-1, "MQTT: ", cmd, msg->length);
+        clientLock.give();
+      }
+#endif
+      
+#if AGVNET_ENABLE_TIMED
+      // AT envelopes go to the timer wheel
+      if (scheduleTimed(msg, reply, sizeof(reply))) {
+        mqtt.publishReply(reply);
+      } else
+#endif
+      {
+        // Queue for dispatch; tell the sender if it was dropped
+        if (submitCommand(msg, true) != AGV_SUBMIT_ACCEPTED) {
+          mqtt.publishReply("ERROR: queue full - command dropped");
+        }
+      }
+    }
+    commandLock.give();
+  }
+  
+  if (takeLock(commandLock, __LINE__)) {
+    mqtt.service(millis(), telemetry);
+    commandLock.give();
+  }
+}
+#endif
+
+#if AGVNET_ENABLE_API
+// REST batches: each command's result goes back before the next command
+// of the batch is parsed, so responses list them in order
+void AGVCoreNetwork::serviceApi() {
+  AGVMessage* msg;
+  uint8_t slot;
+  for (uint8_t n = 0; n < AGV_API_BATCH_MAX && (msg = api.receive(millis(), slot)) != nullptr; n++) {
+    AGV_RECORD_TEXT(AGV_EVT_CMD_RX, AGV_SOURCE_HTTP, msg->text(), msg->length);
+    if (!takeLock(commandLock, __LINE__)) {
+      messagePool.release(msg);
+      api.result(slot, AGV_API_BUSY);
+      continue;
+    }
+    AGV_CAPTURE(AGV_CAPTURE_RX, AGV_SOURCE_HTTP, msg->text(), msg->length);
+    // A batch can be longer than a class queue: make room instead of refusing the rest
+    if (scheduler.isFull(msg->text())) runDispatchPass();
+    AGVSubmitResult result = submitCommand(msg);
+    commandLock.give();
+    api.result(slot, (AGVApiResult)result);
+  }
+}
+#endif
+
+#if AGVNET_ENABLE_DISCOVERY
+void AGVCoreNetwork::setFirmwareVersion(const char* version) {
+  if (!version) return;
+  firmwareVersion = version;       // advertised when mDNS starts
+  discovery.setFirmware(version);  // or updated by the network task
+}
+#endif
+
+#if AGVNET_ENABLE_SELFTEST
+bool AGVCoreNetwork::startSelfTest() {
+  if (!selfTest.start(commandLock.handle())) {
+    Serial.println("[SELFTEST] ❌ Already running");
+    return false;
+  }
+  Serial.println("[SELFTEST] Started - one sample per network loop pass");
+  return true;
+}
+
+// Take one sample of the current benchmark; print the report when done
+void AGVCoreNetwork::serviceSelfTest() {
+  if (!selfTest.running()) return;
+  
+  uint32_t ns;
+  switch (selfTest.current()) {
+    case AGV_BENCH_MUTEX:
+      if (selfTest.peerLock(ns)) selfTest.record(ns);
+      else selfTest.skip("helper timeout");
+      break;
+    case AGV_BENCH_QUEUE:
+      if (selfTest.peerHandoff(ns)) selfTest.record(ns);
+      else selfTest.skip("helper timeout");
+      break;
+    case AGV_BENCH_PARSE:
+      benchCommandParse();
+      break;
+    case AGV_BENCH_BROADCAST:
+      benchBroadcast();
+      break;
+    case AGV_BENCH_PREFS_WRITE:
+      benchPreferences(true);
+      break;
+    case AGV_BENCH_PREFS_READ:
+      benchPreferences(false);
+      break;
+    default:
+      break;
+  }
+  
+  if (selfTest.finished()) {
+    Serial.printf("[SELFTEST] ✅ %s\n", selfTest.result());
+  }
+}
+
+// What every incoming command pays before dispatch: pool copy, envelope
+// checks and classification
+void AGVCoreNetwork::benchCommandParse() {
+  static const char* const commands[] = {
+    "STOP", "START", "PATH:1,1,3,2:ONCE", "PATH:2,5,8,9:LOOP:3", "DEFAULT", "ABORT"
+  };
+  static uint8_t next = 0;
+  const char* command = commands[next];
+  next = (next + 1) % (sizeof(commands) / sizeof(commands[0]));
+  
+  if (!takeLock(commandLock, __LINE__)) return;
+  uint32_t start = ESP.getCycleCount();
+  AGVMessage* msg = messagePool.copy(command, strlen(command));
+  if (msg) {
+    const char* text = msg->text();
+    bool envelope = strncasecmp(text, "AT ", 3) == 0 || strncasecmp(text, "TSYNC", 5) == 0 ||
+                    strncasecmp(text, "GET", 3) == 0;
+    msg->cls = envelope ? AGV_CLASS_NORMAL : scheduler.classify(text);
+    messagePool.release(msg);
+  }
+  uint32_t cycles = ESP.getCycleCount() - start;
+  commandLock.give();
+  
+  if (msg) selfTest.record((uint32_t)((uint64_t)cycles * 1000 / ESP.getCpuFreqMHz()));
+  else selfTest.skip("message pool exhausted");
+}
+
+void AGVCoreNetwork::benchBroadcast() {
+#if AGVNET_ENABLE_WEBSOCKET
+  uint8_t clients = 0;
+  for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+    if (clientLinks[num].connected) clients++;
+  }
+  if (!webSocket || clients == 0) {
+    selfTest.skip("no WebSocket clients");
+    return;
+  }
+  
+  if (!takeLock(clientLock, __LINE__)) return;
+  uint32_t start = ESP.getCycleCount();
+  webSocket->broadcastTXT("SELFTEST: broadcast probe");
+  uint32_t cycles = ESP.getCycleCount() - start;
+  clientLock.give();
+  
+  selfTest.record((uint32_t)((uint64_t)cycles * 1000 / clients / ESP.getCpuFreqMHz()));
+#else
+  selfTest.skip("WebSocket not built");
+#endif
+}
+
+// Own namespace, cleared at the end so runs leave nothing behind
+void AGVCoreNetwork::benchPreferences(bool write) {
+  Preferences bench;
+  if (!bench.begin("agvbench", false)) {
+    selfTest.skip("NVS unavailable");
+    return;
+  }
+  
+  int64_t startUs = esp_timer_get_time();
+  if (write) {
+    bench.putUInt("probe", (uint32_t)startUs);  // new value, so NVS really writes
+  } else {
+    bench.getUInt("probe", 0);
+  }
+  selfTest.record((uint32_t)((esp_timer_get_time() - startUs) * 1000));
+  
+  if (!write && !selfTest.running()) {
+    bench.clear();
+  }
+  bench.end();
+}
+#endif
+
+// Take a lock domain; timeouts go to the flight recorder and the log with
+// the caller's line, since the caller drops its work
+bool AGVCoreNetwork::takeLock(AGVLock& lock, uint16_t line) {
+  if (lock.take(line)) return true;
+  uint8_t domain = &lock == &commandLock ? 0 : &lock == &clientLock ? 1 : 2;
+  AGV_RECORD(AGV_EVT_MUTEX_TIMEOUT, AGV_SOURCE_INTERNAL, line, domain);
+  Serial.printf("[LOCK] ❌ %s lock timeout at line %u\n", lock.name(), line);
+  return false;
+}
+
+// Command processing without locking (called within the commands lock)
+// Priority was assigned by the scheduler's classifier
+void AGVCoreNetwork::processCommandUnsafe(AGVMessage* msg) {
+#if AGVNET_ENABLE_ROUTING
+  if (expandPath(msg)) return;
+#endif
+  
+  bool handled = false;
+#if AGVNET_ENABLE_DISPATCH
+  AGVDispatchResult routed = dispatcher.dispatch(msg);
+  if (routed == AGV_DISPATCH_DROPPED) {
+    AGV_RECORD(AGV_EVT_CMD_DROP, msg->source, AGV_DROP_HANDLER_BUSY, AGVRecorder::head(msg->text(), msg->length));
+    Serial.printf("[DISPATCH] ❌ Dropped '%s' - handler queue full\n", msg->text());
+    return;
+  }
+  handled = routed != AGV_DISPATCH_UNHANDLED;
+#endif
+  
+  // Send to command callback if registered
+  if (!handled && commandCallback) {
+    handled = true;
+    commandCallback(msg->text(), msg->source, msg->priority);
+  }
+#if AGVNET_ENABLE_JOURNAL
+  if (handled) journal.noteCommand(++commandSeq);
+#endif
+}
+
+#if AGVNET_ENABLE_WEBSOCKET
+// WebSocket event handler - FIXED IMPLEMENTATION
+void AGVCoreNetwork::webSocketEvent(uint8_t num, WStype_t type, uint8_t * payload, size_t length) {
+#if AGVNET_ENABLE_TIMED
+  int64_t receivedUs = esp_timer_get_time();  // before any wait, for clock sync
+#endif
+  // Only frames that may queue commands or missions need the commands lock;
+  // connects, disconnects and heartbeats must not wait behind dispatch
+  bool queues = (type == WStype_TEXT || type == WStype_BIN ||
+                 type == WStype_FRAGMENT_BIN_START || type == WStype_FRAGMENT ||
+                 type == WStype_FRAGMENT_FIN);
+  if (queues && !takeLock(commandLock, __LINE__)) return;
+  if (!takeLock(clientLock, __LINE__)) {
+    if (queues) commandLock.give();
+    return;
+  }
+  if (queues) applyLinkResets();
+  
+  switch(type) {
+    case WStype_DISCONNECTED:
+      Serial.printf("[WS] Client #%u disconnected\n", num);
+      AGV_RECORD(AGV_EVT_WS_DISCONNECT, AGV_SOURCE_WEBSOCKET, num, 0);
+      if (num < WEBSOCKETS_SERVER_CLIENT_MAX) {
+        clientLinks[num].connected = false;
+        clientLinks[num].alive = false;
+        clientLinks[num].deltaTelemetry = false;
+#if AGVNET_ENABLE_TIMED
+        clockSync[num].reset();
+#endif
+        linkResets |= 1UL << num;  // aborts its mission upload
+      }
+      break;
+      
+    case WStype_CONNECTED:
+      {
+        if (num < WEBSOCKETS_SERVER_CLIENT_MAX) {
+          AGVClientLink& link = clientLinks[num];
+          link.connected = true;
+          link.alive = true;
+          link.lastSeenMs = millis();
+          link.lastPingMs = 0;
+          link.rttUs = 0;
+          link.rttAvgUs = 0;
+          link.deltaTelemetry = false;
+#if AGVNET_ENABLE_TIMED
+          clockSync[num].reset();
+#endif
+          linkResets |= 1UL << num;  // fresh rate limit bucket
+        }
+        if (webSocket) {
+          IPAddress ip = webSocket->remoteIP(num);
+          AGV_RECORD(AGV_EVT_WS_CONNECT, AGV_SOURCE_WEBSOCKET, num, (uint32_t)ip);
+          Serial.printf("[WS] Client #%u connected from %d.%d.%d.%d\n", 
+                       num, ip[0], ip[1], ip[2], ip[3]);
+          webSocket->sendTXT(num, "AGV Connected - Ready for commands");
+          
+          // Full telemetry snapshot so fresh dashboards render immediately
+          char snapshot[AGV_TELEMETRY_JSON_MAX];
+          if (handleTelemetryQuery("GET", snapshot, sizeof(snapshot))) {
+            webSocket->sendTXT(num, snapshot);
+          }
+        }
+      }
+      break;
+      
+    case WStype_PONG:
+      if (num < WEBSOCKETS_SERVER_CLIENT_MAX) {
+        AGVClientLink& link = clientLinks[num];
+        link.lastSeenMs = millis();
+        if (length == sizeof(uint32_t)) {
+          uint32_t stamp;
+          memcpy(&stamp, payload, sizeof(stamp));
+          link.rttUs = micros() - stamp;
+          link.rttAvgUs = link.rttAvgUs ? (link.rttAvgUs * 7 + link.rttUs) / 8 : link.rttUs;
+        }
+      }
+      break;
+      
+#if AGVNET_ENABLE_MISSION
+    case WStype_BIN:
+    case WStype_FRAGMENT_BIN_START:
+    case WStype_FRAGMENT:
+    case WStype_FRAGMENT_FIN:
+      handleMissionFrame(num, type, payload, length);
+      break;
+#endif
+      
+    case WStype_TEXT:
+      {
+        if (num < WEBSOCKETS_SERVER_CLIENT_MAX) {
+          clientLinks[num].lastSeenMs = millis();
+        }
+        
+#if AGVNET_ENABLE_TIMED
+        if (handleClockSync(num, (const char*)payload, length, receivedUs)) break;
+#endif
+#if AGVNET_ENABLE_DELTA
+        if (handleDeltaControl(num, (const char*)payload, length)) break;
+#endif
+        
+        AGV_RECORD_TEXT(AGV_EVT_CMD_RX, AGV_SOURCE_WEBSOCKET, (const char*)payload, length);
+        AGV_CAPTURE(AGV_CAPTURE_RX, AGV_SOURCE_WEBSOCKET, (const char*)payload, length);
+        if (length > AGVMessagePool::maxLength()) {
+          AGV_RECORD(AGV_EVT_CMD_DROP, AGV_SOURCE_WEBSOCKET, AGV_DROP_TOO_LONG, 0);
+          Serial.printf("[WS] ❌ Command from client #%u too long (%u bytes)\n", num, (unsigned)length);
+          if (webSocket) {
+            webSocket->sendTXT(num, "ERROR: command too long");
+          }
+          break;
+        }
+        
+        AGVMessage* msg = messagePool.copy((const char*)payload, length);
+        if (!msg) {
+          AGV_RECORD(AGV_EVT_CMD_DROP, AGV_SOURCE_WEBSOCKET, AGV_DROP_NO_BLOCK,
+                     AGVRecorder::head((const char*)payload, length));
+          Serial.printf("[WS] ❌ Message pool exhausted - command from client #%u dropped\n", num);
+          if (webSocket) {
+            webSocket->sendTXT(num, "ERROR: busy - command dropped");
+          }
+          break;
+        }
+        msg->source = AGV_SOURCE_WEBSOCKET;
+        msg->client = num;
+        const char* cmd = msg->text();
+        
+        // Telemetry queries are answered directly to the requesting client
+        char reply[AGV_TELEMETRY_JSON_MAX];
+        if (handleTelemetryQuery(cmd, reply, sizeof(reply))) {
+          if (webSocket) {
+            webSocket->sendTXT(num, reply);
+          }
+          messagePool.release(msg);
+          break;
+        }
+        
+        // Refuse rate-limited frames before the log line and the fan-out
+        if (!admitCommand(msg)) {
+          if (webSocket) {
+            webSocket->sendTXT(num, "ERROR: rate limited - command dropped");
+          }
+          break;
+        }
+        
+        Serial.printf("\n[WS] Command received from client #%u: '%s'\n", num, cmd);
+        
+        // Echo back to sender
+        if (webSocket) {
+          sendPrefixed(num, "Received: ", cmd, msg->length);
+          
+          // Broadcast to all other clients
+          sendPrefixed(-1, "CLIENT: ", cmd, msg->length);
+        }
+        
+#if AGVNET_ENABLE_TIMED
+        // AT envelopes go to the timer wheel
+        if (scheduleTimed(msg, reply, sizeof(reply))) {
+          if (webSocket) {
+            webSocket->sendTXT(num, reply);
+          }
+          break;
+        }
+#endif
+        
+        // Queue for dispatch; tell the sender if it was dropped
+        if (submitCommand(msg, true) != AGV_SUBMIT_ACCEPTED && webSocket) {
+          webSocket->sendTXT(num, "ERROR: queue full - command dropped");
+        }
+      }
+      break;
+      
+    default:
+      break;
+  }
+  
+  clientLock.give();
+  if (queues) commandLock.give();
+}
+
+// Reset the rate limit and mission upload of clients that connected or
+// disconnected. Called within the commands lock.
+void AGVCoreNetwork::applyLinkResets() {
+  for (uint8_t num = 0; linkResets && num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+    if (!(linkResets & (1UL << num))) continue;
+    linkResets &= ~(1UL << num);
+    scheduler.resetSource(AGV_SOURCE_WEBSOCKET, num);
+#if AGVNET_ENABLE_MISSION
+    if (missionParser.isActive() && missionOwner == num) {
+      missionParser.abort();
+    }
+#endif
+  }
+}
+
+void AGVCoreNetwork::serviceLinkResets() {
+  if (!linkResets || !takeLock(commandLock, __LINE__)) return;
+  applyLinkResets();
+  commandLock.give();
+}
+#endif
+
+#if AGVNET_ENABLE_WEBUI
+// Web route handlers (SPECIAL HANDLING FOR AP MODE)
+void AGVCoreNetwork::handleRoot() {
+  if (isAPMode) {
+    // In AP mode, no lock needed for redirect
+    server->sendHeader("Location", "/setup", true);
+    server->send(302, "text/plain", "");
+  } else {
+    // Pages are constants in flash - served without a lock
+    server->send_P(200, "text/html", loginPage);
+  }
+}
+
+void AGVCoreNetwork::handleDashboard() {
+  if (server) {
+#if AGVNET_ENABLE_SELFTEST
+    // Every page load is a send_P sample for the self-test
+    int64_t startUs = esp_timer_get_time();
+    server->send_P(200, "text/html", mainPage);
+    selfTest.notePageSend((uint32_t)((esp_timer_get_time() - startUs) * 1000), sizeof(mainPage) - 1);
+#else
+    server->send_P(200, "text/html", mainPage);
+#endif
+  }
+}
+
+// Shared by the dashboard and the fleet worker
+void AGVCoreNetwork::handleDeltaDecoder() {
+  if (server) {
+    server->send_P(200, "application/javascript", deltaDecoder);
+  }
+}
+#endif
+
+#if AGVNET_ENABLE_FLEET
+void AGVCoreNetwork::handleFleet() {
+  if (server) {
+    server->send_P(200, "text/html", fleetPage);
+  }
+}
+
+// Tabs share the worker only if they load it from the same URL and origin
+void AGVCoreNetwork::handleFleetWorker() {
+  if (server) {
+    server->send_P(200, "application/javascript", fleetWorker);
+  }
+}
+#endif
+
+#if AGVNET_ENABLE_HTTP
+void AGVCoreNetwork::handleLogin() {
+  if (!takeLock(configLock, __LINE__)) return;
   
   if (!server || server->method() != HTTP_POST) {
-    xSemaphoreGive(mutex);
+    configLock.give();
+    return;
+  }
+  
+  const String& body = server->arg("plain");
+  
+#if AGVNET_ENABLE_FLEET
+  // The fleet worker logs in to every vehicle from the origin that served /fleet
+  server->sendHeader("Access-Control-Allow-Origin", "*");
+#endif
+  
+  // Missing or oversized fields stay empty and fail the comparison
+  char username[64] = "";
+  char password[64] = "";
+  AGVJsonTokenizer::findString(body.c_str(), body.length(), "username", username, sizeof(username));
+  AGVJsonTokenizer::findString(body.c_str(), body.length(), "password", password, sizeof(password));
+  
+  Serial.printf("\n[AUTH] Login attempt: '%s'\n", username);
+  
+  if (username[0] != '\0' && admin_username == username && admin_password == password) {
+    char response[128];
+#if AGVNET_ENABLE_AUTH
+    char token[AGV_TOKEN_LENGTH + 1];
+    auth.issue(token, sizeof(token), sessionTtlS);
+    snprintf(response, sizeof(response), "{\"success\":true,\"token\":\"%s\",\"expiresIn\":%lu}",
+             token, (unsigned long)sessionTtlS);
+#else
+    snprintf(response, sizeof(response), "{\"success\":true,\"token\":\"none\"}");
+#endif
+    server->send(200, "application/json", response);
+    Serial.println("[AUTH] ✅ Login successful");
+  } else {
+    server->send(200, "application/json", "{\"success\":false}");
+    Serial.println("[AUTH] ❌ Login failed");
+  }
+  
+  configLock.give();
+}
+
+#if AGVNET_ENABLE_AUTH
+// "Authorization: Bearer <token>" on requests that change vehicle state
+bool AGVCoreNetwork::authorizeHttp() {
+  String header = server->header("Authorization");
+  if (!header.startsWith("Bearer ")) return false;
+  return auth.verify(header.c_str() + 7, header.length() - 7) == AGV_AUTH_OK;
+}
+
+// Lets the dashboard tell an expired session from a network problem
+void AGVCoreNetwork::handleSession() {
+  if (!takeLock(configLock, __LINE__)) return;
+  
+  if (server) {
+    if (authorizeHttp()) {
+      server->send(200, "application/json", "{\"valid\":true}");
+    } else {
+      server->send(401, "application/json", "{\"valid\":false}");
+    }
+  }
+  
+  configLock.give();
+}
+#endif
+
+void AGVCoreNetwork::handleState() {
+  // Telemetry reads are lock-free - no lock needed
+  if (!server) return;
+  
+  char json[AGV_TELEMETRY_JSON_MAX];
+  if (telemetry.toJson(json, sizeof(json)) == 0) {
+    server->send(500, "application/json", "{\"error\":\"telemetry overflow\"}");
+    return;
+  }
+  server->sendHeader("Cache-Control", "no-cache");
+  server->send(200, "application/json", json);
+}
+
+void AGVCoreNetwork::handleStats() {
+  if (!server) return;
+  if (!takeLock(commandLock, __LINE__)) {
+    server->send(503, "application/json", "{\"error\":\"busy\"}");
+    return;
+  }
+  if (!takeLock(clientLock, __LINE__)) {
+    commandLock.give();
+    server->send(503, "application/json", "{\"error\":\"busy\"}");
+    return;
+  }
+  
+  // Snapshot under the locks, send after releasing them: a slow client
+  // must not hold up command dispatch or WebSocket fan-out
+  char json[2048];
+  String doc;
+  doc.reserve(4096);
+  
+  doc += "{\"pool\":";
+  doc += messagePool.toJson(json, sizeof(json)) ? json : "null";
+  doc += ",\"scheduler\":";
+  doc += scheduler.toJson(json, sizeof(json)) ? json : "null";
+  // This request's own hold is still open and shows up on the next one
+  const AGVLock* locks[] = { &commandLock, &clientLock, &configLock };
+  doc += ",\"locks\":[";
+  for (uint8_t i = 0; i < 3; i++) {
+    if (i > 0) doc += ",";
+    doc += locks[i]->toJson(json, sizeof(json)) ? json : "null";
+  }
+  doc += "]";
+#if AGVNET_ENABLE_TIMED
+  doc += ",\"timers\":";
+  doc += timerWheel.toJson(json, sizeof(json)) ? json : "null";
+#if AGVNET_ENABLE_WEBSOCKET
+  doc += ",\"clock\":[";
+  bool first = true;
+  for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+    const AGVClockSync& sync = clockSync[num];
+    if (!clientLinks[num].connected || !sync.enabled) continue;
+    snprintf(json, sizeof(json),
+             "%s{\"client\":%u,\"synced\":%s,\"offsetUs\":%lld,\"delayUs\":%lu,\"samples\":%lu}",
+             first ? "" : ",", num, sync.synced() ? "true" : "false", (long long)sync.offsetUs(),
+             (unsigned long)sync.delayUs(), (unsigned long)sync.samples());
+    doc += json;
+    first = false;
+  }
+  doc += "]";
+#endif
+#endif
+#if AGVNET_ENABLE_MQTT
+  doc += ",\"mqtt\":";
+  doc += mqtt.active() && mqtt.toJson(json, sizeof(json)) ? json : "null";
+#endif
+#if AGVNET_ENABLE_DISPATCH
+  doc += ",\"verbs\":[";
+  for (uint8_t i = 0; i < dispatcher.count(); i++) {
+    if (i > 0) doc += ",";
+    doc += dispatcher.verbToJson(i, json, sizeof(json)) ? json : "null";
+  }
+  doc += "]";
+#endif
+#if AGVNET_ENABLE_EVENTS
+  doc += ",\"events\":";
+  doc += events.toJson(json, sizeof(json)) ? json : "null";
+#endif
+#if AGVNET_ENABLE_PROVISION
+  doc += ",\"provision\":";
+  doc += provisioner.toJson(json, sizeof(json)) ? json : "null";
+#endif
+#if AGVNET_ENABLE_WEBSOCKET
+  doc += ",\"websocket\":";
+  doc += webSocket && webSocket->toJson(json, sizeof(json)) ? json : "null";
+#endif
+#if AGVNET_ENABLE_API
+  doc += ",\"api\":";
+  doc += api.toJson(json, sizeof(json)) ? json : "null";
+#endif
+#if AGVNET_ENABLE_DELTA
+  doc += ",\"delta\":";
+  doc += deltaEncoder.toJson(json, sizeof(json)) ? json : "null";
+#endif
+#if AGVNET_ENABLE_DISCOVERY
+  doc += ",\"discovery\":";
+  doc += discovery.toJson(json, sizeof(json)) ? json : "null";
+#endif
+#if AGVNET_ENABLE_CAPTURE
+  doc += ",\"capture\":";
+  doc += capture.toJson(json, sizeof(json)) ? json : "null";
+#endif
+#if AGVNET_ENABLE_JOURNAL
+  doc += ",\"journal\":";
+  doc += journal.toJson(json, sizeof(json)) ? json : "null";
+#endif
+#if AGVNET_ENABLE_ISR_EVENTS
+  doc += ",\"isr\":";
+  doc += isrQueue.toJson(json, sizeof(json)) ? json : "null";
+#endif
+#if AGVNET_ENABLE_ROUTING
+  doc += ",\"routes\":";
+  doc += router.toJson(json, sizeof(json)) ? json : "null";
+#endif
+#if AGVNET_ENABLE_MQTT || AGVNET_ENABLE_CAPTURE
+  snprintf(json, sizeof(json), ",\"mirrorDrops\":%lu", (unsigned long)mirrorDrops);
+  doc += json;
+#endif
+  snprintf(json, sizeof(json), ",\"statusFallbacks\":%lu}", (unsigned long)statusFallbacks);
+  doc += json;
+  
+  clientLock.give();
+  commandLock.give();
+  
+  server->sendHeader("Cache-Control", "no-cache");
+  server->send(200, "application/json", doc);
+}
+
+#if AGVNET_ENABLE_RECORDER
+// Raw recorder ring for tools/agv_recorder.py, streamed without locking
+void AGVCoreNetwork::handleRecorder() {
+  if (!server) return;
+  
+  uint8_t chunk[512];
+  size_t total = AGVRecorder::downloadSize();
+  server->sendHeader("Cache-Control", "no-cache");
+  server->sendHeader("Content-Disposition", "attachment; filename=\"agv-recorder.bin\"");
+  server->setContentLength(total);
+  server->send(200, "application/octet-stream", "");
+  
+  size_t offset = 0;
+  size_t n;
+  while ((n = recorder.read(offset, chunk, sizeof(chunk))) > 0) {
+    server->sendContent((const char*)chunk, n);
+    offset += n;
+  }
+}
+#endif
+
+#if AGVNET_ENABLE_EVENTS
+// Server-Sent Events stream; the connection is handed to the event stream
+// and stays open after this handler returns
+void AGVCoreNetwork::handleEvents() {
+  if (!server) return;
+  
+  // Browsers resend the last id on reconnect; ?lastEventId= for other clients
+  String lastId = server->header("Last-Event-ID");
+  if (lastId.length() == 0) lastId = server->arg("lastEventId");
+  bool hasLastId = lastId.length() > 0;
+  
+  WiFiClient client = server->client();
+  if (!takeLock(clientLock, __LINE__)) {
+    server->send(503, "text/plain", "Event stream busy");
+    return;
+  }
+  AGVEventAttach result = events.attach(client, hasLastId, hasLastId ? strtoul(lastId.c_str(), nullptr, 10) : 0, millis());
+  clientLock.give();
+  
+  if (result == AGV_SSE_FULL) {
+    server->send(503, "text/plain", "Too many event viewers");
+    return;
+  }
+  if (result == AGV_SSE_WRITE_FAILED) {
+    // The socket is already closed; there is no one left to answer
+    Serial.println("[SSE] ❌ Viewer dropped while sending headers");
+    return;
+  }
+  Serial.printf("[SSE] Viewer connected from %s (%u/%u)%s\n", client.remoteIP().toString().c_str(),
+                events.viewers(), (unsigned)AGV_SSE_VIEWERS, hasLastId ? ", resuming" : "");
+}
+
+// Encode telemetry once for all viewers (only while someone watches), then
+// write pending frames
+void AGVCoreNetwork::serviceEvents() {
+  if (events.viewers() == 0) return;
+  if (!takeLock(clientLock, __LINE__)) return;
+  
+  uint32_t now = millis();
+  uint32_t version = telemetry.version();
+  if (version != eventsTelemetryVersion && now - eventsTelemetryMs >= AGV_SSE_TELEMETRY_MS) {
+    char json[AGV_TELEMETRY_JSON_MAX];
+    size_t length = telemetry.toJson(json, sizeof(json));
+    if (length > 0) events.setTelemetry(json, length);
+    eventsTelemetryVersion = version;
+    eventsTelemetryMs = now;
+  }
+  events.service(now);
+  clientLock.give();
+}
+#endif
+
+#if AGVNET_ENABLE_CAPTURE
+bool AGVCoreNetwork::startCapture() {
+  bool started = false;
+  if (takeLock(commandLock, __LINE__)) {
+    started = capture.start();
+    commandLock.give();
+  }
+  if (started) {
+    Serial.printf("[CAPTURE] Started (%u B buffer)\n", (unsigned)AGV_CAPTURE_BYTES);
+  } else {
+    Serial.println("[CAPTURE] ❌ Cannot allocate the capture buffer");
+  }
+  return started;
+}
+
+void AGVCoreNetwork::stopCapture() {
+  if (takeLock(commandLock, __LINE__)) {
+    if (capture.active()) {
+      capture.stop();
+      Serial.println("[CAPTURE] Stopped");
+    }
+    commandLock.give();
+  }
+}
+
+// Capture file for tools/agv_replay.py; a running capture is stopped first
+// so the download is one complete session
+void AGVCoreNetwork::handleCapture() {
+  if (!server) return;
+  stopCapture();
+  
+  uint8_t chunk[512];
+  size_t total = capture.downloadSize();
+  server->sendHeader("Cache-Control", "no-cache");
+  server->sendHeader("Content-Disposition", "attachment; filename=\"agv-capture.bin\"");
+  server->setContentLength(total);
+  server->send(200, "application/octet-stream", "");
+  
+  size_t offset = 0;
+  size_t n;
+  while ((n = capture.read(offset, chunk, sizeof(chunk))) > 0) {
+    server->sendContent((const char*)chunk, n);
+    offset += n;
+  }
+}
+
+// POST /capture?action=start|stop
+void AGVCoreNetwork::handleCaptureControl() {
+  if (!server) return;
+  
+#if AGVNET_ENABLE_AUTH
+  bool authorized = false;
+  if (takeLock(configLock, __LINE__)) {
+    authorized = authorizeHttp();
+    configLock.give();
+  }
+  if (!authorized) {
+    server->send(401, "application/json", "{\"success\":false,\"error\":\"login required\"}");
+    return;
+  }
+#endif
+  
+  String action = server->arg("action");
+  if (action == "start") {
+    if (startCapture()) {
+      server->send(200, "application/json", "{\"success\":true}");
+    } else {
+      server->send(507, "application/json", "{\"success\":false,\"error\":\"out of memory\"}");
+    }
+  } else if (action == "stop") {
+    stopCapture();
+    server->send(200, "application/json", "{\"success\":true}");
+  } else {
+    server->send(400, "application/json", "{\"success\":false,\"error\":\"action must be start or stop\"}");
+  }
+}
+#endif
+
+#if AGVNET_ENABLE_SELFTEST
+// Latest self-test report; 202 while a run is in progress
+void AGVCoreNetwork::handleSelfTest() {
+  if (!server) return;
+  
+  server->sendHeader("Cache-Control", "no-cache");
+  if (selfTest.running()) {
+    char json[64];
+    snprintf(json, sizeof(json), "{\"running\":true,\"phase\":\"%s\"}",
+             AGVSelfTest::phaseName(selfTest.current()));
+    server->send(202, "application/json", json);
+  } else if (selfTest.finished()) {
+    server->send(200, "application/json", selfTest.result());
+  } else {
+    server->send(404, "application/json", "{\"error\":\"no self-test run yet\"}");
+  }
+}
+
+void AGVCoreNetwork::handleSelfTestStart() {
+  if (!server) return;
+  
+#if AGVNET_ENABLE_AUTH
+  bool authorized = false;
+  if (takeLock(configLock, __LINE__)) {
+    authorized = authorizeHttp();
+    configLock.give();
+  }
+  if (!authorized) {
+    server->send(401, "application/json", "{\"success\":false,\"error\":\"login required\"}");
     return;
   }
+#endif
+  
+  if (startSelfTest()) {
+    server->send(202, "application/json", "{\"success\":true}");
+  } else {
+    server->send(409, "application/json", "{\"success\":false,\"error\":\"self-test already running\"}");
+  }
+}
+#endif
+
+#if AGVNET_ENABLE_ROUTING
+// Current grid map as text rows
+void AGVCoreNetwork::handleMap() {
+  if (!server) return;
+  if (!takeLock(commandLock, __LINE__)) {
+    server->send(503, "text/plain", "Map busy");
+    return;
+  }
+  
+  // Copy the rows under the lock, send after releasing it: a slow client
+  // must not hold up command dispatch (at most 2 * AGV_GRID_MAX_CELLS bytes)
+  bool loaded = router.map().loaded();
+  String rows;
+  if (loaded) {
+    uint8_t width = router.map().getWidth();
+    uint16_t height = router.map().getHeight();
+    rows.reserve((size_t)(width + 1) * height);
+    for (uint16_t y = 0; y < height; y++) {
+      for (uint16_t x = 0; x < width; x++) {
+        rows += router.map().blocked(y * width + x) ? '#' : '.';
+      }
+      rows += '\n';
+    }
+  }
+  commandLock.give();
+  
+  if (!loaded) {
+    server->send(404, "text/plain", "No map loaded");
+    return;
+  }
+  server->sendHeader("Cache-Control", "no-cache");
+  server->send(200, "text/plain", rows);
+}
+
+// Replace the grid map; cached routes of the old map are invalidated
+void AGVCoreNetwork::handleMapUpload() {
+  if (!server) return;
+  
+#if AGVNET_ENABLE_AUTH
+  bool authorized = false;
+  if (takeLock(configLock, __LINE__)) {
+    authorized = authorizeHttp();
+    configLock.give();
+  }
+  if (!authorized) {
+    server->send(401, "application/json", "{\"success\":false,\"error\":\"login required\"}");
+    return;
+  }
+#endif
   
   String body = server->arg("plain");
+  if (!loadMap(body.c_str())) {
+    char response[96];
+    snprintf(response, sizeof(response), "{\"success\":false,\"error\":\"empty map or more than %u cells\"}",
+             (unsigned)AGV_GRID_MAX_CELLS);
+    server->send(400, "application/json", response);
+    return;
+  }
+  
+  char response[96];
+  snprintf(response, sizeof(response), "{\"success\":true,\"width\":%u,\"height\":%u,\"blocked\":%u}",
+           router.map().getWidth(), router.map().getHeight(), router.map().blockedCount());
+  server->send(200, "application/json", response);
+}
+#endif
+
+#if AGVNET_ENABLE_MISSION
+// Streamed body of POST /mission - parsed chunk by chunk, never buffered whole
+void AGVCoreNetwork::handleMissionUpload() {
+  if (!server) return;
+  HTTPRaw& raw = server->raw();
+  
+  switch (raw.status) {
+    case RAW_START:
+#if AGVNET_ENABLE_AUTH
+      // Unauthorised bodies are never parsed
+      missionHttpStarted = false;
+      if (!takeLock(configLock, __LINE__)) break;
+      if (!authorizeHttp()) {
+        configLock.give();
+        break;
+      }
+      configLock.give();
+#endif
+      missionHttpStarted = !missionParser.isActive();
+      if (missionHttpStarted) {
+        beginMission(AGV_SOURCE_HTTP, 0xFF);
+      }
+      break;
+    case RAW_WRITE:
+      if (missionHttpStarted && missionParser.isActive()) {
+        missionParser.feed(raw.buf, raw.currentSize);
+      }
+      break;
+    case RAW_ABORTED:
+      if (missionHttpStarted) {
+        missionParser.abort();
+        missionHttpStarted = false;
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+void AGVCoreNetwork::handleMissionDone() {
+  if (!server) return;
+  
+#if AGVNET_ENABLE_AUTH
+  bool authorized = false;
+  if (takeLock(configLock, __LINE__)) {
+    authorized = authorizeHttp();
+    configLock.give();
+  }
+  if (!authorized) {
+    server->send(401, "application/json", "{\"success\":false,\"error\":\"login required\"}");
+    return;
+  }
+#endif
+  
+  if (!takeLock(commandLock, __LINE__)) {
+    // Drop this body so the next upload starts clean
+    if (missionHttpStarted) {
+      missionParser.abort();
+      missionHttpStarted = false;
+    }
+    server->send(503, "application/json", "{\"success\":false,\"error\":\"busy\"}");
+    return;
+  }
+  
+  if (!missionHttpStarted) {
+    if (missionParser.isActive()) {
+      server->send(409, "application/json", "{\"success\":false,\"error\":\"mission upload busy\"}");
+    } else {
+      server->send(400, "application/json", "{\"success\":false,\"error\":\"expected raw mission body\"}");
+    }
+    commandLock.give();
+    return;
+  }
+  missionHttpStarted = false;
+  
+  char response[128];
+  AGVMissionError result = finishMission();
+  if (result == AGV_MISSION_OK) {
+    const AGVMission& mission = missions[missionStaging ^ 1];
+    snprintf(response, sizeof(response), "{\"success\":true,\"mission\":%lu,\"waypoints\":%u}",
+             (unsigned long)mission.id, mission.count);
+    server->send(200, "application/json", response);
+  } else {
+    snprintf(response, sizeof(response), "{\"success\":false,\"error\":\"%s\",\"offset\":%u}",
+             AGVMissionParser::errorText(result), (unsigned)missionParser.errorOffset());
+    server->send(400, "application/json", response);
+  }
+  
+  commandLock.give();
+}
+#endif
+
+void AGVCoreNetwork::handleNotFound() {
+#if AGVNET_ENABLE_AP_PORTAL
+  if (isAPMode) {
+    // In AP mode, redirect everything to setup - NO MUTEX NEEDED
+    String header = "HTTP/1.1 302 Found\r\n";
+    header += "Location: http://192.168.4.1/setup\r\n";
+    header += "Cache-Control: no-cache\r\n";
+    header += "Connection: close\r\n";
+    header += "\r\n";
+    
+    server->client().write(header.c_str(), header.length());
+    server->client().stop();
+    return;
+  }
+#endif
+  server->send(404, "text/plain", "File Not Found");
+}
+#endif
+
+#if AGVNET_ENABLE_AP_PORTAL
+void AGVCoreNetwork::handleRootRedirect() {
+  // In AP mode, no lock needed for redirect
+  server->sendHeader("Location", "/setup", true);
+  server->send(302, "text/plain", "");
+}
+
+void AGVCoreNetwork::handleWiFiSetup() {
+  // In AP mode, no lock needed for page serving
+  if (server) {
+    server->send_P(200, "text/html", wifiSetupPage);
+  }
+}
+
+// Scans run in the background: the first request starts one and, like
+// every request until it is done, gets 202; the page polls. The network
+// task keeps serving meanwhile. Only touches the WiFi driver - no lock.
+void AGVCoreNetwork::handleScan() {
+  if (!server) return;
+  
+  int n = WiFi.scanComplete();
+  if (n == WIFI_SCAN_FAILED) {  // none started yet, or the last one failed
+    Serial.println("[WIFI] Scanning networks...");
+    WiFi.scanNetworks(true);
+    n = WIFI_SCAN_RUNNING;
+  }
+  if (n == WIFI_SCAN_RUNNING) {
+    server->send(202, "application/json", "{\"scanning\":true}");
+    return;
+  }
+  
+  String json = "[";
+  
+  for (int i = 0; i < n; i++) {
+    if (i > 0) json += ",";
+    json += "{";
+    json += "\"ssid\":\"" + WiFi.SSID(i) + "\",";
+    json += "\"rssi\":" + String(WiFi.RSSI(i)) + ",";
+    json += "\"secured\":" + String(WiFi.encryptionType(i) != WIFI_AUTH_OPEN ? "true" : "false");
+    json += "}";
+  }
+  
+  json += "]";
+  WiFi.scanDelete();  // the next request starts a fresh scan
+  server->send(200, "application/json", json);
+  Serial.printf("[WIFI] Found %d networks\n", n);
+}
+
+void AGVCoreNetwork::handleSaveWiFi() {
+  if (!takeLock(configLock, __LINE__)) return;
   
-  int ssidStart = body.indexOf("\"ssid\":\"") + 8;
-  int ssidEnd = body.indexOf("\"", ssidStart);
-  String ssid = "";
-  if (ssidStart > 8 && ssidEnd > ssidStart && ssidEnd < (int)body.length()) {
-    ssid = body.substring(ssidStart, ssidEnd);
+  if (!server || server->method() != HTTP_POST) {
+    configLock.give();
+    return;
   }
   
-  int passStart = body.indexOf("\"password\":\"") + 12;
-  int passEnd = body.indexOf("\"", passStart);
-  String password = "";
-  if (passStart > 12 && passEnd > passStart && passEnd < (int)body.length()) {
-    password = body.substring(passStart, passEnd);
+  const String& body = server->arg("plain");
+  
+  // 802.11 limits: SSID 32 bytes, passphrase 63
+  char ssid[33] = "";
+  char password[64] = "";
+  if (!AGVJsonTokenizer::findString(body.c_str(), body.length(), "ssid", ssid, sizeof(ssid)) || ssid[0] == '\0') {
+    server->send(400, "application/json", "{\"success\":false,\"error\":\"ssid missing or too long\"}");
+    configLock.give();
+    return;
   }
+  AGVJsonTokenizer::findString(body.c_str(), body.length(), "password", password, sizeof(password));
   
-  Serial.printf("\n[WIFI] Saving credentials: '%s'\n", ssid.c_str());
+  Serial.printf("\n[WIFI] Saving credentials: '%s'\n", ssid);
   
   // Save to preferences
   preferences.begin("agvnet", false);
@@ -503,9 +2833,10 @@ void AGVCoreNetwork::handleSaveWiFi() {
   
   server->send(200, "application/json", "{\"success\":true}");
   
-  xSemaphoreGive(mutex);
+  configLock.give();
   
   Serial.println("[WIFI] ✅ Credentials saved. Restarting...");
+  AGV_RECORD(AGV_EVT_RESTART, AGV_SOURCE_HTTP, __LINE__, 0);
   delay(1000);
   ESP.restart();
 }
@@ -521,21 +2852,4 @@ void AGVCoreNetwork::handleCaptivePortal() {
   server->client().write(header.c_str(), header.length());
   server->client().stop();
 }
-
-void AGVCoreNetwork::handleNotFound() {
-  if (isAPMode) {
-    // In AP mode, redirect everything to setup - NO MUTEX NEEDED
-    String header = "HTTP/1.1 302 Found\r\n";
-    header += "Location: http://192.168.4.1/setup\r\n";
-    header += "Cache-Control: no-cache\r\n";
-    header += "Connection: close\r\n";
-    header += "\r\n";
-    
-    server->client().write(header.c_str(), header.length());
-    server->client().stop();
-  } else {
-    if (xSemaphoreTake(mutex, pdMS_TO_TICKS(100)) != pdPASS) return;
-    server->send(404, "text/plain", "File Not Found");
-    xSemaphoreGive(mutex);
-  }
-}
\ No newline at end of file
+#endif
@@ -2,32 +2,75 @@
 #define AGVCORENETWORK_H
 
 #include <Arduino.h>
+#include "AGVCoreNetworkConfig.h"
+#if AGVNET_ENABLE_WIFI
 #include <WiFi.h>
+#endif
+#if AGVNET_ENABLE_HTTP
 #include <WebServer.h>
+#endif
+#if AGVNET_ENABLE_WEBSOCKET
 #include <WebSocketsServer.h>
+#include "AGVWsServer.h"
+#endif
+#if AGVNET_ENABLE_MDNS
 #include <ESPmDNS.h>
-#include <Preferences.h>
+#endif
+#if AGVNET_ENABLE_AP_PORTAL
 #include <DNSServer.h>
+#endif
+#include <Preferences.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <freertos/queue.h>
 #include <freertos/semphr.h>
+#include "AGVTelemetry.h"
+#include "AGVMission.h"
+#include "AGVMessagePool.h"
+#include "AGVScheduler.h"
+#include "AGVRecorder.h"
+#include "AGVClock.h"
+#include "AGVAuth.h"
+#include "AGVSelfTest.h"
+#include "AGVMqtt.h"
+#include "AGVRoute.h"
+#include "AGVIsrQueue.h"
+#include "AGVJournal.h"
+#include "AGVDispatch.h"
+#include "AGVCapture.h"
+#include "AGVDiscovery.h"
+#include "AGVEventStream.h"
+#include "AGVDelta.h"
+#include "AGVProvision.h"
+#include "AGVApi.h"
+#include "AGVLock.h"
+
 
 // Unique library namespace to prevent conflicts
 namespace AGVCoreNetworkLib {
 
-// Command structure for inter-core communication
+// Per-client WebSocket link state (heartbeat / RTT tracking)
 typedef struct {
-  char command[64];
-  uint8_t source;  // 0=WebSocket, 1=Serial
-  uint8_t priority; // 0=normal, 1=high (STOP/ABORT)
-} AGVCommandMessage;
+  bool connected;
+  bool alive;          // answered within the link-loss bound
+  uint32_t lastSeenMs; // last pong or frame received
+  uint32_t lastPingMs; // last ping sent
+  uint32_t rttUs;      // last measured round-trip time
+  uint32_t rttAvgUs;   // smoothed round-trip time
+  bool deltaTelemetry; // subscribed to the binary delta telemetry stream
+} AGVClientLink;
 
 class AGVCoreNetwork {
 public:
   // Callback function type for command processing
   typedef void (*CommandCallback)(const char* command, uint8_t source, uint8_t priority);
   
+  // Callback for uploaded missions (valid until the next mission is delivered)
+  typedef void (*MissionCallback)(const AGVMission& mission);
+  
+  // Callback for operator presence changes (linkUp=false means control link lost)
+  typedef void (*LinkCallback)(bool linkUp, uint8_t operators);
+  
   // Initialize the network system - 1 of 4 lines
   void begin(const char* deviceName = "agvcontrol", 
              const char* adminUser = "admin", 
@@ -36,67 +79,415 @@ public:
   // Set callback for received commands - 2 of 4 lines
   void setCommandCallback(CommandCallback callback);
   
+#if AGVNET_ENABLE_DISPATCH
+  // Per-verb handlers ("PATH" matches "PATH:..." and "PATH ..."), looked up
+  // through a perfect hash before the command callback. CORE1 handlers run
+  // when the control loop calls runQueuedCommands(); WORKER handlers on a
+  // task one priority below the network task. A nullptr handler removes
+  // the verb; its context cannot change while jobs for it are queued.
+  bool on(const char* verb, AGVVerbHandler handler, AGVHandlerContext context = AGV_CONTEXT_INLINE);
+  uint8_t runQueuedCommands(uint8_t max = AGV_DISPATCH_QUEUE_LEN);
+#endif
+  
+  // Set callback for batch mission uploads (HTTP POST /mission, WS binary)
+  void setMissionCallback(MissionCallback callback);
+  
+  // Command scheduling: classifier rule ("STOP", "PATH:*"), per-class
+  // weight per dispatch pass, and per-source token bucket (0 disables)
+  bool setCommandClass(const char* pattern, AGVCommandClass cls);
+  void setClassWeight(AGVCommandClass cls, uint8_t weight);
+  void setRateLimit(uint16_t perSecond, uint16_t burst);
+  
+  // Set callback for control link lost / restored events. It runs on the
+  // network task (Core 0), not in loop(): keep it short and non-blocking,
+  // e.g. set a flag the Core 1 control loop acts on.
+  void setLinkCallback(LinkCallback callback);
+  
+  // Configure WebSocket heartbeat: ping period, link-loss bound and drop timeout (ms)
+  void setHeartbeat(uint16_t pingIntervalMs, uint16_t linkLossMs, uint16_t dropAfterMs = 3000);
+  
+  // True while at least one operator answers heartbeats within the link-loss bound
+  bool isControlLinkUp() const { return controlLinkUp; }
+  
+  // Smoothed WebSocket round-trip time for a client in microseconds (0 = unknown)
+  uint32_t getClientRtt(uint8_t num) const;
+  
   // Send status update to all interfaces - 3 of 4 lines
   void sendStatus(const char* status);
   
+  // Publish typed telemetry (lock-free, safe to call from the control loop)
+  bool setTelemetry(const char* key, int value) { return telemetry.setInt(key, value); }
+  bool setTelemetry(const char* key, long value) { return telemetry.setInt(key, (int32_t)value); }
+  bool setTelemetry(const char* key, float value) { return telemetry.setFloat(key, value); }
+  bool setTelemetry(const char* key, double value) { return telemetry.setFloat(key, (float)value); }
+  bool setTelemetry(const char* key, const char* value) { return telemetry.setText(key, value); }
+  
+  // Message pool counters (allocations, spills, exhaustion per size class)
+  const AGVMessagePool& getMessagePool() const { return messagePool; }
+  
+  // Read access to the telemetry registry
+  const AGVTelemetry& getTelemetry() const { return telemetry; }
+  
   // Emergency broadcast (bypasses normal queue)
   void broadcastEmergency(const char* message);
   
+#if AGVNET_ENABLE_ISR_EVENTS
+  // Interrupt-safe variants: copy up to AGV_ISR_TEXT_MAX - 1 bytes into a
+  // lock-free ring and wake the network task, which publishes them on its
+  // next pass. False if the ring is full (counted in /stats "isr").
+  // Telemetry keys set here must not be written from anywhere else.
+  bool sendStatusFromISR(const char* status);
+  bool broadcastEmergencyFromISR(const char* message);
+  bool setTelemetryFromISR(const char* key, int32_t value);
+#endif
+  
+#if AGVNET_ENABLE_AUTH
+  // Operator sessions: lifetime of new tokens, revoke all live tokens, and
+  // mint a token for clients provisioned by the application (e.g. a gateway)
+  void setSessionTtl(uint32_t seconds);
+  void revokeSessions();
+  bool issueSessionToken(char* out, size_t size);
+#endif
+  
+#if AGVNET_ENABLE_MQTT
+  // MQTT transport on agv/<deviceName>/... (topics in AGVMqtt.h); call after
+  // begin(). QoS per direction and the status batch interval are adjustable.
+  bool beginMqtt(const char* brokerUri, const char* username = nullptr, const char* password = nullptr);
+  void setMqttQos(uint8_t commandQos, uint8_t statusQos, uint8_t telemetryQos);
+  void setMqttBatch(uint16_t intervalMs);
+  bool isMqttConnected() const { return mqtt.connected(); }
+#endif
+  
+#if AGVNET_ENABLE_ROUTING
+  // Grid map for PATH expansion (text rows, '#' = obstacle; format in
+  // AGVRoute.h). With a map loaded and a mission callback set, PATH commands
+  // are planned here and delivered as missions instead of raw commands.
+  bool loadMap(const char* rows);
+  bool setObstacle(uint8_t x, uint8_t y, bool blocked);
+#endif
+  
+#if AGVNET_ENABLE_JOURNAL
+  // Crash recovery. Report progress through the mission last delivered
+  // (lock-free, cheap enough for every control step - flash is written in
+  // batches by the network task) and clear it when finished or aborted.
+  void setMissionProgress(uint16_t loop, uint16_t waypoint);
+  void clearMission();
+  
+  // Mission recovered from the journal at begin() with its last reported
+  // progress, or nullptr. Valid until the next mission is delivered.
+  const AGVMission* getRecoveredMission(uint16_t& loop, uint16_t& waypoint);
+#endif
+  
+#if AGVNET_ENABLE_SELFTEST
+  // Start the benchmark suite (result printed to serial and served at GET /selftest)
+  bool startSelfTest();
+#endif
+  
+#if AGVNET_ENABLE_RECORDER
+  // Flight recorder (application events use AGV_EVT_USER and above)
+  AGVRecorder& getRecorder() { return recorder; }
+#endif
+  
+#if AGVNET_ENABLE_DISCOVERY
+  // Version advertised in the _agv._tcp TXT record (default AGVNET_FIRMWARE_VERSION);
+  // the string must stay valid
+  void setFirmwareVersion(const char* version);
+#endif
+  
+#if AGVNET_ENABLE_PROVISION
+  // Fleet key for zero-touch provisioning (tools/agv_provision.py); call
+  // before begin(). In setup mode or without credentials the vehicle then
+  // accepts WiFi credentials and a device name signed with this key.
+  bool setProvisioningKey(const char* key) { return provisioner.setKey(key); }
+#endif
+  
+#if AGVNET_ENABLE_CAPTURE
+  // Session capture for tools/agv_replay.py: inbound frames, broadcasts and
+  // command timings until stopped or full; downloaded from GET /capture
+  bool startCapture();
+  void stopCapture();
+#endif
+  
+  // Print the static RAM and flash reserved by the compiled-in subsystems
+  void printFootprint();
+  
+#if AGVNET_ENABLE_WEBSOCKET
   // WebSocket event handler (public for library access)
   void webSocketEvent(uint8_t num, WStype_t type, uint8_t * payload, size_t length);
+#endif
   
   // Library handles everything else automatically
   void loop(); // Called automatically in background task
 
 private:
   // Internal implementation details hidden from user
+#if AGVNET_ENABLE_HTTP
   WebServer* server = nullptr;
-  WebSocketsServer* webSocket = nullptr;
+#endif
+#if AGVNET_ENABLE_WEBSOCKET
+  AGVWsServer* webSocket = nullptr;
+#endif
+#if AGVNET_ENABLE_AP_PORTAL
   DNSServer* dnsServer = nullptr;
+#endif
   Preferences preferences;
+  AGVTelemetry telemetry;
+  AGVMessagePool messagePool;
+  AGVScheduler scheduler;
+#if AGVNET_ENABLE_RECORDER
+  AGVRecorder recorder;
+#endif
+#if AGVNET_ENABLE_CAPTURE
+  AGVCapture capture;
+#endif
+#if AGVNET_ENABLE_EVENTS
+  AGVEventStream events;
+  uint32_t eventsTelemetryVersion = 0;
+  uint32_t eventsTelemetryMs = 0;
+  void serviceEvents();
+#endif
+#if AGVNET_ENABLE_PROVISION
+  AGVProvisioner provisioner;
+  void serviceProvisioning();
+  bool storeProvisioning(const AGVProvisionRequest& request);
+  void applyProvisioning();
+#endif
+#if AGVNET_ENABLE_DELTA
+  AGVDeltaEncoder deltaEncoder;
+  uint32_t lastDeltaMs = 0;
+  bool handleDeltaControl(uint8_t num, const char* text, size_t length);
+  void sendDeltaKeyframe(uint8_t num, bool resync);
+  void serviceDelta();
+#endif
+#if AGVNET_ENABLE_API
+  AGVApiServer api;
+  void serviceApi();
+#endif
+#if AGVNET_ENABLE_DISCOVERY
+  AGVDiscovery discovery;
+  const char* firmwareVersion = AGVNET_FIRMWARE_VERSION;
+#endif
+  QueueHandle_t statusQueue = nullptr;
+  uint32_t statusFallbacks = 0;  // statuses published synchronously (pool/queue full)
+#if AGVNET_ENABLE_MQTT || AGVNET_ENABLE_CAPTURE
+  QueueHandle_t mirrorQueue = nullptr;  // statuses/emergencies for MQTT and capture
+  uint32_t mirrorDrops = 0;             // not mirrored: pool or queue full
+  void mirror(const char* text, size_t length, uint8_t priority);
+  void serviceMirror();
+#endif
   
   String stored_ssid;
   String stored_password;
+  String stored_name;    // device name from provisioning (overrides begin())
   String admin_username;
   String admin_password;
-  String sessionToken;
+#if AGVNET_ENABLE_AUTH
+  AGVTokenAuth auth;
+  uint32_t sessionTtlS = AGVNET_SESSION_TTL_S;
+#endif
   
   bool isAPMode = false;
   const char* mdnsName = nullptr;
-  const char* ap_ssid = "AGV_Controller_Network";
-  const char* ap_password = "AGVSecure123";
+  const char* ap_ssid = AGVNET_AP_SSID;
+  const char* ap_password = AGVNET_AP_PASSWORD;
   
   CommandCallback commandCallback = nullptr;
-  SemaphoreHandle_t mutex = nullptr;
+  LinkCallback linkCallback = nullptr;
+  MissionCallback missionCallback = nullptr;
+  
+#if AGVNET_ENABLE_MISSION
+  // Mission upload: parse into one buffer while Core 1 uses the other
+  AGVMission missions[2];
+  uint8_t missionStaging = 0;
+  uint32_t missionSeq = 0;
+  AGVMissionParser missionParser;
+  uint8_t missionOwner = 0xFF;  // WS client feeding the parser, 0xFF = HTTP
+  bool missionHttpStarted = false;
+#endif
+  
+  // Heartbeat configuration and per-client link state
+  uint16_t heartbeatIntervalMs = 100;
+  uint16_t linkLossMs = 300;
+  uint16_t linkDropMs = 3000;
+  uint32_t lastHeartbeatMs = 0;
+  volatile bool controlLinkUp = false;
+#if AGVNET_ENABLE_WEBSOCKET
+  AGVClientLink clientLinks[WEBSOCKETS_SERVER_CLIENT_MAX] = {};
+  // Clients that connected or disconnected since the commands lock was last
+  // held: their rate limit and mission upload are reset under it. Touched
+  // by the network task only.
+  uint32_t linkResets = 0;
+#endif
+  
+#if AGVNET_ENABLE_TIMED
+  // Time-triggered commands and per-client clock offsets
+  AGVTimerWheel timerWheel;
+#if AGVNET_ENABLE_WEBSOCKET
+  AGVClockSync clockSync[WEBSOCKETS_SERVER_CLIENT_MAX];
+  uint32_t lastClockSyncMs = 0;
+#endif
+#endif
+#if AGVNET_ENABLE_SELFTEST
+  AGVSelfTest selfTest;
+#endif
+#if AGVNET_ENABLE_MQTT
+  AGVMqttBridge mqtt;
+#endif
+#if AGVNET_ENABLE_ROUTING
+  AGVRouter router;
+#endif
+#if AGVNET_ENABLE_DISPATCH
+  AGVDispatcher dispatcher;
+#endif
+#if AGVNET_ENABLE_JOURNAL
+  AGVJournal journal;
+  uint32_t missionProgress = 0;  // loop << 16 | waypoint, written by Core 1
+  uint32_t commandSeq = 0;       // commands handed to the command callback
+  bool missionRecovered = false;
+#endif
+#if AGVNET_ENABLE_ISR_EVENTS
+  AGVIsrQueue isrQueue;
+  uint32_t isrOverflowsSeen = 0;
+#endif
+  // Synchronisation domains. Nest only in this order: commandLock, then
+  // clientLock, then configLock. Pages are immutable and telemetry and
+  // statuses have lock-free paths, so neither needs one.
+  AGVLock commandLock;   // scheduler, verb table, missions, timers, MQTT, capture
+  AGVLock clientLock;    // WebSocket client table and sends, SSE viewers
+  AGVLock configLock;    // session keys, credentials, preferences
   TaskHandle_t core0TaskHandle = nullptr;
   
   // Internal methods
+#if AGVNET_ENABLE_WIFI
+  bool stationJoining = false;
+  uint32_t stationJoinStartMs = 0;
   void setupWiFi();
-  void startAPMode();
   void startStationMode();
+  void beginStationJoin();
+  void serviceStationJoin();
+  void finishStationMode(bool connected);
+#endif
+#if AGVNET_ENABLE_AP_PORTAL
+  void startAPMode();
+#endif
+#if AGVNET_ENABLE_HTTP
   void setupRoutes();
+#endif
   void processSerialInput();
-  String getSessionToken();
+  bool handleTelemetryQuery(const char* cmd, char* reply, size_t size);
+#if AGVNET_ENABLE_MISSION
+  void beginMission(uint8_t source, uint8_t owner);
+  AGVMissionError finishMission();
+  void deliverMission();
+#endif
+#if AGVNET_ENABLE_ROUTING
+  bool expandPath(AGVMessage* msg);
+  void replyTo(const AGVMessage* msg, const char* text);
+#endif
+#if AGVNET_ENABLE_WEBSOCKET
+#if AGVNET_ENABLE_MISSION
+  void handleMissionFrame(uint8_t num, WStype_t type, uint8_t* payload, size_t length);
+#endif
+  void serviceHeartbeat();
+  void serviceLinkResets();
+  void applyLinkResets();
+  void sendPrefixed(int16_t num, const char* prefix, const char* text, size_t length);
+#endif
+#if AGVNET_ENABLE_TIMED
+  bool scheduleTimed(AGVMessage* msg, char* reply, size_t size);
+  void serviceTimers();
+#if AGVNET_ENABLE_WEBSOCKET
+  bool handleClockSync(uint8_t num, const char* text, size_t length, int64_t receivedUs);
+  void serviceClockSync();
+#endif
+#endif
+#if AGVNET_ENABLE_MQTT
+  void serviceMqtt();
+#endif
+#if AGVNET_ENABLE_SELFTEST
+  void serviceSelfTest();
+  void benchCommandParse();
+  void benchBroadcast();
+  void benchPreferences(bool write);
+#endif
+  void publishPendingStatus();
+  void publishStatus(const char* text, size_t length);
+  void publishEmergency(const char* text, size_t length);
+#if AGVNET_ENABLE_JOURNAL
+  void serviceJournal();
+#endif
+#if AGVNET_ENABLE_ISR_EVENTS
+  bool postFromISR(AGVIsrKind kind, const char* text, int32_t value);
+  void serviceIsrEvents();
+#endif
+  bool admitCommand(AGVMessage* msg);
+  AGVSubmitResult submitCommand(AGVMessage* msg, bool admitted = false);
+  void dispatchCommands();
+  void runDispatchPass();
   void core0Task(void *parameter);
+  bool takeLock(AGVLock& lock, uint16_t line);
+  
+#if AGVNET_ENABLE_AUTH && AGVNET_ENABLE_WEBSOCKET
+  bool validateWsHeader(const String& name, const String& value);
+#endif
   
+#if AGVNET_ENABLE_WEBUI
   // Web route handlers
   void handleRoot();
-  void handleRootRedirect();
-  void handleLogin();
   void handleDashboard();
+  void handleDeltaDecoder();
+#endif
+#if AGVNET_ENABLE_FLEET
+  void handleFleet();
+  void handleFleetWorker();
+#endif
+#if AGVNET_ENABLE_HTTP
+  void handleLogin();
+#if AGVNET_ENABLE_AUTH
+  bool authorizeHttp();
+  void handleSession();
+#endif
+  void handleState();
+  void handleStats();
+#if AGVNET_ENABLE_MISSION
+  void handleMissionUpload();
+  void handleMissionDone();
+#endif
+#if AGVNET_ENABLE_RECORDER
+  void handleRecorder();
+#endif
+#if AGVNET_ENABLE_EVENTS
+  void handleEvents();
+#endif
+#if AGVNET_ENABLE_CAPTURE
+  void handleCapture();
+  void handleCaptureControl();
+#endif
+#if AGVNET_ENABLE_SELFTEST
+  void handleSelfTest();
+  void handleSelfTestStart();
+#endif
+#if AGVNET_ENABLE_ROUTING
+  void handleMap();
+  void handleMapUpload();
+#endif
+  void handleNotFound();
+#endif
+#if AGVNET_ENABLE_AP_PORTAL
+  void handleRootRedirect();
   void handleWiFiSetup();
   void handleScan();
   void handleSaveWiFi();
   void handleCaptivePortal();
-  void handleNotFound();
+#endif
   
   // Cleanup methods
   void cleanupServer();
   void cleanupWebSocket();
   void cleanupDNSServer();
   
-  // Command processing (without mutex - called from within mutex)
-  void processCommandUnsafe(const char* cmd, uint8_t source);
+  // Command processing (without locking - called within the commands lock)
+  void processCommandUnsafe(AGVMessage* msg);
 };
 
 } // namespace AGVCoreNetworkLib
@@ -0,0 +1,500 @@
+#ifndef AGVCORENETWORKCONFIG_H
+#define AGVCORENETWORKCONFIG_H
+
+#include <stdint.h>
+
+// Compile-time configuration for AGVCoreNetwork.
+//
+// The library is compiled separately from the sketch, so set these as build
+// flags (e.g. PlatformIO build_flags = -DAGVNET_PROFILE_HEADLESS, or
+// arduino-cli --build-property "compiler.cpp.extra_flags=-DAGVNET_ENABLE_WEBUI=0").
+// Disabled subsystems are not compiled, so their code, pages and buffers
+// cost neither flash nor RAM. Call agvNetwork.printFootprint() to see what
+// the active configuration reserves.
+
+// ---- Profiles (set defaults; individual flags still override) ----
+
+// Serial-only vehicle: no WiFi stack, web server, WebSocket, portal or mDNS
+#ifdef AGVNET_PROFILE_HEADLESS
+#ifndef AGVNET_ENABLE_WIFI
+#define AGVNET_ENABLE_WIFI 0
+#endif
+#ifndef AGV_POOL_SMALL_COUNT
+#define AGV_POOL_SMALL_COUNT 8
+#endif
+#ifndef AGV_POOL_MEDIUM_COUNT
+#define AGV_POOL_MEDIUM_COUNT 4
+#endif
+#ifndef AGV_POOL_LARGE_COUNT
+#define AGV_POOL_LARGE_COUNT 2
+#endif
+#ifndef AGVNET_TASK_STACK
+#define AGVNET_TASK_STACK 6144
+#endif
+#endif
+
+// Gateway-driven vehicle: WebSocket control only, no pages or setup portal
+#ifdef AGVNET_PROFILE_CONTROLLER
+#ifndef AGVNET_ENABLE_WEBUI
+#define AGVNET_ENABLE_WEBUI 0
+#endif
+#ifndef AGVNET_ENABLE_AP_PORTAL
+#define AGVNET_ENABLE_AP_PORTAL 0
+#endif
+#endif
+
+// ---- Subsystems ----
+
+#ifndef AGVNET_ENABLE_WIFI
+#define AGVNET_ENABLE_WIFI 1        // WiFi station + everything network below
+#endif
+#ifndef AGVNET_ENABLE_HTTP
+#define AGVNET_ENABLE_HTTP 1        // WebServer: /state, /stats, /mission
+#endif
+#ifndef AGVNET_ENABLE_WEBSOCKET
+#define AGVNET_ENABLE_WEBSOCKET 1   // WebSocket command/status channel
+#endif
+#ifndef AGVNET_ENABLE_WEBUI
+#define AGVNET_ENABLE_WEBUI 1       // Login and dashboard pages
+#endif
+#ifndef AGVNET_ENABLE_AP_PORTAL
+#define AGVNET_ENABLE_AP_PORTAL 1   // AP mode, DNS captive portal, WiFi setup page
+#endif
+#ifndef AGVNET_ENABLE_MDNS
+#define AGVNET_ENABLE_MDNS 1        // <deviceName>.local
+#endif
+#ifndef AGVNET_ENABLE_MISSION
+#define AGVNET_ENABLE_MISSION 1     // Batch mission upload (HTTP and WS binary)
+#endif
+#ifndef AGVNET_ENABLE_RECORDER
+#define AGVNET_ENABLE_RECORDER 1    // Flight recorder in RTC memory, GET /recorder
+#endif
+#ifndef AGVNET_ENABLE_TIMED
+#define AGVNET_ENABLE_TIMED 1       // "AT <t> <command>" timer wheel, TSYNC clock sync
+#endif
+#ifndef AGVNET_ENABLE_AUTH
+#define AGVNET_ENABLE_AUTH 1        // Signed session tokens required for WebSocket and POST /mission
+#endif
+#ifndef AGVNET_ENABLE_SELFTEST
+#define AGVNET_ENABLE_SELFTEST 1    // On-device benchmark suite: /selftest, serial SELFTEST
+#endif
+#ifndef AGVNET_ENABLE_MQTT
+#define AGVNET_ENABLE_MQTT 1        // MQTT client transport (idle until beginMqtt())
+#endif
+#ifndef AGVNET_ENABLE_ROUTING
+#define AGVNET_ENABLE_ROUTING 1     // Grid map and "PATH" route expansion into missions
+#endif
+#ifndef AGVNET_ENABLE_ISR_EVENTS
+#define AGVNET_ENABLE_ISR_EVENTS 1  // sendStatusFromISR() and friends
+#endif
+#ifndef AGVNET_ENABLE_JOURNAL
+#define AGVNET_ENABLE_JOURNAL 1     // Mission/progress journal in a flash partition (idle without one)
+#endif
+#ifndef AGVNET_ENABLE_DISPATCH
+#define AGVNET_ENABLE_DISPATCH 1    // on("VERB", handler, context) verb table
+#endif
+#ifndef AGVNET_ENABLE_CAPTURE
+#define AGVNET_ENABLE_CAPTURE 1     // Session capture for replay, /capture (heap buffer on first start)
+#endif
+#ifndef AGVNET_ENABLE_EVENTS
+#define AGVNET_ENABLE_EVENTS 1      // GET /events Server-Sent Events for read-only viewers
+#endif
+#ifndef AGVNET_ENABLE_DISCOVERY
+#define AGVNET_ENABLE_DISCOVERY 1   // _agv._tcp mDNS service with a state summary in TXT
+#endif
+#ifndef AGVNET_ENABLE_PROVISION
+#define AGVNET_ENABLE_PROVISION 1   // Signed UDP/serial provisioning in setup mode (needs setProvisioningKey())
+#endif
+#ifndef AGVNET_ENABLE_DELTA
+#define AGVNET_ENABLE_DELTA 1       // Binary delta telemetry stream for "TELEMETRY DELTA" WebSocket clients
+#endif
+#ifndef AGVNET_ENABLE_API
+#define AGVNET_ENABLE_API 1         // Keep-alive REST command API on AGVNET_API_PORT (PLC/MES batches)
+#endif
+#ifndef AGVNET_ENABLE_FLEET
+#define AGVNET_ENABLE_FLEET 1       // /fleet overview of many vehicles through one SharedWorker
+#endif
+
+// Dependencies: a subsystem is only built if what it needs is built
+#if !AGVNET_ENABLE_WIFI
+#undef AGVNET_ENABLE_HTTP
+#define AGVNET_ENABLE_HTTP 0
+#undef AGVNET_ENABLE_WEBSOCKET
+#define AGVNET_ENABLE_WEBSOCKET 0
+#undef AGVNET_ENABLE_MDNS
+#define AGVNET_ENABLE_MDNS 0
+#undef AGVNET_ENABLE_MQTT
+#define AGVNET_ENABLE_MQTT 0
+#undef AGVNET_ENABLE_PROVISION
+#define AGVNET_ENABLE_PROVISION 0
+#endif
+#if !AGVNET_ENABLE_MDNS
+#undef AGVNET_ENABLE_DISCOVERY
+#define AGVNET_ENABLE_DISCOVERY 0
+#endif
+#if !AGVNET_ENABLE_WEBSOCKET
+#undef AGVNET_ENABLE_DELTA
+#define AGVNET_ENABLE_DELTA 0
+#endif
+#if !AGVNET_ENABLE_HTTP
+#undef AGVNET_ENABLE_EVENTS
+#define AGVNET_ENABLE_EVENTS 0
+#undef AGVNET_ENABLE_CAPTURE
+#define AGVNET_ENABLE_CAPTURE 0
+#undef AGVNET_ENABLE_WEBUI
+#define AGVNET_ENABLE_WEBUI 0
+#undef AGVNET_ENABLE_AP_PORTAL
+#define AGVNET_ENABLE_AP_PORTAL 0
+#undef AGVNET_ENABLE_API
+#define AGVNET_ENABLE_API 0
+#endif
+#if !AGVNET_ENABLE_HTTP && !AGVNET_ENABLE_WEBSOCKET
+#undef AGVNET_ENABLE_MISSION
+#define AGVNET_ENABLE_MISSION 0
+#endif
+#if !AGVNET_ENABLE_MISSION
+#undef AGVNET_ENABLE_ROUTING
+#define AGVNET_ENABLE_ROUTING 0
+#undef AGVNET_ENABLE_JOURNAL
+#define AGVNET_ENABLE_JOURNAL 0
+#endif
+#if !AGVNET_ENABLE_WEBUI || !AGVNET_ENABLE_DELTA
+#undef AGVNET_ENABLE_FLEET
+#define AGVNET_ENABLE_FLEET 0
+#endif
+
+// ---- Network ----
+
+#ifndef AGVNET_HTTP_PORT
+#define AGVNET_HTTP_PORT 80
+#endif
+#ifndef AGVNET_WS_PORT
+#define AGVNET_WS_PORT 81
+#endif
+#ifndef AGVNET_API_PORT
+#define AGVNET_API_PORT 8080
+#endif
+#ifndef AGVNET_AP_SSID
+#define AGVNET_AP_SSID "AGV_Controller_Network"
+#endif
+#ifndef AGVNET_AP_PASSWORD
+#define AGVNET_AP_PASSWORD "AGVSecure123"
+#endif
+#ifndef AGVNET_PROVISION_SSID
+#define AGVNET_PROVISION_SSID ""    // commissioning network joined in setup mode ("" = setup AP only)
+#endif
+#ifndef AGVNET_PROVISION_PASSWORD
+#define AGVNET_PROVISION_PASSWORD ""
+#endif
+#ifndef AGVNET_FIRMWARE_VERSION
+#define AGVNET_FIRMWARE_VERSION "dev"  // advertised in mDNS TXT "fw" (or setFirmwareVersion())
+#endif
+#ifndef AGVNET_SESSION_TTL_S
+#define AGVNET_SESSION_TTL_S 28800  // operator session lifetime (8 h)
+#endif
+
+// ---- Network task ----
+
+#ifndef AGVNET_TASK_STACK
+#define AGVNET_TASK_STACK 16384
+#endif
+#ifndef AGVNET_TASK_PRIORITY
+#define AGVNET_TASK_PRIORITY 1
+#endif
+#ifndef AGVNET_TASK_CORE
+#define AGVNET_TASK_CORE 0
+#endif
+#ifndef AGVNET_WIFI_JOIN_MS
+#define AGVNET_WIFI_JOIN_MS 10000   // wait for the station join before falling back to setup
+#endif
+#ifndef AGV_LOCK_TIMEOUT_MS
+#define AGV_LOCK_TIMEOUT_MS 100     // wait for a lock domain before the work is dropped
+#endif
+
+// ---- Buffers and queues ----
+
+// Message pool: payload bytes per block (including terminator) and block
+// count per size class. Sizes must be ascending; the largest bounds the
+// longest accepted command.
+#ifndef AGV_POOL_SMALL_SIZE
+#define AGV_POOL_SMALL_SIZE 32
+#endif
+#ifndef AGV_POOL_SMALL_COUNT
+#define AGV_POOL_SMALL_COUNT 16
+#endif
+#ifndef AGV_POOL_MEDIUM_SIZE
+#define AGV_POOL_MEDIUM_SIZE 128
+#endif
+#ifndef AGV_POOL_MEDIUM_COUNT
+#define AGV_POOL_MEDIUM_COUNT 8
+#endif
+#ifndef AGV_POOL_LARGE_SIZE
+#define AGV_POOL_LARGE_SIZE 512
+#endif
+#ifndef AGV_POOL_LARGE_COUNT
+#define AGV_POOL_LARGE_COUNT 4
+#endif
+
+// Status messages waiting for the network task
+#ifndef AGV_STATUS_QUEUE_LEN
+#define AGV_STATUS_QUEUE_LEN 16
+#endif
+
+// Scheduler: queue length per class, classifier rules, WebSocket source slots
+#ifndef AGV_SCHED_QUEUE_LEN
+#define AGV_SCHED_QUEUE_LEN 16
+#endif
+#ifndef AGV_SCHED_MAX_RULES
+#define AGV_SCHED_MAX_RULES 16
+#endif
+#ifndef AGV_SCHED_WS_SLOTS
+#define AGV_SCHED_WS_SLOTS 8        // >= WEBSOCKETS_SERVER_CLIENT_MAX
+#endif
+
+// Telemetry registry
+#ifndef AGV_TELEMETRY_MAX_KEYS
+#define AGV_TELEMETRY_MAX_KEYS 16
+#endif
+#ifndef AGV_TELEMETRY_KEY_LEN
+#define AGV_TELEMETRY_KEY_LEN 16
+#endif
+#ifndef AGV_TELEMETRY_TEXT_LEN
+#define AGV_TELEMETRY_TEXT_LEN 32
+#endif
+
+// Mission upload
+#ifndef AGV_MISSION_MAX_WAYPOINTS
+#define AGV_MISSION_MAX_WAYPOINTS 256
+#endif
+
+// Flight recorder: events retained in RTC slow memory (16 bytes each; the
+// whole RTC slow segment is 8 KB) and the network loop time that counts as a stall
+#ifndef AGV_RECORDER_EVENTS
+#define AGV_RECORDER_EVENTS 256
+#endif
+#ifndef AGV_RECORDER_STALL_MS
+#define AGV_RECORDER_STALL_MS 50
+#endif
+
+// Time-triggered commands: pending timers, furthest target accepted,
+// busy-wait window before a target and the skew counted as late
+#ifndef AGV_TIMER_MAX
+#define AGV_TIMER_MAX 16
+#endif
+#ifndef AGV_TIMER_MAX_DELAY_MS
+#define AGV_TIMER_MAX_DELAY_MS 60000
+#endif
+#ifndef AGV_TIMER_SPIN_US
+#define AGV_TIMER_SPIN_US 2000
+#endif
+#ifndef AGV_TIMER_LATE_US
+#define AGV_TIMER_LATE_US 1000
+#endif
+
+// Clock sync: probe period per WebSocket client, filter window, and the
+// samples needed before absolute AT times are accepted
+#ifndef AGV_TSYNC_INTERVAL_MS
+#define AGV_TSYNC_INTERVAL_MS 250
+#endif
+#ifndef AGV_TSYNC_SAMPLES
+#define AGV_TSYNC_SAMPLES 8
+#endif
+#ifndef AGV_TSYNC_MIN_SAMPLES
+#define AGV_TSYNC_MIN_SAMPLES 4
+#endif
+
+// Self-test: samples per benchmark (p99 needs at least 100) and report size
+#ifndef AGV_SELFTEST_SAMPLES
+#define AGV_SELFTEST_SAMPLES 100
+#endif
+#ifndef AGV_SELFTEST_JSON_MAX
+#define AGV_SELFTEST_JSON_MAX 1024
+#endif
+
+// MQTT: status batch interval and size, offline buffer, telemetry period,
+// received commands waiting for the network task, broker keepalive
+#ifndef AGV_MQTT_BATCH_MS
+#define AGV_MQTT_BATCH_MS 100
+#endif
+#ifndef AGV_MQTT_BATCH_MAX
+#define AGV_MQTT_BATCH_MAX 1024
+#endif
+#ifndef AGV_MQTT_OFFLINE_BYTES
+#define AGV_MQTT_OFFLINE_BYTES 8192
+#endif
+#ifndef AGV_MQTT_FLUSH_PER_TICK
+#define AGV_MQTT_FLUSH_PER_TICK 4
+#endif
+#ifndef AGV_MQTT_TELEMETRY_MS
+#define AGV_MQTT_TELEMETRY_MS 1000
+#endif
+#ifndef AGV_MQTT_INBOX_LEN
+#define AGV_MQTT_INBOX_LEN 8
+#endif
+#ifndef AGV_MQTT_KEEPALIVE_S
+#define AGV_MQTT_KEEPALIVE_S 15
+#endif
+
+// Routing: grid size (cells, bitset + ~7 bytes search state each), cached
+// routes and corners per cached route
+#ifndef AGV_GRID_MAX_CELLS
+#define AGV_GRID_MAX_CELLS 1024
+#endif
+#ifndef AGV_ROUTE_CACHE_SIZE
+#define AGV_ROUTE_CACHE_SIZE 8
+#endif
+#ifndef AGV_ROUTE_CACHE_POINTS
+#define AGV_ROUTE_CACHE_POINTS 32
+#endif
+
+// Interrupt events: ring slots (power of two) and text bytes per event
+#ifndef AGV_ISR_QUEUE_LEN
+#define AGV_ISR_QUEUE_LEN 16
+#endif
+#ifndef AGV_ISR_TEXT_MAX
+#define AGV_ISR_TEXT_MAX 48
+#endif
+
+// Journal: partition label (tools/partitions_journal.csv) and the batch
+// interval - at most one flash write per interval
+#ifndef AGV_JOURNAL_PARTITION
+#define AGV_JOURNAL_PARTITION "agvjournal"
+#endif
+#ifndef AGV_JOURNAL_FLUSH_MS
+#define AGV_JOURNAL_FLUSH_MS 1000
+#endif
+
+// Verb dispatch: registered verbs (power of two), verb length including
+// terminator, jobs waiting per queued context, worker task stack and
+// priority (below the network task, so slow handlers do not delay it)
+#ifndef AGV_DISPATCH_MAX_VERBS
+#define AGV_DISPATCH_MAX_VERBS 16
+#endif
+#ifndef AGV_DISPATCH_VERB_LEN
+#define AGV_DISPATCH_VERB_LEN 16
+#endif
+#ifndef AGV_DISPATCH_QUEUE_LEN
+#define AGV_DISPATCH_QUEUE_LEN 8
+#endif
+#ifndef AGV_DISPATCH_WORKER_STACK
+#define AGV_DISPATCH_WORKER_STACK 4096
+#endif
+#ifndef AGV_DISPATCH_WORKER_PRIORITY
+#define AGV_DISPATCH_WORKER_PRIORITY (AGVNET_TASK_PRIORITY > 0 ? AGVNET_TASK_PRIORITY - 1 : 0)
+#endif
+
+// Fleet discovery: minimum interval between TXT state updates
+#ifndef AGV_DISCOVERY_TXT_MS
+#define AGV_DISCOVERY_TXT_MS 2000
+#endif
+
+// Server-Sent Events: viewers, replay ring for Last-Event-ID resume,
+// bytes per encoded event, per-viewer rate cap (frames/s and burst),
+// telemetry snapshot period and keepalive comment interval
+#ifndef AGV_SSE_VIEWERS
+#define AGV_SSE_VIEWERS 4
+#endif
+#ifndef AGV_SSE_REPLAY
+#define AGV_SSE_REPLAY 16
+#endif
+#ifndef AGV_SSE_FRAME_MAX
+#define AGV_SSE_FRAME_MAX 256
+#endif
+#ifndef AGV_SSE_RATE
+#define AGV_SSE_RATE 20
+#endif
+#ifndef AGV_SSE_BURST
+#define AGV_SSE_BURST 10
+#endif
+#ifndef AGV_SSE_TELEMETRY_MS
+#define AGV_SSE_TELEMETRY_MS 500
+#endif
+#ifndef AGV_SSE_KEEPALIVE_MS
+#define AGV_SSE_KEEPALIVE_MS 15000
+#endif
+
+// Provisioning: UDP port (announcements and configs) and announce period
+#ifndef AGV_PROVISION_PORT
+#define AGV_PROVISION_PORT 4210
+#endif
+#ifndef AGV_PROVISION_HELLO_MS
+#define AGV_PROVISION_HELLO_MS 1000
+#endif
+
+// Delta telemetry: update period (changed fields since the last update)
+// and keyframe period (every field, so late or lossy clients converge)
+#ifndef AGV_DELTA_INTERVAL_MS
+#define AGV_DELTA_INTERVAL_MS 100
+#endif
+#ifndef AGV_DELTA_KEYFRAME_MS
+#define AGV_DELTA_KEYFRAME_MS 10000
+#endif
+
+// REST API: persistent connections, commands per batch and how long an
+// idle keep-alive connection is held open
+#ifndef AGV_API_CLIENTS
+#define AGV_API_CLIENTS 4
+#endif
+#ifndef AGV_API_BATCH_MAX
+#define AGV_API_BATCH_MAX 32
+#endif
+#ifndef AGV_API_IDLE_MS
+#define AGV_API_IDLE_MS 30000
+#endif
+
+// Session capture: buffer for one capture (frames are stored in full)
+#ifndef AGV_CAPTURE_BYTES
+#define AGV_CAPTURE_BYTES 16384
+#endif
+
+// WebSocket handshakes: upgrades open at once per remote address and in
+// total (below WEBSOCKETS_SERVER_CLIENT_MAX), and how long one may take
+#ifndef AGV_WS_HANDSHAKES_PER_IP
+#define AGV_WS_HANDSHAKES_PER_IP 2
+#endif
+#ifndef AGV_WS_HANDSHAKES_MAX
+#define AGV_WS_HANDSHAKES_MAX 3
+#endif
+#ifndef AGV_WS_HANDSHAKE_MS
+#define AGV_WS_HANDSHAKE_MS 2000
+#endif
+
+namespace AGVCoreNetworkLib {
+
+// The resolved configuration as constants the compiler can fold
+struct AGVNetConfig {
+  static constexpr bool wifi = AGVNET_ENABLE_WIFI;
+  static constexpr bool http = AGVNET_ENABLE_HTTP;
+  static constexpr bool webSocket = AGVNET_ENABLE_WEBSOCKET;
+  static constexpr bool webUI = AGVNET_ENABLE_WEBUI;
+  static constexpr bool apPortal = AGVNET_ENABLE_AP_PORTAL;
+  static constexpr bool mdns = AGVNET_ENABLE_MDNS;
+  static constexpr bool mission = AGVNET_ENABLE_MISSION;
+  static constexpr bool recorder = AGVNET_ENABLE_RECORDER;
+  static constexpr bool timed = AGVNET_ENABLE_TIMED;
+  static constexpr bool auth = AGVNET_ENABLE_AUTH;
+  static constexpr bool selfTest = AGVNET_ENABLE_SELFTEST;
+  static constexpr bool mqtt = AGVNET_ENABLE_MQTT;
+  static constexpr bool routing = AGVNET_ENABLE_ROUTING;
+  static constexpr bool isrEvents = AGVNET_ENABLE_ISR_EVENTS;
+  static constexpr bool journal = AGVNET_ENABLE_JOURNAL;
+  static constexpr bool dispatch = AGVNET_ENABLE_DISPATCH;
+  static constexpr bool capture = AGVNET_ENABLE_CAPTURE;
+  static constexpr bool discovery = AGVNET_ENABLE_DISCOVERY;
+  static constexpr bool events = AGVNET_ENABLE_EVENTS;
+  static constexpr bool delta = AGVNET_ENABLE_DELTA;
+  static constexpr bool provision = AGVNET_ENABLE_PROVISION;
+  static constexpr bool api = AGVNET_ENABLE_API;
+  static constexpr bool fleet = AGVNET_ENABLE_FLEET;
+
+  static constexpr uint16_t httpPort = AGVNET_HTTP_PORT;
+  static constexpr uint16_t wsPort = AGVNET_WS_PORT;
+  static constexpr uint16_t apiPort = AGVNET_API_PORT;
+  static constexpr uint32_t taskStack = AGVNET_TASK_STACK;
+  static constexpr uint8_t taskPriority = AGVNET_TASK_PRIORITY;
+  static constexpr int8_t taskCore = AGVNET_TASK_CORE;
+};
+
+} // namespace AGVCoreNetworkLib
+
+#endif
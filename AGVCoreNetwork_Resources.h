@@ -2,7 +2,9 @@
 #define AGVCORENETWORK_RESOURCES_H
 
 #include <Arduino.h>
+#include "AGVCoreNetworkConfig.h"
 
+#if AGVNET_ENABLE_WEBUI
 // Login page HTML
 const char loginPage[] PROGMEM = R"rawliteral(
 <!DOCTYPE html>
@@ -120,7 +122,9 @@ const char loginPage[] PROGMEM = R"rawliteral(
 </body>
 </html>
 )rawliteral";
+#endif
 
+#if AGVNET_ENABLE_AP_PORTAL
 // WiFi Setup page HTML
 const char wifiSetupPage[] PROGMEM = R"rawliteral(
 <!DOCTYPE html>
@@ -237,8 +241,16 @@ const char wifiSetupPage[] PROGMEM = R"rawliteral(
     <script>
         async function scanNetworks() {
             document.getElementById('loading').style.display = 'block';
-            const response = await fetch('/scan');
-            const networks = await response.json();
+            // 202 while the scan is still running
+            let networks = [];
+            for (let tries = 0; tries < 40; tries++) {
+                const response = await fetch('/scan');
+                if (response.status !== 202) {
+                    networks = await response.json();
+                    break;
+                }
+                await new Promise(resolve => setTimeout(resolve, 500));
+            }
             document.getElementById('loading').style.display = 'none';
             
             const select = document.getElementById('ssid');
@@ -281,6 +293,69 @@ const char wifiSetupPage[] PROGMEM = R"rawliteral(
 </body>
 </html>
 )rawliteral";
+#endif
+
+#if AGVNET_ENABLE_WEBUI
+// Delta telemetry decoder (/delta.js), the one copy of the frame format of
+// AGVDelta.h on the browser side: loaded by the dashboard and imported by
+// the fleet worker. state holds seq (-1: waiting for a keyframe), names and
+// telemetry; resync() asks the sender for a keyframe after a gap. Returns
+// true if telemetry changed.
+const char deltaDecoder[] PROGMEM = R"rawliteral(
+function decodeDelta(state, bytes, resync) {
+    let pos = 0;
+    function varint() {
+        let value = 0, scale = 1, b;
+        do {
+            b = bytes[pos++];
+            value += (b & 0x7F) * scale;
+            scale *= 128;
+        } while (b & 0x80);
+        return value;
+    }
+    function zigzag(v) {
+        return v % 2 ? -(v + 1) / 2 : v / 2;
+    }
+    function text() {
+        const length = bytes[pos++];
+        const value = new TextDecoder().decode(bytes.subarray(pos, pos + length));
+        pos += length;
+        return value;
+    }
+
+    const kind = bytes[pos++];
+    const seq = varint();
+    if (kind !== 1) {
+        if (state.seq < 0) return false;  // resync pending
+        if (seq !== state.seq + 1) {
+            state.seq = -1;
+            resync();
+            return false;
+        }
+    }
+    state.seq = seq;
+
+    const count = varint();
+    for (let i = 0; i < count; i++) {
+        const slot = varint();
+        const type = bytes[pos++];
+        const named = (type & 0x80) !== 0;
+        if (named) state.names[slot] = text();
+        const key = state.names[slot];
+        let value;
+        if ((type & 0x7F) === 3) {
+            value = text();
+        } else {
+            value = zigzag(varint());
+            if ((type & 0x7F) === 2) value /= 1000;
+            if (kind !== 1 && !named) value += state.telemetry[key];
+            if ((type & 0x7F) === 2) value = Math.round(value * 1000) / 1000;
+        }
+        if (key !== undefined) state.telemetry[key] = value;
+    }
+    return true;
+}
+)rawliteral";
 
 // Main AGV Control page
 const char mainPage[] PROGMEM = R"rawliteral(
@@ -419,14 +494,69 @@ const char mainPage[] PROGMEM = R"rawliteral(
             margin-top: 20px;
         }
         
+        .mission-input {
+            width: 100%;
+            height: 80px;
+            font-family: monospace;
+            box-sizing: border-box;
+        }
+        
+        .telemetry-grid {
+            display: grid;
+            grid-template-columns: repeat(auto-fill, minmax(150px, 1fr));
+            gap: 5px;
+        }
+        
+        .telemetry-item {
+            font-family: monospace;
+            font-size: 13px;
+            padding: 5px;
+            background-color: #ecf0f1;
+            border-radius: 3px;
+        }
+        
+        .log-view {
+            position: relative;
+            height: 200px;
+            overflow-y: auto;
+            margin-top: 10px;
+        }
+        
+        .log-spacer {
+            position: relative;
+        }
+        
         .log-entry {
+            position: absolute;
+            left: 0;
+            right: 0;
+            height: 16px;
+            line-height: 16px;
             font-family: monospace;
             font-size: 12px;
-            margin: 2px 0;
-            padding: 2px 5px;
+            padding: 0 5px;
             background-color: #2c3e50;
             color: white;
             border-radius: 3px;
+            white-space: nowrap;
+            overflow: hidden;
+            text-overflow: ellipsis;
+        }
+        
+        .log-controls {
+            display: flex;
+            align-items: center;
+            gap: 10px;
+        }
+        
+        .log-controls input {
+            flex: 1;
+            padding: 5px;
+        }
+        
+        .log-stats {
+            font-size: 12px;
+            color: #7f8c8d;
         }
         
         .connection-status {
@@ -464,6 +594,11 @@ const char mainPage[] PROGMEM = R"rawliteral(
             font-weight: bold;
         }
         
+        .agv-status.moving { background-color: #27ae60; }
+        .agv-status.stopped { background-color: #f39c12; }
+        .agv-status.aborted { background-color: #e74c3c; }
+        .agv-status.ready { background-color: #3498db; }
+        
         .loop-count {
             margin-left: 20px;
             display: none;
@@ -528,6 +663,14 @@ const char mainPage[] PROGMEM = R"rawliteral(
             </div>
         </div>
 
+        <div class="control-section">
+            <div class="section-title">Mission Upload</div>
+            <textarea id="missionText" class="mission-input" placeholder="MISSION LOOP 3&#10;1,1&#10;3,1&#10;3,4"></textarea>
+            <div class="button-group">
+                <button class="success-btn" onclick="uploadMission()">📦 Upload Mission</button>
+            </div>
+        </div>
+
         <div class="control-section">
             <div class="section-title">AGV Control</div>
             <div class="button-group">
@@ -544,22 +687,82 @@ const char mainPage[] PROGMEM = R"rawliteral(
             </div>
         </div>
 
+        <div class="control-section">
+            <div class="section-title">Telemetry</div>
+            <div id="telemetryDisplay" class="telemetry-grid"></div>
+        </div>
+
+        <div class="control-section">
+            <div class="section-title">Maintenance</div>
+            <div class="button-group">
+                <button class="primary-btn" id="selfTestBtn" onclick="runSelfTest()">🧪 Run Self-Test</button>
+            </div>
+        </div>
+
         <div class="status-section">
             <div class="section-title">System Logs</div>
-            <div id="logDisplay" style="max-height: 200px; overflow-y: auto; margin-top: 10px;">
+            <div class="log-controls">
+                <button class="primary-btn" id="logPauseBtn" onclick="toggleLogPause()">⏸️ Pause</button>
+                <input type="text" id="logFilter" placeholder="Filter logs..." oninput="setLogFilter(this.value)">
+                <span class="log-stats" id="logStats"></span>
+            </div>
+            <div id="logDisplay" class="log-view" onscroll="scheduleFrame()">
+                <div id="logSpacer" class="log-spacer"></div>
             </div>
         </div>
     </div>
 
+    <script src="/delta.js"></script>
     <script>
         let ws;
         let isConnected = false;
 
+        // Log view: fixed-size ring, only visible rows are in the DOM, and all
+        // incoming messages are applied once per animation frame.
+        const LOG_CAPACITY = 500;
+        const LOG_ROW_HEIGHT = 18;
+        const logTimes = new Array(LOG_CAPACITY);
+        const logTexts = new Array(LOG_CAPACITY);
+        let logHead = 0;
+        let logCount = 0;
+        let logDropped = 0;
+        let logPaused = false;
+        let logFilter = '';
+        let logView = [];
+        let logViewDirty = true;
+        let logRows = [];
+        let pendingLogs = [];
+        let pendingStatus = null;
+        let shownStatus = null;
+        let frameScheduled = false;
+
+        // Latest telemetry values from "STATE: {...}" snapshots and delta frames
+        const telemetry = {};
+        const telemetryCells = {};
+        let telemetryDirty = false;
+        const delta = {seq: -1, names: {}, telemetry: telemetry};
+
         function checkAuth() {
             const token = localStorage.getItem('token');
             if (!token) {
                 window.location.href = '/';
+                return;
             }
+            checkSession();
+        }
+
+        // Tokens expire and are revoked on reboot; only 401 means log in again
+        async function checkSession() {
+            try {
+                const response = await fetch('/session', { headers: authHeaders() });
+                if (response.status === 401) logout();
+            } catch (e) {
+                // AGV unreachable - keep retrying the WebSocket
+            }
+        }
+
+        function authHeaders() {
+            return { 'Authorization': 'Bearer ' + localStorage.getItem('token') };
         }
 
         function logout() {
@@ -568,10 +771,18 @@ const char mainPage[] PROGMEM = R"rawliteral(
         }
 
         function connect() {
-            ws = new WebSocket('ws://' + window.location.hostname + ':81');
+            // The session token travels as a second offered subprotocol
+            ws = new WebSocket('ws://' + window.location.hostname + ':81',
+                               ['agv.v1', 'agv-token.' + localStorage.getItem('token')]);
+            ws.binaryType = 'arraybuffer';
+            let opened = false;
             
             ws.onopen = function() {
+                opened = true;
                 isConnected = true;
+                ws.send('TSYNC');  // lets the AGV estimate our clock offset for AT commands
+                delta.seq = -1;
+                ws.send('TELEMETRY DELTA');  // changed fields only, as binary frames
                 updateConnectionStatus(true, 'Connected to AGV');
                 addLog('✅ Connected to AGV');
                 updateAGVStatus('Connected - Ready for commands');
@@ -582,6 +793,7 @@ const char mainPage[] PROGMEM = R"rawliteral(
                 updateConnectionStatus(false, 'Disconnected from AGV');
                 addLog('🔌 Disconnected. Reconnecting...');
                 updateAGVStatus('Disconnected');
+                if (!opened) checkSession();  // refused at the handshake?
                 setTimeout(connect, 2000);
             };
             
@@ -590,6 +802,23 @@ const char mainPage[] PROGMEM = R"rawliteral(
             };
             
             ws.onmessage = function(event) {
+                if (event.data instanceof ArrayBuffer) {
+                    applyDelta(new Uint8Array(event.data));
+                    return;
+                }
+                // Clock sync probe "TSYNC <t1>": answer with our receive/send time in us
+                if (event.data.startsWith('TSYNC ')) {
+                    const now = Math.round((performance.timeOrigin + performance.now()) * 1000);
+                    ws.send(event.data + ' ' + now + ' ' + now);
+                    return;
+                }
+                if (event.data.startsWith('STATE: ')) {
+                    updateTelemetry(event.data.substring(7));
+                    return;
+                }
+                if (event.data.startsWith('SELFTEST: ')) {
+                    return;  // broadcast benchmark traffic
+                }
                 addLog('📥 AGV: ' + event.data);
                 updateAGVStatus(event.data);
             };
@@ -609,32 +838,179 @@ const char mainPage[] PROGMEM = R"rawliteral(
         }
 
         function updateAGVStatus(message) {
-            const statusDisplay = document.getElementById('agvStatusDisplay');
-            statusDisplay.textContent = 'AGV: ' + message;
+            pendingStatus = message;
+            scheduleFrame();
+        }
+
+        function applyAGVStatus(message) {
+            if (message === shownStatus) return;
+            shownStatus = message;
             
+            let state = '';
             if (message.includes('START') || message.includes('Moving')) {
-                statusDisplay.style.backgroundColor = '#27ae60';
+                state = ' moving';
             } else if (message.includes('STOP') || message.includes('Stopped')) {
-                statusDisplay.style.backgroundColor = '#f39c12';
+                state = ' stopped';
             } else if (message.includes('ABORT') || message.includes('Emergency')) {
-                statusDisplay.style.backgroundColor = '#e74c3c';
+                state = ' aborted';
             } else if (message.includes('Ready') || message.includes('Connected')) {
-                statusDisplay.style.backgroundColor = '#3498db';
-            } else {
-                statusDisplay.style.backgroundColor = '#34495e';
+                state = ' ready';
+            }
+            
+            const statusDisplay = document.getElementById('agvStatusDisplay');
+            statusDisplay.textContent = 'AGV: ' + message;
+            statusDisplay.className = 'agv-status' + state;
+        }
+
+        function updateTelemetry(json) {
+            try {
+                Object.assign(telemetry, JSON.parse(json));
+            } catch (e) {
+                addLog('❌ Bad telemetry: ' + json);
+                return;
             }
+            telemetryDirty = true;
+            scheduleFrame();
+        }
+
+        // Binary telemetry frames, decoded by /delta.js
+        function applyDelta(bytes) {
+            if (!decodeDelta(delta, bytes, () => ws.send('RESYNC'))) return;
+            telemetryDirty = true;
+            scheduleFrame();
+        }
+
+        function renderTelemetry() {
+            const display = document.getElementById('telemetryDisplay');
+            for (const key in telemetry) {
+                let cell = telemetryCells[key];
+                if (!cell) {
+                    cell = document.createElement('div');
+                    cell.className = 'telemetry-item';
+                    display.appendChild(cell);
+                    telemetryCells[key] = cell;
+                }
+                const text = key + ': ' + telemetry[key];
+                if (cell.textContent !== text) cell.textContent = text;
+            }
+            telemetryDirty = false;
         }
 
         function addLog(message) {
+            // While paused, hold at most one ring's worth of new entries
+            if (pendingLogs.length >= LOG_CAPACITY) {
+                pendingLogs.shift();
+                logDropped++;
+            }
+            pendingLogs.push([Date.now(), message]);
+            if (!logPaused) scheduleFrame();
+        }
+
+        function pushLog(time, text) {
+            logTimes[logHead] = time;
+            logTexts[logHead] = text;
+            logHead = (logHead + 1) % LOG_CAPACITY;
+            if (logCount < LOG_CAPACITY) {
+                logCount++;
+            } else {
+                logDropped++;
+            }
+            logViewDirty = true;
+        }
+
+        function scheduleFrame() {
+            if (frameScheduled) return;
+            frameScheduled = true;
+            requestAnimationFrame(renderFrame);
+        }
+
+        function renderFrame() {
+            frameScheduled = false;
+            
+            if (!logPaused && pendingLogs.length > 0) {
+                for (const entry of pendingLogs) {
+                    pushLog(entry[0], entry[1]);
+                }
+                pendingLogs = [];
+            }
+            
+            if (pendingStatus !== null) {
+                applyAGVStatus(pendingStatus);
+                pendingStatus = null;
+            }
+            
+            if (telemetryDirty) {
+                renderTelemetry();
+            }
+            
+            renderLog();
+        }
+
+        function renderLog() {
             const logDisplay = document.getElementById('logDisplay');
-            const logEntry = document.createElement('div');
-            logEntry.className = 'log-entry';
+            const spacer = document.getElementById('logSpacer');
             
-            const timestamp = new Date().toLocaleTimeString();
-            logEntry.textContent = `[${timestamp}] ${message}`;
+            if (logViewDirty) {
+                const wasAtBottom = logDisplay.scrollTop + logDisplay.clientHeight >=
+                                    logDisplay.scrollHeight - LOG_ROW_HEIGHT;
+                const start = (logHead - logCount + LOG_CAPACITY) % LOG_CAPACITY;
+                const filter = logFilter.toLowerCase();
+                
+                logView = [];
+                for (let i = 0; i < logCount; i++) {
+                    const slot = (start + i) % LOG_CAPACITY;
+                    if (!filter || logTexts[slot].toLowerCase().includes(filter)) {
+                        logView.push(slot);
+                    }
+                }
+                spacer.style.height = (logView.length * LOG_ROW_HEIGHT) + 'px';
+                if (wasAtBottom && !logPaused) {
+                    logDisplay.scrollTop = logDisplay.scrollHeight;
+                }
+                logViewDirty = false;
+                
+                document.getElementById('logStats').textContent =
+                    `${logView.length}/${logCount} shown` +
+                    (logDropped ? `, ${logDropped} dropped` : '') +
+                    (logPaused && pendingLogs.length ? `, ${pendingLogs.length} held` : '');
+            }
+            
+            // Keep just enough row elements to cover the viewport
+            const visible = Math.ceil(logDisplay.clientHeight / LOG_ROW_HEIGHT) + 1;
+            while (logRows.length < visible) {
+                const row = document.createElement('div');
+                row.className = 'log-entry';
+                spacer.appendChild(row);
+                logRows.push(row);
+            }
             
-            logDisplay.appendChild(logEntry);
-            logDisplay.scrollTop = logDisplay.scrollHeight;
+            const first = Math.floor(logDisplay.scrollTop / LOG_ROW_HEIGHT);
+            for (let i = 0; i < logRows.length; i++) {
+                const row = logRows[i];
+                const index = first + i;
+                if (index >= logView.length) {
+                    row.style.display = 'none';
+                    continue;
+                }
+                const slot = logView[index];
+                const text = `[${new Date(logTimes[slot]).toLocaleTimeString()}] ${logTexts[slot]}`;
+                row.style.display = '';
+                row.style.top = (index * LOG_ROW_HEIGHT) + 'px';
+                if (row.textContent !== text) row.textContent = text;
+            }
+        }
+
+        function toggleLogPause() {
+            logPaused = !logPaused;
+            document.getElementById('logPauseBtn').textContent = logPaused ? '▶️ Resume' : '⏸️ Pause';
+            logViewDirty = true;
+            scheduleFrame();
+        }
+
+        function setLogFilter(value) {
+            logFilter = value;
+            logViewDirty = true;
+            scheduleFrame();
         }
 
         function sendCommand(command) {
@@ -676,6 +1052,75 @@ const char mainPage[] PROGMEM = R"rawliteral(
             sendCommand(command);
         }
 
+        async function uploadMission() {
+            const body = document.getElementById('missionText').value;
+            try {
+                const response = await fetch('/mission', {
+                    method: 'POST',
+                    headers: Object.assign({'Content-Type': 'text/plain'}, authHeaders()),
+                    body: body
+                });
+                if (response.status === 401) {
+                    logout();
+                    return;
+                }
+                const result = await response.json();
+                if (result.success) {
+                    addLog(`📦 Mission #${result.mission} uploaded (${result.waypoints} waypoints)`);
+                } else {
+                    addLog(`❌ Mission rejected: ${result.error}` +
+                           (result.offset !== undefined ? ` at byte ${result.offset}` : ''));
+                }
+            } catch (e) {
+                addLog('❌ Mission upload failed');
+            }
+        }
+
+        // Loads the dashboard a few times so the AGV can time send_P, then
+        // starts the suite and polls until the report is ready
+        async function runSelfTest() {
+            const button = document.getElementById('selfTestBtn');
+            button.disabled = true;
+            addLog('🧪 Self-test started...');
+            try {
+                for (let i = 0; i < 3; i++) {
+                    await (await fetch('/dashboard', { cache: 'no-store' })).text();
+                }
+                const start = await fetch('/selftest', { method: 'POST', headers: authHeaders() });
+                if (start.status === 401) {
+                    logout();
+                    return;
+                }
+                if (start.status !== 202) {
+                    addLog('❌ Self-test: ' + (await start.json()).error);
+                    return;
+                }
+                let response;
+                do {
+                    await new Promise(resolve => setTimeout(resolve, 250));
+                    response = await fetch('/selftest', { cache: 'no-store' });
+                } while (response.status === 202);
+                showSelfTest(await response.json());
+            } catch (e) {
+                addLog('❌ Self-test failed');
+            } finally {
+                button.disabled = false;
+            }
+        }
+
+        function showSelfTest(report) {
+            addLog(`🧪 ${report.chip} rev ${report.rev} @ ${report.cpuMHz} MHz, SDK ${report.sdk}, build ${report.build}`);
+            for (const [name, r] of Object.entries(report.tests)) {
+                if (r.n === 0) {
+                    addLog(`🧪 ${name}: skipped (${r.skipped})`);
+                    continue;
+                }
+                const us = v => (v / 1000).toFixed(1);
+                addLog(`🧪 ${name}: median ${us(r.median)} µs, p99 ${us(r.p99)} µs, ` +
+                       `min ${us(r.min)} µs (n=${r.n})` + (r.kBps ? `, ${r.kBps} kB/s` : ''));
+            }
+        }
+
         function sendDefault() {
             sendCommand('DEFAULT');
         }
@@ -704,5 +1149,596 @@ const char mainPage[] PROGMEM = R"rawliteral(
 </body>
 </html>
 )rawliteral";
+#endif
+
+#if AGVNET_ENABLE_FLEET
+// Fleet overview page: one tile per vehicle, detail on demand
+const char fleetPage[] PROGMEM = R"rawliteral(
+<!DOCTYPE html>
+<html lang="en">
+<head>
+    <meta charset="UTF-8">
+    <meta name="viewport" content="width=device-width, initial-scale=1.0">
+    <title>AGV Fleet</title>
+    <style>
+        body {
+            font-family: Arial, sans-serif;
+            margin: 0;
+            padding: 15px;
+            background-color: #f5f5f5;
+        }
+
+        .header {
+            display: flex;
+            justify-content: space-between;
+            align-items: center;
+            margin-bottom: 15px;
+        }
+
+        h1 {
+            color: #2c3e50;
+            font-size: 22px;
+            margin: 0;
+        }
+
+        .summary {
+            color: #7f8c8d;
+            font-size: 14px;
+        }
+
+        button {
+            padding: 8px 12px;
+            margin: 2px;
+            border: none;
+            border-radius: 5px;
+            cursor: pointer;
+            font-weight: bold;
+            background-color: #3498db;
+            color: white;
+        }
+
+        .success-btn { background-color: #2ecc71; }
+        .warning-btn { background-color: #f39c12; }
+
+        .panel {
+            background: white;
+            padding: 15px;
+            border-radius: 10px;
+            box-shadow: 0 2px 10px rgba(0,0,0,0.1);
+            margin-bottom: 15px;
+        }
+
+        .panel input, .panel textarea {
+            padding: 8px;
+            margin: 4px 0;
+            border: 1px solid #ddd;
+            border-radius: 5px;
+            box-sizing: border-box;
+        }
+
+        .panel textarea {
+            width: 100%;
+            height: 120px;
+            font-family: monospace;
+        }
+
+        .hidden {
+            display: none;
+        }
+
+        /* Fixed-size tiles: an update never moves its neighbours */
+        .grid {
+            display: grid;
+            grid-template-columns: repeat(auto-fill, minmax(170px, 1fr));
+            gap: 8px;
+        }
+
+        .tile {
+            height: 92px;
+            padding: 8px 10px;
+            border-radius: 8px;
+            background: white;
+            border-left: 6px solid #95a5a6;
+            box-shadow: 0 1px 4px rgba(0,0,0,0.1);
+            cursor: pointer;
+            overflow: hidden;
+            contain: strict;
+        }
+
+        .tile.up { border-left-color: #2ecc71; }
+        .tile.connecting { border-left-color: #f39c12; }
+        .tile.down, .tile.denied { border-left-color: #e74c3c; opacity: 0.7; }
+        .tile.fault { background: #fdecea; }
+
+        .tile div {
+            white-space: nowrap;
+            overflow: hidden;
+            text-overflow: ellipsis;
+            line-height: 20px;
+        }
+
+        .tile-name {
+            font-weight: bold;
+            color: #2c3e50;
+        }
+
+        .tile-state {
+            font-size: 13px;
+            color: #34495e;
+        }
+
+        .tile-status {
+            font-size: 12px;
+            color: #7f8c8d;
+        }
+
+        .low {
+            color: #e74c3c;
+            font-weight: bold;
+        }
+
+        .telemetry-grid {
+            display: grid;
+            grid-template-columns: repeat(auto-fill, minmax(150px, 1fr));
+            gap: 5px;
+            margin: 10px 0;
+        }
+
+        .telemetry-item {
+            font-family: monospace;
+            font-size: 13px;
+            padding: 5px;
+            background-color: #ecf0f1;
+            border-radius: 3px;
+        }
+
+        .detail-log {
+            height: 180px;
+            overflow-y: auto;
+            margin: 0;
+            padding: 5px;
+            font-size: 12px;
+            background-color: #2c3e50;
+            color: white;
+            border-radius: 3px;
+        }
+    </style>
+</head>
+<body>
+    <div class="header">
+        <h1>🚗 AGV Fleet</h1>
+        <span class="summary" id="summary"></span>
+        <button onclick="toggleHosts()">Vehicles</button>
+    </div>
+
+    <div class="panel hidden" id="loginPanel">
+        <form id="loginForm">
+            <div id="loginPrompt">Log in to the fleet (same account on every vehicle)</div>
+            <input type="text" id="username" placeholder="Username" required>
+            <input type="password" id="password" placeholder="Password" required>
+            <button type="submit">Login</button>
+        </form>
+    </div>
+
+    <div class="panel hidden" id="hostsPanel">
+        <div>Vehicle addresses, one per line</div>
+        <textarea id="hostsText" placeholder="factory_agv_01.local&#10;192.168.1.42"></textarea>
+        <button onclick="saveHosts()">Save</button>
+    </div>
+
+    <div class="panel hidden" id="detailPanel">
+        <div class="header">
+            <span class="tile-name" id="detailName"></span>
+            <span>
+                <button class="success-btn" onclick="sendDetail('START')">▶️ START</button>
+                <button class="warning-btn" onclick="sendDetail('STOP')">⏹️ STOP</button>
+                <button onclick="openDashboard()">Dashboard</button>
+                <button onclick="showDetail(null)">✖</button>
+            </span>
+        </div>
+        <div id="detailTelemetry" class="telemetry-grid"></div>
+        <pre id="detailLog" class="detail-log"></pre>
+    </div>
+
+    <div class="grid" id="grid"></div>
+
+    <script>
+        // Every tab of this origin shares one worker and with it one
+        // connection per vehicle (dedicated worker where SharedWorker is missing)
+        const worker = typeof SharedWorker !== 'undefined'
+            ? new SharedWorker('/fleet.js', 'agv-fleet') : new Worker('/fleet.js');
+        const port = worker.port || worker;
+
+        let hosts = JSON.parse(localStorage.getItem('fleetHosts') || 'null') || [window.location.hostname];
+        const tiles = {};
+        const pendingTiles = new Map();
+        let pendingDetail = null;
+        let detailHost = null;
+        const detailCells = {};
+        let frameScheduled = false;
+
+        port.onmessage = function(event) {
+            const message = event.data;
+            if (message.type === 'hello') {
+                if (message.login) showLogin(true);
+            } else if (message.type === 'login') {
+                document.getElementById('loginPrompt').textContent =
+                    message.host + ' refused the login - log in to the fleet again';
+                showLogin(true);
+            } else if (message.type === 'tiles') {
+                for (const tile of message.tiles) pendingTiles.set(tile.host, tile);
+                scheduleFrame();
+            } else if (message.type === 'hosts') {
+                hosts = message.hosts;
+                localStorage.setItem('fleetHosts', JSON.stringify(hosts));
+                for (const host in tiles) {
+                    if (!hosts.includes(host)) {
+                        tiles[host].element.remove();
+                        delete tiles[host];
+                    }
+                }
+                scheduleFrame();
+            } else if (message.type === 'detail') {
+                if (message.detail.host === detailHost) {
+                    pendingDetail = message.detail;
+                    scheduleFrame();
+                }
+            }
+        };
+        port.postMessage({type: 'hosts', hosts: hosts});
+        window.addEventListener('pagehide', () => port.postMessage({type: 'close'}));
+        window.addEventListener('pageshow', e => { if (e.persisted) window.location.reload(); });
+
+        document.getElementById('loginForm').addEventListener('submit', function(e) {
+            e.preventDefault();
+            port.postMessage({
+                type: 'login',
+                username: document.getElementById('username').value,
+                password: document.getElementById('password').value
+            });
+            document.getElementById('password').value = '';
+            showLogin(false);
+        });
+
+        function showLogin(show) {
+            document.getElementById('loginPanel').classList.toggle('hidden', !show);
+        }
+
+        function toggleHosts() {
+            const panel = document.getElementById('hostsPanel');
+            document.getElementById('hostsText').value = hosts.join('\n');
+            panel.classList.toggle('hidden');
+        }
+
+        function saveHosts() {
+            const list = document.getElementById('hostsText').value.split('\n')
+                .map(line => line.trim()).filter(line => line.length > 0);
+            port.postMessage({type: 'hosts', hosts: Array.from(new Set(list))});
+            document.getElementById('hostsPanel').classList.add('hidden');
+        }
+
+        function showDetail(host) {
+            detailHost = host;
+            port.postMessage({type: 'detail', host: host});
+            document.getElementById('detailPanel').classList.toggle('hidden', !host);
+            document.getElementById('detailTelemetry').textContent = '';
+            document.getElementById('detailLog').textContent = '';
+            for (const key in detailCells) delete detailCells[key];
+            if (host) document.getElementById('detailName').textContent = host;
+        }
+
+        function sendDetail(command) {
+            if (detailHost) port.postMessage({type: 'command', host: detailHost, text: command});
+        }
+
+        function openDashboard() {
+            if (detailHost) window.open('http://' + detailHost + '/', '_blank');
+        }
+
+        function scheduleFrame() {
+            if (frameScheduled) return;
+            frameScheduled = true;
+            requestAnimationFrame(renderFrame);
+        }
+
+        function setText(element, text) {
+            if (element.textContent !== text) element.textContent = text;
+        }
+
+        function createTile(host) {
+            const element = document.createElement('div');
+            element.innerHTML = '<div class="tile-name"></div><div class="tile-state"></div>' +
+                                '<div class="tile-state"></div><div class="tile-status"></div>';
+            element.onclick = () => showDetail(host);
+            const tile = {
+                element: element,
+                name: element.children[0],
+                mode: element.children[1],
+                battery: element.children[2],
+                status: element.children[3]
+            };
+            setText(tile.name, host);
+            document.getElementById('grid').appendChild(element);
+            tiles[host] = tile;
+            return tile;
+        }
+
+        // Worker batches arrive a few times a second; the DOM is touched once
+        // per animation frame and only where a value changed
+        function renderFrame() {
+            frameScheduled = false;
+
+            for (const [host, data] of pendingTiles) {
+                if (!hosts.includes(host)) continue;
+                const tile = tiles[host] || createTile(host);
+                const className = 'tile ' + data.link + (data.fault ? ' fault' : '');
+                if (tile.element.className !== className) tile.element.className = className;
+                setText(tile.mode, (data.fault ? '⚠️ ' : '') + (data.mode !== undefined ? data.mode : data.link));
+                const battery = typeof data.battery === 'number' ? Math.round(data.battery) : null;
+                setText(tile.battery, battery !== null ? '🔋 ' + battery + '%' : '');
+                const batteryClass = 'tile-state' + (battery !== null && battery < 20 ? ' low' : '');
+                if (tile.battery.className !== batteryClass) tile.battery.className = batteryClass;
+                setText(tile.status, data.status || '');
+            }
+            pendingTiles.clear();
+
+            let up = 0, faults = 0;
+            for (const host in tiles) {
+                if (tiles[host].element.classList.contains('up')) up++;
+                if (tiles[host].element.classList.contains('fault')) faults++;
+            }
+            setText(document.getElementById('summary'),
+                    `${up}/${hosts.length} connected` + (faults ? `, ${faults} faults` : ''));
+
+            if (pendingDetail) {
+                renderDetail(pendingDetail);
+                pendingDetail = null;
+            }
+        }
+
+        function renderDetail(detail) {
+            setText(document.getElementById('detailName'), detail.host + ' - ' + detail.link);
+            const grid = document.getElementById('detailTelemetry');
+            for (const key in detail.telemetry) {
+                let cell = detailCells[key];
+                if (!cell) {
+                    cell = document.createElement('div');
+                    cell.className = 'telemetry-item';
+                    grid.appendChild(cell);
+                    detailCells[key] = cell;
+                }
+                setText(cell, key + ': ' + detail.telemetry[key]);
+            }
+            const log = document.getElementById('detailLog');
+            setText(log, detail.log.map(entry =>
+                `[${new Date(entry[0]).toLocaleTimeString()}] ${entry[1]}`).join('\n'));
+            log.scrollTop = log.scrollHeight;
+        }
+    </script>
+</body>
+</html>
+)rawliteral";
+
+// Fleet connection worker: one WebSocket per vehicle, shared by every
+// /fleet tab of this origin. It decodes the delta telemetry, keeps a short
+// status log per vehicle and posts the tiles that changed in batches.
+const char fleetWorker[] PROGMEM = R"rawliteral(
+importScripts('/delta.js');
+
+const BATCH_MS = 250;
+const LOG_LENGTH = 50;
+const RETRY_MIN_MS = 2000;
+const RETRY_MAX_MS = 30000;
+
+const vehicles = new Map();
+const pages = [];
+let credentials = null;  // memory only; needed again after a vehicle reboots
+let batchTimer = null;
+
+function addVehicle(host) {
+    const v = {
+        host: host, ws: null, token: null, link: 'down', busy: false, timer: null,
+        retryMs: RETRY_MIN_MS, telemetry: {}, names: {}, seq: -1, status: '', log: [],
+        dirty: true, removed: false
+    };
+    vehicles.set(host, v);
+    markDirty(v);
+    connect(v);
+}
+
+function removeVehicle(v) {
+    v.removed = true;
+    clearTimeout(v.timer);
+    if (v.ws) v.ws.close();
+    vehicles.delete(v.host);
+}
+
+function setLink(v, link) {
+    if (v.link === link) return;
+    v.link = link;
+    markDirty(v);
+}
+
+function markDirty(v) {
+    v.dirty = true;
+    if (!batchTimer) batchTimer = setTimeout(flush, BATCH_MS);
+}
+
+async function connect(v) {
+    v.timer = null;
+    if (v.removed || v.busy || v.ws || !credentials) return;
+    v.busy = true;
+    setLink(v, 'connecting');
+    if (!v.token) {
+        const tried = credentials;
+        try {
+            // text/plain keeps the cross-origin login a simple request (no preflight)
+            const response = await fetch('http://' + v.host + '/login', {
+                method: 'POST',
+                headers: {'Content-Type': 'text/plain'},
+                body: JSON.stringify(tried)
+            });
+            const result = await response.json();
+            if (!result.success) {
+                v.busy = false;
+                setLink(v, 'denied');  // until the next login
+                // Forget the refused credentials and ask every tab for new ones
+                if (credentials === tried) {
+                    credentials = null;
+                    for (const page of pages) page.port.postMessage({type: 'login', host: v.host});
+                }
+                return;
+            }
+            v.token = result.token;
+        } catch (e) {
+            v.busy = false;
+            setLink(v, 'down');
+            retry(v);
+            return;
+        }
+    }
+    v.busy = false;
+    if (v.removed) return;
+
+    const ws = new WebSocket('ws://' + v.host + ':81', ['agv.v1', 'agv-token.' + v.token]);
+    ws.binaryType = 'arraybuffer';
+    let opened = false;
+    v.ws = ws;
+
+    ws.onopen = function() {
+        opened = true;
+        v.retryMs = RETRY_MIN_MS;
+        v.seq = -1;
+        ws.send('TELEMETRY DELTA');
+        setLink(v, 'up');
+    };
+
+    ws.onclose = function() {
+        if (v.ws !== ws) return;
+        v.ws = null;
+        if (!opened) v.token = null;  // refused at the handshake: log in again
+        if (v.removed) return;
+        setLink(v, 'down');
+        retry(v);
+    };
+
+    ws.onmessage = function(event) {
+        if (event.data instanceof ArrayBuffer) {
+            applyDelta(v, new Uint8Array(event.data));
+        } else {
+            applyText(v, event.data);
+        }
+    };
+}
+
+// Backoff with jitter, so vehicles behind a restarted access point do not
+// all come back in the same second
+function retry(v) {
+    if (v.removed || v.timer) return;
+    v.timer = setTimeout(() => connect(v), v.retryMs * (0.5 + Math.random() / 2));
+    v.retryMs = Math.min(v.retryMs * 2, RETRY_MAX_MS);
+}
+
+function applyText(v, text) {
+    if (text.startsWith('STATE: ')) {
+        try {
+            Object.assign(v.telemetry, JSON.parse(text.substring(7)));
+        } catch (e) {
+            return;
+        }
+        markDirty(v);
+        return;
+    }
+    if (text.startsWith('SELFTEST: ')) return;  // broadcast benchmark traffic
+    v.log.push([Date.now(), text]);
+    if (v.log.length > LOG_LENGTH) v.log.shift();
+    if (!text.startsWith('CLIENT: ') && !text.startsWith('Received: ')) v.status = text;
+    markDirty(v);
+}
+
+// A vehicle is its own decoder state (seq, names, telemetry)
+function applyDelta(v, bytes) {
+    if (decodeDelta(v, bytes, () => v.ws && v.ws.send('RESYNC'))) markDirty(v);
+}
+
+// What a tile shows: the keys fleet discovery summarizes too
+function tile(v) {
+    const errors = v.telemetry.errors;
+    return {
+        host: v.host,
+        link: v.link,
+        mode: v.telemetry.mode,
+        battery: v.telemetry.battery,
+        fault: errors !== undefined && errors !== 0 && errors !== '' && errors !== '0',
+        status: v.status
+    };
+}
+
+function detail(v) {
+    return {host: v.host, link: v.link, telemetry: v.telemetry, log: v.log};
+}
+
+function flush() {
+    batchTimer = null;
+    const changed = [];
+    for (const v of vehicles.values()) {
+        if (!v.dirty) continue;
+        v.dirty = false;
+        changed.push(tile(v));
+        for (const page of pages) {
+            if (page.detail === v.host) page.port.postMessage({type: 'detail', detail: detail(v)});
+        }
+    }
+    if (changed.length === 0) return;
+    for (const page of pages) page.port.postMessage({type: 'tiles', tiles: changed});
+}
+
+function receive(page, message) {
+    if (message.type === 'login') {
+        credentials = {username: message.username, password: message.password};
+        for (const v of vehicles.values()) {
+            if (v.link === 'denied' || (v.link === 'down' && !v.busy)) {
+                clearTimeout(v.timer);
+                v.timer = null;
+                v.token = null;
+                connect(v);
+            }
+        }
+    } else if (message.type === 'hosts') {
+        for (const v of Array.from(vehicles.values())) {
+            if (!message.hosts.includes(v.host)) removeVehicle(v);
+        }
+        for (const host of message.hosts) {
+            if (!vehicles.has(host)) addVehicle(host);
+        }
+        const list = Array.from(vehicles.keys());
+        for (const other of pages) other.port.postMessage({type: 'hosts', hosts: list});
+    } else if (message.type === 'detail') {
+        page.detail = message.host;
+        const v = vehicles.get(message.host);
+        if (v) page.port.postMessage({type: 'detail', detail: detail(v)});
+    } else if (message.type === 'command') {
+        const v = vehicles.get(message.host);
+        if (v && v.ws && v.link === 'up') v.ws.send(message.text);
+    } else if (message.type === 'close') {
+        pages.splice(pages.indexOf(page), 1);
+    }
+}
+
+function attach(port) {
+    const page = {port: port, detail: null};
+    pages.push(page);
+    port.onmessage = event => receive(page, event.data);
+    port.postMessage({type: 'hello', login: !credentials});
+    port.postMessage({type: 'tiles', tiles: Array.from(vehicles.values(), tile)});
+}
+
+if (typeof SharedWorkerGlobalScope !== 'undefined' && self instanceof SharedWorkerGlobalScope) {
+    self.onconnect = event => attach(event.ports[0]);
+} else {
+    attach(self);
+}
+)rawliteral";
+#endif
 
 #endif
\ No newline at end of file
@@ -0,0 +1,191 @@
+#include "AGVDelta.h"
+#include <math.h>
+
+using namespace AGVCoreNetworkLib;
+
+#if AGVNET_ENABLE_DELTA
+
+// Largest field record: slot, type, named key, longest text
+static_assert(5 + AGV_TELEMETRY_MAX_KEYS * (2 + AGV_TELEMETRY_KEY_LEN + AGV_TELEMETRY_TEXT_LEN) <= AGV_DELTA_FRAME_MAX,
+              "a keyframe of every telemetry key must fit AGV_DELTA_FRAME_MAX");
+static_assert(AGV_TELEMETRY_MAX_KEYS < 128, "delta field count must fit one varint byte");
+
+// LEB128 varint; returns bytes written, 0 if it does not fit
+static size_t putVarint(uint8_t* out, size_t size, uint64_t value) {
+  size_t n = 0;
+  do {
+    if (n >= size) return 0;
+    uint8_t byte = value & 0x7F;
+    value >>= 7;
+    out[n++] = value ? (byte | 0x80) : byte;
+  } while (value);
+  return n;
+}
+
+static inline uint64_t zigzag(int64_t value) {
+  return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+bool AGVDeltaEncoder::load(const AGVTelemetryValue& value, Field& out) {
+  out.type = value.type;
+  switch (value.type) {
+    case AGV_TELEM_INT:
+      out.number = value.i;
+      return true;
+    case AGV_TELEM_FLOAT:
+      if (!isfinite(value.f)) return false;
+      out.number = llroundf(value.f * 1000.0f);
+      return true;
+    case AGV_TELEM_TEXT:
+      memcpy(out.text, value.text, sizeof(out.text));
+      out.text[sizeof(out.text) - 1] = '\0';
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool AGVDeltaEncoder::same(const Field& a, const Field& b) {
+  if (a.type != b.type) return false;
+  if (a.type == AGV_TELEM_TEXT) return strcmp(a.text, b.text) == 0;
+  return a.number == b.number;
+}
+
+// One field record; `number` is the value to write for int/float (absolute or delta)
+size_t AGVDeltaEncoder::putField(uint8_t* out, size_t size, uint8_t slot, const Field& field,
+                                 const char* name, int64_t number) {
+  size_t n = putVarint(out, size, slot);
+  if (n == 0 || n >= size) return 0;
+  out[n++] = field.type | (name ? AGV_DELTA_NAMED : 0);
+  if (name) {
+    size_t length = strlen(name);
+    if (n + 1 + length > size) return 0;
+    out[n++] = (uint8_t)length;
+    memcpy(out + n, name, length);
+    n += length;
+  }
+  if (field.type == AGV_TELEM_TEXT) {
+    size_t length = strlen(field.text);
+    if (n + 1 + length > size) return 0;
+    out[n++] = (uint8_t)length;
+    memcpy(out + n, field.text, length);
+    return n + length;
+  }
+  size_t v = putVarint(out + n, size - n, zigzag(number));
+  return v ? n + v : 0;
+}
+
+size_t AGVDeltaEncoder::encodeKeyframe(uint8_t* out, size_t size) {
+  if (size < 1) return 0;
+  size_t n = 0;
+  out[n++] = AGV_DELTA_KEYFRAME;
+  size_t v = putVarint(out + n, size - n, seq);
+  if (!v) return 0;
+  n += v;
+
+  uint8_t count = 0;
+  for (uint8_t i = 0; i < fieldCount; i++) {
+    if (fields[i].type != AGV_TELEM_NONE) count++;
+  }
+  v = putVarint(out + n, size - n, count);
+  if (!v) return 0;
+  n += v;
+
+  for (uint8_t i = 0; i < fieldCount; i++) {
+    if (fields[i].type == AGV_TELEM_NONE) continue;
+    v = putField(out + n, size - n, i, fields[i], names[i], fields[i].number);
+    if (!v) return 0;
+    n += v;
+    fields[i].named = true;
+  }
+  return n;
+}
+
+size_t AGVDeltaEncoder::keyframe(uint8_t* out, size_t size, bool resync) {
+  size_t n = encodeKeyframe(out, size);
+  if (n == 0) {
+    stats.overflows++;
+    return 0;
+  }
+  stats.keyframes++;
+  if (resync) stats.resyncs++;
+  stats.bytes += n;
+  return n;
+}
+
+size_t AGVDeltaEncoder::update(const AGVTelemetry& telemetry, uint32_t nowMs, uint8_t* out, size_t size) {
+  // New keys since the last pass (slots are never reused)
+  uint8_t keys = telemetry.count();
+  while (fieldCount < keys) {
+    strncpy(names[fieldCount], telemetry.keyAt(fieldCount), AGV_TELEMETRY_KEY_LEN - 1);
+    fields[fieldCount].type = AGV_TELEM_NONE;
+    fields[fieldCount].named = false;
+    fieldCount++;
+  }
+
+  if (resyncAll || nowMs - lastKeyframeMs >= AGV_DELTA_KEYFRAME_MS) {
+    // Periodic keyframe: refresh the whole baseline
+    for (uint8_t i = 0; i < fieldCount; i++) {
+      AGVTelemetryValue value;
+      if (telemetry.read(i, value)) load(value, fields[i]);
+    }
+    seq++;
+    lastKeyframeMs = nowMs;
+    resyncAll = false;
+    return keyframe(out, size, false);
+  }
+
+  // Changed fields only. The baseline moves as fields are encoded; should
+  // the frame not fit, it is dropped and the next pass sends a keyframe.
+  if (size < 3) return 0;
+  size_t n = 0;
+  out[n++] = AGV_DELTA_UPDATE;
+  size_t v = putVarint(out + n, size - n, seq + 1);
+  if (!v || n + v >= size) return 0;
+  n += v;
+  size_t countAt = n++;  // at most AGV_TELEMETRY_MAX_KEYS: one varint byte
+
+  uint8_t count = 0;
+  for (uint8_t i = 0; i < fieldCount; i++) {
+    AGVTelemetryValue value;
+    Field field;
+    if (!telemetry.read(i, value) || !load(value, field)) continue;
+    Field& last = fields[i];
+    if (same(field, last)) continue;
+
+    // New fields and type changes carry their name and an absolute value
+    bool named = !last.named || last.type != field.type;
+    int64_t number = named ? field.number : field.number - last.number;
+    v = putField(out + n, size - n, i, field, named ? names[i] : nullptr, number);
+    if (!v) {
+      stats.overflows++;
+      resyncAll = true;
+      return 0;
+    }
+    n += v;
+    field.named = true;
+    last = field;
+    count++;
+  }
+  if (count == 0) return 0;
+
+  out[countAt] = count;
+  seq++;
+  stats.deltas++;
+  stats.fields += count;
+  stats.bytes += n;
+  return n;
+}
+
+size_t AGVDeltaEncoder::toJson(char* buffer, size_t size) const {
+  int written = snprintf(buffer, size,
+                         "{\"seq\":%lu,\"keyframes\":%lu,\"deltas\":%lu,\"resyncs\":%lu,\"fields\":%lu,"
+                         "\"bytes\":%lu,\"overflows\":%lu}",
+                         (unsigned long)seq, (unsigned long)stats.keyframes, (unsigned long)stats.deltas,
+                         (unsigned long)stats.resyncs, (unsigned long)stats.fields,
+                         (unsigned long)stats.bytes,
+                         (unsigned long)stats.overflows);
+  return (written > 0 && (size_t)written < size) ? (size_t)written : 0;
+}
+
+#endif
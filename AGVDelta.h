@@ -0,0 +1,83 @@
+#ifndef AGVDELTA_H
+#define AGVDELTA_H
+
+#include <Arduino.h>
+#include "AGVCoreNetworkConfig.h"
+#include "AGVTelemetry.h"
+
+#define AGV_DELTA_KEYFRAME 0x01
+#define AGV_DELTA_UPDATE 0x02
+#define AGV_DELTA_NAMED 0x80   // field type flag: key name follows
+
+// Frame buffer: a keyframe of every key with the longest names and texts
+#define AGV_DELTA_FRAME_MAX 1024
+
+namespace AGVCoreNetworkLib {
+
+typedef struct {
+  uint32_t keyframes;     // broadcast and per-client
+  uint32_t deltas;
+  uint32_t resyncs;       // keyframes requested by clients after a gap
+  uint32_t fields;        // changed fields sent in deltas
+  uint32_t bytes;         // delta and keyframe bytes encoded
+  uint32_t overflows;     // update did not fit (replaced by a keyframe)
+} AGVDeltaStats;
+
+// Delta-encoded telemetry for WebSocket clients that subscribe with
+// "TELEMETRY DELTA". The encoder keeps the last broadcast value of every
+// field (the baseline) and emits only the fields that changed, as one
+// binary frame shared by all subscribers:
+//
+//   u8 kind (AGV_DELTA_KEYFRAME / AGV_DELTA_UPDATE), varint seq, varint count,
+//   count x { varint slot, u8 type [| AGV_DELTA_NAMED, u8 length, name], value }
+//
+// Values: int = zigzag varint, float = zigzag varint of value * 1000 (the
+// precision of STATE: JSON), text = u8 length + bytes. In an update, ints
+// and floats are the difference to the previous value of the field. A
+// field's name is sent in every keyframe and with its first update;
+// afterwards the slot number identifies it.
+//
+// Every update advances seq by one. A client that sees a jump asks for
+// "RESYNC" and gets a keyframe of the baseline at the current seq, as do
+// new subscribers; a keyframe is also broadcast every AGV_DELTA_KEYFRAME_MS.
+// Non-finite floats are not sent (the field keeps its last value).
+// Browsers decode it with deltaDecoder (/delta.js) - keep the two in step.
+//
+// Not thread-safe - use from the network task within the clients lock.
+class AGVDeltaEncoder {
+public:
+  // Frame for all subscribers (update or periodic keyframe); 0 if nothing to send
+  size_t update(const AGVTelemetry& telemetry, uint32_t nowMs, uint8_t* out, size_t size);
+
+  // Keyframe of the baseline for one client (subscribe or resync)
+  size_t keyframe(uint8_t* out, size_t size, bool resync);
+
+  uint32_t sequence() const { return seq; }
+  size_t toJson(char* buffer, size_t size) const;
+
+private:
+  typedef struct {
+    AGVTelemetryType type;
+    bool named;             // name sent since the last keyframe
+    int64_t number;         // int, or float * 1000
+    char text[AGV_TELEMETRY_TEXT_LEN];
+  } Field;
+
+  Field fields[AGV_TELEMETRY_MAX_KEYS] = {};
+  char names[AGV_TELEMETRY_MAX_KEYS][AGV_TELEMETRY_KEY_LEN] = {};
+  uint8_t fieldCount = 0;
+  uint32_t seq = 0;
+  uint32_t lastKeyframeMs = 0;
+  bool resyncAll = true;  // first update is a keyframe
+  AGVDeltaStats stats = {};
+
+  static bool load(const AGVTelemetryValue& value, Field& out);
+  static bool same(const Field& a, const Field& b);
+  size_t encodeKeyframe(uint8_t* out, size_t size);
+  static size_t putField(uint8_t* out, size_t size, uint8_t slot, const Field& field,
+                         const char* name, int64_t number);
+};
+
+} // namespace AGVCoreNetworkLib
+
+#endif
@@ -0,0 +1,125 @@
+#include "AGVDiscovery.h"
+#include "AGVAuth.h"
+#include <ESPmDNS.h>
+
+using namespace AGVCoreNetworkLib;
+
+#if AGVNET_ENABLE_DISCOVERY
+
+bool AGVDiscovery::begin(uint16_t httpPort, const char* firmware) {
+  if (!MDNS.addService("agv", "tcp", httpPort)) return false;
+
+  char text[96];
+  MDNS.addServiceTxt("agv", "tcp", "fw", firmware);
+#if AGVNET_ENABLE_WEBSOCKET
+  snprintf(text, sizeof(text), "%u", (unsigned)AGVNET_WS_PORT);
+  MDNS.addServiceTxt("agv", "tcp", "ws", text);
+  MDNS.addServiceTxt("agv", "tcp", "proto", AGV_WS_PROTOCOL);
+#endif
+  capabilities(text, sizeof(text));
+  MDNS.addServiceTxt("agv", "tcp", "caps", text);
+
+  started = true;
+  AGVFleetSummary summary;
+  memset(&summary, 0, sizeof(summary));
+  summary.battery = -1;
+  publish(summary);
+  return true;
+}
+
+// Compiled-in protocol features, comma separated
+size_t AGVDiscovery::capabilities(char* buffer, size_t size) {
+  static const struct { bool enabled; const char* name; } features[] = {
+    { AGVNET_ENABLE_WEBSOCKET, "ws" },
+    { AGVNET_ENABLE_AUTH, "auth" },
+    { AGVNET_ENABLE_TIMED, "timed" },
+    { AGVNET_ENABLE_MISSION, "mission" },
+    { AGVNET_ENABLE_ROUTING, "route" },
+    { AGVNET_ENABLE_MQTT, "mqtt" },
+    { AGVNET_ENABLE_RECORDER, "recorder" },
+    { AGVNET_ENABLE_CAPTURE, "capture" },
+  };
+  size_t length = 0;
+  buffer[0] = '\0';
+  for (size_t i = 0; i < sizeof(features) / sizeof(features[0]); i++) {
+    if (!features[i].enabled) continue;
+    int written = snprintf(buffer + length, size - length, "%s%s", length ? "," : "", features[i].name);
+    if (written < 0 || (size_t)written >= size - length) break;
+    length += written;
+  }
+  return length;
+}
+
+void AGVDiscovery::summarize(const AGVTelemetry& telemetry, bool linkUp, AGVFleetSummary& out) {
+  memset(&out, 0, sizeof(out));
+  out.battery = -1;
+  out.linkUp = linkUp;
+
+  AGVTelemetryValue value;
+  if (telemetry.get("mode", value)) {
+    if (value.type == AGV_TELEM_TEXT) {
+      // Printable, no spaces or quotes: the value also goes into /stats JSON
+      size_t i = 0;
+      for (; i < sizeof(out.mode) - 1 && value.text[i]; i++) {
+        char c = value.text[i];
+        out.mode[i] = (c > ' ' && c < 0x7F && c != '"' && c != '\\') ? c : '_';
+      }
+      out.mode[i] = '\0';
+    } else {
+      AGVTelemetry::formatValue(value, out.mode, sizeof(out.mode));
+    }
+  }
+  if (telemetry.get("battery", value)) {
+    float percent = value.type == AGV_TELEM_FLOAT ? value.f
+                  : value.type == AGV_TELEM_INT ? (float)value.i : -1.0f;
+    if (percent >= 0.0f) out.battery = percent >= 100.0f ? 10 : (int8_t)(percent / 10.0f);
+  }
+  if (telemetry.get("errors", value)) {
+    out.fault = value.type == AGV_TELEM_INT ? value.i != 0
+              : value.type == AGV_TELEM_FLOAT ? value.f != 0.0f
+              : value.text[0] != '\0' && strcmp(value.text, "0") != 0;
+  }
+}
+
+void AGVDiscovery::service(uint32_t nowMs, const AGVTelemetry& telemetry, bool linkUp) {
+  if (!started) return;
+  const char* firmware = __atomic_exchange_n(&pendingFirmware, (const char*)nullptr, __ATOMIC_ACQUIRE);
+  if (firmware) MDNS.addServiceTxt("agv", "tcp", "fw", firmware);
+  if (nowMs - lastCheckMs < AGV_DISCOVERY_TXT_MS) return;
+  lastCheckMs = nowMs;
+
+  AGVFleetSummary summary;
+  summarize(telemetry, linkUp, summary);
+  if (memcmp(&summary, &published, sizeof(summary)) != 0) publish(summary);
+}
+
+// Every TXT change makes the responder announce the record again
+void AGVDiscovery::publish(const AGVFleetSummary& summary) {
+  char text[12];
+  MDNS.addServiceTxt("agv", "tcp", "mode", summary.mode[0] ? summary.mode : "-");
+  if (summary.battery < 0) {
+    MDNS.addServiceTxt("agv", "tcp", "bat", "-");
+  } else {
+    snprintf(text, sizeof(text), "%d", summary.battery);
+    MDNS.addServiceTxt("agv", "tcp", "bat", text);
+  }
+  MDNS.addServiceTxt("agv", "tcp", "fault", summary.fault ? "1" : "0");
+  MDNS.addServiceTxt("agv", "tcp", "link", summary.linkUp ? "1" : "0");
+  snprintf(text, sizeof(text), "%lu", (unsigned long)++seq);
+  MDNS.addServiceTxt("agv", "tcp", "seq", text);
+
+  published = summary;
+  updates++;
+}
+
+size_t AGVDiscovery::toJson(char* buffer, size_t size) const {
+  int written = snprintf(buffer, size,
+                         "{\"active\":%s,\"seq\":%lu,\"updates\":%lu,\"mode\":\"%s\",\"bat\":%d,"
+                         "\"fault\":%s,\"link\":%s}",
+                         started ? "true" : "false", (unsigned long)seq, (unsigned long)updates,
+                         published.mode, published.battery,
+                         published.fault ? "true" : "false", published.linkUp ? "true" : "false");
+  return (written > 0 && (size_t)written < size) ? (size_t)written : 0;
+}
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef AGVDISCOVERY_H
+#define AGVDISCOVERY_H
+
+#include <Arduino.h>
+#include "AGVCoreNetworkConfig.h"
+#include "AGVTelemetry.h"
+
+#define AGV_DISCOVERY_MODE_LEN 16
+
+namespace AGVCoreNetworkLib {
+
+// State summary carried in the TXT record
+typedef struct {
+  char mode[AGV_DISCOVERY_MODE_LEN];  // telemetry "mode" ("" if never set)
+  int8_t battery;                     // telemetry "battery" in tens of percent, -1 unknown
+  bool fault;                         // telemetry "errors" non-zero
+  bool linkUp;                        // an operator is connected
+} AGVFleetSummary;
+
+// Fleet discovery: a _agv._tcp mDNS service whose TXT record describes the
+// vehicle, so a supervisor learns the whole fleet from one multicast query
+// (tools/agv_scan.py) instead of opening a WebSocket to every host.
+//
+//   fw, ws, proto, caps    fixed at start
+//   mode, bat, fault, link state summary
+//   seq                    bumped on every summary change
+//
+// The summary is checked at most once per AGV_DISCOVERY_TXT_MS and only
+// re-announced when it changed. Battery is bucketed so a slowly draining
+// pack does not announce every few seconds.
+//
+// Not thread-safe (except setFirmware) - use from the network task.
+class AGVDiscovery {
+public:
+  // Add the service once mDNS is up
+  bool begin(uint16_t httpPort, const char* firmware);
+
+  // Any task: applied by the next service() call
+  void setFirmware(const char* firmware) { __atomic_store_n(&pendingFirmware, firmware, __ATOMIC_RELEASE); }
+
+  void service(uint32_t nowMs, const AGVTelemetry& telemetry, bool linkUp);
+
+  static void summarize(const AGVTelemetry& telemetry, bool linkUp, AGVFleetSummary& out);
+  size_t toJson(char* buffer, size_t size) const;
+
+private:
+  bool started = false;
+  const char* pendingFirmware = nullptr;
+  AGVFleetSummary published = {};
+  uint32_t lastCheckMs = 0;
+  uint32_t seq = 0;
+  uint32_t updates = 0;
+
+  void publish(const AGVFleetSummary& summary);
+  static size_t capabilities(char* buffer, size_t size);
+};
+
+} // namespace AGVCoreNetworkLib
+
+#endif
@@ -0,0 +1,216 @@
+#include "AGVDispatch.h"
+
+using namespace AGVCoreNetworkLib;
+
+#if AGVNET_ENABLE_DISPATCH
+
+static_assert(AGV_DISPATCH_MAX_VERBS < AGV_DISPATCH_NONE, "AGV_DISPATCH_MAX_VERBS too large");
+static_assert((AGV_DISPATCH_TABLE_SIZE & (AGV_DISPATCH_TABLE_SIZE - 1)) == 0,
+              "AGV_DISPATCH_MAX_VERBS must be a power of two");
+
+// Seeds tried per rebuild; at quarter load over 1 in 8 seeds is collision-free
+#define AGV_DISPATCH_SEED_TRIES 4096
+
+bool AGVDispatcher::begin(AGVMessagePool* pool) {
+  this->pool = pool;
+  memset(table, AGV_DISPATCH_NONE, sizeof(table));
+  core1Queue = xQueueCreate(AGV_DISPATCH_QUEUE_LEN, sizeof(Job));
+  workerQueue = xQueueCreate(AGV_DISPATCH_QUEUE_LEN, sizeof(Job));
+  return core1Queue && workerQueue;
+}
+
+// FNV-1a over the upper-cased verb, seeded, with a final mix of the high bits
+uint32_t AGVDispatcher::hash(const char* verb, uint8_t length, uint32_t seed) {
+  uint32_t h = 2166136261u ^ seed;
+  for (uint8_t i = 0; i < length; i++) {
+    h ^= (uint8_t)toupper((uint8_t)verb[i]);
+    h *= 16777619u;
+  }
+  return h ^ (h >> 15);
+}
+
+uint8_t AGVDispatcher::verbLength(const char* command) {
+  uint8_t length = 0;
+  while (command[length] && command[length] != ':' && command[length] != ' ') {
+    if (++length >= AGV_DISPATCH_VERB_LEN) return 0;  // longer than any verb
+  }
+  return length;
+}
+
+int AGVDispatcher::find(const char* verb, uint8_t length) const {
+  if (length == 0 || verbCount == 0) return -1;
+  uint8_t index = table[hash(verb, length, seed) & (AGV_DISPATCH_TABLE_SIZE - 1)];
+  if (index == AGV_DISPATCH_NONE) return -1;
+  const Verb& entry = verbs[index];
+  if (entry.length != length || strncasecmp(entry.name, verb, length) != 0) return -1;
+  return index;
+}
+
+// Search a seed under which no two verbs share a slot
+bool AGVDispatcher::rebuild() {
+  for (uint32_t candidate = 0; candidate < AGV_DISPATCH_SEED_TRIES; candidate++) {
+    uint8_t slots[AGV_DISPATCH_TABLE_SIZE];
+    memset(slots, AGV_DISPATCH_NONE, sizeof(slots));
+    bool collision = false;
+    for (uint8_t i = 0; i < verbCount && !collision; i++) {
+      uint32_t slot = hash(verbs[i].name, verbs[i].length, candidate) & (AGV_DISPATCH_TABLE_SIZE - 1);
+      if (slots[slot] != AGV_DISPATCH_NONE) {
+        collision = true;
+      } else {
+        slots[slot] = i;
+      }
+    }
+    if (!collision) {
+      memcpy(table, slots, sizeof(table));
+      seed = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool AGVDispatcher::on(const char* verb, AGVVerbHandler handler, AGVHandlerContext context) {
+  if (!verb || context > AGV_CONTEXT_WORKER) return false;
+  uint8_t length = verbLength(verb);
+  if (length == 0 || verb[length] != '\0') return false;
+
+  // Known verb: replace (or disable) in place, so queued jobs stay valid
+  int index = find(verb, length);
+  if (index >= 0) {
+    Verb& entry = verbs[index];
+    if (handler && context != entry.context && __atomic_load_n(&entry.pending, __ATOMIC_ACQUIRE)) {
+      return false;  // queued jobs would run in the old context
+    }
+    entry.handler = handler;
+    if (handler) entry.context = context;
+  } else {
+    if (!handler) return true;
+    if (verbCount >= AGV_DISPATCH_MAX_VERBS) return false;
+    Verb& entry = verbs[verbCount++];
+    for (uint8_t i = 0; i < length; i++) {
+      entry.name[i] = toupper((uint8_t)verb[i]);
+    }
+    entry.name[length] = '\0';
+    entry.length = length;
+    entry.handler = handler;
+    entry.context = context;
+    if (!rebuild()) {
+      verbCount--;
+      rebuild();
+      return false;
+    }
+  }
+
+  if (context == AGV_CONTEXT_WORKER && !workerHandle) {
+    xTaskCreatePinnedToCore(workerTask, "AGVNetWorker", AGV_DISPATCH_WORKER_STACK, this,
+                            AGV_DISPATCH_WORKER_PRIORITY, &workerHandle, AGVNET_TASK_CORE);
+    if (!workerHandle) return false;
+  }
+  return true;
+}
+
+AGVDispatchResult AGVDispatcher::dispatch(const AGVMessage* msg) {
+  const char* text = msg->text();
+  uint8_t length = verbLength(text);
+  int index = find(text, length);
+  if (index < 0 || !verbs[index].handler) return AGV_DISPATCH_UNHANDLED;
+
+  Verb& verb = verbs[index];
+  if (verb.context == AGV_CONTEXT_INLINE) {
+    Job job = { const_cast<AGVMessage*>(msg), (uint8_t)index };
+    run(job);
+    return AGV_DISPATCH_DONE;
+  }
+
+  // Queued contexts outlive the dispatch pass: give them their own block
+  Job job = { pool->copy(text, msg->length), (uint8_t)index };
+  if (job.msg) {
+    job.msg->source = msg->source;
+    job.msg->priority = msg->priority;
+    job.msg->client = msg->client;
+    job.msg->cls = msg->cls;
+    job.msg->queuedUs = micros();
+    QueueHandle_t queue = verb.context == AGV_CONTEXT_CORE1 ? core1Queue : workerQueue;
+    __atomic_add_fetch(&verb.pending, 1, __ATOMIC_RELEASE);
+    if (xQueueSend(queue, &job, 0) == pdPASS) return AGV_DISPATCH_QUEUED;
+    __atomic_sub_fetch(&verb.pending, 1, __ATOMIC_RELEASE);
+    pool->release(job.msg);
+  }
+  verb.stats.dropped++;
+  return AGV_DISPATCH_DROPPED;
+}
+
+// Run one handler and account its time (stats of a verb are written by
+// its own context only)
+void AGVDispatcher::run(const Job& job) {
+  Verb& verb = verbs[job.verb];
+  AGVVerbHandler handler = verb.handler;
+  if (!handler) return;  // removed while queued
+
+  const char* text = job.msg->text();
+  uint8_t length = verbLength(text);
+  const char* args = text[length] ? text + length + 1 : "";
+
+  uint32_t startUs = micros();
+  if (verb.context != AGV_CONTEXT_INLINE) {
+    uint32_t waitUs = startUs - job.msg->queuedUs;
+    if (waitUs > verb.stats.maxWaitUs) verb.stats.maxWaitUs = waitUs;
+  }
+  handler(text, args, job.msg->source, job.msg->priority);
+  uint32_t runUs = micros() - startUs;
+
+  verb.stats.calls++;
+  verb.stats.lastRunUs = runUs;
+  verb.stats.totalRunUs += runUs;
+  if (runUs > verb.stats.maxRunUs) verb.stats.maxRunUs = runUs;
+}
+
+uint8_t AGVDispatcher::runCore1(uint8_t max) {
+  uint8_t ran = 0;
+  Job job;
+  while (ran < max && core1Queue && xQueueReceive(core1Queue, &job, 0) == pdPASS) {
+    run(job);
+    pool->release(job.msg);
+    __atomic_sub_fetch(&verbs[job.verb].pending, 1, __ATOMIC_RELEASE);
+    ran++;
+  }
+  return ran;
+}
+
+void AGVDispatcher::workerTask(void* parameter) {
+  AGVDispatcher* dispatcher = (AGVDispatcher*)parameter;
+  Job job;
+  while (true) {
+    if (xQueueReceive(dispatcher->workerQueue, &job, portMAX_DELAY) == pdPASS) {
+      dispatcher->run(job);
+      dispatcher->pool->release(job.msg);
+      __atomic_sub_fetch(&dispatcher->verbs[job.verb].pending, 1, __ATOMIC_RELEASE);
+    }
+  }
+}
+
+const char* AGVDispatcher::contextName(AGVHandlerContext context) {
+  switch (context) {
+    case AGV_CONTEXT_INLINE: return "inline";
+    case AGV_CONTEXT_CORE1:  return "core1";
+    case AGV_CONTEXT_WORKER: return "worker";
+  }
+  return "unknown";
+}
+
+size_t AGVDispatcher::verbToJson(uint8_t index, char* buffer, size_t size) const {
+  if (index >= verbCount) return 0;
+  const Verb& verb = verbs[index];
+  const AGVVerbStats& stats = verb.stats;
+  int written = snprintf(buffer, size,
+                         "{\"verb\":\"%s\",\"context\":\"%s\",\"active\":%s,\"calls\":%lu,\"dropped\":%lu,"
+                         "\"maxWaitUs\":%lu,\"runUs\":{\"last\":%lu,\"max\":%lu,\"avg\":%lu}}",
+                         verb.name, contextName(verb.context), verb.handler ? "true" : "false",
+                         (unsigned long)stats.calls, (unsigned long)stats.dropped,
+                         (unsigned long)stats.maxWaitUs, (unsigned long)stats.lastRunUs,
+                         (unsigned long)stats.maxRunUs,
+                         (unsigned long)(stats.calls ? stats.totalRunUs / stats.calls : 0));
+  return (written > 0 && (size_t)written < size) ? (size_t)written : 0;
+}
+
+#endif
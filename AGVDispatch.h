@@ -0,0 +1,109 @@
+#ifndef AGVDISPATCH_H
+#define AGVDISPATCH_H
+
+#include <Arduino.h>
+#include "AGVCoreNetworkConfig.h"
+#include "AGVMessagePool.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+
+// Hash slots: at most a quarter full, so a collision-free seed is found in
+// a few tries
+#define AGV_DISPATCH_TABLE_SIZE (AGV_DISPATCH_MAX_VERBS * 4)
+#define AGV_DISPATCH_NONE 0xFF
+
+namespace AGVCoreNetworkLib {
+
+// Verb handler: the full command, the arguments after "VERB:" or "VERB "
+// ("" if none), and the sender as for the command callback
+typedef void (*AGVVerbHandler)(const char* command, const char* args, uint8_t source, uint8_t priority);
+
+// Where a verb handler runs
+typedef enum : uint8_t {
+  AGV_CONTEXT_INLINE = 0,  // network task, during the dispatch pass - keep it short
+  AGV_CONTEXT_CORE1,       // queued until the control loop calls runQueuedCommands()
+  AGV_CONTEXT_WORKER       // queued for a worker task below the network task
+} AGVHandlerContext;
+
+typedef enum : uint8_t {
+  AGV_DISPATCH_UNHANDLED = 0,  // no handler for the verb
+  AGV_DISPATCH_DONE,           // ran inline
+  AGV_DISPATCH_QUEUED,
+  AGV_DISPATCH_DROPPED         // queue full or pool exhausted
+} AGVDispatchResult;
+
+typedef struct {
+  uint32_t calls;
+  uint32_t dropped;
+  uint32_t maxWaitUs;     // queued contexts: dispatch to handler start
+  uint32_t lastRunUs;
+  uint32_t maxRunUs;
+  uint32_t totalRunUs;
+} AGVVerbStats;
+
+// Verb table for commands. The verb is the command text up to the first
+// ':' or ' ' (case-insensitive). Lookup is a perfect hash: whenever the
+// verb set changes a seed is searched that maps every registered verb to
+// its own slot, so a dispatch costs one hash and one compare regardless of
+// the number of verbs. Commands without a registered verb go to the
+// command callback as before.
+//
+// on() and dispatch() are not thread-safe - call within the commands lock.
+// runCore1() runs on the control loop; the worker task runs on its own.
+// A verb cannot move to another context while jobs for it are queued, so
+// its stats are only ever written by one context.
+class AGVDispatcher {
+public:
+  bool begin(AGVMessagePool* pool);
+
+  // Register, replace (same verb) or remove (handler = nullptr) a verb.
+  // Fails if the verb has queued jobs and the context would change.
+  bool on(const char* verb, AGVVerbHandler handler, AGVHandlerContext context);
+
+  // Run or queue the handler for msg; queued contexts get their own copy
+  AGVDispatchResult dispatch(const AGVMessage* msg);
+
+  // Run up to `max` handlers queued for Core 1 (returns the number run)
+  uint8_t runCore1(uint8_t max);
+
+  uint8_t count() const { return verbCount; }
+  size_t verbToJson(uint8_t index, char* buffer, size_t size) const;
+  static const char* contextName(AGVHandlerContext context);
+
+private:
+  typedef struct {
+    char name[AGV_DISPATCH_VERB_LEN];
+    uint8_t length;
+    AGVHandlerContext context;
+    AGVVerbHandler handler;
+    AGVVerbStats stats;
+    uint8_t pending;  // queued jobs not yet run (atomic)
+  } Verb;
+
+  typedef struct {
+    AGVMessage* msg;
+    uint8_t verb;
+  } Job;
+
+  AGVMessagePool* pool = nullptr;
+  Verb verbs[AGV_DISPATCH_MAX_VERBS] = {};
+  uint8_t verbCount = 0;
+  uint8_t table[AGV_DISPATCH_TABLE_SIZE];
+  uint32_t seed = 0;
+
+  QueueHandle_t core1Queue = nullptr;
+  QueueHandle_t workerQueue = nullptr;
+  TaskHandle_t workerHandle = nullptr;
+
+  bool rebuild();
+  int find(const char* verb, uint8_t length) const;
+  static uint8_t verbLength(const char* command);
+  static uint32_t hash(const char* verb, uint8_t length, uint32_t seed);
+  void run(const Job& job);
+  static void workerTask(void* parameter);
+};
+
+} // namespace AGVCoreNetworkLib
+
+#endif
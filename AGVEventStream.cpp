@@ -0,0 +1,168 @@
+#include "AGVEventStream.h"
+#include <lwip/sockets.h>
+
+using namespace AGVCoreNetworkLib;
+
+#if AGVNET_ENABLE_EVENTS
+
+static const char sseHeaders[] =
+  "HTTP/1.1 200 OK\r\n"
+  "Content-Type: text/event-stream\r\n"
+  "Cache-Control: no-cache\r\n"
+  "Connection: keep-alive\r\n"
+  "Access-Control-Allow-Origin: *\r\n"
+  "\r\n"
+  "retry: 2000\n\n";
+
+uint32_t AGVEventStream::oldestId() const {
+  return nextEventId > AGV_SSE_REPLAY ? nextEventId - AGV_SSE_REPLAY : 1;
+}
+
+AGVEventAttach AGVEventStream::attach(WiFiClient& client, bool hasLastId, uint32_t lastId, uint32_t nowMs) {
+  Viewer* viewer = nullptr;
+  for (uint8_t i = 0; i < AGV_SSE_VIEWERS && !viewer; i++) {
+    if (!viewerSlots[i].active) viewer = &viewerSlots[i];
+  }
+  if (!viewer) {
+    stats.rejected++;
+    return AGV_SSE_FULL;
+  }
+
+  viewer->client = client;  // shares the socket: it stays open after the request
+  viewer->active = true;
+  viewerCount++;
+  viewer->telemetrySeq = 0;
+  viewer->tokens = AGV_SSE_BURST;
+  viewer->refillMs = nowMs;
+  if (!write(*viewer, sseHeaders, sizeof(sseHeaders) - 1, nowMs)) return AGV_SSE_WRITE_FAILED;
+
+  if (!hasLastId || lastId >= nextEventId) {
+    viewer->nextId = nextEventId;  // new viewer (or a reboot since): live events only
+  } else if (lastId + 1 >= oldestId()) {
+    viewer->nextId = lastId + 1;
+    stats.resumed++;
+  } else {
+    viewer->nextId = oldestId();
+    stats.gaps++;
+    char gap[48];
+    int n = snprintf(gap, sizeof(gap), "event: gap\ndata: %lu\n\n", (unsigned long)(viewer->nextId - lastId - 1));
+    if (!write(*viewer, gap, n, nowMs)) return AGV_SSE_WRITE_FAILED;
+  }
+  return AGV_SSE_ATTACHED;
+}
+
+// Encode once: "id: <n>\nevent: <event>\ndata: <text>\n\n", line breaks
+// in the text become spaces (one data line per event)
+void AGVEventStream::publish(const char* event, const char* text, size_t length) {
+  Entry& entry = ring[nextEventId % AGV_SSE_REPLAY];
+  int head = snprintf(entry.frame, sizeof(entry.frame), "id: %lu\nevent: %s\ndata: ",
+                      (unsigned long)nextEventId, event);
+  if (head < 0 || (size_t)head >= sizeof(entry.frame) - 2) return;
+
+  size_t room = sizeof(entry.frame) - head - 2;
+  if (length > room) length = room;
+  char* data = entry.frame + head;
+  for (size_t i = 0; i < length; i++) {
+    data[i] = (text[i] == '\n' || text[i] == '\r') ? ' ' : text[i];
+  }
+  data[length] = '\n';
+  data[length + 1] = '\n';
+  entry.length = head + length + 2;
+  entry.id = nextEventId++;
+  stats.published++;
+}
+
+void AGVEventStream::setTelemetry(const char* json, size_t length) {
+  int written = snprintf(telemetryFrame, sizeof(telemetryFrame), "event: telemetry\ndata: %.*s\n\n",
+                         (int)length, json);
+  if (written <= 0 || (size_t)written >= sizeof(telemetryFrame)) return;
+  telemetryLength = written;
+  telemetrySeq++;
+  stats.telemetry++;
+}
+
+void AGVEventStream::service(uint32_t nowMs) {
+  if (viewerCount == 0) return;
+
+  for (uint8_t i = 0; i < AGV_SSE_VIEWERS; i++) {
+    Viewer& viewer = viewerSlots[i];
+    if (!viewer.active) continue;
+    if (!viewer.client.connected()) {
+      close(viewer);
+      continue;
+    }
+
+    // Token bucket: AGV_SSE_RATE frames per second, bursts of AGV_SSE_BURST
+    uint32_t refills = (nowMs - viewer.refillMs) * AGV_SSE_RATE / 1000;
+    if (refills > 0) {
+      viewer.refillMs += refills * 1000 / AGV_SSE_RATE;
+      viewer.tokens = viewer.tokens + refills >= AGV_SSE_BURST ? AGV_SSE_BURST : viewer.tokens + refills;
+    }
+
+    if (viewer.nextId < oldestId()) {
+      // Fell behind the ring while rate-capped: skip ahead and say so
+      char gap[48];
+      int n = snprintf(gap, sizeof(gap), "event: gap\ndata: %lu\n\n",
+                       (unsigned long)(oldestId() - viewer.nextId));
+      viewer.nextId = oldestId();
+      stats.gaps++;
+      if (!write(viewer, gap, n, nowMs)) continue;
+    }
+
+    bool open = true;
+    while (open && viewer.tokens > 0 && viewer.nextId < nextEventId) {
+      const Entry& entry = ring[viewer.nextId % AGV_SSE_REPLAY];
+      open = write(viewer, entry.frame, entry.length, nowMs);
+      viewer.nextId++;
+      viewer.tokens--;
+    }
+    if (!open) continue;
+
+    if (viewer.tokens > 0 && telemetryLength > 0 && viewer.telemetrySeq != telemetrySeq) {
+      if (viewer.telemetrySeq != 0) stats.coalesced += telemetrySeq - viewer.telemetrySeq - 1;
+      viewer.telemetrySeq = telemetrySeq;
+      viewer.tokens--;
+      if (!write(viewer, telemetryFrame, telemetryLength, nowMs)) continue;
+    }
+
+    // Comment line: keeps proxies from timing out and detects dead viewers
+    if (nowMs - viewer.lastWriteMs >= AGV_SSE_KEEPALIVE_MS) {
+      write(viewer, ": keepalive\n\n", 13, nowMs);
+    }
+  }
+}
+
+// Whole frame or nothing: a partial write would corrupt the stream
+bool AGVEventStream::write(Viewer& viewer, const char* data, size_t length, uint32_t nowMs) {
+  int sent = send(viewer.client.fd(), data, length, MSG_DONTWAIT);
+  if (sent != (int)length) {
+    stats.dropped++;
+    close(viewer);
+    return false;
+  }
+  viewer.lastWriteMs = nowMs;
+  stats.sent++;
+  return true;
+}
+
+void AGVEventStream::close(Viewer& viewer) {
+  viewer.client.stop();
+  viewer.client = WiFiClient();
+  viewer.active = false;
+  viewerCount--;
+}
+
+size_t AGVEventStream::toJson(char* buffer, size_t size) const {
+  int written = snprintf(buffer, size,
+                         "{\"viewers\":%u,\"capacity\":%u,\"lastId\":%lu,\"published\":%lu,\"telemetry\":%lu,"
+                         "\"sent\":%lu,\"coalesced\":%lu,\"resumed\":%lu,\"gaps\":%lu,\"rejected\":%lu,"
+                         "\"dropped\":%lu}",
+                         viewerCount, (unsigned)AGV_SSE_VIEWERS, (unsigned long)(nextEventId - 1),
+                         (unsigned long)stats.published, (unsigned long)stats.telemetry,
+                         (unsigned long)stats.sent, (unsigned long)stats.coalesced,
+                         (unsigned long)stats.resumed, (unsigned long)stats.gaps,
+                         (unsigned long)stats.rejected, (unsigned long)stats.dropped);
+  return (written > 0 && (size_t)written < size) ? (size_t)written : 0;
+}
+
+#endif
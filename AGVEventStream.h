@@ -0,0 +1,93 @@
+#ifndef AGVEVENTSTREAM_H
+#define AGVEVENTSTREAM_H
+
+#include <Arduino.h>
+#include "AGVCoreNetworkConfig.h"
+#include "AGVTelemetry.h"
+#include <WiFiClient.h>
+
+namespace AGVCoreNetworkLib {
+
+typedef struct {
+  uint32_t published;     // events encoded into the replay ring
+  uint32_t telemetry;     // telemetry snapshots encoded
+  uint32_t sent;          // frames written to viewers
+  uint32_t coalesced;     // telemetry snapshots a rate-capped viewer skipped
+  uint32_t resumed;       // reconnects continued from Last-Event-ID
+  uint32_t gaps;          // viewers that fell behind the replay ring
+  uint32_t rejected;      // no viewer slot free
+  uint32_t dropped;       // viewers closed: socket full or gone
+} AGVEventStreamStats;
+
+typedef enum : uint8_t {
+  AGV_SSE_ATTACHED = 0,
+  AGV_SSE_FULL,           // every viewer slot taken
+  AGV_SSE_WRITE_FAILED    // socket refused the headers and was closed
+} AGVEventAttach;
+
+// Server-Sent Events for read-only viewers (GET /events), so wall displays
+// and supervisors do not take WebSocket slots meant for operators.
+//
+// Each status or emergency is encoded once, with its event id, into a small
+// replay ring shared by all viewers; the latest telemetry snapshot is kept
+// as one more pre-encoded frame. A viewer that reconnects with
+// Last-Event-ID continues where it left off while the ring still holds
+// that event, otherwise it gets a "gap" event first. Each viewer is capped
+// at AGV_SSE_RATE frames per second (burst AGV_SSE_BURST); a capped viewer
+// only ever receives the newest telemetry snapshot.
+//
+// Writes never block: a viewer whose socket cannot take a whole frame is
+// closed, and the browser's EventSource reconnects and resumes.
+//
+// Not thread-safe - call within the clients lock.
+class AGVEventStream {
+public:
+  // Take over the current HTTP connection and send the stream headers.
+  // lastId is the Last-Event-ID of a reconnect (hasLastId false for new viewers).
+  AGVEventAttach attach(WiFiClient& client, bool hasLastId, uint32_t lastId, uint32_t nowMs);
+
+  void publish(const char* event, const char* text, size_t length);
+  void setTelemetry(const char* json, size_t length);
+
+  // Write pending frames to every viewer (rate-capped)
+  void service(uint32_t nowMs);
+
+  uint8_t viewers() const { return viewerCount; }
+  size_t toJson(char* buffer, size_t size) const;
+
+private:
+  typedef struct {
+    uint32_t id;          // 0 = empty
+    uint16_t length;
+    char frame[AGV_SSE_FRAME_MAX];
+  } Entry;
+
+  typedef struct {
+    WiFiClient client;
+    bool active;
+    uint32_t nextId;          // next ring event to send
+    uint32_t telemetrySeq;    // last snapshot sent
+    uint8_t tokens;
+    uint32_t refillMs;
+    uint32_t lastWriteMs;
+  } Viewer;
+
+  Entry ring[AGV_SSE_REPLAY] = {};
+  uint32_t nextEventId = 1;
+  char telemetryFrame[AGV_TELEMETRY_JSON_MAX + 32];
+  uint16_t telemetryLength = 0;
+  uint32_t telemetrySeq = 0;
+
+  Viewer viewerSlots[AGV_SSE_VIEWERS] = {};
+  uint8_t viewerCount = 0;
+
+  AGVEventStreamStats stats = {};
+
+  uint32_t oldestId() const;
+  bool write(Viewer& viewer, const char* data, size_t length, uint32_t nowMs);
+  void close(Viewer& viewer);
+};
+
+} // namespace AGVCoreNetworkLib
+
+#endif
@@ -0,0 +1,87 @@
+#include "AGVIsrQueue.h"
+
+using namespace AGVCoreNetworkLib;
+
+#if AGVNET_ENABLE_ISR_EVENTS
+
+static_assert((AGV_ISR_QUEUE_LEN & (AGV_ISR_QUEUE_LEN - 1)) == 0, "AGV_ISR_QUEUE_LEN must be a power of two");
+static_assert(AGV_ISR_TEXT_MAX >= AGV_TELEMETRY_KEY_LEN && AGV_ISR_TEXT_MAX <= 256,
+              "AGV_ISR_TEXT_MAX must hold a telemetry key and fit a uint8_t length");
+
+AGVIsrQueue::AGVIsrQueue() {
+  for (uint32_t i = 0; i < AGV_ISR_QUEUE_LEN; i++) {
+    slots[i].seq = i;
+  }
+}
+
+bool IRAM_ATTR AGVIsrQueue::post(AGVIsrKind kind, const char* text, int32_t value) {
+  uint32_t position = __atomic_load_n(&tail, __ATOMIC_RELAXED);
+  Slot* slot;
+  while (true) {
+    slot = &slots[position & (AGV_ISR_QUEUE_LEN - 1)];
+    int32_t lag = (int32_t)(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - position);
+    if (lag == 0) {
+      // Free: claim it (on failure position holds the current tail)
+      if (__atomic_compare_exchange_n(&tail, &position, position + 1, false,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        break;
+      }
+    } else if (lag < 0) {
+      // Not yet taken from the previous lap: full
+      __atomic_add_fetch(&stats.overflows, 1, __ATOMIC_RELAXED);
+      return false;
+    } else {
+      position = __atomic_load_n(&tail, __ATOMIC_RELAXED);  // another producer got it
+    }
+  }
+
+  AGVIsrEvent& event = slot->event;
+  size_t length = 0;
+  if (text) {
+    while (text[length] && length < AGV_ISR_TEXT_MAX - 1) {
+      event.text[length] = text[length];
+      length++;
+    }
+    if (text[length]) __atomic_add_fetch(&stats.truncated, 1, __ATOMIC_RELAXED);
+  }
+  event.text[length] = '\0';
+  event.kind = kind;
+  event.length = (uint8_t)length;
+  event.value = value;
+  event.postedUs = micros();
+
+  __atomic_store_n(&slot->seq, position + 1, __ATOMIC_RELEASE);
+  __atomic_add_fetch(&stats.posted, 1, __ATOMIC_RELAXED);
+  return true;
+}
+
+bool AGVIsrQueue::take(AGVIsrEvent& out) {
+  Slot& slot = slots[head & (AGV_ISR_QUEUE_LEN - 1)];
+  if (__atomic_load_n(&slot.seq, __ATOMIC_ACQUIRE) != head + 1) return false;
+
+  memcpy(&out, &slot.event, sizeof(out));
+  __atomic_store_n(&slot.seq, head + AGV_ISR_QUEUE_LEN, __ATOMIC_RELEASE);  // free for the next lap
+  head++;
+  return true;
+}
+
+void AGVIsrQueue::notePublished(uint32_t latencyUs) {
+  stats.published++;
+  stats.lastLatencyUs = latencyUs;
+  if (latencyUs > stats.maxLatencyUs) stats.maxLatencyUs = latencyUs;
+}
+
+size_t AGVIsrQueue::toJson(char* buffer, size_t size) const {
+  uint32_t pending = __atomic_load_n(&tail, __ATOMIC_RELAXED) - head;
+  int written = snprintf(buffer, size,
+                         "{\"capacity\":%u,\"pending\":%lu,\"posted\":%lu,\"published\":%lu,"
+                         "\"overflows\":%lu,\"truncated\":%lu,\"latencyUs\":{\"last\":%lu,\"max\":%lu}}",
+                         (unsigned)AGV_ISR_QUEUE_LEN, (unsigned long)pending,
+                         (unsigned long)__atomic_load_n(&stats.posted, __ATOMIC_RELAXED),
+                         (unsigned long)stats.published, (unsigned long)overflows(),
+                         (unsigned long)__atomic_load_n(&stats.truncated, __ATOMIC_RELAXED),
+                         (unsigned long)stats.lastLatencyUs, (unsigned long)stats.maxLatencyUs);
+  return (written > 0 && (size_t)written < size) ? (size_t)written : 0;
+}
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef AGVISRQUEUE_H
+#define AGVISRQUEUE_H
+
+#include <Arduino.h>
+#include "AGVCoreNetworkConfig.h"
+
+namespace AGVCoreNetworkLib {
+
+typedef enum : uint8_t {
+  AGV_ISR_STATUS = 0,
+  AGV_ISR_EMERGENCY,
+  AGV_ISR_TELEMETRY    // text = key, value = integer value
+} AGVIsrKind;
+
+// One event posted from an interrupt handler
+typedef struct {
+  AGVIsrKind kind;
+  uint8_t length;                // text bytes
+  int32_t value;
+  uint32_t postedUs;             // micros() at post time
+  char text[AGV_ISR_TEXT_MAX];   // NUL terminated
+} AGVIsrEvent;
+
+typedef struct {
+  uint32_t posted;
+  uint32_t overflows;       // ring full, event lost
+  uint32_t truncated;       // text cut to AGV_ISR_TEXT_MAX - 1 bytes
+  uint32_t published;
+  uint32_t lastLatencyUs;   // post to publish
+  uint32_t maxLatencyUs;
+} AGVIsrStats;
+
+// Bounded multi-producer / single-consumer ring for interrupt handlers.
+// A producer claims a slot with one compare-and-swap on the tail and hands
+// it over through the slot's sequence number, so post() never blocks or
+// takes a lock and works from ISRs on either core. A full ring drops the
+// new event and counts it. The network task is the only consumer.
+class AGVIsrQueue {
+public:
+  AGVIsrQueue();
+
+  // ISR-safe (IRAM); false if the ring is full
+  bool post(AGVIsrKind kind, const char* text, int32_t value);
+
+  // Consumer side
+  bool take(AGVIsrEvent& out);
+  void notePublished(uint32_t latencyUs);
+  uint32_t overflows() const { return __atomic_load_n(&stats.overflows, __ATOMIC_RELAXED); }
+
+  const AGVIsrStats& getStats() const { return stats; }
+  size_t toJson(char* buffer, size_t size) const;
+
+private:
+  typedef struct {
+    uint32_t seq;  // == position: free for that claim, == position + 1: filled
+    AGVIsrEvent event;
+  } Slot;
+
+  Slot slots[AGV_ISR_QUEUE_LEN];
+  uint32_t tail = 0;  // next position to claim
+  uint32_t head = 0;  // next position to take
+  AGVIsrStats stats = {};
+};
+
+} // namespace AGVCoreNetworkLib
+
+#endif
@@ -0,0 +1,261 @@
+#include "AGVJournal.h"
+#include <esp_rom_crc.h>
+#include <esp_timer.h>
+
+using namespace AGVCoreNetworkLib;
+
+#if AGVNET_ENABLE_JOURNAL
+
+enum : uint8_t {
+  AGV_JOURNAL_SNAPSHOT = 1,   // SnapshotHead + waypoints
+  AGV_JOURNAL_PROGRESS = 2    // AGVJournalState
+};
+
+#define AGV_JOURNAL_RECORD_SIZE(length) (sizeof(RecordHeader) + (((length) + 3) & ~3u))
+
+bool AGVJournal::begin(const char* partitionLabel, AGVMission* restore) {
+  static_assert(sizeof(RecordHeader) + sizeof(SnapshotHead) +
+                AGV_MISSION_MAX_WAYPOINTS * sizeof(AGVWaypoint) <= AGV_JOURNAL_SECTOR,
+                "a mission snapshot must fit in one journal sector");
+
+  partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, partitionLabel);
+  if (!partition || partition->size / AGV_JOURNAL_SECTOR < 2) {
+    Serial.printf("[JOURNAL] ❌ No '%s' data partition of 8 KB or more - state is not persisted "
+                  "(see tools/partitions_journal.csv)\n", partitionLabel);
+    partition = nullptr;
+    return false;
+  }
+  sectorCount = partition->size / AGV_JOURNAL_SECTOR;
+  int64_t startUs = esp_timer_get_time();
+
+  // Newest checkpoint first; if its sector does not scan, try the next older
+  uint32_t below = 0xFFFFFFFF;
+  bool found = false;
+  uint32_t snapshotAt = 0;
+  AGVJournalState state = {};
+  for (uint16_t attempt = 0; attempt < sectorCount && !found; attempt++) {
+    int32_t best = -1;
+    uint32_t bestSeq = 0;
+    for (uint16_t index = 0; index < sectorCount; index++) {
+      RecordHeader header;
+      if (esp_partition_read(partition, (size_t)index * AGV_JOURNAL_SECTOR, &header, sizeof(header)) != ESP_OK) continue;
+      if (header.magic != AGV_JOURNAL_MAGIC || header.type != AGV_JOURNAL_SNAPSHOT) continue;
+      if (header.seq < below && (best < 0 || header.seq > bestSeq)) {
+        best = index;
+        bestSeq = header.seq;
+      }
+    }
+    if (best < 0) break;
+    below = bestSeq;
+    found = scanSector((uint16_t)best, state, snapshotAt);
+  }
+
+  bool recovered = false;
+  if (!found) {
+    // Empty or unreadable: the first write starts at sector 0
+    sector = sectorCount - 1;
+    needRollover = true;
+  } else {
+    current = written = state;
+    SnapshotHead head;
+    if (state.missionId != 0 &&
+        esp_partition_read(partition, snapshotAt + sizeof(RecordHeader), &head, sizeof(head)) == ESP_OK &&
+        head.count > 0 && head.count <= AGV_MISSION_MAX_WAYPOINTS &&
+        esp_partition_read(partition, snapshotAt + sizeof(RecordHeader) + sizeof(head), restore->waypoints,
+                           head.count * sizeof(AGVWaypoint)) == ESP_OK) {
+      restore->id = state.missionId;
+      restore->source = head.source;
+      restore->mode = (AGVMissionMode)head.mode;
+      restore->loops = head.loops;
+      restore->count = head.count;
+      mission = restore;
+    } else {
+      current.missionId = written.missionId = 0;
+    }
+    recovered = current.missionId != 0 || current.commandSeq != 0;
+  }
+
+  stats.recoverUs = (uint32_t)(esp_timer_get_time() - startUs);
+  return recovered;
+}
+
+// Replay one sector: a checkpoint snapshot followed by newer records. Stops
+// at erased flash (clean end) or at the first invalid record (torn write).
+bool AGVJournal::scanSector(uint16_t index, AGVJournalState& state, uint32_t& snapshotAt) {
+  uint32_t base = (uint32_t)index * AGV_JOURNAL_SECTOR;
+  uint32_t at = 0;
+  bool torn = false;
+  uint32_t lastSeq = 0;
+
+  while (at + sizeof(RecordHeader) <= AGV_JOURNAL_SECTOR) {
+    RecordHeader header;
+    if (!readRecord(base + at, header, AGV_JOURNAL_SECTOR - at)) {
+      const uint8_t* bytes = (const uint8_t*)&header;
+      for (size_t i = 0; i < sizeof(header); i++) {
+        if (bytes[i] != 0xFF) torn = true;
+      }
+      break;
+    }
+    if (at == 0 && header.type != AGV_JOURNAL_SNAPSHOT) break;
+
+    bool applied = false;
+    if (header.type == AGV_JOURNAL_SNAPSHOT && header.length >= sizeof(SnapshotHead)) {
+      applied = esp_partition_read(partition, base + at + sizeof(RecordHeader), &state, sizeof(state)) == ESP_OK;
+      if (applied) snapshotAt = base + at;
+    } else if (header.type == AGV_JOURNAL_PROGRESS && header.length == sizeof(state)) {
+      applied = esp_partition_read(partition, base + at + sizeof(RecordHeader), &state, sizeof(state)) == ESP_OK;
+    }
+    if (!applied) {
+      torn = true;
+      break;
+    }
+    lastSeq = header.seq;
+    at += AGV_JOURNAL_RECORD_SIZE(header.length);
+  }
+
+  if (torn) stats.tornRecords++;
+  if (at == 0) return false;  // checkpoint damaged
+
+  sector = index;
+  offset = (uint16_t)at;
+  nextSeq = lastSeq + 1;
+  needRollover = torn;  // never append behind damaged bytes
+  return true;
+}
+
+// Read a header and check the CRC over header and payload (in small chunks)
+bool AGVJournal::readRecord(uint32_t address, RecordHeader& header, uint32_t limit) {
+  if (esp_partition_read(partition, address, &header, sizeof(header)) != ESP_OK) return false;
+  if (header.magic != AGV_JOURNAL_MAGIC || AGV_JOURNAL_RECORD_SIZE(header.length) > limit) return false;
+
+  uint32_t crc = checksum(header, 0);
+  uint8_t chunk[128];
+  uint32_t done = 0;
+  while (done < header.length) {
+    uint32_t n = header.length - done < sizeof(chunk) ? header.length - done : sizeof(chunk);
+    if (esp_partition_read(partition, address + sizeof(header) + done, chunk, n) != ESP_OK) return false;
+    crc = esp_rom_crc32_le(crc, chunk, n);
+    done += n;
+  }
+  return crc == header.crc;
+}
+
+uint32_t AGVJournal::checksum(const RecordHeader& header, uint32_t crc) {
+  RecordHeader copy = header;
+  copy.crc = 0;
+  return esp_rom_crc32_le(crc, (const uint8_t*)&copy, sizeof(copy));
+}
+
+void AGVJournal::noteMission(const AGVMission* active) {
+  mission = active;
+  current.missionId = active ? active->id : 0;
+  current.loop = 0;
+  current.waypoint = 0;
+  snapshotDue = true;
+}
+
+void AGVJournal::noteProgress(uint16_t loop, uint16_t waypoint) {
+  current.loop = loop;
+  current.waypoint = waypoint;
+}
+
+void AGVJournal::service(uint32_t nowMs) {
+  if (!partition || nowMs - lastFlushMs < AGV_JOURNAL_FLUSH_MS) return;
+  if (!snapshotDue && memcmp(&current, &written, sizeof(current)) == 0) return;
+  lastFlushMs = nowMs;
+
+  int64_t startUs = esp_timer_get_time();
+  AGVJournalState pending = current;
+  bool ok = snapshotDue ? appendSnapshot()
+                        : append(AGV_JOURNAL_PROGRESS, &pending, sizeof(pending), nullptr, 0);
+  if (ok) {
+    written = pending;
+    snapshotDue = false;
+  }
+  stats.lastFlushUs = (uint32_t)(esp_timer_get_time() - startUs);
+  if (stats.lastFlushUs > stats.maxFlushUs) stats.maxFlushUs = stats.lastFlushUs;
+}
+
+bool AGVJournal::appendSnapshot() {
+  SnapshotHead head = {};
+  head.state = current;
+  if (mission && current.missionId != 0) {
+    head.mode = mission->mode;
+    head.source = mission->source;
+    head.loops = mission->loops;
+    head.count = mission->count;
+  }
+  return append(AGV_JOURNAL_SNAPSHOT, &head, sizeof(head),
+                mission ? mission->waypoints : nullptr, head.count * sizeof(AGVWaypoint));
+}
+
+// Erase the next sector of the ring and make it the append target
+bool AGVJournal::startSector(uint16_t next) {
+  if (esp_partition_erase_range(partition, (size_t)next * AGV_JOURNAL_SECTOR, AGV_JOURNAL_SECTOR) != ESP_OK) {
+    stats.writeErrors++;
+    return false;
+  }
+  stats.erases++;
+  sector = next;
+  offset = 0;
+  needRollover = false;
+  return true;
+}
+
+bool AGVJournal::append(uint8_t type, const void* head, uint16_t headLength,
+                        const void* tail, uint16_t tailLength) {
+  uint16_t length = headLength + tailLength;
+  if (needRollover || offset + AGV_JOURNAL_RECORD_SIZE(length) > AGV_JOURNAL_SECTOR) {
+    if (!startSector((sector + 1) % sectorCount)) return false;
+    // A sector always starts with a checkpoint, which carries the progress too
+    if (type != AGV_JOURNAL_SNAPSHOT) return appendSnapshot();
+  }
+
+  RecordHeader header = {};
+  header.magic = AGV_JOURNAL_MAGIC;
+  header.type = type;
+  header.length = length;
+  header.seq = nextSeq;
+  uint32_t crc = checksum(header, 0);
+  crc = esp_rom_crc32_le(crc, (const uint8_t*)head, headLength);
+  if (tailLength > 0) crc = esp_rom_crc32_le(crc, (const uint8_t*)tail, tailLength);
+  header.crc = crc;
+
+  size_t address = (size_t)sector * AGV_JOURNAL_SECTOR + offset;
+  if (esp_partition_write(partition, address, &header, sizeof(header)) != ESP_OK ||
+      esp_partition_write(partition, address + sizeof(header), head, headLength) != ESP_OK ||
+      (tailLength > 0 &&
+       esp_partition_write(partition, address + sizeof(header) + headLength, tail, tailLength) != ESP_OK)) {
+    stats.writeErrors++;
+    needRollover = true;
+    return false;
+  }
+
+  offset += AGV_JOURNAL_RECORD_SIZE(length);
+  nextSeq++;
+  stats.records++;
+  if (type == AGV_JOURNAL_SNAPSHOT) stats.snapshots++;
+  return true;
+}
+
+size_t AGVJournal::toJson(char* buffer, size_t size) const {
+  if (!partition) {
+    int written = snprintf(buffer, size, "{\"ready\":false}");
+    return (written > 0 && (size_t)written < size) ? (size_t)written : 0;
+  }
+  int written = snprintf(buffer, size,
+                         "{\"ready\":true,\"sectors\":%u,\"sector\":%u,\"offset\":%u,\"seq\":%lu,"
+                         "\"records\":%lu,\"snapshots\":%lu,\"erases\":%lu,\"writeErrors\":%lu,"
+                         "\"tornRecords\":%u,\"recoverUs\":%lu,\"flushUs\":{\"last\":%lu,\"max\":%lu},"
+                         "\"state\":{\"mission\":%lu,\"loop\":%u,\"waypoint\":%u,\"commandSeq\":%lu}}",
+                         sectorCount, sector, offset, (unsigned long)nextSeq,
+                         (unsigned long)stats.records, (unsigned long)stats.snapshots,
+                         (unsigned long)stats.erases, (unsigned long)stats.writeErrors,
+                         stats.tornRecords, (unsigned long)stats.recoverUs,
+                         (unsigned long)stats.lastFlushUs, (unsigned long)stats.maxFlushUs,
+                         (unsigned long)current.missionId, current.loop, current.waypoint,
+                         (unsigned long)current.commandSeq);
+  return (written > 0 && (size_t)written < size) ? (size_t)written : 0;
+}
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef AGVJOURNAL_H
+#define AGVJOURNAL_H
+
+#include <Arduino.h>
+#include "AGVCoreNetworkConfig.h"
+#include "AGVMission.h"
+#include <esp_partition.h>
+
+#define AGV_JOURNAL_MAGIC 0x4A41      // "AJ"
+#define AGV_JOURNAL_SECTOR 4096
+
+namespace AGVCoreNetworkLib {
+
+// Persistent vehicle state
+typedef struct {
+  uint32_t missionId;     // active mission (0 = none)
+  uint32_t commandSeq;    // last command handed to the command callback
+  uint16_t loop;          // progress reported by the control loop
+  uint16_t waypoint;
+} AGVJournalState;
+
+typedef struct {
+  uint32_t records;       // appended since boot
+  uint32_t snapshots;     // of which full snapshots
+  uint32_t erases;        // sectors erased since boot
+  uint32_t writeErrors;
+  uint32_t recoverUs;     // boot-time recovery
+  uint32_t lastFlushUs;
+  uint32_t maxFlushUs;
+  uint16_t tornRecords;   // invalid record found at recovery (interrupted write)
+} AGVJournalStats;
+
+// Append-only state journal in a dedicated flash partition (see
+// tools/partitions_journal.csv). The partition is used as a ring of 4 KB
+// sectors; each record carries a sequence number and a CRC, so a write cut
+// short by a reset is detected and ignored.
+//
+// Changes are collected in RAM and appended at most once per flush
+// interval: a small progress record if only the counters moved, a full
+// snapshot (state + waypoints) when the mission changed. Every sector
+// starts with a snapshot - the checkpoint - so recovery reads one record
+// header per sector plus the newest sector: a few milliseconds. Sectors
+// are erased round-robin, which spreads wear over the whole partition.
+//
+// Not thread-safe - use from the network task within the commands lock.
+// Flash writes and erases suspend the flash cache on both cores (IRAM code
+// and ISRs keep running), which is why writes are batched.
+class AGVJournal {
+public:
+  // Find the partition and recover the newest state. The waypoints of a
+  // recovered mission are read into `mission`. Returns true if a state
+  // was recovered.
+  bool begin(const char* partitionLabel, AGVMission* mission);
+  bool ready() const { return partition != nullptr; }
+
+  // Batched updates (written by the next due flush)
+  void noteMission(const AGVMission* active);   // nullptr = mission finished
+  void noteProgress(uint16_t loop, uint16_t waypoint);
+  void noteCommand(uint32_t seq) { current.commandSeq = seq; }
+
+  // Append pending changes if the flush interval has passed
+  void service(uint32_t nowMs);
+
+  const AGVJournalState& state() const { return current; }
+  const AGVJournalStats& getStats() const { return stats; }
+  size_t toJson(char* buffer, size_t size) const;
+
+private:
+  typedef struct {
+    uint16_t magic;
+    uint8_t type;
+    uint8_t reserved;
+    uint16_t length;      // payload bytes
+    uint16_t reserved2;
+    uint32_t seq;
+    uint32_t crc;         // over the header (crc = 0) and the payload
+  } RecordHeader;
+
+  // Snapshot payload; `count` waypoints follow
+  typedef struct {
+    AGVJournalState state;
+    uint8_t mode;
+    uint8_t source;
+    uint16_t loops;
+    uint16_t count;
+    uint16_t reserved;
+  } SnapshotHead;
+
+  const esp_partition_t* partition = nullptr;
+  uint16_t sectorCount = 0;
+  uint16_t sector = 0;        // sector being appended to
+  uint16_t offset = 0;        // next record in that sector
+  uint32_t nextSeq = 1;
+  bool needRollover = false;  // tail damaged or unknown: continue in a fresh sector
+
+  const AGVMission* mission = nullptr;
+  AGVJournalState current = {};
+  AGVJournalState written = {};
+  bool snapshotDue = false;
+  uint32_t lastFlushMs = 0;
+
+  AGVJournalStats stats = {};
+
+  bool append(uint8_t type, const void* head, uint16_t headLength,
+              const void* tail, uint16_t tailLength);
+  bool appendSnapshot();
+  bool startSector(uint16_t next);
+  bool readRecord(uint32_t address, RecordHeader& header, uint32_t limit);
+  bool scanSector(uint16_t index, AGVJournalState& state, uint32_t& snapshotAt);
+  static uint32_t checksum(const RecordHeader& header, uint32_t crc);
+};
+
+} // namespace AGVCoreNetworkLib
+
+#endif
@@ -0,0 +1,217 @@
+#include "AGVJson.h"
+
+using namespace AGVCoreNetworkLib;
+
+static_assert(AGV_JSON_DEPTH_MAX <= 32, "nesting is tracked in a 32-bit mask");
+
+void AGVJsonTokenizer::reset() {
+  textLength = 0;
+  buffer[0] = '\0';
+  objects = 0;
+  level = 0;
+  expect = EXPECT_VALUE;
+  mode = MODE_NORMAL;
+  cut = false;
+  hold = false;
+}
+
+void AGVJsonTokenizer::append(char c) {
+  if (textLength < sizeof(buffer) - 1) {
+    buffer[textLength++] = c;
+  } else {
+    cut = true;
+  }
+}
+
+// Basic multilingual plane only; surrogate halves become '?'
+void AGVJsonTokenizer::appendUtf8(uint16_t code) {
+  if (code < 0x80) {
+    append((char)code);
+  } else if (code < 0x800) {
+    append((char)(0xC0 | code >> 6));
+    append((char)(0x80 | (code & 0x3F)));
+  } else if (code >= 0xD800 && code <= 0xDFFF) {
+    append('?');
+  } else {
+    append((char)(0xE0 | code >> 12));
+    append((char)(0x80 | (code >> 6 & 0x3F)));
+    append((char)(0x80 | (code & 0x3F)));
+  }
+}
+
+void AGVJsonTokenizer::afterValue() {
+  expect = level == 0 ? EXPECT_DONE : EXPECT_COMMA_OR_END;
+}
+
+AGVJsonToken AGVJsonTokenizer::fail() {
+  expect = EXPECT_ERROR;
+  mode = MODE_NORMAL;
+  return AGV_JSON_ERROR;
+}
+
+AGVJsonToken AGVJsonTokenizer::feed(char c) {
+  hold = false;
+  if (expect == EXPECT_ERROR) return AGV_JSON_ERROR;
+
+  switch (mode) {
+    case MODE_STRING:
+      if (c == '"') {
+        buffer[textLength] = '\0';
+        mode = MODE_NORMAL;
+        if (key) {
+          expect = EXPECT_COLON;
+          return AGV_JSON_KEY;
+        }
+        afterValue();
+        return AGV_JSON_STRING;
+      }
+      if (c == '\\') {
+        mode = MODE_ESCAPE;
+      } else if ((uint8_t)c < 0x20) {
+        return fail();
+      } else {
+        append(c);
+      }
+      return AGV_JSON_NONE;
+
+    case MODE_ESCAPE:
+      mode = MODE_STRING;
+      switch (c) {
+        case '"': case '\\': case '/': append(c); break;
+        case 'b': append('\b'); break;
+        case 'f': append('\f'); break;
+        case 'n': append('\n'); break;
+        case 'r': append('\r'); break;
+        case 't': append('\t'); break;
+        case 'u':
+          mode = MODE_UNICODE;
+          unicode = 0;
+          unicodeDigits = 0;
+          break;
+        default: return fail();
+      }
+      return AGV_JSON_NONE;
+
+    case MODE_UNICODE:
+      {
+        uint8_t digit;
+        if (c >= '0' && c <= '9') digit = c - '0';
+        else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+        else return fail();
+        unicode = unicode << 4 | digit;
+        if (++unicodeDigits == 4) {
+          appendUtf8(unicode);
+          mode = MODE_STRING;
+        }
+      }
+      return AGV_JSON_NONE;
+
+    case MODE_BARE:
+      if (isalnum((uint8_t)c) || c == '-' || c == '+' || c == '.') {
+        append(c);
+        return AGV_JSON_NONE;
+      }
+      {
+        buffer[textLength] = '\0';
+        mode = MODE_NORMAL;
+        hold = true;  // c still needs to be read as a token of its own
+        afterValue();
+        if (strcmp(buffer, "true") == 0 || strcmp(buffer, "false") == 0 || strcmp(buffer, "null") == 0) {
+          return AGV_JSON_LITERAL;
+        }
+        if (buffer[0] == '-' || isdigit((uint8_t)buffer[0])) return AGV_JSON_NUMBER;
+        hold = false;
+        return fail();
+      }
+
+    case MODE_NORMAL:
+      break;
+  }
+
+  switch (c) {
+    case ' ': case '\t': case '\r': case '\n':
+      return AGV_JSON_NONE;
+
+    case '{':
+    case '[':
+      if (expect != EXPECT_VALUE && expect != EXPECT_VALUE_OR_END) return fail();
+      if (level >= AGV_JSON_DEPTH_MAX) return fail();
+      if (c == '{') {
+        objects |= 1u << level;
+      } else {
+        objects &= ~(1u << level);
+      }
+      level++;
+      expect = c == '{' ? EXPECT_KEY_OR_END : EXPECT_VALUE_OR_END;
+      return c == '{' ? AGV_JSON_OBJECT_START : AGV_JSON_ARRAY_START;
+
+    case '}':
+    case ']':
+      {
+        bool object = c == '}';
+        if (level == 0 || (bool)(objects >> (level - 1) & 1) != object) return fail();
+        if (expect != EXPECT_COMMA_OR_END && expect != (object ? EXPECT_KEY_OR_END : EXPECT_VALUE_OR_END)) {
+          return fail();
+        }
+        level--;
+        afterValue();
+        return object ? AGV_JSON_OBJECT_END : AGV_JSON_ARRAY_END;
+      }
+
+    case ':':
+      if (expect != EXPECT_COLON) return fail();
+      expect = EXPECT_VALUE;
+      return AGV_JSON_NONE;
+
+    case ',':
+      if (expect != EXPECT_COMMA_OR_END) return fail();
+      expect = (objects >> (level - 1) & 1) ? EXPECT_KEY : EXPECT_VALUE;
+      return AGV_JSON_NONE;
+
+    case '"':
+      if (expect == EXPECT_KEY || expect == EXPECT_KEY_OR_END) {
+        key = true;
+      } else if (expect == EXPECT_VALUE || expect == EXPECT_VALUE_OR_END) {
+        key = false;
+      } else {
+        return fail();
+      }
+      mode = MODE_STRING;
+      textLength = 0;
+      cut = false;
+      return AGV_JSON_NONE;
+
+    default:
+      if ((expect != EXPECT_VALUE && expect != EXPECT_VALUE_OR_END) ||
+          !(isalnum((uint8_t)c) || c == '-')) {
+        return fail();
+      }
+      mode = MODE_BARE;
+      textLength = 0;
+      cut = false;
+      append(c);
+      return AGV_JSON_NONE;
+  }
+}
+
+bool AGVJsonTokenizer::findString(const char* json, size_t length, const char* key, char* out, size_t size) {
+  AGVJsonTokenizer tokenizer;
+  tokenizer.reset();
+  bool matched = false;
+  for (size_t i = 0; i < length; i++) {
+    AGVJsonToken token;
+    do {
+      token = tokenizer.feed(json[i]);
+      if (token == AGV_JSON_ERROR) return false;
+      if (token == AGV_JSON_NONE) continue;
+      if (matched && tokenizer.depth() == 1) {
+        if (token != AGV_JSON_STRING || tokenizer.truncated() || tokenizer.length() >= size) return false;
+        memcpy(out, tokenizer.text(), tokenizer.length() + 1);
+        return true;
+      }
+      matched = token == AGV_JSON_KEY && tokenizer.depth() == 1 && strcmp(tokenizer.text(), key) == 0;
+    } while (tokenizer.held());
+  }
+  return false;
+}
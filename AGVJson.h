@@ -0,0 +1,84 @@
+#ifndef AGVJSON_H
+#define AGVJSON_H
+
+#include <Arduino.h>
+#include "AGVCoreNetworkConfig.h"
+
+// Longest string or number kept in full (a command may be as long as the
+// largest pool block)
+#define AGV_JSON_TOKEN_MAX AGV_POOL_LARGE_SIZE
+#define AGV_JSON_DEPTH_MAX 32
+
+namespace AGVCoreNetworkLib {
+
+typedef enum : uint8_t {
+  AGV_JSON_NONE = 0,       // byte consumed, no token finished
+  AGV_JSON_OBJECT_START,
+  AGV_JSON_OBJECT_END,
+  AGV_JSON_ARRAY_START,
+  AGV_JSON_ARRAY_END,
+  AGV_JSON_KEY,            // text() is the unescaped key
+  AGV_JSON_STRING,         // text() is the unescaped value
+  AGV_JSON_NUMBER,         // text() as written
+  AGV_JSON_LITERAL,        // true, false or null
+  AGV_JSON_ERROR           // sticky until reset()
+} AGVJsonToken;
+
+// Streaming JSON tokenizer with fixed memory: bytes go in one at a time as
+// they arrive, tokens come out as soon as they are complete, so a body is
+// parsed while it is still being received and never needs a buffer of its
+// own. Strings are unescaped (\uXXXX to UTF-8) into one token buffer;
+// longer strings are cut and flagged truncated(). Structure is checked
+// (brackets, commas, colons, key positions) but numbers are not validated
+// beyond their characters.
+//
+// A number or literal only ends at the next byte. When that byte is also
+// a token of its own, feed() returns the number and held() is true: feed
+// the same byte again.
+class AGVJsonTokenizer {
+public:
+  void reset();
+  AGVJsonToken feed(char c);
+  bool held() const { return hold; }
+
+  const char* text() const { return buffer; }
+  size_t length() const { return textLength; }
+  bool truncated() const { return cut; }
+  uint8_t depth() const { return level; }
+  bool inArray() const { return level > 0 && !(objects >> (level - 1) & 1); }
+
+  // One complete value (object or array) has been read
+  bool complete() const { return expect == EXPECT_DONE && mode == MODE_NORMAL; }
+
+  // Copy the string value of `key` in the top-level object of `json`
+  // (false if missing, not a string or longer than size - 1)
+  static bool findString(const char* json, size_t length, const char* key, char* out, size_t size);
+
+private:
+  typedef enum : uint8_t {
+    EXPECT_VALUE, EXPECT_VALUE_OR_END, EXPECT_KEY, EXPECT_KEY_OR_END,
+    EXPECT_COLON, EXPECT_COMMA_OR_END, EXPECT_DONE, EXPECT_ERROR
+  } Expect;
+  typedef enum : uint8_t { MODE_NORMAL, MODE_STRING, MODE_ESCAPE, MODE_UNICODE, MODE_BARE } Mode;
+
+  char buffer[AGV_JSON_TOKEN_MAX];
+  size_t textLength = 0;
+  uint32_t objects = 0;      // bit per level: 1 = object, 0 = array
+  uint16_t unicode = 0;
+  uint8_t unicodeDigits = 0;
+  uint8_t level = 0;
+  Expect expect = EXPECT_VALUE;
+  Mode mode = MODE_NORMAL;
+  bool key = false;
+  bool cut = false;
+  bool hold = false;
+
+  void append(char c);
+  void appendUtf8(uint16_t code);
+  void afterValue();
+  AGVJsonToken fail();
+};
+
+} // namespace AGVCoreNetworkLib
+
+#endif
@@ -0,0 +1,95 @@
+#include "AGVLock.h"
+
+using namespace AGVCoreNetworkLib;
+
+static portMUX_TYPE lockStatsMux = portMUX_INITIALIZER_UNLOCKED;
+
+void AGVLock::begin(const char* name) {
+  if (!mutex) mutex = xSemaphoreCreateMutex();
+  label = name ? name : "";
+}
+
+uint8_t AGVLock::bucket(uint32_t us) {
+  if (us < 2) return 0;
+  uint8_t b = 31 - __builtin_clz(us);
+  return b < AGV_LOCK_BUCKETS ? b : AGV_LOCK_BUCKETS - 1;
+}
+
+// Uncontended takes cost one extra timer read; only waiters are timed
+// against the timeout
+bool AGVLock::take(uint16_t line, uint32_t timeoutMs) {
+  if (!mutex) return false;
+  uint32_t startUs = micros();
+  bool contended = xSemaphoreTake(mutex, 0) != pdPASS;
+  if (contended && xSemaphoreTake(mutex, pdMS_TO_TICKS(timeoutMs)) != pdPASS) {
+    portENTER_CRITICAL(&lockStatsMux);
+    stats.timeouts++;
+    portEXIT_CRITICAL(&lockStatsMux);
+    return false;
+  }
+
+  uint32_t nowUs = micros();
+  uint32_t waitUs = nowUs - startUs;
+  portENTER_CRITICAL(&lockStatsMux);
+  stats.takes++;
+  if (contended) stats.contended++;
+  stats.wait[bucket(waitUs)]++;
+  if (waitUs > stats.maxWaitUs) stats.maxWaitUs = waitUs;
+  portEXIT_CRITICAL(&lockStatsMux);
+
+  heldSinceUs = nowUs;
+  heldLine = line;
+  return true;
+}
+
+void AGVLock::give() {
+  uint32_t holdUs = micros() - heldSinceUs;
+  uint16_t line = heldLine;
+
+  portENTER_CRITICAL(&lockStatsMux);
+  stats.hold[bucket(holdUs)]++;
+  if (holdUs > stats.maxHoldUs) {
+    stats.maxHoldUs = holdUs;
+    stats.maxHoldLine = line;
+  }
+  portEXIT_CRITICAL(&lockStatsMux);
+
+  xSemaphoreGive(mutex);
+}
+
+void AGVLock::getStats(AGVLockStats& out) const {
+  portENTER_CRITICAL(&lockStatsMux);
+  out = stats;
+  portEXIT_CRITICAL(&lockStatsMux);
+}
+
+void AGVLock::resetStats() {
+  portENTER_CRITICAL(&lockStatsMux);
+  stats = AGVLockStats();
+  portEXIT_CRITICAL(&lockStatsMux);
+}
+
+static int histogramJson(char* buffer, size_t size, const uint32_t* counts) {
+  int at = snprintf(buffer, size, "[");
+  for (uint8_t i = 0; i < AGV_LOCK_BUCKETS && at > 0 && (size_t)at < size; i++) {
+    at += snprintf(buffer + at, size - at, "%s%lu", i ? "," : "", (unsigned long)counts[i]);
+  }
+  if (at > 0 && (size_t)at < size) at += snprintf(buffer + at, size - at, "]");
+  return at;
+}
+
+size_t AGVLock::toJson(char* buffer, size_t size) const {
+  AGVLockStats s;
+  getStats(s);
+
+  int at = snprintf(buffer, size,
+                    "{\"name\":\"%s\",\"takes\":%lu,\"contended\":%lu,\"timeouts\":%lu,\"maxWaitUs\":%lu,"
+                    "\"maxHoldUs\":%lu,\"maxHoldLine\":%u,\"waitUs\":",
+                    label, (unsigned long)s.takes, (unsigned long)s.contended, (unsigned long)s.timeouts,
+                    (unsigned long)s.maxWaitUs, (unsigned long)s.maxHoldUs, s.maxHoldLine);
+  if (at > 0 && (size_t)at < size) at += histogramJson(buffer + at, size - at, s.wait);
+  if (at > 0 && (size_t)at < size) at += snprintf(buffer + at, size - at, ",\"holdUs\":");
+  if (at > 0 && (size_t)at < size) at += histogramJson(buffer + at, size - at, s.hold);
+  if (at > 0 && (size_t)at < size) at += snprintf(buffer + at, size - at, "}");
+  return (at > 0 && (size_t)at < size) ? (size_t)at : 0;
+}
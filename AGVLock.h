@@ -0,0 +1,59 @@
+#ifndef AGVLOCK_H
+#define AGVLOCK_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "AGVCoreNetworkConfig.h"
+
+// Histogram buckets: bucket i counts durations of 2^i to 2^(i+1) - 1 us
+// (bucket 0 also counts 0 us), the last bucket everything longer
+#define AGV_LOCK_BUCKETS 16
+
+namespace AGVCoreNetworkLib {
+
+typedef struct {
+  uint32_t takes;
+  uint32_t contended;     // had to wait for another holder
+  uint32_t timeouts;      // gave up; the caller's work was dropped
+  uint32_t maxWaitUs;
+  uint32_t maxHoldUs;
+  uint16_t maxHoldLine;   // where the longest hold was taken
+  uint32_t wait[AGV_LOCK_BUCKETS];
+  uint32_t hold[AGV_LOCK_BUCKETS];
+} AGVLockStats;
+
+// A named synchronisation domain: a FreeRTOS mutex that measures how long
+// takers wait for it and how long holders keep it. Wait and hold times go
+// into log2 microsecond histograms, the longest hold is remembered with
+// the source line it started at, so a domain that is held too long points
+// at the code holding it. The mutex is not recursive: a holder must not
+// take the same domain again.
+//
+// take()/give() are thread-safe; stats are updated in a short critical
+// section and can be read from any task.
+class AGVLock {
+public:
+  void begin(const char* name);
+  bool take(uint16_t line, uint32_t timeoutMs = AGV_LOCK_TIMEOUT_MS);
+  void give();
+
+  const char* name() const { return label; }
+  SemaphoreHandle_t handle() const { return mutex; }
+
+  void getStats(AGVLockStats& out) const;
+  void resetStats();
+  size_t toJson(char* buffer, size_t size) const;
+  static uint8_t bucket(uint32_t us);
+
+private:
+  SemaphoreHandle_t mutex = nullptr;
+  const char* label = "";
+  uint32_t heldSinceUs = 0;  // written by the holder only
+  uint16_t heldLine = 0;
+  AGVLockStats stats = {};
+};
+
+} // namespace AGVCoreNetworkLib
+
+#endif
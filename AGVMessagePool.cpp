@@ -0,0 +1,123 @@
+#include "AGVMessagePool.h"
+#include <freertos/FreeRTOS.h>
+
+using namespace AGVCoreNetworkLib;
+
+static_assert(AGV_POOL_SMALL_SIZE < AGV_POOL_MEDIUM_SIZE && AGV_POOL_MEDIUM_SIZE < AGV_POOL_LARGE_SIZE,
+              "AGV pool size classes must be ascending");
+static_assert(AGV_POOL_LARGE_SIZE <= 65535, "AGV pool blocks are limited to 64 KB");
+static_assert(AGV_POOL_SMALL_COUNT > 0 && AGV_POOL_MEDIUM_COUNT > 0 && AGV_POOL_LARGE_COUNT > 0,
+              "every AGV pool class needs at least one block");
+
+// Short critical sections guard the free stacks (shared by both cores)
+static portMUX_TYPE poolMux = portMUX_INITIALIZER_UNLOCKED;
+
+AGVMessagePool::AGVMessagePool() {
+  uint8_t* storage[AGV_POOL_CLASS_COUNT] = { smallStorage, mediumStorage, largeStorage };
+  AGVMessage** stacks[AGV_POOL_CLASS_COUNT] = { smallFree, mediumFree, largeFree };
+  const uint16_t sizes[AGV_POOL_CLASS_COUNT] = { AGV_POOL_SMALL_SIZE, AGV_POOL_MEDIUM_SIZE, AGV_POOL_LARGE_SIZE };
+  const uint16_t counts[AGV_POOL_CLASS_COUNT] = { AGV_POOL_SMALL_COUNT, AGV_POOL_MEDIUM_COUNT, AGV_POOL_LARGE_COUNT };
+
+  for (uint8_t c = 0; c < AGV_POOL_CLASS_COUNT; c++) {
+    SizeClass& sc = classes[c];
+    sc.storage = storage[c];
+    sc.stride = AGV_POOL_STRIDE(sizes[c]);
+    sc.freeStack = stacks[c];
+    sc.freeTop = 0;
+    memset(&sc.stats, 0, sizeof(sc.stats));
+    sc.stats.blockSize = sizes[c];
+    sc.stats.blocks = counts[c];
+
+    for (uint16_t i = 0; i < counts[c]; i++) {
+      AGVMessage* block = (AGVMessage*)(sc.storage + (size_t)i * sc.stride);
+      block->sizeClass = c;
+      sc.freeStack[sc.freeTop++] = block;
+    }
+  }
+}
+
+AGVMessage* AGVMessagePool::alloc(size_t length) {
+  AGVMessage* block = nullptr;
+  bool spilled = false;
+  int8_t first = -1;
+
+  portENTER_CRITICAL(&poolMux);
+  for (uint8_t c = 0; c < AGV_POOL_CLASS_COUNT; c++) {
+    SizeClass& sc = classes[c];
+    if (length >= sc.stats.blockSize) continue;
+    if (first < 0) first = c;
+    if (sc.freeTop == 0) {
+      spilled = true;
+      continue;
+    }
+    block = sc.freeStack[--sc.freeTop];
+    sc.stats.allocs++;
+    if (++sc.stats.inUse > sc.stats.highWater) sc.stats.highWater = sc.stats.inUse;
+    break;
+  }
+  if (first >= 0) {
+    if (!block) {
+      classes[first].stats.exhausted++;
+    } else if (spilled) {
+      classes[first].stats.spills++;
+    }
+  }
+  portEXIT_CRITICAL(&poolMux);
+
+  if (!block) return nullptr;
+  block->length = (uint16_t)length;
+  block->source = 0;
+  block->priority = 0;
+  block->client = 0xFF;
+  block->text()[length] = '\0';
+  return block;
+}
+
+AGVMessage* AGVMessagePool::copy(const char* text, size_t length) {
+  AGVMessage* message = alloc(length);
+  if (message) {
+    memcpy(message->text(), text, length);
+  }
+  return message;
+}
+
+void AGVMessagePool::release(AGVMessage* message) {
+  if (!message || message->sizeClass >= AGV_POOL_CLASS_COUNT) return;
+
+  portENTER_CRITICAL(&poolMux);
+  SizeClass& sc = classes[message->sizeClass];
+  sc.freeStack[sc.freeTop++] = message;
+  sc.stats.inUse--;
+  portEXIT_CRITICAL(&poolMux);
+}
+
+void AGVMessagePool::getStats(uint8_t sizeClass, AGVPoolClassStats& out) const {
+  if (sizeClass >= AGV_POOL_CLASS_COUNT) return;
+  portENTER_CRITICAL(&poolMux);
+  out = classes[sizeClass].stats;
+  portEXIT_CRITICAL(&poolMux);
+}
+
+size_t AGVMessagePool::toJson(char* buffer, size_t size) const {
+  size_t pos = 0;
+  int n = snprintf(buffer, size, "[");
+  if (n <= 0 || (size_t)n >= size) return 0;
+  pos += n;
+
+  for (uint8_t c = 0; c < AGV_POOL_CLASS_COUNT; c++) {
+    AGVPoolClassStats st;
+    getStats(c, st);
+    n = snprintf(buffer + pos, size - pos,
+                 "%s{\"size\":%u,\"blocks\":%u,\"inUse\":%u,\"highWater\":%u,"
+                 "\"allocs\":%lu,\"spills\":%lu,\"exhausted\":%lu}",
+                 c ? "," : "", st.blockSize, st.blocks, st.inUse, st.highWater,
+                 (unsigned long)st.allocs, (unsigned long)st.spills, (unsigned long)st.exhausted);
+    if (n <= 0 || (size_t)n >= size - pos) return 0;
+    pos += n;
+  }
+
+  if (pos + 2 > size) return 0;
+  buffer[pos++] = ']';
+  buffer[pos] = '\0';
+  return pos;
+}
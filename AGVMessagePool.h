@@ -0,0 +1,97 @@
+#ifndef AGVMESSAGEPOOL_H
+#define AGVMESSAGEPOOL_H
+
+#include <Arduino.h>
+#include "AGVCoreNetworkConfig.h"
+
+#define AGV_POOL_CLASS_COUNT 3
+
+// Block = header + payload, rounded to keep headers 4-byte aligned
+#define AGV_POOL_STRIDE(size) ((sizeof(AGVCoreNetworkLib::AGVMessage) + (size) + 3) & ~3u)
+
+namespace AGVCoreNetworkLib {
+
+// Message sources
+enum : uint8_t {
+  AGV_SOURCE_WEBSOCKET = 0,
+  AGV_SOURCE_SERIAL = 1,
+  AGV_SOURCE_HTTP = 2,
+  AGV_SOURCE_INTERNAL = 3,
+  AGV_SOURCE_MQTT = 4,
+  AGV_SOURCE_COUNT
+};
+
+// Message priorities: high for the critical and control classes
+enum : uint8_t {
+  AGV_PRIORITY_NORMAL = 0,
+  AGV_PRIORITY_HIGH = 1    // STOP / ABORT / EMERGENCY / START / PATH
+};
+
+// Message header; the payload follows directly in the same pool block.
+// Ownership moves with the pointer: whoever dequeues a message releases it.
+typedef struct AGVMessage {
+  uint16_t length;    // payload length (excluding terminator)
+  uint8_t source;     // AGV_SOURCE_*
+  uint8_t priority;   // AGV_PRIORITY_*
+  uint8_t client;     // WebSocket client number (0xFF = none)
+  uint8_t sizeClass;  // owning pool class (internal)
+  uint8_t cls;        // scheduler class (AGVCommandClass)
+  uint8_t reserved;
+  uint32_t queuedUs;  // enqueue timestamp (scheduler)
+
+  char* text() { return (char*)(this + 1); }
+  const char* text() const { return (const char*)(this + 1); }
+} AGVMessage;
+
+// Command structure for inter-core communication
+typedef AGVMessage AGVCommandMessage;
+
+typedef struct {
+  uint16_t blockSize;   // payload capacity including terminator
+  uint16_t blocks;
+  uint16_t inUse;
+  uint16_t highWater;
+  uint32_t allocs;
+  uint32_t spills;      // served by a larger class because this one was empty
+  uint32_t exhausted;   // requests that found no block at all
+} AGVPoolClassStats;
+
+// Fixed-size slab allocator for variable-length messages. Blocks come from
+// static storage, so there is no heap use or fragmentation; alloc/release
+// are O(1) and safe from either core.
+class AGVMessagePool {
+public:
+  AGVMessagePool();
+
+  // Allocate a block for a payload of `length` bytes (nullptr if exhausted)
+  AGVMessage* alloc(size_t length);
+  AGVMessage* copy(const char* text, size_t length);
+  void release(AGVMessage* message);
+
+  // Longest payload any block can hold
+  static size_t maxLength() { return AGV_POOL_LARGE_SIZE - 1; }
+
+  void getStats(uint8_t sizeClass, AGVPoolClassStats& out) const;
+  size_t toJson(char* buffer, size_t size) const;
+
+private:
+  typedef struct {
+    uint8_t* storage;
+    uint16_t stride;
+    AGVMessage** freeStack;
+    uint16_t freeTop;
+    AGVPoolClassStats stats;
+  } SizeClass;
+
+  SizeClass classes[AGV_POOL_CLASS_COUNT];
+  uint8_t smallStorage[AGV_POOL_SMALL_COUNT * AGV_POOL_STRIDE(AGV_POOL_SMALL_SIZE)] __attribute__((aligned(4)));
+  uint8_t mediumStorage[AGV_POOL_MEDIUM_COUNT * AGV_POOL_STRIDE(AGV_POOL_MEDIUM_SIZE)] __attribute__((aligned(4)));
+  uint8_t largeStorage[AGV_POOL_LARGE_COUNT * AGV_POOL_STRIDE(AGV_POOL_LARGE_SIZE)] __attribute__((aligned(4)));
+  AGVMessage* smallFree[AGV_POOL_SMALL_COUNT];
+  AGVMessage* mediumFree[AGV_POOL_MEDIUM_COUNT];
+  AGVMessage* largeFree[AGV_POOL_LARGE_COUNT];
+};
+
+} // namespace AGVCoreNetworkLib
+
+#endif
@@ -0,0 +1,188 @@
+#include "AGVMission.h"
+
+using namespace AGVCoreNetworkLib;
+
+void AGVMissionParser::begin(AGVMission* target, uint8_t source) {
+  this->target = target;
+  target->source = source;
+  target->mode = AGV_MISSION_ONCE;
+  target->loops = 1;
+  target->count = 0;
+
+  lastError = AGV_MISSION_OK;
+  offset = 0;
+  errorAt = 0;
+  binary = false;
+  expectLoops = false;
+  tokenLength = 0;
+  partialLength = 0;
+  declaredCount = 0;
+}
+
+bool AGVMissionParser::feed(const uint8_t* data, size_t length) {
+  if (!target) return false;
+
+  for (size_t i = 0; i < length; i++, offset++) {
+    uint8_t c = data[i];
+    if (offset == 0) {
+      binary = (c == AGV_MISSION_BINARY_MAGIC);
+    }
+    if (!(binary ? feedBinary(c) : feedText(c))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+AGVMissionError AGVMissionParser::finish() {
+  if (!target) return lastError;
+
+  if (binary) {
+    if (offset < sizeof(header) || partialLength != 0 || target->count != declaredCount) {
+      fail(AGV_MISSION_ERR_TRUNCATED);
+      return lastError;
+    }
+  } else {
+    if (!endToken()) return lastError;
+    if (expectLoops) {
+      fail(AGV_MISSION_ERR_TRUNCATED);
+      return lastError;
+    }
+  }
+
+  if (target->count == 0) {
+    fail(AGV_MISSION_ERR_EMPTY);
+    return lastError;
+  }
+
+  target = nullptr;
+  return AGV_MISSION_OK;
+}
+
+const char* AGVMissionParser::errorText(AGVMissionError error) {
+  switch (error) {
+    case AGV_MISSION_OK:           return "ok";
+    case AGV_MISSION_ERR_SYNTAX:   return "syntax error";
+    case AGV_MISSION_ERR_RANGE:    return "value out of range";
+    case AGV_MISSION_ERR_TOO_MANY: return "too many waypoints";
+    case AGV_MISSION_ERR_EMPTY:    return "no waypoints";
+    case AGV_MISSION_ERR_ZERO_LEG: return "zero-length leg";
+    case AGV_MISSION_ERR_TRUNCATED:return "truncated mission";
+  }
+  return "unknown error";
+}
+
+bool AGVMissionParser::fail(AGVMissionError error) {
+  lastError = error;
+  errorAt = offset;
+  target = nullptr;
+  return false;
+}
+
+bool AGVMissionParser::feedText(uint8_t c) {
+  if (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == ';' || c == ':') {
+    return endToken();
+  }
+  if (c < 0x20 || c > 0x7E || tokenLength >= sizeof(token) - 1) {
+    return fail(AGV_MISSION_ERR_SYNTAX);
+  }
+  token[tokenLength++] = (char)c;
+  return true;
+}
+
+bool AGVMissionParser::endToken() {
+  if (tokenLength == 0) return true;
+  token[tokenLength] = '\0';
+  tokenLength = 0;
+
+  // Header keywords are only allowed before the first waypoint
+  if (isalpha((unsigned char)token[0])) {
+    if (target->count > 0 || expectLoops) return fail(AGV_MISSION_ERR_SYNTAX);
+    if (strcasecmp(token, "MISSION") == 0) return true;
+    if (strcasecmp(token, "ONCE") == 0) {
+      target->mode = AGV_MISSION_ONCE;
+      target->loops = 1;
+      return true;
+    }
+    if (strcasecmp(token, "LOOP") == 0) {
+      target->mode = AGV_MISSION_LOOP;
+      expectLoops = true;
+      return true;
+    }
+    return fail(AGV_MISSION_ERR_SYNTAX);
+  }
+
+  const char* end;
+  int32_t a, b;
+  if (!parseInt(token, a, &end)) return fail(AGV_MISSION_ERR_SYNTAX);
+
+  if (expectLoops) {
+    if (*end != '\0') return fail(AGV_MISSION_ERR_SYNTAX);
+    if (a < 1 || a > 65535) return fail(AGV_MISSION_ERR_RANGE);
+    target->loops = (uint16_t)a;
+    expectLoops = false;
+    return true;
+  }
+
+  if (*end != ',' || !parseInt(end + 1, b, &end) || *end != '\0') {
+    return fail(AGV_MISSION_ERR_SYNTAX);
+  }
+  return addWaypoint(a, b);
+}
+
+bool AGVMissionParser::feedBinary(uint8_t c) {
+  if (offset < sizeof(header)) {
+    header[offset] = c;
+    if (offset == sizeof(header) - 1) {
+      if (header[1] > AGV_MISSION_LOOP) return fail(AGV_MISSION_ERR_SYNTAX);
+      target->mode = (AGVMissionMode)header[1];
+      target->loops = header[2] | (header[3] << 8);
+      declaredCount = header[4] | (header[5] << 8);
+      if (target->loops == 0) return fail(AGV_MISSION_ERR_RANGE);
+      if (declaredCount > AGV_MISSION_MAX_WAYPOINTS) return fail(AGV_MISSION_ERR_TOO_MANY);
+    }
+    return true;
+  }
+
+  partial[partialLength++] = c;
+  if (partialLength < sizeof(partial)) return true;
+  partialLength = 0;
+
+  if (target->count >= declaredCount) return fail(AGV_MISSION_ERR_SYNTAX);
+  int16_t x = (int16_t)(partial[0] | (partial[1] << 8));
+  int16_t y = (int16_t)(partial[2] | (partial[3] << 8));
+  return addWaypoint(x, y);
+}
+
+bool AGVMissionParser::addWaypoint(int32_t x, int32_t y) {
+  if (x < INT16_MIN || x > INT16_MAX || y < INT16_MIN || y > INT16_MAX) {
+    return fail(AGV_MISSION_ERR_RANGE);
+  }
+  if (target->count >= AGV_MISSION_MAX_WAYPOINTS) {
+    return fail(AGV_MISSION_ERR_TOO_MANY);
+  }
+  if (target->count > 0) {
+    const AGVWaypoint& last = target->waypoints[target->count - 1];
+    if (last.x == x && last.y == y) return fail(AGV_MISSION_ERR_ZERO_LEG);
+  }
+  AGVWaypoint& wp = target->waypoints[target->count++];
+  wp.x = (int16_t)x;
+  wp.y = (int16_t)y;
+  return true;
+}
+
+bool AGVMissionParser::parseInt(const char* text, int32_t& value, const char** end) {
+  bool negative = (*text == '-');
+  if (negative) text++;
+  if (!isdigit((unsigned char)*text)) return false;
+
+  // Saturate instead of overflowing; addWaypoint() rejects the range
+  int32_t v = 0;
+  while (isdigit((unsigned char)*text)) {
+    if (v <= 100000) v = v * 10 + (*text - '0');
+    text++;
+  }
+  value = negative ? -v : v;
+  *end = text;
+  return true;
+}
@@ -0,0 +1,94 @@
+#ifndef AGVMISSION_H
+#define AGVMISSION_H
+
+#include <Arduino.h>
+#include "AGVCoreNetworkConfig.h"
+
+// First byte of a binary mission upload (text uploads never start with it)
+#define AGV_MISSION_BINARY_MAGIC 0xA6
+
+namespace AGVCoreNetworkLib {
+
+typedef enum : uint8_t {
+  AGV_MISSION_ONCE = 0,
+  AGV_MISSION_LOOP = 1
+} AGVMissionMode;
+
+typedef struct {
+  int16_t x;
+  int16_t y;
+} AGVWaypoint;
+
+// A complete route delivered to the control loop in one piece.
+// Consecutive waypoints form the legs of the route.
+typedef struct {
+  uint32_t id;        // increments with every accepted upload
+  uint8_t source;     // AGV_SOURCE_WEBSOCKET or AGV_SOURCE_HTTP
+  AGVMissionMode mode;
+  uint16_t loops;     // number of runs (1 for ONCE)
+  uint16_t count;     // number of waypoints
+  AGVWaypoint waypoints[AGV_MISSION_MAX_WAYPOINTS];
+} AGVMission;
+
+typedef enum : uint8_t {
+  AGV_MISSION_OK = 0,
+  AGV_MISSION_ERR_SYNTAX,
+  AGV_MISSION_ERR_RANGE,
+  AGV_MISSION_ERR_TOO_MANY,
+  AGV_MISSION_ERR_EMPTY,
+  AGV_MISSION_ERR_ZERO_LEG,
+  AGV_MISSION_ERR_TRUNCATED
+} AGVMissionError;
+
+// Incremental mission parser with fixed memory. Bytes can be fed in chunks
+// of any size straight from the network; nothing is buffered beyond the
+// current token.
+//
+// Text format (tokens separated by whitespace, ';' or ':'):
+//   MISSION ONCE | MISSION LOOP 5      (optional header)
+//   1,1  3,1  3,4  6,4 ...             (waypoints as x,y)
+//
+// Binary format (little endian):
+//   0xA6, mode, loops(u16), count(u16), count * {x(i16), y(i16)}
+class AGVMissionParser {
+public:
+  void begin(AGVMission* target, uint8_t source);
+  bool feed(const uint8_t* data, size_t length);
+  AGVMissionError finish();
+
+  bool isActive() const { return target != nullptr; }
+  void abort() { target = nullptr; }
+
+  AGVMissionError error() const { return lastError; }
+  size_t errorOffset() const { return errorAt; }
+  static const char* errorText(AGVMissionError error);
+
+private:
+  AGVMission* target = nullptr;
+  AGVMissionError lastError = AGV_MISSION_OK;
+  size_t offset = 0;
+  size_t errorAt = 0;
+
+  // Text state
+  bool binary = false;
+  bool expectLoops = false;
+  char token[24];
+  uint8_t tokenLength = 0;
+
+  // Binary state
+  uint8_t header[6];
+  uint8_t partial[4];
+  uint8_t partialLength = 0;
+  uint16_t declaredCount = 0;
+
+  bool fail(AGVMissionError error);
+  bool feedText(uint8_t c);
+  bool feedBinary(uint8_t c);
+  bool endToken();
+  bool addWaypoint(int32_t x, int32_t y);
+  static bool parseInt(const char* text, int32_t& value, const char** end);
+};
+
+} // namespace AGVCoreNetworkLib
+
+#endif
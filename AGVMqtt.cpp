@@ -0,0 +1,290 @@
+#include "AGVMqtt.h"
+#include <esp_idf_version.h>
+
+using namespace AGVCoreNetworkLib;
+
+#if AGVNET_ENABLE_MQTT
+
+static_assert(AGV_MQTT_BATCH_MAX >= 64, "AGV_MQTT_BATCH_MAX too small");
+static_assert(AGV_MQTT_OFFLINE_BYTES >= AGV_MQTT_BATCH_MAX + 2,
+              "AGV_MQTT_OFFLINE_BYTES must hold at least one batch");
+
+bool AGVMqttBridge::begin(const char* deviceName, const char* brokerUri, const char* username,
+                          const char* password, AGVMessagePool* pool) {
+  if (client || !brokerUri || !*brokerUri) return false;
+  this->pool = pool;
+
+  snprintf(commandTopic, sizeof(commandTopic), "agv/%s/cmd", deviceName);
+  snprintf(replyTopic, sizeof(replyTopic), "agv/%s/reply", deviceName);
+  snprintf(statusTopic, sizeof(statusTopic), "agv/%s/status", deviceName);
+  snprintf(telemetryTopic, sizeof(telemetryTopic), "agv/%s/telemetry", deviceName);
+  snprintf(availabilityTopic, sizeof(availabilityTopic), "agv/%s/availability", deviceName);
+
+  inbox = xQueueCreate(AGV_MQTT_INBOX_LEN, sizeof(AGVMessage*));
+  if (!inbox) return false;
+
+  // The client copies every string; the broker announces "offline" for us
+  esp_mqtt_client_config_t config = {};
+#if ESP_IDF_VERSION_MAJOR >= 5
+  config.broker.address.uri = brokerUri;
+  config.credentials.client_id = deviceName;
+  config.credentials.username = username;
+  config.credentials.authentication.password = password;
+  config.session.keepalive = AGV_MQTT_KEEPALIVE_S;
+  config.session.last_will.topic = availabilityTopic;
+  config.session.last_will.msg = "offline";
+  config.session.last_will.qos = 1;
+  config.session.last_will.retain = 1;
+#else
+  config.uri = brokerUri;
+  config.client_id = deviceName;
+  config.username = username;
+  config.password = password;
+  config.keepalive = AGV_MQTT_KEEPALIVE_S;
+  config.lwt_topic = availabilityTopic;
+  config.lwt_msg = "offline";
+  config.lwt_qos = 1;
+  config.lwt_retain = 1;
+#endif
+
+  client = esp_mqtt_client_init(&config);
+  if (!client) return false;
+  esp_mqtt_client_register_event(client, MQTT_EVENT_ANY, onEvent, this);
+  return esp_mqtt_client_start(client) == 0;
+}
+
+void AGVMqttBridge::setQos(uint8_t command, uint8_t status, uint8_t telemetry) {
+  commandQos = command > 2 ? 2 : command;
+  statusQos = status > 2 ? 2 : status;
+  telemetryQos = telemetry > 2 ? 2 : telemetry;
+}
+
+// Runs in the esp-mqtt task: only the inbox and the connected flag are shared
+void AGVMqttBridge::onEvent(void* arg, esp_event_base_t base, int32_t eventId, void* eventData) {
+  AGVMqttBridge* bridge = (AGVMqttBridge*)arg;
+  esp_mqtt_event_handle_t event = (esp_mqtt_event_handle_t)eventData;
+
+  switch ((esp_mqtt_event_id_t)eventId) {
+    case MQTT_EVENT_CONNECTED:
+      bridge->isConnected = true;
+      bridge->stats.connects++;
+      esp_mqtt_client_subscribe(bridge->client, bridge->commandTopic, bridge->commandQos);
+      esp_mqtt_client_enqueue(bridge->client, bridge->availabilityTopic, "online", 6, 1, 1, true);
+      break;
+
+    case MQTT_EVENT_DISCONNECTED:
+      bridge->isConnected = false;
+      break;
+
+    case MQTT_EVENT_DATA:
+      {
+        if (event->topic_len != (int)strlen(bridge->commandTopic) ||
+            strncmp(event->topic, bridge->commandTopic, event->topic_len) != 0) {
+          break;
+        }
+
+        // Trim, so "START\n" from mosquitto_pub -l works
+        const char* data = event->data;
+        int length = event->data_len;
+        while (length > 0 && (*data == ' ' || *data == '\t')) { data++; length--; }
+        while (length > 0 && (data[length - 1] == ' ' || data[length - 1] == '\t' ||
+                              data[length - 1] == '\r' || data[length - 1] == '\n')) {
+          length--;
+        }
+
+        AGVMessage* msg = nullptr;
+        if (event->data_len == event->total_data_len && length > 0 &&
+            (size_t)length <= AGVMessagePool::maxLength()) {
+          msg = bridge->pool->copy(data, length);
+        }
+        if (!msg) {
+          bridge->stats.commandsDropped++;
+          break;
+        }
+        msg->source = AGV_SOURCE_MQTT;
+        msg->client = 0xFF;
+        if (xQueueSend(bridge->inbox, &msg, 0) != pdPASS) {
+          bridge->pool->release(msg);
+          bridge->stats.commandsDropped++;
+          break;
+        }
+        bridge->stats.commands++;
+      }
+      break;
+
+    default:
+      break;
+  }
+}
+
+AGVMessage* AGVMqttBridge::receive() {
+  AGVMessage* msg = nullptr;
+  if (!inbox || xQueueReceive(inbox, &msg, 0) != pdPASS) return nullptr;
+  return msg;
+}
+
+// Append one status as a JSON string; a full batch is closed early
+void AGVMqttBridge::addStatus(const char* text, size_t length) {
+  if (!client) return;
+
+  // Escaped size first, so a status is never split across batches
+  size_t escaped = 2;
+  for (size_t i = 0; i < length; i++) {
+    uint8_t c = (uint8_t)text[i];
+    escaped += (c == '"' || c == '\\') ? 2 : (c < 0x20 ? 6 : 1);
+  }
+  if (escaped + 3 > sizeof(batch)) {  // '[' + ']' + NUL
+    stats.oversize++;
+    return;
+  }
+  if (batchLength > 0 && batchLength + 1 + escaped + 2 > sizeof(batch)) {
+    closeBatch();
+  }
+
+  if (batchLength == 0) {
+    batch[batchLength++] = '[';
+    batchStartMs = millis();
+  } else {
+    batch[batchLength++] = ',';
+  }
+  batch[batchLength++] = '"';
+  for (size_t i = 0; i < length; i++) {
+    char c = text[i];
+    if (c == '"' || c == '\\') {
+      batch[batchLength++] = '\\';
+      batch[batchLength++] = c;
+    } else if ((uint8_t)c < 0x20) {
+      batchLength += snprintf(batch + batchLength, 7, "\\u%04x", c);
+    } else {
+      batch[batchLength++] = c;
+    }
+  }
+  batch[batchLength++] = '"';
+  stats.statuses++;
+}
+
+// Publish the batch, or park it behind older batches while offline
+void AGVMqttBridge::closeBatch() {
+  if (batchLength == 0) return;
+  batch[batchLength++] = ']';
+  batch[batchLength] = '\0';
+
+  if (offlineCount == 0 && isConnected &&
+      enqueue(statusTopic, batch, batchLength, statusQos, false)) {
+    stats.batches++;
+  } else {
+    pushOffline(batch, batchLength);
+  }
+  batchLength = 0;
+}
+
+void AGVMqttBridge::publishReply(const char* text) {
+  if (client && isConnected) {
+    enqueue(replyTopic, text, strlen(text), statusQos, false);
+  }
+}
+
+bool AGVMqttBridge::enqueue(const char* topic, const char* data, size_t length, uint8_t qos, bool retain) {
+  return esp_mqtt_client_enqueue(client, topic, data, (int)length, qos, retain ? 1 : 0, true) >= 0;
+}
+
+void AGVMqttBridge::service(uint32_t nowMs, const AGVTelemetry& telemetry) {
+  if (!client) return;
+
+  if (batchLength > 0 && nowMs - batchStartMs >= batchMs) {
+    closeBatch();
+  }
+
+  if (!isConnected) {
+    telemetryDirty = true;  // republish the snapshot after reconnecting
+    return;
+  }
+  flushOffline();
+
+  uint32_t version = telemetry.version();
+  if ((version != telemetryVersion || telemetryDirty) &&
+      nowMs - lastTelemetryMs >= AGV_MQTT_TELEMETRY_MS) {
+    char json[AGV_TELEMETRY_JSON_MAX];
+    size_t length = telemetry.toJson(json, sizeof(json));
+    if (length > 0 && enqueue(telemetryTopic, json, length, telemetryQos, true)) {
+      telemetryVersion = version;
+      telemetryDirty = false;
+      lastTelemetryMs = nowMs;
+      stats.telemetry++;
+    }
+  }
+}
+
+// Oldest first, a few batches per pass so the client's outbox stays small
+void AGVMqttBridge::flushOffline() {
+  char data[AGV_MQTT_BATCH_MAX];
+  for (uint8_t i = 0; i < AGV_MQTT_FLUSH_PER_TICK && offlineCount > 0; i++) {
+    size_t length = peekOffline(data, sizeof(data));
+    if (!enqueue(statusTopic, data, length, statusQos, false)) return;
+    dropOffline();
+    stats.batches++;
+  }
+}
+
+// ---- Offline ring: [uint16 length][payload] records ----
+
+void AGVMqttBridge::ringWrite(size_t at, const void* data, size_t length) {
+  const uint8_t* bytes = (const uint8_t*)data;
+  for (size_t i = 0; i < length; i++) {
+    offline[(at + i) % sizeof(offline)] = bytes[i];
+  }
+}
+
+void AGVMqttBridge::ringRead(size_t at, void* out, size_t length) const {
+  uint8_t* bytes = (uint8_t*)out;
+  for (size_t i = 0; i < length; i++) {
+    bytes[i] = offline[(at + i) % sizeof(offline)];
+  }
+}
+
+void AGVMqttBridge::pushOffline(const char* data, size_t length) {
+  while (sizeof(offline) - offlineUsed < length + 2) {
+    dropOffline();
+    stats.offlineDropped++;
+  }
+  uint16_t prefix = (uint16_t)length;
+  size_t tail = (offlineHead + offlineUsed) % sizeof(offline);
+  ringWrite(tail, &prefix, 2);
+  ringWrite(tail + 2, data, length);
+  offlineUsed += length + 2;
+  offlineCount++;
+  stats.buffered++;
+}
+
+size_t AGVMqttBridge::peekOffline(char* out, size_t size) const {
+  uint16_t length;
+  ringRead(offlineHead, &length, 2);
+  if (length > size) length = (uint16_t)size;
+  ringRead(offlineHead + 2, out, length);
+  return length;
+}
+
+void AGVMqttBridge::dropOffline() {
+  if (offlineCount == 0) return;
+  uint16_t length;
+  ringRead(offlineHead, &length, 2);
+  offlineHead = (offlineHead + length + 2) % sizeof(offline);
+  offlineUsed -= length + 2;
+  offlineCount--;
+}
+
+size_t AGVMqttBridge::toJson(char* buffer, size_t size) const {
+  int written = snprintf(buffer, size,
+                         "{\"connected\":%s,\"connects\":%lu,\"commands\":%lu,\"commandsDropped\":%lu,"
+                         "\"statuses\":%lu,\"batches\":%lu,\"telemetry\":%lu,\"oversize\":%lu,"
+                         "\"offline\":{\"batches\":%u,\"bytes\":%u,\"capacity\":%u,\"buffered\":%lu,\"dropped\":%lu}}",
+                         isConnected ? "true" : "false", (unsigned long)stats.connects,
+                         (unsigned long)stats.commands, (unsigned long)stats.commandsDropped,
+                         (unsigned long)stats.statuses, (unsigned long)stats.batches,
+                         (unsigned long)stats.telemetry, (unsigned long)stats.oversize,
+                         offlineCount, (unsigned)offlineUsed, (unsigned)sizeof(offline),
+                         (unsigned long)stats.buffered, (unsigned long)stats.offlineDropped);
+  return (written > 0 && (size_t)written < size) ? (size_t)written : 0;
+}
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef AGVMQTT_H
+#define AGVMQTT_H
+
+#include <Arduino.h>
+#include "AGVCoreNetworkConfig.h"
+#include "AGVMessagePool.h"
+#include "AGVTelemetry.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <mqtt_client.h>
+
+#define AGV_MQTT_TOPIC_MAX 64
+
+namespace AGVCoreNetworkLib {
+
+typedef struct {
+  uint32_t connects;
+  uint32_t commands;         // received on agv/<name>/cmd
+  uint32_t commandsDropped;  // too long, fragmented, pool or inbox full
+  uint32_t statuses;
+  uint32_t batches;          // status batches handed to the client
+  uint32_t telemetry;
+  uint32_t buffered;         // batches parked while offline
+  uint32_t offlineDropped;   // oldest batches evicted from a full offline buffer
+  uint32_t oversize;         // single status too large for a batch
+} AGVMqttStats;
+
+// MQTT transport for the network task (ESP-IDF esp-mqtt client).
+//
+//   agv/<name>/cmd           subscribed; payload is one command, same syntax as WS/serial
+//   agv/<name>/reply         answers to MQTT commands (GET, AT, errors)
+//   agv/<name>/status        JSON array of the statuses of one batch interval
+//   agv/<name>/telemetry     telemetry snapshot on change, retained
+//   agv/<name>/availability  "online" / "offline" (last will), retained
+//
+// Statuses are collected for a batch interval and published as one message.
+// While the broker is unreachable finished batches go to a bounded byte ring
+// (oldest evicted first) that is flushed in order after reconnecting;
+// telemetry is a snapshot and is simply republished. The esp-mqtt task owns
+// the socket: received commands reach the network task through a queue, and
+// publishing only enqueues, so the network task never blocks on the broker.
+//
+// Local test: mosquitto -v, then tools/mqtt_smoke.sh localhost <name>
+class AGVMqttBridge {
+public:
+  // Network task only, within the commands lock (except receive())
+  bool begin(const char* deviceName, const char* brokerUri, const char* username,
+             const char* password, AGVMessagePool* pool);
+  bool active() const { return client != nullptr; }
+  bool connected() const { return isConnected; }
+
+  void setQos(uint8_t command, uint8_t status, uint8_t telemetry);
+  void setBatchInterval(uint16_t intervalMs) { batchMs = intervalMs > 0 ? intervalMs : 1; }
+
+  // Next command from the broker, or nullptr (caller owns the message)
+  AGVMessage* receive();
+
+  void addStatus(const char* text, size_t length);
+  void publishReply(const char* text);
+
+  // Close due batches, flush the offline buffer and publish telemetry
+  void service(uint32_t nowMs, const AGVTelemetry& telemetry);
+
+  const AGVMqttStats& getStats() const { return stats; }
+  size_t toJson(char* buffer, size_t size) const;
+
+private:
+  esp_mqtt_client_handle_t client = nullptr;
+  AGVMessagePool* pool = nullptr;
+  QueueHandle_t inbox = nullptr;
+  volatile bool isConnected = false;
+
+  char commandTopic[AGV_MQTT_TOPIC_MAX];
+  char replyTopic[AGV_MQTT_TOPIC_MAX];
+  char statusTopic[AGV_MQTT_TOPIC_MAX];
+  char telemetryTopic[AGV_MQTT_TOPIC_MAX];
+  char availabilityTopic[AGV_MQTT_TOPIC_MAX];
+
+  uint8_t commandQos = 1;
+  uint8_t statusQos = 1;
+  uint8_t telemetryQos = 0;
+  uint16_t batchMs = AGV_MQTT_BATCH_MS;
+
+  // Current batch: '[' + comma-separated JSON strings
+  char batch[AGV_MQTT_BATCH_MAX];
+  size_t batchLength = 0;
+  uint32_t batchStartMs = 0;
+
+  // Offline ring of length-prefixed batches
+  uint8_t offline[AGV_MQTT_OFFLINE_BYTES];
+  size_t offlineHead = 0;   // oldest record
+  size_t offlineUsed = 0;
+  uint16_t offlineCount = 0;
+
+  uint32_t telemetryVersion = 0;
+  uint32_t lastTelemetryMs = 0;
+  bool telemetryDirty = true;
+
+  AGVMqttStats stats = {};
+
+  void closeBatch();
+  bool enqueue(const char* topic, const char* data, size_t length, uint8_t qos, bool retain);
+  void flushOffline();
+  void pushOffline(const char* data, size_t length);
+  size_t peekOffline(char* out, size_t size) const;
+  void dropOffline();
+  void ringWrite(size_t at, const void* data, size_t length);
+  void ringRead(size_t at, void* out, size_t length) const;
+  static void onEvent(void* arg, esp_event_base_t base, int32_t eventId, void* eventData);
+};
+
+} // namespace AGVCoreNetworkLib
+
+#endif
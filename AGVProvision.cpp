@@ -0,0 +1,254 @@
+#include "AGVProvision.h"
+#include <WiFi.h>
+#include <mbedtls/md.h>
+
+using namespace AGVCoreNetworkLib;
+
+#if AGVNET_ENABLE_PROVISION
+
+static_assert(AGV_PROVISION_HEADER + 3 + (AGV_PROVISION_SSID_LEN - 1) + (AGV_PROVISION_PASSWORD_LEN - 1) +
+              (AGV_PROVISION_NAME_LEN - 1) + AGV_PROVISION_TAG <= AGV_PROVISION_PACKET_MAX,
+              "AGV_PROVISION_PACKET_MAX too small for the longest config");
+
+bool AGVProvisioner::setKey(const char* key) {
+  size_t length = key ? strlen(key) : 0;
+  if (length > sizeof(this->key)) return false;
+  memcpy(this->key, key, length);
+  keyLength = (uint8_t)length;
+  WiFi.macAddress(mac);
+  if (nonce == 0) renewNonce();
+  return true;
+}
+
+void AGVProvisioner::renewNonce() {
+  do {
+    nonce = esp_random();
+  } while (nonce == 0);
+}
+
+bool AGVProvisioner::begin(uint16_t port, const char* name) {
+  if (!enabled()) return false;
+  this->port = port;
+  this->name = name ? name : "";
+  listening = udp.begin(port);
+  lastHelloMs = millis() - AGV_PROVISION_HELLO_MS;  // announce right away
+  return listening;
+}
+
+void AGVProvisioner::stop() {
+  if (listening) udp.stop();
+  listening = false;
+}
+
+void AGVProvisioner::hmac(const uint8_t* data, size_t length, uint8_t digest[32]) const {
+  mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), key, keyLength, data, length, digest);
+}
+
+void AGVProvisioner::putHeader(uint8_t* packet, AGVProvisionType type) const {
+  memcpy(packet, AGV_PROVISION_MAGIC, 4);
+  packet[4] = AGV_PROVISION_VERSION;
+  packet[5] = type;
+  memcpy(packet + 6, mac, sizeof(mac));
+  memcpy(packet + 12, &nonce, sizeof(nonce));
+}
+
+// Broadcast on every interface that is up: the setup AP and, if joined,
+// the commissioning network
+void AGVProvisioner::sendHello() {
+  uint8_t packet[AGV_PROVISION_HEADER + AGV_PROVISION_NAME_LEN];
+  putHeader(packet, AGV_PROVISION_HELLO);
+  size_t length = strnlen(name, AGV_PROVISION_NAME_LEN - 1);
+  packet[AGV_PROVISION_HEADER] = (uint8_t)length;
+  memcpy(packet + AGV_PROVISION_HEADER + 1, name, length);
+  size_t size = AGV_PROVISION_HEADER + 1 + length;
+
+  int mode = WiFi.getMode();
+  if (mode == WIFI_AP || mode == WIFI_AP_STA) {
+    udp.beginPacket(WiFi.softAPBroadcastIP(), port);
+    udp.write(packet, size);
+    udp.endPacket();
+  }
+  if (WiFi.isConnected()) {
+    udp.beginPacket(WiFi.broadcastIP(), port);
+    udp.write(packet, size);
+    udp.endPacket();
+  }
+  stats.hellos++;
+}
+
+bool AGVProvisioner::service(uint32_t nowMs, AGVProvisionRequest& out) {
+  if (!listening) return false;
+  if (nowMs - lastHelloMs >= AGV_PROVISION_HELLO_MS) {
+    lastHelloMs = nowMs;
+    sendHello();
+  }
+
+  int size = udp.parsePacket();
+  if (size <= 0) return false;
+  uint8_t packet[AGV_PROVISION_PACKET_MAX];
+  int length = udp.read(packet, sizeof(packet));
+  // Other vehicles' announcements arrive on the same port
+  if (length < AGV_PROVISION_HEADER || size > (int)sizeof(packet) || packet[5] != AGV_PROVISION_CONFIG) {
+    return false;
+  }
+
+  replyIP = udp.remoteIP();
+  replyPort = udp.remotePort();
+  AGVProvisionStatus status = open(packet, length, out);
+  if (status == AGV_PROVISION_OK) return true;
+  if (status != AGV_PROVISION_NOT_FOR_US) acknowledge(status);
+  return false;
+}
+
+void AGVProvisioner::acknowledge(AGVProvisionStatus status) {
+  if (!listening || replyPort == 0) return;
+  uint8_t packet[AGV_PROVISION_HEADER + 1];
+  putHeader(packet, AGV_PROVISION_ACK);
+  packet[AGV_PROVISION_HEADER] = status;
+  udp.beginPacket(replyIP, replyPort);
+  udp.write(packet, sizeof(packet));
+  udp.endPacket();
+}
+
+// Verify and decrypt a config packet in place
+AGVProvisionStatus AGVProvisioner::open(uint8_t* packet, size_t length, AGVProvisionRequest& out) {
+  if (length < AGV_PROVISION_HEADER || memcmp(packet, AGV_PROVISION_MAGIC, 4) != 0 ||
+      packet[5] != AGV_PROVISION_CONFIG) {
+    return AGV_PROVISION_MALFORMED;
+  }
+  if (memcmp(packet + 6, mac, sizeof(mac)) != 0) return AGV_PROVISION_NOT_FOR_US;
+  stats.received++;
+  if (!enabled()) return AGV_PROVISION_DISABLED;
+  if (packet[4] != AGV_PROVISION_VERSION || length < AGV_PROVISION_HEADER + 3 + AGV_PROVISION_TAG) {
+    stats.rejected++;
+    return AGV_PROVISION_MALFORMED;
+  }
+
+  // Tag first (constant time), then the nonce: no oracle for forged packets
+  size_t signedLength = length - AGV_PROVISION_TAG;
+  uint8_t digest[32];
+  hmac(packet, signedLength, digest);
+  uint8_t diff = 0;
+  for (size_t i = 0; i < AGV_PROVISION_TAG; i++) diff |= digest[i] ^ packet[signedLength + i];
+  if (diff != 0) {
+    stats.rejected++;
+    return AGV_PROVISION_BAD_SIGNATURE;
+  }
+  uint32_t packetNonce;
+  memcpy(&packetNonce, packet + 12, sizeof(packetNonce));
+  if (packetNonce != nonce) {
+    stats.rejected++;
+    return AGV_PROVISION_STALE;
+  }
+
+  // Keystream blocks: HMAC("AGVK" | MAC | nonce | block)
+  uint8_t* body = packet + AGV_PROVISION_HEADER;
+  size_t bodyLength = signedLength - AGV_PROVISION_HEADER;
+  uint8_t input[4 + 6 + 4 + 1];
+  memcpy(input, "AGVK", 4);
+  memcpy(input + 4, packet + 6, 10);
+  for (size_t offset = 0; offset < bodyLength; offset += sizeof(digest)) {
+    input[14] = (uint8_t)(offset / sizeof(digest));
+    hmac(input, sizeof(input), digest);
+    for (size_t i = 0; i < sizeof(digest) && offset + i < bodyLength; i++) body[offset + i] ^= digest[i];
+  }
+  memset(digest, 0, sizeof(digest));
+
+  // u8 length + text, three times
+  char* fields[3] = { out.ssid, out.password, out.name };
+  const size_t sizes[3] = { sizeof(out.ssid), sizeof(out.password), sizeof(out.name) };
+  size_t at = 0;
+  for (uint8_t f = 0; f < 3; f++) {
+    if (at >= bodyLength || body[at] >= sizes[f] || at + 1 + body[at] > bodyLength) {
+      stats.rejected++;
+      return AGV_PROVISION_MALFORMED;
+    }
+    memcpy(fields[f], body + at + 1, body[at]);
+    fields[f][body[at]] = '\0';
+    at += 1 + body[at];
+  }
+  memset(body, 0, bodyLength);
+
+  // The name becomes the mDNS host name: [a-z0-9_-], not empty
+  bool nameValid = out.ssid[0] != '\0' && out.name[0] != '\0';
+  for (const char* p = out.name; *p && nameValid; p++) {
+    nameValid = isalnum((uint8_t)*p) || *p == '-' || *p == '_';
+  }
+  if (!nameValid || (out.password[0] != '\0' && strlen(out.password) < 8)) {
+    stats.rejected++;
+    return AGV_PROVISION_MALFORMED;
+  }
+  stats.accepted++;
+  return AGV_PROVISION_OK;
+}
+
+static int hexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+bool AGVProvisioner::handleSerial(const char* line, char* reply, size_t size, AGVProvisionRequest& out,
+                                  bool& accepted) {
+  if (strncasecmp(line, "PROVISION", 9) != 0 || (line[9] != '\0' && line[9] != ' ')) return false;
+  accepted = false;
+  if (!enabled()) {
+    snprintf(reply, size, "PROVISION: ERROR %s", statusText(AGV_PROVISION_DISABLED));
+    return true;
+  }
+
+  const char* hex = line + 9;
+  while (*hex == ' ') hex++;
+  if (*hex == '\0') {
+    stats.hellos++;
+    snprintf(reply, size, "PROVISION: HELLO %02x%02x%02x%02x%02x%02x %08lx %s", mac[0], mac[1], mac[2],
+             mac[3], mac[4], mac[5], (unsigned long)nonce, name);
+    return true;
+  }
+
+  uint8_t packet[AGV_PROVISION_PACKET_MAX];
+  size_t length = 0;
+  AGVProvisionStatus status = AGV_PROVISION_MALFORMED;
+  while (hex[0] && hex[1] && length < sizeof(packet)) {
+    int high = hexValue(hex[0]);
+    int low = hexValue(hex[1]);
+    if (high < 0 || low < 0) break;
+    packet[length++] = (uint8_t)(high << 4 | low);
+    hex += 2;
+  }
+  if (*hex == '\0') status = open(packet, length, out);
+  memset(packet, 0, sizeof(packet));
+
+  accepted = status == AGV_PROVISION_OK;
+  if (accepted) {
+    snprintf(reply, size, "PROVISION: OK %s", out.name);
+  } else {
+    snprintf(reply, size, "PROVISION: ERROR %s", statusText(status));
+  }
+  return true;
+}
+
+const char* AGVProvisioner::statusText(AGVProvisionStatus status) {
+  switch (status) {
+    case AGV_PROVISION_OK:            return "ok";
+    case AGV_PROVISION_MALFORMED:     return "malformed";
+    case AGV_PROVISION_BAD_SIGNATURE: return "bad signature";
+    case AGV_PROVISION_STALE:         return "stale nonce";
+    case AGV_PROVISION_NOT_FOR_US:    return "other vehicle";
+    case AGV_PROVISION_DISABLED:      return "no provisioning key";
+  }
+  return "unknown";
+}
+
+size_t AGVProvisioner::toJson(char* buffer, size_t size) const {
+  int written = snprintf(buffer, size,
+                         "{\"enabled\":%s,\"listening\":%s,\"hellos\":%lu,\"received\":%lu,"
+                         "\"accepted\":%lu,\"rejected\":%lu}",
+                         enabled() ? "true" : "false", listening ? "true" : "false",
+                         (unsigned long)stats.hellos, (unsigned long)stats.received,
+                         (unsigned long)stats.accepted, (unsigned long)stats.rejected);
+  return (written > 0 && (size_t)written < size) ? (size_t)written : 0;
+}
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef AGVPROVISION_H
+#define AGVPROVISION_H
+
+#include <Arduino.h>
+#include <WiFiUdp.h>
+#include "AGVCoreNetworkConfig.h"
+
+#define AGV_PROVISION_MAGIC "AGVP"
+#define AGV_PROVISION_VERSION 1
+#define AGV_PROVISION_HEADER 16      // magic, version, type, MAC, nonce
+#define AGV_PROVISION_TAG 16         // truncated HMAC-SHA256
+#define AGV_PROVISION_PACKET_MAX 192
+#define AGV_PROVISION_SSID_LEN 33
+#define AGV_PROVISION_PASSWORD_LEN 64
+#define AGV_PROVISION_NAME_LEN 32
+
+namespace AGVCoreNetworkLib {
+
+typedef enum : uint8_t {
+  AGV_PROVISION_HELLO = 1,   // vehicle -> tool: MAC, nonce, current name
+  AGV_PROVISION_CONFIG,      // tool -> vehicle: encrypted credentials, signed
+  AGV_PROVISION_ACK          // vehicle -> tool: MAC, nonce, status
+} AGVProvisionType;
+
+typedef enum : uint8_t {
+  AGV_PROVISION_OK = 0,
+  AGV_PROVISION_MALFORMED,
+  AGV_PROVISION_BAD_SIGNATURE,
+  AGV_PROVISION_STALE,         // nonce of another boot or an applied config
+  AGV_PROVISION_NOT_FOR_US,    // addressed to another vehicle (not answered)
+  AGV_PROVISION_DISABLED       // no provisioning key set
+} AGVProvisionStatus;
+
+// Credentials from a verified config packet
+typedef struct {
+  char ssid[AGV_PROVISION_SSID_LEN];
+  char password[AGV_PROVISION_PASSWORD_LEN];
+  char name[AGV_PROVISION_NAME_LEN];
+} AGVProvisionRequest;
+
+typedef struct {
+  uint32_t hellos;
+  uint32_t received;      // config packets (UDP and serial)
+  uint32_t accepted;
+  uint32_t rejected;      // malformed, bad signature or stale
+} AGVProvisionStats;
+
+// Zero-touch provisioning for vehicles in setup (AP) mode or without
+// credentials. The vehicle announces itself (HELLO: MAC and a per-boot
+// random nonce) by UDP broadcast every AGV_PROVISION_HELLO_MS and on
+// "PROVISION" over serial; tools/agv_provision.py answers each vehicle with
+//
+//   "AGVP", u8 version, u8 type, MAC[6], u32 nonce, ciphertext, tag[16]
+//
+// The plaintext (u8 length + SSID, password, device name) is XORed with
+// HMAC-SHA256(key, "AGVK" | MAC | nonce | block) and the tag is the
+// truncated HMAC-SHA256 over everything before it, both under the fleet
+// provisioning key. A config for another MAC or nonce is rejected, so a
+// captured packet cannot provision another vehicle or be replayed after
+// a restart. Serial carries the same packet hex-encoded ("PROVISION <hex>").
+//
+// Not thread-safe - use from the network task.
+class AGVProvisioner {
+public:
+  // Fleet key shared with the provisioning tool (up to 64 characters);
+  // nullptr or "" disables
+  bool setKey(const char* key);
+  bool enabled() const { return keyLength > 0; }
+
+  // Listen and announce; name is the vehicle's current device name
+  bool begin(uint16_t port, const char* name);
+  void stop();
+  bool active() const { return listening; }
+
+  // Announce and read the socket; true when a verified config arrived
+  // (answer with acknowledge() before changing networks)
+  bool service(uint32_t nowMs, AGVProvisionRequest& out);
+  void acknowledge(AGVProvisionStatus status);
+
+  // Serial: "PROVISION" answers the HELLO line, "PROVISION <hex>" checks
+  // a config packet (accepted: `out` holds verified credentials). Returns
+  // false if the line is not for the provisioner.
+  bool handleSerial(const char* line, char* reply, size_t size, AGVProvisionRequest& out, bool& accepted);
+
+  // Draw a new nonce (after a config was applied)
+  void renewNonce();
+
+  size_t toJson(char* buffer, size_t size) const;
+  static const char* statusText(AGVProvisionStatus status);
+
+private:
+  uint8_t key[64] = {};
+  uint8_t keyLength = 0;
+  uint8_t mac[6] = {};
+  uint32_t nonce = 0;
+  uint16_t port = 0;
+  const char* name = "";
+  bool listening = false;
+  uint32_t lastHelloMs = 0;
+  WiFiUDP udp;
+  IPAddress replyIP;
+  uint16_t replyPort = 0;
+  AGVProvisionStats stats = {};
+
+  AGVProvisionStatus open(uint8_t* packet, size_t length, AGVProvisionRequest& out);
+  void sendHello();
+  void putHeader(uint8_t* packet, AGVProvisionType type) const;
+  void hmac(const uint8_t* data, size_t length, uint8_t digest[32]) const;
+};
+
+} // namespace AGVCoreNetworkLib
+
+#endif
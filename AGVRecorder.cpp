@@ -0,0 +1,104 @@
+#include "AGVRecorder.h"
+#include "AGVMessagePool.h"
+#include <esp_attr.h>
+#include <esp_system.h>
+
+using namespace AGVCoreNetworkLib;
+
+#if AGVNET_ENABLE_RECORDER
+
+// Download header (little endian), followed by the ring in slot order
+typedef struct {
+  uint32_t magic;
+  uint8_t version;
+  uint8_t eventSize;
+  uint16_t capacity;
+  uint32_t nextSeq;
+  uint32_t nowUs;
+} RecorderHeader;
+
+// Retained across warm resets; contents are garbage after power-on
+typedef struct {
+  uint32_t magic;
+  uint32_t bootCount;
+  uint32_t check;
+  AGVEvent events[AGV_RECORDER_EVENTS];
+} RecorderStore;
+
+RTC_NOINIT_ATTR static RecorderStore recorderStore;
+
+static_assert(sizeof(AGVEvent) == 16, "AGVEvent layout is part of the download format");
+static_assert(AGV_RECORDER_EVENTS > 0 && AGV_RECORDER_EVENTS <= 0xFFFF, "AGV_RECORDER_EVENTS out of range");
+
+static uint32_t storeCheck(const RecorderStore& store) {
+  return store.magic ^ store.bootCount ^ (AGV_RECORDER_EVENTS * 0x9E3779B1u);
+}
+
+void AGVRecorder::begin() {
+  RecorderStore& store = recorderStore;
+  esp_reset_reason_t reason = esp_reset_reason();
+
+  bool valid = reason != ESP_RST_POWERON &&
+               store.magic == AGV_RECORDER_MAGIC &&
+               store.check == storeCheck(store);
+
+  recoveredEvents = 0;
+  nextSeq = 0;
+  if (valid) {
+    // Continue the sequence after the newest retained event
+    for (uint32_t i = 0; i < AGV_RECORDER_EVENTS; i++) {
+      const AGVEvent& e = store.events[i];
+      if (e.type == AGV_EVT_NONE) continue;
+      recoveredEvents++;
+      if (e.seq + 1 > nextSeq) nextSeq = e.seq + 1;
+    }
+    store.bootCount++;
+  } else {
+    memset(&store, 0, sizeof(store));
+    store.magic = AGV_RECORDER_MAGIC;
+  }
+  store.check = storeCheck(store);
+
+  ring = store.events;
+  record(AGV_EVT_BOOT, AGV_SOURCE_INTERNAL, (uint16_t)store.bootCount, (uint32_t)reason);
+
+  Serial.printf("[REC] Flight recorder: %u events, %u recovered (boot %lu, reset reason %d)\n",
+                (unsigned)AGV_RECORDER_EVENTS, (unsigned)recoveredEvents,
+                (unsigned long)store.bootCount, (int)reason);
+}
+
+size_t AGVRecorder::downloadSize() {
+  return sizeof(RecorderHeader) + sizeof(AGVEvent) * AGV_RECORDER_EVENTS;
+}
+
+size_t AGVRecorder::read(size_t offset, uint8_t* buffer, size_t size) const {
+  if (!ring || offset >= downloadSize()) return 0;
+
+  size_t written = 0;
+  if (offset < sizeof(RecorderHeader)) {
+    RecorderHeader header;
+    header.magic = AGV_RECORDER_MAGIC;
+    header.version = AGV_RECORDER_VERSION;
+    header.eventSize = sizeof(AGVEvent);
+    header.capacity = AGV_RECORDER_EVENTS;
+    header.nextSeq = __atomic_load_n(&nextSeq, __ATOMIC_RELAXED);
+    header.nowUs = (uint32_t)micros();
+
+    size_t n = sizeof(header) - offset;
+    if (n > size) n = size;
+    memcpy(buffer, (const uint8_t*)&header + offset, n);
+    written = n;
+    if (written == size) return written;
+  }
+
+  // Events are copied while recording continues; a slot overwritten
+  // mid-copy shows up as an event with an out-of-order sequence number
+  size_t ringOffset = offset + written - sizeof(RecorderHeader);
+  size_t remaining = sizeof(AGVEvent) * AGV_RECORDER_EVENTS - ringOffset;
+  size_t n = size - written;
+  if (n > remaining) n = remaining;
+  memcpy(buffer + written, (const uint8_t*)ring + ringOffset, n);
+  return written + n;
+}
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef AGVRECORDER_H
+#define AGVRECORDER_H
+
+#include <Arduino.h>
+#include "AGVCoreNetworkConfig.h"
+
+#define AGV_RECORDER_MAGIC 0x52564741u  // "AGVR"
+#define AGV_RECORDER_VERSION 1
+
+namespace AGVCoreNetworkLib {
+
+typedef enum : uint8_t {
+  AGV_EVT_NONE = 0,
+  AGV_EVT_BOOT,           // arg=boot count, data=reset reason
+  AGV_EVT_CMD_RX,         // arg=length, data=first 4 chars
+  AGV_EVT_CMD_EXEC,       // arg=priority | class << 8, data=first 4 chars
+  AGV_EVT_CMD_DROP,       // arg=AGV_DROP_* or AGVSubmitResult, data=first 4 chars
+  AGV_EVT_STATUS,         // arg=length, data=first 4 chars
+  AGV_EVT_EMERGENCY,      // arg=length, data=first 4 chars
+  AGV_EVT_WS_CONNECT,     // arg=client, data=IPv4 address
+  AGV_EVT_WS_DISCONNECT,  // arg=client
+  AGV_EVT_LINK,           // arg=operators, data=1 up / 0 lost
+  AGV_EVT_MUTEX_TIMEOUT,  // arg=source line, data=lock domain (0 commands, 1 clients, 2 config)
+  AGV_EVT_LOOP_STALL,     // data=loop iteration in ms
+  AGV_EVT_MISSION,        // arg=waypoints, data=mission id
+  AGV_EVT_RESTART,        // planned restart, arg=source line
+  AGV_EVT_TIMED_EXEC,     // AT command fired, arg=priority | class << 8, data=skew in us (signed)
+  AGV_EVT_AUTH_REJECT,    // arg=AGVAuthResult
+  AGV_EVT_ISR_OVERFLOW,   // data=ISR events lost since the last report
+  AGV_EVT_USER = 0x80     // application events (0x80-0xFF)
+} AGVEventType;
+
+// Drop reasons recorded besides AGVSubmitResult
+#define AGV_DROP_HANDLER_BUSY 0xFD
+#define AGV_DROP_TOO_LONG 0xFE
+#define AGV_DROP_NO_BLOCK 0xFF
+
+// One recorded event. Layout is part of the /recorder download format.
+typedef struct {
+  uint32_t seq;     // global sequence number, written last
+  uint32_t timeUs;  // micros() at record time (restarts at every boot)
+  uint8_t type;     // AGVEventType
+  uint8_t source;   // AGV_SOURCE_*
+  uint16_t arg;
+  uint32_t data;
+} AGVEvent;
+
+// Flight recorder: a ring of fixed-size binary events kept in RTC memory
+// that is not cleared on warm resets (panic, watchdog, brown-out,
+// ESP.restart()), so the last events before a reboot can be downloaded
+// afterwards. record() is lock-free and safe from either core or an ISR:
+// one atomic increment, a timer read and four stores.
+class AGVRecorder {
+public:
+  // Validate the retained ring (cleared on power-on) and log a BOOT event
+  void begin();
+
+  inline void record(AGVEventType type, uint8_t source, uint16_t arg, uint32_t data) {
+    if (!ring) return;
+    uint32_t seq = __atomic_fetch_add(&nextSeq, 1, __ATOMIC_RELAXED);
+    AGVEvent& e = ring[seq % AGV_RECORDER_EVENTS];
+    e.timeUs = (uint32_t)micros();
+    e.type = type;
+    e.source = source;
+    e.arg = arg;
+    e.data = data;
+    __atomic_store_n(&e.seq, seq, __ATOMIC_RELEASE);
+  }
+
+  // Text events keep the length and the first four characters
+  inline void recordText(AGVEventType type, uint8_t source, const char* text, size_t length) {
+    record(type, source, length > 0xFFFF ? 0xFFFF : (uint16_t)length, head(text, length));
+  }
+
+  static inline uint32_t head(const char* text, size_t length) {
+    uint32_t value = 0;
+    memcpy(&value, text, length < sizeof(value) ? length : sizeof(value));
+    return value;
+  }
+
+  // Events left over from before this boot
+  uint32_t recovered() const { return recoveredEvents; }
+  uint32_t capacity() const { return AGV_RECORDER_EVENTS; }
+
+  // Serialize header + ring (slot order) into buffer, starting at byte
+  // `offset` of the download. Returns bytes written; 0 at the end.
+  size_t read(size_t offset, uint8_t* buffer, size_t size) const;
+  static size_t downloadSize();
+
+private:
+  AGVEvent* ring = nullptr;
+  uint32_t nextSeq = 0;
+  uint32_t recoveredEvents = 0;
+};
+
+} // namespace AGVCoreNetworkLib
+
+#endif
@@ -0,0 +1,319 @@
+#include "AGVRoute.h"
+#include <esp_timer.h>
+
+using namespace AGVCoreNetworkLib;
+
+#if AGVNET_ENABLE_ROUTING
+
+static_assert(AGV_GRID_MAX_CELLS < 0xFFFE, "AGV_GRID_MAX_CELLS must leave room for the heap markers");
+static_assert(AGV_ROUTE_CACHE_POINTS <= AGV_MISSION_MAX_WAYPOINTS,
+              "AGV_ROUTE_CACHE_POINTS exceeds the mission size");
+
+#define AGV_ROUTE_CLOSED 0xFFFE
+
+// Moves: +x, -x, +y, -y
+static const int8_t stepX[4] = { 1, -1, 0, 0 };
+static const int8_t stepY[4] = { 0, 0, 1, -1 };
+
+// ---- Map ----
+
+bool AGVGridMap::resize(uint8_t width, uint8_t height) {
+  if ((uint32_t)width * height > AGV_GRID_MAX_CELLS) return false;
+  memset(bits, 0, sizeof(bits));
+  this->width = width;
+  this->height = height;
+  mapVersion++;
+  return true;
+}
+
+bool AGVGridMap::load(const char* rows) {
+  // Measure first so a map that does not fit leaves the old one intact
+  uint16_t w = 0, h = 0, column = 0;
+  for (const char* p = rows; *p; p++) {
+    if (*p == '\r') continue;
+    if (*p == '\n') {
+      if (column > w) w = column;
+      h++;
+      column = 0;
+    } else {
+      column++;
+    }
+  }
+  if (column > 0) {
+    if (column > w) w = column;
+    h++;
+  }
+  if (w == 0 || w > 255 || h > 255 || (uint32_t)w * h > AGV_GRID_MAX_CELLS) return false;
+
+  memset(bits, 0, sizeof(bits));
+  width = (uint8_t)w;
+  height = (uint8_t)h;
+  uint16_t x = 0, y = 0;
+  for (const char* p = rows; *p; p++) {
+    if (*p == '\r') continue;
+    if (*p == '\n') {
+      x = 0;
+      y++;
+      continue;
+    }
+    if (*p == '#' || *p == '1') {
+      uint16_t cell = y * width + x;
+      bits[cell >> 3] |= 1 << (cell & 7);
+    }
+    x++;
+  }
+  mapVersion++;
+  return true;
+}
+
+bool AGVGridMap::setBlocked(uint8_t x, uint8_t y, bool blocked) {
+  if (!inside(x, y)) return false;
+  uint16_t cell = y * width + x;
+  if (this->blocked(cell) == blocked) return true;  // no new version, cache stays valid
+  if (blocked) {
+    bits[cell >> 3] |= 1 << (cell & 7);
+  } else {
+    bits[cell >> 3] &= ~(1 << (cell & 7));
+  }
+  mapVersion++;
+  return true;
+}
+
+uint16_t AGVGridMap::blockedCount() const {
+  uint16_t total = 0;
+  for (uint16_t cell = 0; cell < (uint16_t)width * height; cell++) {
+    if (blocked(cell)) total++;
+  }
+  return total;
+}
+
+// ---- Router ----
+
+AGVRouteResult AGVRouter::route(int32_t sx, int32_t sy, int32_t dx, int32_t dy,
+                                AGVWaypoint* out, uint16_t capacity, uint16_t& count, bool& cached) {
+  cached = false;
+  count = 0;
+  AGVRouteResult result = AGV_ROUTE_OK;
+  if (!grid.loaded()) {
+    result = AGV_ROUTE_NO_MAP;
+  } else if (!grid.inside(sx, sy) || !grid.inside(dx, dy)) {
+    result = AGV_ROUTE_OUT_OF_MAP;
+  } else if (sx == dx && sy == dy) {
+    result = AGV_ROUTE_SAME_CELL;
+  }
+  if (result != AGV_ROUTE_OK) {
+    stats.failures++;
+    return result;
+  }
+
+  // Cache lookup: same endpoints on the same map version
+  useClock++;
+  CacheEntry* victim = &cache[0];
+  for (uint8_t i = 0; i < AGV_ROUTE_CACHE_SIZE; i++) {
+    CacheEntry& entry = cache[i];
+    if (entry.version == grid.version() && entry.sx == sx && entry.sy == sy &&
+        entry.dx == dx && entry.dy == dy && entry.count <= capacity) {
+      entry.lastUsed = useClock;
+      memcpy(out, entry.points, entry.count * sizeof(AGVWaypoint));
+      count = entry.count;
+      cached = true;
+      stats.cacheHits++;
+      return AGV_ROUTE_OK;
+    }
+    // Prefer slots from an older map, then the least recently used
+    bool stale = entry.version != grid.version();
+    bool victimStale = victim->version != grid.version();
+    if ((stale && !victimStale) || (stale == victimStale && entry.lastUsed < victim->lastUsed)) {
+      victim = &entry;
+    }
+  }
+  stats.cacheMisses++;
+
+  uint16_t width = grid.getWidth();
+  int64_t startUs = esp_timer_get_time();
+  result = search(sy * width + sx, dy * width + dx, out, capacity, count);
+  uint32_t planUs = (uint32_t)(esp_timer_get_time() - startUs);
+  stats.plans++;
+  stats.lastPlanUs = planUs;
+  if (planUs > stats.maxPlanUs) stats.maxPlanUs = planUs;
+
+  if (result != AGV_ROUTE_OK) {
+    stats.failures++;
+    return result;
+  }
+
+  if (count > AGV_ROUTE_CACHE_POINTS) {
+    stats.uncacheable++;
+    return result;
+  }
+  if (victim->version == grid.version() && victim->version != 0) stats.evictions++;
+  victim->version = grid.version();
+  victim->lastUsed = useClock;
+  victim->sx = (uint8_t)sx;
+  victim->sy = (uint8_t)sy;
+  victim->dx = (uint8_t)dx;
+  victim->dy = (uint8_t)dy;
+  victim->count = count;
+  memcpy(victim->points, out, count * sizeof(AGVWaypoint));
+  return result;
+}
+
+uint16_t AGVRouter::heuristic(uint16_t cell) const {
+  uint16_t width = grid.getWidth();
+  int16_t x = cell % width, y = cell / width;
+  int16_t gx = goalCell % width, gy = goalCell / width;
+  return (uint16_t)(abs(x - gx) + abs(y - gy));
+}
+
+// Lower f first; on ties the cell closer to the goal, which keeps A* from
+// fanning out across equally good cells on an open floor
+bool AGVRouter::before(uint16_t a, uint16_t b) const {
+  uint16_t ha = heuristic(a), hb = heuristic(b);
+  uint32_t fa = (uint32_t)gScore[a] + ha, fb = (uint32_t)gScore[b] + hb;
+  return fa < fb || (fa == fb && ha < hb);
+}
+
+void AGVRouter::siftUp(uint16_t pos) {
+  uint16_t cell = heap[pos];
+  while (pos > 0) {
+    uint16_t parent = (pos - 1) / 2;
+    if (!before(cell, heap[parent])) break;
+    heap[pos] = heap[parent];
+    heapPos[heap[pos]] = pos;
+    pos = parent;
+  }
+  heap[pos] = cell;
+  heapPos[cell] = pos;
+}
+
+void AGVRouter::siftDown(uint16_t pos) {
+  uint16_t cell = heap[pos];
+  while (true) {
+    uint16_t child = pos * 2 + 1;
+    if (child >= heapSize) break;
+    if (child + 1 < heapSize && before(heap[child + 1], heap[child])) child++;
+    if (!before(heap[child], cell)) break;
+    heap[pos] = heap[child];
+    heapPos[heap[pos]] = pos;
+    pos = child;
+  }
+  heap[pos] = cell;
+  heapPos[cell] = pos;
+}
+
+void AGVRouter::heapPush(uint16_t cell) {
+  heap[heapSize] = cell;
+  siftUp(heapSize++);
+}
+
+uint16_t AGVRouter::heapPop() {
+  uint16_t top = heap[0];
+  heapPos[top] = AGV_ROUTE_CLOSED;
+  if (--heapSize > 0) {
+    heap[0] = heap[heapSize];
+    siftDown(0);
+  }
+  return top;
+}
+
+void AGVRouter::setDirection(uint16_t cell, uint8_t dir) {
+  uint8_t shift = (cell & 3) * 2;
+  cameFrom[cell >> 2] = (cameFrom[cell >> 2] & ~(3 << shift)) | (dir << shift);
+}
+
+AGVRouteResult AGVRouter::search(uint16_t start, uint16_t goal, AGVWaypoint* out,
+                                 uint16_t capacity, uint16_t& count) {
+  if (grid.blocked(start) || grid.blocked(goal)) return AGV_ROUTE_BLOCKED;
+
+  uint16_t width = grid.getWidth();
+  uint16_t cells = width * grid.getHeight();
+  memset(gScore, 0xFF, cells * sizeof(gScore[0]));
+  memset(heapPos, 0xFF, cells * sizeof(heapPos[0]));
+  heapSize = 0;
+  goalCell = goal;
+  stats.lastExpanded = 0;
+
+  gScore[start] = 0;
+  heapPush(start);
+  bool found = false;
+  while (heapSize > 0) {
+    uint16_t cell = heapPop();
+    stats.lastExpanded++;
+    if (cell == goal) {
+      found = true;
+      break;
+    }
+
+    int16_t x = cell % width, y = cell / width;
+    for (uint8_t dir = 0; dir < 4; dir++) {
+      int16_t nx = x + stepX[dir], ny = y + stepY[dir];
+      if (!grid.inside(nx, ny)) continue;
+      uint16_t next = ny * width + nx;
+      if (heapPos[next] == AGV_ROUTE_CLOSED || grid.blocked(next)) continue;
+
+      uint16_t g = gScore[cell] + 1;
+      if (g >= gScore[next]) continue;
+      gScore[next] = g;
+      setDirection(next, dir);
+      if (heapPos[next] == AGV_ROUTE_NONE) {
+        heapPush(next);
+      } else {
+        siftUp(heapPos[next]);  // decrease-key
+      }
+    }
+  }
+  if (!found) return AGV_ROUTE_UNREACHABLE;
+
+  // Walk back from the goal keeping only the corners, then reverse
+  count = 0;
+  uint16_t cell = goal;
+  int8_t lastDir = -1;
+  while (true) {
+    uint8_t dir = direction(cell);
+    if (cell == start || dir != lastDir) {
+      if (count >= capacity) return AGV_ROUTE_TOO_LONG;
+      out[count].x = cell % width;
+      out[count].y = cell / width;
+      count++;
+    }
+    if (cell == start) break;
+    lastDir = dir;
+    cell = (cell / width - stepY[dir]) * width + (cell % width - stepX[dir]);
+  }
+  for (uint16_t i = 0; i < count / 2; i++) {
+    AGVWaypoint swap = out[i];
+    out[i] = out[count - 1 - i];
+    out[count - 1 - i] = swap;
+  }
+  return AGV_ROUTE_OK;
+}
+
+const char* AGVRouter::resultText(AGVRouteResult result) {
+  switch (result) {
+    case AGV_ROUTE_OK:          return "ok";
+    case AGV_ROUTE_NO_MAP:      return "no map loaded";
+    case AGV_ROUTE_OUT_OF_MAP:  return "endpoint outside the map";
+    case AGV_ROUTE_BLOCKED:     return "endpoint is an obstacle";
+    case AGV_ROUTE_SAME_CELL:   return "start equals goal";
+    case AGV_ROUTE_UNREACHABLE: return "no route";
+    case AGV_ROUTE_TOO_LONG:    return "route has too many turns";
+  }
+  return "unknown";
+}
+
+size_t AGVRouter::toJson(char* buffer, size_t size) const {
+  int written = snprintf(buffer, size,
+                         "{\"map\":{\"width\":%u,\"height\":%u,\"version\":%lu,\"blocked\":%u},"
+                         "\"plans\":%lu,\"cacheHits\":%lu,\"cacheMisses\":%lu,\"evictions\":%lu,"
+                         "\"uncacheable\":%lu,\"failures\":%lu,\"lastExpanded\":%u,"
+                         "\"planUs\":{\"last\":%lu,\"max\":%lu}}",
+                         grid.getWidth(), grid.getHeight(), (unsigned long)grid.version(),
+                         grid.blockedCount(), (unsigned long)stats.plans,
+                         (unsigned long)stats.cacheHits, (unsigned long)stats.cacheMisses,
+                         (unsigned long)stats.evictions, (unsigned long)stats.uncacheable,
+                         (unsigned long)stats.failures, stats.lastExpanded,
+                         (unsigned long)stats.lastPlanUs, (unsigned long)stats.maxPlanUs);
+  return (written > 0 && (size_t)written < size) ? (size_t)written : 0;
+}
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef AGVROUTE_H
+#define AGVROUTE_H
+
+#include <Arduino.h>
+#include "AGVCoreNetworkConfig.h"
+#include "AGVMission.h"
+
+#define AGV_ROUTE_NONE 0xFFFF
+
+namespace AGVCoreNetworkLib {
+
+typedef enum : uint8_t {
+  AGV_ROUTE_OK = 0,
+  AGV_ROUTE_NO_MAP,
+  AGV_ROUTE_OUT_OF_MAP,
+  AGV_ROUTE_BLOCKED,       // start or goal is an obstacle
+  AGV_ROUTE_SAME_CELL,
+  AGV_ROUTE_UNREACHABLE,
+  AGV_ROUTE_TOO_LONG       // more corners than the caller's buffer
+} AGVRouteResult;
+
+typedef struct {
+  uint32_t plans;          // searches run
+  uint32_t cacheHits;
+  uint32_t cacheMisses;
+  uint32_t evictions;
+  uint32_t uncacheable;    // more than AGV_ROUTE_CACHE_POINTS corners
+  uint32_t failures;
+  uint32_t lastPlanUs;
+  uint32_t maxPlanUs;
+  uint16_t lastExpanded;   // cells taken off the open list by the last search
+} AGVRouteStats;
+
+// Occupancy grid, one bit per cell (1 = obstacle). Every change bumps the
+// version, which invalidates cached routes.
+class AGVGridMap {
+public:
+  // Text map: one row per line (y = 0 first), '#' or '1' blocked, anything
+  // else free. Rows may differ in length; the widest sets the width.
+  bool load(const char* rows);
+  bool resize(uint8_t width, uint8_t height);
+  bool setBlocked(uint8_t x, uint8_t y, bool blocked);
+
+  bool loaded() const { return width > 0; }
+  bool inside(int32_t x, int32_t y) const { return x >= 0 && y >= 0 && x < width && y < height; }
+  bool blocked(uint16_t cell) const { return bits[cell >> 3] & (1 << (cell & 7)); }
+  uint8_t getWidth() const { return width; }
+  uint8_t getHeight() const { return height; }
+  uint32_t version() const { return mapVersion; }
+  uint16_t blockedCount() const;
+
+private:
+  uint8_t bits[(AGV_GRID_MAX_CELLS + 7) / 8] = {};
+  uint8_t width = 0;
+  uint8_t height = 0;
+  uint32_t mapVersion = 0;
+};
+
+// A* over the grid (4-connected, unit cost, Manhattan heuristic) with a
+// binary heap supporting decrease-key. All search state is preallocated for
+// AGV_GRID_MAX_CELLS. Routes come back as corner points only: start, every
+// change of direction, goal.
+//
+// Routes are cached by (start, goal, map version) with LRU eviction, so a
+// repeated PATH - e.g. every run of a loop mission - is a copy, not a search.
+// Not thread-safe - use from the network task within the commands lock.
+class AGVRouter {
+public:
+  AGVGridMap& map() { return grid; }
+  const AGVGridMap& map() const { return grid; }
+
+  AGVRouteResult route(int32_t sx, int32_t sy, int32_t dx, int32_t dy,
+                       AGVWaypoint* out, uint16_t capacity, uint16_t& count, bool& cached);
+
+  const AGVRouteStats& getStats() const { return stats; }
+  size_t toJson(char* buffer, size_t size) const;
+  static const char* resultText(AGVRouteResult result);
+
+private:
+  typedef struct {
+    uint32_t version;      // map version the route was planned on (0 = empty)
+    uint32_t lastUsed;
+    uint8_t sx, sy, dx, dy;
+    uint16_t count;
+    AGVWaypoint points[AGV_ROUTE_CACHE_POINTS];
+  } CacheEntry;
+
+  AGVGridMap grid;
+  CacheEntry cache[AGV_ROUTE_CACHE_SIZE] = {};
+  uint32_t useClock = 0;
+  AGVRouteStats stats = {};
+
+  // Search scratch
+  uint16_t gScore[AGV_GRID_MAX_CELLS];
+  uint16_t heapPos[AGV_GRID_MAX_CELLS];  // AGV_ROUTE_NONE, position, or CLOSED
+  uint16_t heap[AGV_GRID_MAX_CELLS];
+  uint8_t cameFrom[(AGV_GRID_MAX_CELLS + 3) / 4];  // 2-bit direction per cell
+  uint16_t heapSize = 0;
+  uint16_t goalCell = 0;
+
+  AGVRouteResult search(uint16_t start, uint16_t goal, AGVWaypoint* out,
+                        uint16_t capacity, uint16_t& count);
+  uint16_t heuristic(uint16_t cell) const;
+  bool before(uint16_t a, uint16_t b) const;
+  void heapPush(uint16_t cell);
+  uint16_t heapPop();
+  void siftUp(uint16_t pos);
+  void siftDown(uint16_t pos);
+  uint8_t direction(uint16_t cell) const { return (cameFrom[cell >> 2] >> ((cell & 3) * 2)) & 3; }
+  void setDirection(uint16_t cell, uint8_t dir);
+};
+
+} // namespace AGVCoreNetworkLib
+
+#endif
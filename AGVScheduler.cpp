@@ -0,0 +1,235 @@
+#include "AGVScheduler.h"
+
+using namespace AGVCoreNetworkLib;
+
+static const char* const classNames[AGV_CLASS_COUNT] = { "critical", "control", "normal", "bulk" };
+
+AGVScheduler::AGVScheduler() {
+  addRule("STOP", AGV_CLASS_CRITICAL);
+  addRule("ABORT", AGV_CLASS_CRITICAL);
+  addRule("EMERGENCY", AGV_CLASS_CRITICAL);
+  addRule("START", AGV_CLASS_CONTROL);
+  addRule("PATH:*", AGV_CLASS_CONTROL);
+}
+
+bool AGVScheduler::addRule(const char* pattern, AGVCommandClass cls) {
+  if (!pattern || cls >= AGV_CLASS_COUNT) return false;
+
+  size_t length = strlen(pattern);
+  bool prefix = length > 0 && pattern[length - 1] == '*';
+  if (prefix) length--;
+  if (length == 0 || length >= sizeof(rules[0].pattern)) return false;
+
+  // Same pattern again just changes its class
+  for (uint8_t i = 0; i < ruleCount; i++) {
+    if (rules[i].prefix == prefix && rules[i].length == length &&
+        strncasecmp(rules[i].pattern, pattern, length) == 0) {
+      rules[i].cls = cls;
+      return true;
+    }
+  }
+
+  if (ruleCount >= AGV_SCHED_MAX_RULES) return false;
+  Rule& rule = rules[ruleCount++];
+  memcpy(rule.pattern, pattern, length);
+  rule.pattern[length] = '\0';
+  rule.length = (uint8_t)length;
+  rule.prefix = prefix;
+  rule.cls = cls;
+  return true;
+}
+
+void AGVScheduler::clearRules() {
+  ruleCount = 0;
+}
+
+AGVCommandClass AGVScheduler::classify(const char* command) const {
+  for (uint8_t i = 0; i < ruleCount; i++) {
+    const Rule& rule = rules[i];
+    if (strncasecmp(command, rule.pattern, rule.length) != 0) continue;
+    if (rule.prefix || command[rule.length] == '\0') return rule.cls;
+  }
+  return AGV_CLASS_NORMAL;
+}
+
+void AGVScheduler::setWeight(AGVCommandClass cls, uint8_t weight) {
+  if (cls < AGV_CLASS_COUNT) {
+    weights[cls] = weight > 0 ? weight : 1;
+  }
+}
+
+void AGVScheduler::setRateLimit(uint16_t perSecond, uint16_t burst) {
+  ratePerSecond = perSecond;
+  rateBurst = burst > 0 ? burst : 1;
+  for (uint8_t i = 0; i < AGV_SCHED_SOURCE_SLOTS; i++) {
+    buckets[i].milliTokens = capacity(i);
+    buckets[i].lastRefillMs = millis();
+  }
+}
+
+void AGVScheduler::resetSource(uint8_t source, uint8_t client) {
+  uint8_t slot = slotFor(source, client);
+  buckets[slot].milliTokens = capacity(slot);
+  buckets[slot].lastRefillMs = millis();
+}
+
+uint8_t AGVScheduler::slotFor(uint8_t source, uint8_t client) {
+  if (source == AGV_SOURCE_WEBSOCKET && client < AGV_SCHED_WS_SLOTS) return client;
+#if AGVNET_ENABLE_API
+  if (source == AGV_SOURCE_HTTP && client < AGV_SCHED_API_SLOTS) return AGV_SCHED_WS_SLOTS + client;
+#endif
+  if (source >= AGV_SOURCE_COUNT) source = AGV_SOURCE_INTERNAL;
+  return AGV_SCHED_WS_SLOTS + AGV_SCHED_API_SLOTS + source;
+}
+
+// Bucket size in milli-tokens; an API connection can always send one full batch
+uint32_t AGVScheduler::capacity(uint8_t slot) const {
+  bool api = slot >= AGV_SCHED_WS_SLOTS && slot < AGV_SCHED_WS_SLOTS + AGV_SCHED_API_SLOTS;
+  uint16_t burst = api ? max(rateBurst, (uint16_t)AGV_API_BATCH_MAX) : rateBurst;
+  return (uint32_t)burst * 1000;
+}
+
+bool AGVScheduler::takeToken(uint8_t slot) {
+  if (ratePerSecond == 0) return true;
+
+  // Refill: ratePerSecond tokens per 1000 ms, in milli-tokens
+  Bucket& bucket = buckets[slot];
+  uint32_t now = millis();
+  uint32_t elapsed = now - bucket.lastRefillMs;
+  uint32_t full = capacity(slot);
+  if (elapsed > 0) {
+    uint32_t refill = elapsed >= 60000 ? full : elapsed * ratePerSecond;
+    bucket.milliTokens = min(full, bucket.milliTokens + refill);
+    bucket.lastRefillMs = now;
+  }
+
+  if (bucket.milliTokens < 1000) return false;
+  bucket.milliTokens -= 1000;
+  return true;
+}
+
+bool AGVScheduler::admit(AGVMessage* message) {
+  AGVCommandClass cls = classify(message->text());
+  message->cls = cls;
+  message->priority = (cls <= AGV_CLASS_CONTROL) ? AGV_PRIORITY_HIGH : AGV_PRIORITY_NORMAL;
+
+  // Critical commands are never rate limited - a STOP must always get through
+  uint8_t slot = slotFor(message->source, message->client);
+  if (cls != AGV_CLASS_CRITICAL && !takeToken(slot)) {
+    sourceStats[slot].rateLimited++;
+    return false;
+  }
+  return true;
+}
+
+AGVSubmitResult AGVScheduler::enqueue(AGVMessage* message) {
+  AGVCommandClass cls = (AGVCommandClass)message->cls;
+  uint8_t slot = slotFor(message->source, message->client);
+
+  Queue& queue = queues[cls];
+  if (queue.count >= AGV_SCHED_QUEUE_LEN) {
+    classStats[cls].dropped++;
+    sourceStats[slot].dropped++;
+    return AGV_SUBMIT_QUEUE_FULL;
+  }
+
+  message->queuedUs = micros();
+  queue.items[(queue.head + queue.count) % AGV_SCHED_QUEUE_LEN] = message;
+  queue.count++;
+
+  classStats[cls].enqueued++;
+  if (queue.count > classStats[cls].maxDepth) classStats[cls].maxDepth = queue.count;
+  sourceStats[slot].accepted++;
+  return AGV_SUBMIT_ACCEPTED;
+}
+
+AGVSubmitResult AGVScheduler::submit(AGVMessage* message) {
+  if (!admit(message)) return AGV_SUBMIT_RATE_LIMITED;
+  return enqueue(message);
+}
+
+void AGVScheduler::beginPass() {
+  memset(served, 0, sizeof(served));
+}
+
+AGVMessage* AGVScheduler::next() {
+  for (uint8_t c = 0; c < AGV_CLASS_COUNT; c++) {
+    Queue& queue = queues[c];
+    if (queue.count == 0 || served[c] >= weights[c]) continue;
+
+    AGVMessage* message = queue.items[queue.head];
+    queue.head = (queue.head + 1) % AGV_SCHED_QUEUE_LEN;
+    queue.count--;
+    served[c]++;
+
+    uint32_t waitUs = micros() - message->queuedUs;
+    classStats[c].dispatched++;
+    if (waitUs > classStats[c].maxWaitUs) classStats[c].maxWaitUs = waitUs;
+    return message;
+  }
+  return nullptr;
+}
+
+uint16_t AGVScheduler::pending() const {
+  uint16_t total = 0;
+  for (uint8_t c = 0; c < AGV_CLASS_COUNT; c++) {
+    total += queues[c].count;
+  }
+  return total;
+}
+
+bool AGVScheduler::isFull(const char* command) const {
+  return queues[classify(command)].count >= AGV_SCHED_QUEUE_LEN;
+}
+
+size_t AGVScheduler::toJson(char* buffer, size_t size) const {
+  size_t pos = 0;
+  int n = snprintf(buffer, size, "{\"classes\":{");
+  if (n <= 0 || (size_t)n >= size) return 0;
+  pos += n;
+
+  for (uint8_t c = 0; c < AGV_CLASS_COUNT; c++) {
+    const AGVClassStats& st = classStats[c];
+    n = snprintf(buffer + pos, size - pos,
+                 "%s\"%s\":{\"queued\":%u,\"enqueued\":%lu,\"dispatched\":%lu,"
+                 "\"dropped\":%lu,\"maxDepth\":%u,\"maxWaitUs\":%lu}",
+                 c ? "," : "", classNames[c], queues[c].count,
+                 (unsigned long)st.enqueued, (unsigned long)st.dispatched,
+                 (unsigned long)st.dropped, st.maxDepth, (unsigned long)st.maxWaitUs);
+    if (n <= 0 || (size_t)n >= size - pos) return 0;
+    pos += n;
+  }
+
+  n = snprintf(buffer + pos, size - pos, "},\"sources\":[");
+  if (n <= 0 || (size_t)n >= size - pos) return 0;
+  pos += n;
+
+  static const char* const sourceNames[AGV_SOURCE_COUNT] = { "ws", "serial", "http", "internal", "mqtt" };
+  bool comma = false;
+  for (uint8_t slot = 0; slot < AGV_SCHED_SOURCE_SLOTS; slot++) {
+    const AGVSourceStats& st = sourceStats[slot];
+    if (st.accepted == 0 && st.rateLimited == 0 && st.dropped == 0) continue;
+
+    char name[16];
+    if (slot < AGV_SCHED_WS_SLOTS) {
+      snprintf(name, sizeof(name), "ws#%u", slot);
+    } else if (slot < AGV_SCHED_WS_SLOTS + AGV_SCHED_API_SLOTS) {
+      snprintf(name, sizeof(name), "api#%u", slot - AGV_SCHED_WS_SLOTS);
+    } else {
+      snprintf(name, sizeof(name), "%s", sourceNames[slot - AGV_SCHED_WS_SLOTS - AGV_SCHED_API_SLOTS]);
+    }
+    n = snprintf(buffer + pos, size - pos,
+                 "%s{\"source\":\"%s\",\"accepted\":%lu,\"rateLimited\":%lu,\"dropped\":%lu}",
+                 comma ? "," : "", name, (unsigned long)st.accepted,
+                 (unsigned long)st.rateLimited, (unsigned long)st.dropped);
+    if (n <= 0 || (size_t)n >= size - pos) return 0;
+    pos += n;
+    comma = true;
+  }
+
+  if (pos + 3 > size) return 0;
+  buffer[pos++] = ']';
+  buffer[pos++] = '}';
+  buffer[pos] = '\0';
+  return pos;
+}
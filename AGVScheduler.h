@@ -0,0 +1,134 @@
+#ifndef AGVSCHEDULER_H
+#define AGVSCHEDULER_H
+
+#include <Arduino.h>
+#include "AGVCoreNetworkConfig.h"
+#include "AGVMessagePool.h"
+
+// Token buckets: one per WebSocket client, one per API connection, then
+// one per remaining source
+#if AGVNET_ENABLE_API
+#define AGV_SCHED_API_SLOTS AGV_API_CLIENTS
+#else
+#define AGV_SCHED_API_SLOTS 0
+#endif
+#define AGV_SCHED_SOURCE_SLOTS (AGV_SCHED_WS_SLOTS + AGV_SCHED_API_SLOTS + AGV_SOURCE_COUNT)
+
+namespace AGVCoreNetworkLib {
+
+// Service classes, most urgent first
+typedef enum : uint8_t {
+  AGV_CLASS_CRITICAL = 0,  // STOP / ABORT / EMERGENCY - never rate limited
+  AGV_CLASS_CONTROL,       // START / PATH
+  AGV_CLASS_NORMAL,        // everything else
+  AGV_CLASS_BULK,          // background traffic
+  AGV_CLASS_COUNT
+} AGVCommandClass;
+
+typedef enum : uint8_t {
+  AGV_SUBMIT_ACCEPTED = 0,
+  AGV_SUBMIT_RATE_LIMITED,
+  AGV_SUBMIT_QUEUE_FULL
+} AGVSubmitResult;
+
+typedef struct {
+  uint32_t enqueued;
+  uint32_t dispatched;
+  uint32_t dropped;      // queue full
+  uint32_t maxWaitUs;    // longest time spent queued
+  uint16_t maxDepth;
+} AGVClassStats;
+
+typedef struct {
+  uint32_t accepted;
+  uint32_t rateLimited;
+  uint32_t dropped;
+} AGVSourceStats;
+
+// Command scheduler for the network task: one classifier for every input,
+// a bounded queue per class served by weighted round robin (each non-empty
+// class gets at least one slot per pass, so nothing starves), and a token
+// bucket per source so one flooding client cannot crowd out the others.
+// WebSocket clients and API connections get a bucket each; an API bucket
+// holds at least one full batch (AGV_API_BATCH_MAX) and refills at the
+// same rate as the others.
+// Not thread-safe - submit and dispatch from the network task only.
+class AGVScheduler {
+public:
+  AGVScheduler();
+
+  // Classifier rules: exact match ("STOP") or prefix match ("PATH:*"),
+  // case-insensitive, first match wins. Unmatched commands are NORMAL.
+  bool addRule(const char* pattern, AGVCommandClass cls);
+  void clearRules();
+  AGVCommandClass classify(const char* command) const;
+
+  // Commands served per class in each dispatch pass
+  void setWeight(AGVCommandClass cls, uint8_t weight);
+
+  // Token bucket per source (commands per second, burst size; 0 disables)
+  void setRateLimit(uint16_t perSecond, uint16_t burst);
+  void resetSource(uint8_t source, uint8_t client);
+
+  // Takes ownership of the message when accepted
+  AGVSubmitResult submit(AGVMessage* message);
+
+  // submit() in two steps, so a frame can be refused before any work is
+  // spent on it: admit() classifies and takes a token (false = rate
+  // limited), enqueue() queues an admitted message.
+  bool admit(AGVMessage* message);
+  AGVSubmitResult enqueue(AGVMessage* message);
+
+  // Weighted round robin: call beginPass() once per loop, then next()
+  // until it returns nullptr. The caller owns the returned message.
+  void beginPass();
+  AGVMessage* next();
+  uint16_t pending() const;
+
+  // True if the class queue of this command has no room left
+  bool isFull(const char* command) const;
+
+  void getClassStats(AGVCommandClass cls, AGVClassStats& out) const { out = classStats[cls]; }
+  size_t toJson(char* buffer, size_t size) const;
+
+private:
+  typedef struct {
+    char pattern[16];
+    uint8_t length;
+    bool prefix;
+    AGVCommandClass cls;
+  } Rule;
+
+  typedef struct {
+    AGVMessage* items[AGV_SCHED_QUEUE_LEN];
+    uint8_t head;
+    uint8_t count;
+  } Queue;
+
+  typedef struct {
+    uint32_t milliTokens;
+    uint32_t lastRefillMs;
+  } Bucket;
+
+  Rule rules[AGV_SCHED_MAX_RULES];
+  uint8_t ruleCount = 0;
+
+  Queue queues[AGV_CLASS_COUNT] = {};
+  uint8_t weights[AGV_CLASS_COUNT] = { 8, 4, 2, 1 };
+  uint8_t served[AGV_CLASS_COUNT] = {};
+
+  uint16_t ratePerSecond = 20;
+  uint16_t rateBurst = 10;
+  Bucket buckets[AGV_SCHED_SOURCE_SLOTS] = {};
+
+  AGVClassStats classStats[AGV_CLASS_COUNT] = {};
+  AGVSourceStats sourceStats[AGV_SCHED_SOURCE_SLOTS] = {};
+
+  static uint8_t slotFor(uint8_t source, uint8_t client);
+  uint32_t capacity(uint8_t slot) const;
+  bool takeToken(uint8_t slot);
+};
+
+} // namespace AGVCoreNetworkLib
+
+#endif
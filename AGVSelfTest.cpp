@@ -0,0 +1,261 @@
+#include "AGVSelfTest.h"
+#include <freertos/task.h>
+#include <esp_timer.h>
+#include <stdarg.h>
+
+using namespace AGVCoreNetworkLib;
+
+#if AGVNET_ENABLE_SELFTEST
+
+// Requests to the helper task; anything >= 0 is a send timestamp
+#define AGV_PEER_LOCK -1
+#define AGV_PEER_QUIT -2
+#define AGV_PEER_TIMEOUT_MS 100
+
+// ---- Series ----
+
+uint32_t AGVBenchSeries::summarize() {
+  // Insertion sort: at most AGV_SELFTEST_SAMPLES, mostly near-sorted timings
+  for (uint16_t i = 1; i < count; i++) {
+    uint32_t value = samples[i];
+    uint16_t j = i;
+    while (j > 0 && samples[j - 1] > value) {
+      samples[j] = samples[j - 1];
+      j--;
+    }
+    samples[j] = value;
+  }
+  return count ? samples[count / 2] : 0;
+}
+
+// Expects summarize() to have run
+size_t AGVBenchSeries::toJson(const char* name, char* buffer, size_t size) const {
+  int written;
+  if (count == 0) {
+    written = snprintf(buffer, size, "\"%s\":{\"n\":0}", name);
+  } else {
+    uint16_t p99 = (uint16_t)((count * 99 + 99) / 100 - 1);
+    written = snprintf(buffer, size,
+                       "\"%s\":{\"n\":%u,\"min\":%lu,\"median\":%lu,\"p99\":%lu,\"max\":%lu}",
+                       name, count, (unsigned long)samples[0], (unsigned long)samples[count / 2],
+                       (unsigned long)samples[p99], (unsigned long)samples[count - 1]);
+  }
+  return (written > 0 && (size_t)written < size) ? (size_t)written : 0;
+}
+
+// ---- Suite ----
+
+const char* AGVSelfTest::phaseName(AGVBenchPhase phase) {
+  switch (phase) {
+    case AGV_BENCH_IDLE:        return "idle";
+    case AGV_BENCH_MUTEX:       return "mutexRoundTrip";
+    case AGV_BENCH_QUEUE:       return "queueHandoff";
+    case AGV_BENCH_PARSE:       return "commandParse";
+    case AGV_BENCH_BROADCAST:   return "broadcastPerClient";
+    case AGV_BENCH_PAGE:        return "pageSend";
+    case AGV_BENCH_PREFS_WRITE: return "prefsWrite";
+    case AGV_BENCH_PREFS_READ:  return "prefsRead";
+    case AGV_BENCH_DONE:        return "done";
+  }
+  return "unknown";
+}
+
+uint16_t AGVSelfTest::target() const {
+  switch (phase) {
+    case AGV_BENCH_BROADCAST:
+    case AGV_BENCH_PREFS_READ:  return 20;
+    case AGV_BENCH_PREFS_WRITE: return 10;  // flash wear: keep it short
+    default:                    return AGV_SELFTEST_SAMPLES;
+  }
+}
+
+bool AGVSelfTest::start(SemaphoreHandle_t mutex) {
+  if (running()) return false;
+
+  lock = mutex;
+  reportLength = 0;
+  report[0] = '\0';
+
+#if portNUM_PROCESSORS > 1
+  BaseType_t peerCore = AGVNetConfig::taskCore == 0 ? 1 : 0;
+  bool crossCore = true;
+#else
+  BaseType_t peerCore = 0;
+  bool crossCore = false;
+#endif
+
+  append("{\"chip\":\"%s\",\"rev\":%u,\"cpuMHz\":%lu,\"sdk\":\"%s\",\"build\":\"%s %s\","
+         "\"crossCore\":%s,\"unit\":\"ns\",\"tests\":{",
+         ESP.getChipModel(), ESP.getChipRevision(), (unsigned long)ESP.getCpuFreqMHz(),
+         ESP.getSdkVersion(), __DATE__, __TIME__, crossCore ? "true" : "false");
+
+  // Helper runs above the Arduino loop task so we time the primitive,
+  // not a wait for the other core's time slice
+  toPeer = xQueueCreate(1, sizeof(int64_t));
+  fromPeer = xQueueCreate(1, sizeof(int64_t));
+  peerRunning = toPeer && fromPeer &&
+                xTaskCreatePinnedToCore(peerTask, "AGVBenchPeer", 2048, this,
+                                        AGVNetConfig::taskPriority + 1, nullptr, peerCore) == pdPASS;
+
+  phase = AGV_BENCH_MUTEX;
+  if (!peerRunning) {
+    skip("no helper task");
+    skip("no helper task");
+  }
+  return true;
+}
+
+void AGVSelfTest::record(uint32_t ns) {
+  if (!running()) return;
+  series.add(ns);
+  if (series.size() >= target()) {
+    series.summarize();
+    if (reportLength < sizeof(report)) {
+      size_t n = series.toJson(phaseName(phase), report + reportLength, sizeof(report) - reportLength);
+      reportLength += n;
+    }
+    advance();
+  }
+}
+
+void AGVSelfTest::skip(const char* reason) {
+  if (!running()) return;
+  append("\"%s\":{\"n\":0,\"skipped\":\"%s\"}", phaseName(phase), reason);
+  advance();
+}
+
+void AGVSelfTest::advance() {
+  series.clear();
+  phase = (AGVBenchPhase)(phase + 1);
+  if (phase != AGV_BENCH_DONE) {
+    append(",");
+  }
+
+  if (phase == AGV_BENCH_PARSE) {
+    stopPeer();  // cross-core phases are over
+  }
+  if (phase == AGV_BENCH_PAGE) {
+    completePage();
+  }
+  if (phase == AGV_BENCH_DONE) {
+    stopPeer();
+    append("}}");
+  }
+}
+
+// Page timings come from real dashboard loads: send_P blocks on the client's
+// TCP window, so only a real browser gives a meaningful throughput
+void AGVSelfTest::completePage() {
+  if (pageCount == 0) {
+    skip("load /dashboard first");
+    return;
+  }
+  for (uint8_t i = 0; i < pageCount; i++) {
+    series.add(pageNs[i]);
+  }
+  uint32_t median = series.summarize();
+  size_t n = series.toJson(phaseName(phase), report + reportLength, sizeof(report) - reportLength);
+  if (n > 1) {
+    // Reopen the object to add size and throughput
+    reportLength += n - 1;
+    append(",\"bytes\":%u,\"kBps\":%lu}", (unsigned)pageBytes,
+           median ? (unsigned long)((uint64_t)pageBytes * 1000000000ULL / median / 1024) : 0UL);
+  }
+  advance();
+}
+
+void AGVSelfTest::notePageSend(uint32_t ns, size_t bytes) {
+  pageNs[pageNext] = ns;
+  pageNext = (pageNext + 1) % AGV_SELFTEST_PAGE_SAMPLES;
+  if (pageCount < AGV_SELFTEST_PAGE_SAMPLES) pageCount++;
+  pageBytes = bytes;
+}
+
+bool AGVSelfTest::peerLock(uint32_t& ns) {
+  if (!peerRunning) return false;
+  int64_t request = AGV_PEER_LOCK;
+  int64_t reply;
+  xQueueReset(fromPeer);  // a late answer to a timed-out request
+  int64_t t0 = esp_timer_get_time();
+  if (xQueueSend(toPeer, &request, pdMS_TO_TICKS(AGV_PEER_TIMEOUT_MS)) != pdPASS ||
+      xQueueReceive(fromPeer, &reply, pdMS_TO_TICKS(AGV_PEER_TIMEOUT_MS)) != pdPASS || reply < 0) {
+    return false;
+  }
+  ns = (uint32_t)((esp_timer_get_time() - t0) * 1000);
+  return true;
+}
+
+bool AGVSelfTest::peerHandoff(uint32_t& ns) {
+  if (!peerRunning) return false;
+  int64_t reply;
+  xQueueReset(fromPeer);
+  int64_t request = esp_timer_get_time();
+  if (xQueueSend(toPeer, &request, pdMS_TO_TICKS(AGV_PEER_TIMEOUT_MS)) != pdPASS ||
+      xQueueReceive(fromPeer, &reply, pdMS_TO_TICKS(AGV_PEER_TIMEOUT_MS)) != pdPASS || reply < 0) {
+    return false;
+  }
+  ns = (uint32_t)(reply * 1000);
+  return true;
+}
+
+void AGVSelfTest::stopPeer() {
+  if (peerRunning) {
+    int64_t request = AGV_PEER_QUIT;
+    int64_t reply;
+    peerRunning = false;
+    if (xQueueSend(toPeer, &request, pdMS_TO_TICKS(AGV_PEER_TIMEOUT_MS)) != pdPASS ||
+        xQueueReceive(fromPeer, &reply, pdMS_TO_TICKS(AGV_PEER_TIMEOUT_MS)) != pdPASS) {
+      // Helper stuck: leak its queues rather than free them under it
+      toPeer = nullptr;
+      fromPeer = nullptr;
+      return;
+    }
+  }
+  if (toPeer) {
+    vQueueDelete(toPeer);
+    toPeer = nullptr;
+  }
+  if (fromPeer) {
+    vQueueDelete(fromPeer);
+    fromPeer = nullptr;
+  }
+}
+
+void AGVSelfTest::peerTask(void* parameter) {
+  // Own copies: the suite forgets the queues if this task stops answering
+  AGVSelfTest* test = (AGVSelfTest*)parameter;
+  QueueHandle_t requests = test->toPeer;
+  QueueHandle_t replies = test->fromPeer;
+  SemaphoreHandle_t lock = test->lock;
+
+  int64_t request;
+  while (xQueueReceive(requests, &request, portMAX_DELAY) == pdPASS) {
+    int64_t reply = 0;
+    if (request >= 0) {
+      reply = esp_timer_get_time() - request;
+    } else if (request == AGV_PEER_LOCK) {
+      if (xSemaphoreTake(lock, pdMS_TO_TICKS(AGV_PEER_TIMEOUT_MS)) == pdPASS) {
+        xSemaphoreGive(lock);
+      } else {
+        reply = -1;
+      }
+    }
+    xQueueSend(replies, &reply, portMAX_DELAY);
+    if (request == AGV_PEER_QUIT) break;
+  }
+  vTaskDelete(nullptr);
+}
+
+void AGVSelfTest::append(const char* format, ...) {
+  if (reportLength >= sizeof(report)) return;
+  va_list args;
+  va_start(args, format);
+  int written = vsnprintf(report + reportLength, sizeof(report) - reportLength, format, args);
+  va_end(args);
+  if (written > 0) {
+    reportLength += (size_t)written < sizeof(report) - reportLength ? (size_t)written
+                                                                    : sizeof(report) - reportLength - 1;
+  }
+}
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef AGVSELFTEST_H
+#define AGVSELFTEST_H
+
+#include <Arduino.h>
+#include "AGVCoreNetworkConfig.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+
+#define AGV_SELFTEST_PAGE_SAMPLES 8
+
+namespace AGVCoreNetworkLib {
+
+// Benchmarks in the order they run
+typedef enum : uint8_t {
+  AGV_BENCH_IDLE = 0,
+  AGV_BENCH_MUTEX,         // other core takes and releases the commands lock, round trip
+  AGV_BENCH_QUEUE,         // queue send here -> receive on the other core, one way
+  AGV_BENCH_PARSE,         // pool copy + envelope checks + classifier
+  AGV_BENCH_BROADCAST,     // broadcastTXT, per connected client
+  AGV_BENCH_PAGE,          // send_P of the dashboard (timed on real page loads)
+  AGV_BENCH_PREFS_WRITE,   // Preferences put incl. commit
+  AGV_BENCH_PREFS_READ,
+  AGV_BENCH_DONE
+} AGVBenchPhase;
+
+// Fixed-capacity sample set reported as min / median / p99 / max
+class AGVBenchSeries {
+public:
+  void clear() { count = 0; }
+  void add(uint32_t ns) { if (count < AGV_SELFTEST_SAMPLES) samples[count++] = ns; }
+  uint16_t size() const { return count; }
+
+  // Sorts the samples; returns the median (0 when empty)
+  uint32_t summarize();
+  size_t toJson(const char* name, char* buffer, size_t size) const;
+
+private:
+  uint32_t samples[AGV_SELFTEST_SAMPLES];
+  uint16_t count = 0;
+};
+
+// On-device benchmark suite. Runs one sample per network loop pass, so the
+// vehicle keeps servicing heartbeats and commands while it is measured.
+// The network task drives the phases; cross-core measurements use a helper
+// task pinned to the other core for the duration of the run.
+class AGVSelfTest {
+public:
+  // False while a run is in progress
+  bool start(SemaphoreHandle_t mutex);
+  bool running() const { return phase != AGV_BENCH_IDLE && phase != AGV_BENCH_DONE; }
+  bool finished() const { return phase == AGV_BENCH_DONE; }
+  AGVBenchPhase current() const { return phase; }
+  static const char* phaseName(AGVBenchPhase phase);
+
+  // Samples wanted for the current phase
+  uint16_t target() const;
+
+  // Add a sample (nanoseconds); the phase completes once target() is reached
+  void record(uint32_t ns);
+  void skip(const char* reason);
+
+  // One cross-core exchange with the helper task; false if it timed out
+  bool peerLock(uint32_t& ns);
+  bool peerHandoff(uint32_t& ns);
+
+  // Dashboard send_P timings, kept between runs
+  void notePageSend(uint32_t ns, size_t bytes);
+
+  // Report JSON; valid once finished()
+  const char* result() const { return report; }
+
+private:
+  AGVBenchPhase phase = AGV_BENCH_IDLE;
+  AGVBenchSeries series;
+  char report[AGV_SELFTEST_JSON_MAX];
+  size_t reportLength = 0;
+
+  uint32_t pageNs[AGV_SELFTEST_PAGE_SAMPLES] = {};
+  uint8_t pageCount = 0;
+  uint8_t pageNext = 0;
+  size_t pageBytes = 0;
+
+  SemaphoreHandle_t lock = nullptr;
+  QueueHandle_t toPeer = nullptr;
+  QueueHandle_t fromPeer = nullptr;
+  bool peerRunning = false;
+
+  void append(const char* format, ...);
+  void advance();
+  void completePage();
+  void stopPeer();
+  static void peerTask(void* parameter);
+};
+
+} // namespace AGVCoreNetworkLib
+
+#endif
@@ -0,0 +1,216 @@
+#include "AGVTelemetry.h"
+#include <freertos/FreeRTOS.h>
+#include <math.h>
+
+using namespace AGVCoreNetworkLib;
+
+// Serialises key creation only; value writes stay lock-free
+static portMUX_TYPE telemetryCreateMux = portMUX_INITIALIZER_UNLOCKED;
+
+bool AGVTelemetry::setInt(const char* key, int32_t value) {
+  Entry* entry = acquire(key);
+  if (!entry) return false;
+  AGVTelemetryValue v;
+  v.type = AGV_TELEM_INT;
+  v.i = value;
+  write(entry, v);
+  return true;
+}
+
+bool AGVTelemetry::setFloat(const char* key, float value) {
+  Entry* entry = acquire(key);
+  if (!entry) return false;
+  AGVTelemetryValue v;
+  v.type = AGV_TELEM_FLOAT;
+  v.f = value;
+  write(entry, v);
+  return true;
+}
+
+bool AGVTelemetry::setText(const char* key, const char* value) {
+  Entry* entry = acquire(key);
+  if (!entry) return false;
+  AGVTelemetryValue v;
+  v.type = AGV_TELEM_TEXT;
+  strncpy(v.text, value ? value : "", sizeof(v.text) - 1);
+  v.text[sizeof(v.text) - 1] = '\0';
+  write(entry, v);
+  return true;
+}
+
+bool AGVTelemetry::get(const char* key, AGVTelemetryValue& out) const {
+  int slot = findSlot(key);
+  if (slot < 0) return false;
+  return read((uint8_t)slot, out);
+}
+
+bool AGVTelemetry::read(uint8_t slot, AGVTelemetryValue& out) const {
+  if (slot >= count()) return false;
+  const Entry& entry = entries[slot];
+
+  uint32_t before, after;
+  do {
+    before = __atomic_load_n(&entry.seq, __ATOMIC_ACQUIRE);
+    if (before & 1) continue;  // writer active
+    memcpy(&out, (const void*)&entry.value, sizeof(out));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    after = __atomic_load_n(&entry.seq, __ATOMIC_RELAXED);
+    if (before == after) break;
+  } while (true);
+
+  return out.type != AGV_TELEM_NONE;
+}
+
+uint8_t AGVTelemetry::count() const {
+  return __atomic_load_n(&entryCount, __ATOMIC_ACQUIRE);
+}
+
+const char* AGVTelemetry::keyAt(uint8_t slot) const {
+  return slot < count() ? entries[slot].key : nullptr;
+}
+
+uint32_t AGVTelemetry::version() const {
+  return __atomic_load_n(&writeVersion, __ATOMIC_ACQUIRE);
+}
+
+int AGVTelemetry::findSlot(const char* key) const {
+  if (!key) return -1;
+  uint8_t n = count();
+  for (uint8_t i = 0; i < n; i++) {
+    if (strncmp(entries[i].key, key, AGV_TELEMETRY_KEY_LEN) == 0) return i;
+  }
+  return -1;
+}
+
+AGVTelemetry::Entry* AGVTelemetry::acquire(const char* key) {
+  if (!key || !key[0] || strlen(key) >= AGV_TELEMETRY_KEY_LEN) return nullptr;
+
+  int slot = findSlot(key);
+  if (slot >= 0) return &entries[slot];
+
+  // New key: fill the slot completely before publishing the new count
+  Entry* entry = nullptr;
+  portENTER_CRITICAL(&telemetryCreateMux);
+  slot = findSlot(key);
+  if (slot >= 0) {
+    entry = &entries[slot];
+  } else if (entryCount < AGV_TELEMETRY_MAX_KEYS) {
+    entry = &entries[entryCount];
+    strncpy(entry->key, key, AGV_TELEMETRY_KEY_LEN - 1);
+    entry->seq = 0;
+    entry->value.type = AGV_TELEM_NONE;
+    __atomic_store_n(&entryCount, (uint8_t)(entryCount + 1), __ATOMIC_RELEASE);
+  }
+  portEXIT_CRITICAL(&telemetryCreateMux);
+
+  if (!entry) {
+    Serial.printf("[TELEM] ❌ Registry full, dropping key '%s'\n", key);
+  }
+  return entry;
+}
+
+void AGVTelemetry::write(Entry* entry, const AGVTelemetryValue& value) {
+  uint32_t seq = entry->seq;
+  __atomic_store_n(&entry->seq, seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  memcpy((void*)&entry->value, &value, sizeof(value));
+  __atomic_store_n(&entry->seq, seq + 2, __ATOMIC_RELEASE);
+  __atomic_add_fetch(&writeVersion, 1, __ATOMIC_RELEASE);
+}
+
+// JSON string with escaping (text values and keys)
+size_t AGVTelemetry::formatString(const char* text, char* buffer, size_t size) {
+  size_t pos = 0;
+  if (pos + 1 >= size) return 0;
+  buffer[pos++] = '"';
+  for (const char* p = text; *p; p++) {
+    char c = *p;
+    if (c == '"' || c == '\\') {
+      if (pos + 2 >= size) return 0;
+      buffer[pos++] = '\\';
+      buffer[pos++] = c;
+    } else if ((uint8_t)c < 0x20) {
+      if (pos + 6 >= size) return 0;
+      pos += snprintf(buffer + pos, size - pos, "\\u%04x", c);
+    } else {
+      if (pos + 1 >= size) return 0;
+      buffer[pos++] = c;
+    }
+  }
+  if (pos + 2 > size) return 0;
+  buffer[pos++] = '"';
+  buffer[pos] = '\0';
+  return pos;
+}
+
+size_t AGVTelemetry::formatValue(const AGVTelemetryValue& value, char* buffer, size_t size) {
+  int n = 0;
+  switch (value.type) {
+    case AGV_TELEM_INT:
+      n = snprintf(buffer, size, "%ld", (long)value.i);
+      break;
+    case AGV_TELEM_FLOAT:
+      if (isfinite(value.f)) {
+        n = snprintf(buffer, size, "%.3f", value.f);
+      } else {
+        n = snprintf(buffer, size, "null");
+      }
+      break;
+    case AGV_TELEM_TEXT:
+      return formatString(value.text, buffer, size);
+    default:
+      n = snprintf(buffer, size, "null");
+      break;
+  }
+  return (n > 0 && (size_t)n < size) ? n : 0;
+}
+
+size_t AGVTelemetry::appendPair(uint8_t slot, char* buffer, size_t size, bool comma) const {
+  AGVTelemetryValue value;
+  if (!read(slot, value)) return 0;
+
+  size_t n = 0;
+  if (comma) {
+    if (size < 2) return 0;
+    buffer[n++] = ',';
+  }
+  size_t k = formatString(entries[slot].key, buffer + n, size - n);
+  if (!k || n + k + 1 >= size) return 0;
+  n += k;
+  buffer[n++] = ':';
+  size_t v = formatValue(value, buffer + n, size - n);
+  return v ? n + v : 0;
+}
+
+size_t AGVTelemetry::toJson(char* buffer, size_t size) const {
+  if (size < 3) return 0;
+  size_t pos = 0;
+  buffer[pos++] = '{';
+
+  bool comma = false;
+  uint8_t n = count();
+  for (uint8_t i = 0; i < n; i++) {
+    size_t len = appendPair(i, buffer + pos, size - pos - 1, comma);
+    if (len == 0) {
+      if (entries[i].value.type == AGV_TELEM_NONE) continue;
+      return 0;
+    }
+    pos += len;
+    comma = true;
+  }
+
+  buffer[pos++] = '}';
+  buffer[pos] = '\0';
+  return pos;
+}
+
+size_t AGVTelemetry::keyToJson(const char* key, char* buffer, size_t size) const {
+  int slot = findSlot(key);
+  if (slot < 0 || size < 3) return 0;
+  size_t len = appendPair((uint8_t)slot, buffer + 1, size - 2, false);
+  if (len == 0) return 0;
+  buffer[0] = '{';
+  buffer[len + 1] = '}';
+  buffer[len + 2] = '\0';
+  return len + 2;
+}
@@ -0,0 +1,75 @@
+#ifndef AGVTELEMETRY_H
+#define AGVTELEMETRY_H
+
+#include <Arduino.h>
+#include "AGVCoreNetworkConfig.h"
+
+#define AGV_TELEMETRY_JSON_MAX 1024
+
+namespace AGVCoreNetworkLib {
+
+typedef enum : uint8_t {
+  AGV_TELEM_NONE = 0,
+  AGV_TELEM_INT,
+  AGV_TELEM_FLOAT,
+  AGV_TELEM_TEXT
+} AGVTelemetryType;
+
+// Typed telemetry value (copied out of the registry by readers)
+typedef struct {
+  AGVTelemetryType type;
+  union {
+    int32_t i;
+    float f;
+    char text[AGV_TELEMETRY_TEXT_LEN];
+  };
+} AGVTelemetryValue;
+
+// Key/value telemetry store shared between the control loop and the network task.
+// Each key is guarded by its own seqlock: the writer never blocks and readers
+// retry if they overlap a write. Each key must have a single writer
+// (typically Core 1); keys are created on first write and never removed.
+//
+// Suggested keys: "battery", "pose_x", "pose_y", "pose_h", "mode", "step", "errors"
+class AGVTelemetry {
+public:
+  // Writer side
+  bool setInt(const char* key, int32_t value);
+  bool setFloat(const char* key, float value);
+  bool setText(const char* key, const char* value);
+
+  // Reader side (lock-free)
+  bool get(const char* key, AGVTelemetryValue& out) const;
+  bool read(uint8_t slot, AGVTelemetryValue& out) const;
+  uint8_t count() const;
+  const char* keyAt(uint8_t slot) const;
+
+  // Incremented on every write to any key
+  uint32_t version() const;
+
+  // JSON rendering into caller-provided buffers (returns length, 0 on overflow)
+  size_t toJson(char* buffer, size_t size) const;
+  size_t keyToJson(const char* key, char* buffer, size_t size) const;
+  static size_t formatValue(const AGVTelemetryValue& value, char* buffer, size_t size);
+
+private:
+  typedef struct {
+    char key[AGV_TELEMETRY_KEY_LEN];
+    uint32_t seq;  // odd while a write is in progress
+    AGVTelemetryValue value;
+  } Entry;
+
+  Entry entries[AGV_TELEMETRY_MAX_KEYS] = {};
+  uint8_t entryCount = 0;
+  uint32_t writeVersion = 0;
+
+  int findSlot(const char* key) const;
+  Entry* acquire(const char* key);
+  void write(Entry* entry, const AGVTelemetryValue& value);
+  size_t appendPair(uint8_t slot, char* buffer, size_t size, bool comma) const;
+  static size_t formatString(const char* text, char* buffer, size_t size);
+};
+
+} // namespace AGVCoreNetworkLib
+
+#endif
@@ -0,0 +1,78 @@
+#include "AGVWsServer.h"
+
+using namespace AGVCoreNetworkLib;
+
+#if AGVNET_ENABLE_WEBSOCKET
+
+static_assert(AGV_WS_HANDSHAKES_MAX < WEBSOCKETS_SERVER_CLIENT_MAX,
+              "AGV_WS_HANDSHAKES_MAX must leave a WebSocket client slot for operators");
+
+void AGVWsServer::loop() {
+  if (!_runnning) return;
+  admitClients(millis());
+  WebSocketsServerCore::loop();
+  expireHandshakes(millis());
+}
+
+bool AGVWsServer::inHandshake(uint8_t num) const {
+  const WSclient_t& client = _clients[num];
+  return client.tcp && client.status != WSC_NOT_CONNECTED && client.status != WSC_CONNECTED;
+}
+
+// Replaces WebSocketsServer::handleNewClients(): the same accept loop, with
+// the handshake limits checked before a client slot is taken
+void AGVWsServer::admitClients(uint32_t nowMs) {
+  while (_server->hasClient()) {
+    WiFiClient* tcp = new WiFiClient(_server->available());
+    if (!tcp) return;
+
+    IPAddress ip = tcp->remoteIP();
+    uint8_t open = 0;
+    uint8_t fromIp = 0;
+    for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+      if (!inHandshake(num)) continue;
+      open++;
+      if (_clients[num].tcp->remoteIP() == ip) fromIp++;
+    }
+
+    WSclient_t* client = nullptr;
+    if (open < AGV_WS_HANDSHAKES_MAX && fromIp < AGV_WS_HANDSHAKES_PER_IP) {
+      client = newClient(tcp);
+    }
+    if (!client) {
+      stats.refused++;
+      Serial.printf("[WS] ❌ Connection from %d.%d.%d.%d refused (%u handshakes open)\n",
+                    ip[0], ip[1], ip[2], ip[3], open);
+      tcp->stop();
+      delete tcp;
+      continue;
+    }
+    startedMs[client->num] = nowMs;
+    stats.admitted++;
+  }
+}
+
+void AGVWsServer::expireHandshakes(uint32_t nowMs) {
+  for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+    if (!inHandshake(num) || nowMs - startedMs[num] < AGV_WS_HANDSHAKE_MS) continue;
+    stats.timedOut++;
+    Serial.printf("[WS] ❌ Client #%u handshake timed out\n", num);
+    _clients[num].tcp->stop();  // the library frees the slot on its next pass
+  }
+}
+
+size_t AGVWsServer::toJson(char* buffer, size_t size) const {
+  uint8_t open = 0;
+  for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+    if (inHandshake(num)) open++;
+  }
+  int written = snprintf(buffer, size,
+                         "{\"handshakes\":%u,\"limit\":%u,\"perIp\":%u,\"admitted\":%lu,"
+                         "\"refused\":%lu,\"timedOut\":%lu}",
+                         open, (unsigned)AGV_WS_HANDSHAKES_MAX, (unsigned)AGV_WS_HANDSHAKES_PER_IP,
+                         (unsigned long)stats.admitted, (unsigned long)stats.refused,
+                         (unsigned long)stats.timedOut);
+  return (written > 0 && (size_t)written < size) ? (size_t)written : 0;
+}
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef AGVWSSERVER_H
+#define AGVWSSERVER_H
+
+#include <Arduino.h>
+#include "AGVCoreNetworkConfig.h"
+
+#if AGVNET_ENABLE_WEBSOCKET
+#include <WebSocketsServer.h>
+
+namespace AGVCoreNetworkLib {
+
+typedef struct {
+  uint32_t admitted;      // sockets given a client slot for their handshake
+  uint32_t refused;       // closed at accept: too many handshakes open
+  uint32_t timedOut;      // closed: handshake not finished in time
+} AGVWsHandshakeStats;
+
+// WebSocketsServer that rations client slots during the upgrade handshake.
+//
+// The session token arrives in the upgrade headers, so it can only be
+// checked once the library has given the socket a client slot. New sockets
+// are therefore accepted here first: a socket is closed without a slot if
+// its address already has AGV_WS_HANDSHAKES_PER_IP handshakes open, or if
+// AGV_WS_HANDSHAKES_MAX are open in total, and a handshake that has not
+// completed within AGV_WS_HANDSHAKE_MS is closed. Silent or unauthenticated
+// sockets can then hold at most AGV_WS_HANDSHAKES_MAX slots, each briefly,
+// and the remaining slots stay free for operators with a valid token.
+//
+// loop() hides the base class loop(), so call it through this type.
+// Not thread-safe - use from the network task only.
+class AGVWsServer : public WebSocketsServer {
+public:
+  AGVWsServer(uint16_t port, const String& origin, const String& protocol)
+    : WebSocketsServer(port, origin, protocol) {}
+
+  void loop();
+
+  size_t toJson(char* buffer, size_t size) const;
+
+private:
+  uint32_t startedMs[WEBSOCKETS_SERVER_CLIENT_MAX] = {};
+  AGVWsHandshakeStats stats = {};
+
+  bool inHandshake(uint8_t num) const;
+  void admitClients(uint32_t nowMs);
+  void expireHandshakes(uint32_t nowMs);
+};
+
+} // namespace AGVCoreNetworkLib
+
+#endif
+#endif
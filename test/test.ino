@@ -2,14 +2,15 @@
 
 // 1. Command handler function (called when commands arrive)
 void onCommandReceived(const char* command, uint8_t source, uint8_t priority) {
-  // source: 0 = web interface, 1 = serial monitor
-  // priority: 0 = normal, 1 = emergency (STOP/ABORT)
+  using namespace AGVCoreNetworkLib;
+  // source: AGV_SOURCE_WEBSOCKET, _SERIAL, _HTTP or _MQTT (_INTERNAL marks library messages)
+  // priority: AGV_PRIORITY_HIGH for STOP/ABORT/EMERGENCY and START/PATH, else AGV_PRIORITY_NORMAL
   
   Serial.printf("[AGV] Processing command: %s (source=%d, priority=%d)\n", 
                 command, source, priority);
   
-  // Example: Emergency stop has highest priority
-  if (priority == 1 && (strstr(command, "STOP") || strstr(command, "ABORT"))) {
+  // Example: Emergency stop (high priority, but so are START and PATH)
+  if (priority == AGV_PRIORITY_HIGH && (strstr(command, "STOP") || strstr(command, "ABORT"))) {
     Serial.println("!!! EMERGENCY STOP ACTIVATED !!!");
     // Your emergency stop code here
   }
@@ -26,19 +27,95 @@ void onCommandReceived(const char* command, uint8_t source, uint8_t priority) {
   agvNetwork.sendStatus(status.c_str());
 }
 
+#if AGVNET_ENABLE_DISPATCH
+// Per-verb handler: "PATH:1,1,3,2:ONCE" arrives with args "1,1,3,2:ONCE".
+// Registered for Core 1, it runs inside loop() via runQueuedCommands().
+void onPath(const char* command, const char* args, uint8_t source, uint8_t priority) {
+  Serial.printf("[AGV] Path %s (source=%d)\n", args, source);
+  // Your path execution code here
+}
+#endif
+
+// Batch mission upload (POST /mission or WebSocket binary)
+void onMissionReceived(const AGVCoreNetworkLib::AGVMission& mission) {
+  Serial.printf("[AGV] Mission #%lu: %u waypoints, %u run(s)\n",
+                (unsigned long)mission.id, mission.count, mission.loops);
+  // Your route execution code here (copy the waypoints if kept beyond the next upload)
+}
+
+// Control link supervision (WebSocket heartbeats). Called on the network
+// task (Core 0): only flag the change, loop() on Core 1 acts on it.
+volatile bool controlLinkLost = false;
+
+void onLinkChanged(bool linkUp, uint8_t operators) {
+  controlLinkLost = !linkUp;
+}
+
 void setup() {
   Serial.begin(115200);
   delay(1000);
   
+  // Optional: fleet key for zero-touch provisioning - new vehicles then take
+  // WiFi and name from tools/agv_provision.py instead of the setup portal
+  // agvNetwork.setProvisioningKey("fleet-provisioning-key");
+  
   // 2. Initialize network system with device name and credentials
   agvNetwork.begin("factory_agv_01", "admin", "agv_secure_pass");
   
   // 3. Register command callback (connects communication to your AGV logic)
   agvNetwork.setCommandCallback(onCommandReceived);
   
+#if AGVNET_ENABLE_DISPATCH
+  // Optional: route verbs to their own handlers - O(1) lookup, per-verb
+  // timing in /stats; unregistered verbs still reach the callback
+  agvNetwork.on("PATH", onPath, AGVCoreNetworkLib::AGV_CONTEXT_CORE1);
+#endif
+  
+  // Optional: report operator link loss within 300 ms (ping every 100 ms)
+  agvNetwork.setHeartbeat(100, 300);
+  agvNetwork.setLinkCallback(onLinkChanged);
+  agvNetwork.setMissionCallback(onMissionReceived);
+  
+  // Optional: MES over MQTT - commands on agv/factory_agv_01/cmd, statuses
+  // batched every 100 ms to agv/factory_agv_01/status (tools/mqtt_smoke.sh)
+  // agvNetwork.beginMqtt("mqtt://192.168.1.10:1883");
+  
+  // Optional: bumper / light-curtain interrupts publish directly, no polling
+  //   void IRAM_ATTR onBumper() { agvNetwork.broadcastEmergencyFromISR("BUMPER HIT"); }
+  //   attachInterrupt(digitalPinToInterrupt(27), onBumper, FALLING);
+  
+  // Optional: plan PATH commands on this hub - with a map loaded they arrive
+  // as missions (corner waypoints) instead of raw PATH commands
+  // agvNetwork.loadMap("..........\n.####.....\n......##..\n");
+  
+  // Optional: resume after a reset (needs the "agvjournal" partition from
+  // tools/partitions_journal.csv); report progress with setMissionProgress()
+#if AGVNET_ENABLE_JOURNAL
+  uint16_t loop, waypoint;
+  if (const AGVCoreNetworkLib::AGVMission* mission = agvNetwork.getRecoveredMission(loop, waypoint)) {
+    Serial.printf("[AGV] Resuming mission #%lu at loop %u, waypoint %u\n",
+                  (unsigned long)mission->id, loop, waypoint);
+  }
+#endif
+  
+  // Optional: fleet discovery (tools/agv_scan.py) shows this version and a
+  // summary of the "mode", "battery" and "errors" telemetry keys
+  // agvNetwork.setFirmwareVersion("1.4.2");
+  
+  // Optional: capture this session for tools/agv_replay.py (or
+  // POST /capture?action=start, then GET /capture)
+  // agvNetwork.startCapture();
+  
+  // Optional: RAM/flash reserved by this build (see AGVCoreNetworkConfig.h)
+  agvNetwork.printFootprint();
+  
   Serial.println("\n✅ AGV system ready!");
   Serial.println("🌐 Web interface: http://factory_agv_01.local");
+  Serial.println("🚚 Fleet overview: http://factory_agv_01.local/fleet");
+  Serial.println("👀 Read-only viewers: EventSource('http://factory_agv_01.local/events')");
   Serial.println("⌨️  Serial commands: START, STOP, PATH:1,1,3,2:ONCE, etc.");
+  Serial.println("⏱️  Timed: AT +500000 START (in 0.5 s)");
+  Serial.println("🧪 Self-test: SELFTEST (serial) or the dashboard Maintenance button");
   Serial.println("📱 Connect to 'AGV_Controller_Network' for initial setup");
 }
 
@@ -46,6 +123,18 @@ void loop() {
   // 4. Nothing needed here! The library runs in its own FreeRTOS task on Core 0
   // Your Core 1 AGV control code would run here (motor control, sensors, etc.)
   
+#if AGVNET_ENABLE_DISPATCH
+  // Run the handlers registered for Core 1 (see setup)
+  agvNetwork.runQueuedCommands();
+#endif
+  
+  static bool stoppedForLink = false;
+  if (controlLinkLost && !stoppedForLink) {
+    Serial.println("!!! CONTROL LINK LOST - STOPPING !!!");
+    // Your controlled stop code here
+  }
+  stoppedForLink = controlLinkLost;
+  
   // Optional: Send periodic status updates
   static unsigned long lastStatus = 0;
   if (millis() - lastStatus > 5000) {
@@ -53,5 +142,9 @@ void loop() {
     lastStatus = millis();
   }
   
+  // Optional: publish telemetry (lock-free; served at /state and via "GET <key>")
+  agvNetwork.setTelemetry("mode", "IDLE");
+  agvNetwork.setTelemetry("battery", 87.5f);
+  
   delay(100);
 }
\ No newline at end of file
@@ -0,0 +1,764 @@
+#!/usr/bin/env python3
+"""Impair the network between clients and an AGV: loss, jitter, caps, drops.
+
+    tools/agv_impair.py proxy --forward 8081:factory_agv_01.local:81 \\
+        --forward 8000:factory_agv_01.local:80 --loss 0.02 --burst 4 --delay normal:20,8
+    tools/agv_impair.py run tools/scenarios/*.json --host factory_agv_01.local \\
+        --password agv_secure_pass --save results.json
+
+`proxy` forwards TCP ports and impairs everything passing through, for a
+browser or any other client: the dashboard connects its WebSocket to port
+81 of the host it was loaded from, so run the proxy on a spare machine
+(or 127.0.0.1, as root) with forwards for 80 and 81.
+
+`run` plays scenario files. Each one starts a proxy on loopback in front
+of the vehicle's WebSocket port and connects through it like the
+dashboard does (no client-side timeout, reconnect 2 s after a close),
+sends numbered commands at a fixed rate and reports delivery and latency
+percentiles: "echo" until "Received: <command>" comes back, "status"
+until a broadcast ending in the command text arrives (the example sketch
+answers every command with "Executing: <command>"). Login goes to the
+vehicle directly; leave out --password for builds without authentication.
+
+Impairments apply per TCP segment read from either side, in both
+directions, from a random generator seeded per connection and direction:
+the same seed gives the same sequence of delays and losses. TCP cannot
+lose or reorder bytes, so both are applied the way the receiver sees
+them - a lost segment arrives after retransmission timeouts (doubling
+per attempt), a reordered one holds up everything behind it.
+
+    delay       none | const:MS | uniform:LO,HI | normal:MEAN,SD | pareto:MIN,SHAPE
+    spike       [probability, ms]   extra delay now and then
+    loss        segment loss probability (Gilbert-Elliott)
+    burst       mean loss burst length in segments (1 = independent)
+    rto         first retransmission timeout in ms (200)
+    rate        bandwidth cap in kbit/s, per direction
+    reorder     [probability, ms]   segment overtaken, held back this long
+    disconnect_every  mean seconds between random disconnects
+    disconnect  reset | close | half-open (reset)
+    half_open_for     seconds a half-open link stays silent before the reset (10)
+
+A scenario is JSON:
+
+    {"description": "...", "seed": 1, "duration": 60, "rate": 10,
+     "command": "NOP {n}", "impair": {"loss": 0.02, "burst": 4},
+     "timeline": [{"at": 20, "impair": {"delay": "pareto:5,2"}},
+                  {"at": 40, "disconnect": "half-open", "for": 8}]}
+
+A timeline "impair" replaces the impairments from then on. Standard
+library only.
+"""
+
+import argparse
+import base64
+import json
+import os
+import queue
+import random
+import select
+import socket
+import struct
+import sys
+import threading
+import time
+import urllib.request
+
+SEGMENT = 1460          # largest chunk read and impaired as one segment
+POLL_S = 0.2            # how often blocked threads look at the link state
+RETRIES_MAX = 5         # a segment is delivered after this many retransmissions anyway
+RECONNECT_S = 2.0       # the dashboard's reconnect delay
+MODES = ("reset", "close", "half-open")
+
+
+def delay_sampler(spec):
+    """Returns rng -> delay in ms for a delay spec."""
+    if not spec or spec == "none":
+        return lambda rng: 0.0
+    name, _, params = spec.partition(":")
+    try:
+        values = [float(v) for v in params.split(",")] if params else []
+    except ValueError:
+        raise ValueError("bad delay '%s'" % spec)
+    counts = {"const": 1, "uniform": 2, "normal": 2, "pareto": 2}
+    if counts.get(name) != len(values):
+        raise ValueError("bad delay '%s'" % spec)
+    if name == "const":
+        return lambda rng: values[0]
+    if name == "uniform":
+        return lambda rng: rng.uniform(values[0], values[1])
+    if name == "normal":
+        return lambda rng: max(0.0, rng.gauss(values[0], values[1]))
+    return lambda rng: values[0] * rng.paretovariate(values[1])
+
+
+class Impairment:
+    def __init__(self, settings=None):
+        self.settings = dict(settings or {})
+        settings = dict(self.settings)
+        self.delay = delay_sampler(settings.pop("delay", None))
+        self.spike = settings.pop("spike", [0, 0])
+        self.loss = float(settings.pop("loss", 0))
+        self.burst = max(1.0, float(settings.pop("burst", 1)))
+        self.rto = float(settings.pop("rto", 200))
+        self.rate = float(settings.pop("rate", 0))
+        self.reorder = settings.pop("reorder", [0, 0])
+        self.disconnect_every = float(settings.pop("disconnect_every", 0))
+        self.disconnect = settings.pop("disconnect", "reset")
+        self.half_open_for = float(settings.pop("half_open_for", 10))
+        if settings:
+            raise ValueError("unknown impairment '%s'" % sorted(settings)[0])
+        if not 0 <= self.loss < 1:
+            raise ValueError("loss must be below 1")
+        if self.disconnect not in MODES:
+            raise ValueError("disconnect must be one of %s" % ", ".join(MODES))
+        # Chance to enter the loss state, so that the long-run loss is self.loss
+        self.enter = self.loss / (self.burst * (1 - self.loss))
+
+    def describe(self):
+        return json.dumps(self.settings, sort_keys=True) if self.settings else "none"
+
+
+class Pipe:
+    """One direction of a link: reads segments, delivers them when due."""
+
+    def __init__(self, link, source, sink, rng, stats):
+        self.link = link
+        self.source = source
+        self.sink = sink
+        self.rng = rng
+        self.stats = stats
+        self.queue = queue.Queue()
+        self.bad = False            # Gilbert-Elliott loss state
+        self.last_due = 0.0         # segments leave in order
+        self.link_free = 0.0        # end of the last transmission under the rate cap
+
+    def start(self):
+        threading.Thread(target=self.read, daemon=True).start()
+        threading.Thread(target=self.write, daemon=True).start()
+
+    # Bursts span consecutive segments; a retransmission, one RTO later, is
+    # lost at the plain loss rate
+    def lost(self, impairment):
+        if self.bad:
+            self.bad = self.rng.random() >= 1.0 / impairment.burst
+        else:
+            self.bad = self.rng.random() < impairment.enter
+        return self.bad
+
+    def due(self, impairment, length):
+        now = time.monotonic()
+        delay_ms = impairment.delay(self.rng)
+        if impairment.spike[0] and self.rng.random() < impairment.spike[0]:
+            delay_ms += impairment.spike[1]
+            self.stats.add("spikes")
+        if impairment.reorder[0] and self.rng.random() < impairment.reorder[0]:
+            delay_ms += impairment.reorder[1]
+            self.stats.add("reordered")
+        if impairment.loss and self.lost(impairment):
+            self.stats.add("retransmitted")
+            attempt = 0
+            delay_ms += impairment.rto
+            while attempt < RETRIES_MAX and self.rng.random() < impairment.loss:
+                attempt += 1
+                delay_ms += impairment.rto * (1 << attempt)
+        due = max(now + delay_ms / 1000.0, self.last_due)
+        if impairment.rate:
+            due = max(due, self.link_free) + length * 8 / (impairment.rate * 1000.0)
+            self.link_free = due
+        self.last_due = due
+        self.stats.peak("max delay ms", (due - now) * 1000.0)
+        return due
+
+    # Sockets are non-blocking so both threads notice a closed link in time
+    def read(self):
+        try:
+            while not self.link.closed:
+                if not self.link.flowing.wait(POLL_S):
+                    continue  # half-open: leave the data in the sender's window
+                readable, _, _ = select.select([self.source], [], [], POLL_S)
+                if not readable:
+                    continue
+                try:
+                    data = self.source.recv(SEGMENT)
+                except BlockingIOError:
+                    continue
+                if not data:
+                    break
+                self.stats.add("segments")
+                self.stats.add("bytes", len(data))
+                self.queue.put((self.due(self.link.proxy.impairment, len(data)), data))
+        except (OSError, ValueError):
+            pass
+        self.queue.put((self.last_due, None))
+
+    def write(self):
+        try:
+            while not self.link.closed:
+                try:
+                    due, data = self.queue.get(timeout=POLL_S)
+                except queue.Empty:
+                    continue
+                while not self.link.closed:
+                    if not self.link.flowing.is_set():
+                        self.link.flowing.wait(POLL_S)
+                    elif time.monotonic() < due:
+                        time.sleep(min(POLL_S, due - time.monotonic()))
+                    else:
+                        break
+                if self.link.closed:
+                    break
+                if data is None:
+                    self.sink.shutdown(socket.SHUT_WR)
+                    break
+                view = memoryview(data)
+                while view and not self.link.closed:
+                    _, writable, _ = select.select([], [self.sink], [], POLL_S)
+                    try:
+                        if writable:
+                            view = view[self.sink.send(view):]
+                    except BlockingIOError:
+                        pass
+        except (OSError, ValueError):
+            pass
+        self.link.pipe_done()
+
+
+class Link:
+    """A proxied connection: a client socket, a vehicle socket, two pipes."""
+
+    def __init__(self, proxy, client, server, seed):
+        self.proxy = proxy
+        self.client = client
+        self.server = server
+        self.closed = False
+        self.flowing = threading.Event()
+        self.flowing.set()
+        self.pipes_open = 2
+        self.lock = threading.Lock()
+        for sock in (client, server):
+            sock.setblocking(False)
+            sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        self.up = Pipe(self, client, server, random.Random("%s:up" % seed), proxy.stats)
+        self.down = Pipe(self, server, client, random.Random("%s:down" % seed), proxy.stats)
+
+    def start(self):
+        self.up.start()
+        self.down.start()
+
+    def pipe_done(self):
+        with self.lock:
+            self.pipes_open -= 1
+            last = self.pipes_open == 0
+        if last:
+            self.close(reset=False)
+
+    def close(self, reset):
+        with self.lock:
+            if self.closed:
+                return
+            self.closed = True
+        for sock in (self.client, self.server):
+            try:
+                if reset:
+                    sock.setsockopt(socket.SOL_SOCKET, socket.SO_LINGER, struct.pack("ii", 1, 0))
+                sock.close()
+            except OSError:
+                pass
+        self.proxy.forget(self)
+
+    def disconnect(self, mode, half_open_for):
+        self.proxy.stats.add("disconnects (%s)" % mode)
+        if mode == "half-open":
+            # Both ends keep a connection that carries nothing, then the
+            # proxy gives up on it the way a roamed-away station would
+            self.flowing.clear()
+            timer = threading.Timer(half_open_for, self.close, args=(True,))
+            timer.daemon = True
+            timer.start()
+        else:
+            self.close(reset=mode == "reset")
+
+
+class Stats:
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.values = {}
+
+    def add(self, key, amount=1):
+        with self.lock:
+            self.values[key] = self.values.get(key, 0) + amount
+
+    def peak(self, key, value):
+        with self.lock:
+            if value > self.values.get(key, 0):
+                self.values[key] = value
+
+    def snapshot(self):
+        with self.lock:
+            return dict(self.values)
+
+
+class Proxy:
+    """Listens on one port and impairs every connection to the target."""
+
+    def __init__(self, listen_host, listen_port, target_host, target_port, impairment, seed):
+        self.target = (target_host, target_port)
+        self.impairment = impairment
+        self.seed = seed
+        self.rng = random.Random("%s:disconnects" % seed)
+        self.stats = Stats()
+        self.links = []
+        self.lock = threading.Lock()
+        self.count = 0
+        self.stopped = False
+        self.listener = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        self.listener.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self.listener.bind((listen_host, listen_port))
+        self.listener.listen(8)
+        self.listener.settimeout(POLL_S)
+        self.port = self.listener.getsockname()[1]
+
+    def start(self):
+        threading.Thread(target=self.accept, daemon=True).start()
+        threading.Thread(target=self.chaos, daemon=True).start()
+
+    def stop(self):
+        self.stopped = True
+        for link in self.live():
+            link.close(reset=True)
+        self.listener.close()
+
+    def live(self):
+        with self.lock:
+            return list(self.links)
+
+    def forget(self, link):
+        with self.lock:
+            if link in self.links:
+                self.links.remove(link)
+
+    def accept(self):
+        while not self.stopped:
+            try:
+                client, _ = self.listener.accept()
+            except socket.timeout:
+                continue
+            except OSError:
+                return
+            try:
+                server = socket.create_connection(self.target, timeout=10)
+            except OSError as e:
+                print("[impair] ❌ %s:%d unreachable: %s" % (self.target[0], self.target[1], e))
+                client.close()
+                continue
+            self.count += 1
+            self.stats.add("connections")
+            link = Link(self, client, server, "%s:%d" % (self.seed, self.count))
+            with self.lock:
+                self.links.append(link)
+            link.start()
+
+    def disconnect(self, mode, half_open_for):
+        for link in self.live():
+            link.disconnect(mode, half_open_for)
+
+    # Random disconnects, exponentially spaced around disconnect_every
+    def chaos(self):
+        next_at = None
+        while not self.stopped:
+            time.sleep(POLL_S)
+            impairment = self.impairment
+            if not impairment.disconnect_every:
+                next_at = None
+                continue
+            now = time.monotonic()
+            if next_at is None:
+                next_at = now + self.rng.expovariate(1.0 / impairment.disconnect_every)
+            elif now >= next_at:
+                self.disconnect(impairment.disconnect, impairment.half_open_for)
+                next_at = None
+
+
+def percentile(values, p):
+    if not values:
+        return 0
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, int(len(ordered) * p / 100.0))]
+
+
+class Client:
+    """WebSocket client that behaves like the dashboard, with timing."""
+
+    def __init__(self, host, port, token):
+        self.host = host
+        self.port = port
+        self.token = token
+        self.sock = None
+        self.send_lock = threading.Lock()
+        self.connected = threading.Event()
+        self.stopped = False
+        self.lock = threading.Lock()
+        self.sent = {}              # command -> time sent
+        self.echo_ms = []
+        self.status_ms = []
+        self.echoed = set()
+        self.statuses = set()
+        self.rejected = 0
+        self.broadcasts = []        # arrival times of broadcasts not matched to a command
+        self.drops = 0
+        self.reconnect_s = []
+
+    def connect(self):
+        sock = socket.create_connection((self.host, self.port), timeout=10)
+        key = base64.b64encode(os.urandom(16)).decode()
+        protocol = "Sec-WebSocket-Protocol: agv.v1, agv-token.%s\r\n" % self.token if self.token else ""
+        sock.sendall(("GET / HTTP/1.1\r\nHost: %s:%d\r\nUpgrade: websocket\r\n"
+                      "Connection: Upgrade\r\nSec-WebSocket-Key: %s\r\n"
+                      "Sec-WebSocket-Version: 13\r\n%s\r\n"
+                      % (self.host, self.port, key, protocol)).encode())
+        response = b""
+        while b"\r\n\r\n" not in response:
+            chunk = sock.recv(1024)
+            if not chunk:
+                raise ConnectionError("closed during upgrade")
+            response += chunk
+        if not response.startswith(b"HTTP/1.1 101"):
+            raise ConnectionError(response.split(b"\r\n")[0].decode())
+        sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        # Anything after the upgrade response belongs to the first frames
+        return sock, response.split(b"\r\n\r\n", 1)[1]
+
+    def frame(self, opcode, payload):
+        mask = os.urandom(4)
+        length = len(payload)
+        if length < 126:
+            head = struct.pack("!BB", 0x80 | opcode, 0x80 | length)
+        else:
+            head = struct.pack("!BBH", 0x80 | opcode, 0x80 | 126, length)
+        masked = bytes(b ^ mask[i % 4] for i, b in enumerate(payload))
+        with self.send_lock:
+            self.sock.sendall(head + mask + masked)
+
+    def send(self, text):
+        if not self.connected.is_set():
+            return False
+        try:
+            with self.lock:
+                self.sent[text] = time.monotonic()
+            self.frame(0x1, text.encode())
+            return True
+        except OSError:
+            self.sock.close()
+            return False
+
+    def received(self, text, now):
+        with self.lock:
+            if text.startswith("Received: ") and text[10:] in self.sent:
+                command = text[10:]
+                if command not in self.echoed:
+                    self.echoed.add(command)
+                    self.echo_ms.append((now - self.sent[command]) * 1000.0)
+                return
+            if text.startswith("ERROR: "):
+                self.rejected += 1
+                return
+            if text.startswith("CLIENT: ") or text.startswith("AGV Connected") or text.startswith("{"):
+                return
+            for command, sent in self.sent.items():
+                if text.endswith(command) and command not in self.statuses:
+                    self.statuses.add(command)
+                    self.status_ms.append((now - sent) * 1000.0)
+                    return
+            self.broadcasts.append(now)
+
+    def serve(self, sock, buffered):
+        data = buffered
+
+        def read(n):
+            nonlocal data
+            while len(data) < n:
+                try:
+                    chunk = sock.recv(4096)
+                except socket.timeout:
+                    if self.stopped:
+                        raise ConnectionError("stopped")
+                    continue
+                if not chunk:
+                    raise ConnectionError("closed")
+                data += chunk
+            out, data = data[:n], data[n:]
+            return out
+
+        try:
+            while True:
+                b0, b1 = read(2)
+                length = b1 & 0x7F
+                if length == 126:
+                    length = struct.unpack("!H", read(2))[0]
+                elif length == 127:
+                    length = struct.unpack("!Q", read(8))[0]
+                payload = read(length)
+                opcode = b0 & 0x0F
+                if opcode == 0x9:
+                    self.frame(0xA, payload)
+                elif opcode == 0x8:
+                    return
+                elif opcode == 0x1:
+                    self.received(payload.decode("utf-8", "replace"), time.monotonic())
+        except (OSError, ConnectionError):
+            return
+
+    def run(self):
+        lost_at = None
+        while not self.stopped:
+            try:
+                sock, buffered = self.connect()
+            except (OSError, ConnectionError):
+                time.sleep(RECONNECT_S)
+                continue
+            sock.settimeout(1.0)
+            self.sock = sock
+            if lost_at is not None:
+                self.reconnect_s.append(time.monotonic() - lost_at)
+            self.connected.set()
+            self.serve(sock, buffered)
+            self.connected.clear()
+            sock.close()
+            if self.stopped:
+                return
+            self.drops += 1
+            lost_at = time.monotonic()
+            time.sleep(RECONNECT_S)
+
+    def stop(self):
+        self.stopped = True
+        self.connected.clear()
+
+
+def login(host, port, user, password):
+    if not password:
+        return None
+    body = json.dumps({"username": user, "password": password}).encode()
+    req = urllib.request.Request("http://%s:%d/login" % (host, port), data=body, method="POST",
+                                 headers={"Content-Type": "application/json"})
+    with urllib.request.urlopen(req, timeout=10) as response:
+        answer = json.loads(response.read())
+    if not answer.get("success"):
+        sys.exit("login failed")
+    return answer["token"]
+
+
+def load_scenario(path, args):
+    with open(path) as f:
+        scenario = json.load(f)
+    scenario.setdefault("name", os.path.splitext(os.path.basename(path))[0])
+    for key in ("seed", "duration", "rate"):
+        if getattr(args, key) is not None:
+            scenario[key] = getattr(args, key)
+    scenario.setdefault("seed", 1)
+    scenario.setdefault("duration", 30)
+    scenario.setdefault("rate", 10)
+    scenario.setdefault("command", "NOP {n}")
+    scenario["timeline"] = sorted(scenario.get("timeline", []), key=lambda step: step["at"])
+    try:
+        Impairment(scenario.get("impair"))
+        for step in scenario["timeline"]:
+            if "impair" in step:
+                Impairment(step["impair"])
+            elif step.get("disconnect") not in MODES:
+                raise ValueError("timeline step at %s s does nothing" % step["at"])
+    except ValueError as e:
+        sys.exit("%s: %s" % (path, e))
+    return scenario
+
+
+def play(scenario, args, token):
+    proxy = Proxy("127.0.0.1", 0, args.host, args.ws_port, Impairment(scenario.get("impair")), scenario["seed"])
+    proxy.start()
+    client = Client("127.0.0.1", proxy.port, token)
+    threading.Thread(target=client.run, daemon=True).start()
+    if not client.connected.wait(10):
+        proxy.stop()
+        sys.exit("no WebSocket connection to %s:%d" % (args.host, args.ws_port))
+    time.sleep(0.5)  # greeting and telemetry snapshot
+
+    print("[impair] %s: %s" % (scenario["name"], scenario.get("description", "")))
+    print("[impair] %d s at %g commands/s, seed %s" % (scenario["duration"], scenario["rate"], scenario["seed"]))
+    timeline = list(scenario["timeline"])
+    attempted = sent = 0
+    start = time.monotonic()
+    period = 1.0 / scenario["rate"]
+    while True:
+        elapsed = time.monotonic() - start
+        if elapsed >= scenario["duration"]:
+            break
+        while timeline and timeline[0]["at"] <= elapsed:
+            step = timeline.pop(0)
+            if "impair" in step:
+                proxy.impairment = Impairment(step["impair"])
+                print("[impair] %6.1f s  impair %s" % (elapsed, proxy.impairment.describe()))
+            else:
+                proxy.disconnect(step["disconnect"], step.get("for", 10))
+                print("[impair] %6.1f s  disconnect (%s)" % (elapsed, step["disconnect"]))
+        attempted += 1
+        if client.send(scenario["command"].format(n=attempted)):
+            sent += 1
+        delay = start + attempted * period - time.monotonic()
+        if delay > 0:
+            time.sleep(delay)
+
+    time.sleep(args.settle)
+    client.stop()
+    proxy.stop()
+    return summarize(scenario, attempted, sent, client, proxy.stats.snapshot())
+
+
+def summarize(scenario, attempted, sent, client, proxy_stats):
+    with client.lock:
+        echo = list(client.echo_ms)
+        status = list(client.status_ms)
+        gaps = [(b - a) * 1000.0 for a, b in zip(client.broadcasts, client.broadcasts[1:])]
+        result = {
+            "scenario": scenario["name"],
+            "attempted": attempted,
+            "sent": sent,
+            "echoed": len(client.echoed),
+            "statuses": len(client.statuses),
+            "rejected": client.rejected,
+            "delivery %": len(client.echoed) * 100.0 / attempted if attempted else 0.0,
+            "status %": len(client.statuses) * 100.0 / attempted if attempted else 0.0,
+        }
+    for label, values in (("echo", echo), ("status", status)):
+        for p in (50, 95, 99):
+            result["%s p%d ms" % (label, p)] = percentile(values, p)
+        result["%s max ms" % label] = max(values) if values else 0
+    result["other broadcasts"] = len(gaps) + 1 if client.broadcasts else 0
+    result["broadcast gap max ms"] = max(gaps) if gaps else 0
+    result["drops"] = client.drops
+    result["reconnect max s"] = max(client.reconnect_s) if client.reconnect_s else 0
+    result["proxy"] = proxy_stats
+    return result
+
+
+def show(result):
+    for key, value in result.items():
+        if key == "proxy":
+            for name in sorted(value):
+                item = value[name]
+                print("  proxy %-23s %s" % (name, "%.1f" % item if isinstance(item, float) else item))
+        elif key != "scenario":
+            print("  %-29s %s" % (key, "%.1f" % value if isinstance(value, float) else value))
+
+
+def table(results):
+    columns = ("delivery %", "echo p50 ms", "echo p95 ms", "echo p99 ms", "status p95 ms", "drops",
+               "reconnect max s")
+    print("%-16s" % "" + "".join("%16s" % c for c in columns))
+    for result in results:
+        print("%-16s" % result["scenario"][:16] + "".join("%16.1f" % result[c] for c in columns))
+
+
+def cmd_run(args):
+    scenarios = [load_scenario(path, args) for path in args.scenario]
+    token = login(args.host, args.http_port, args.user, args.password)
+    results = []
+    for scenario in scenarios:
+        result = play(scenario, args, token)
+        show(result)
+        print()
+        results.append(result)
+    if len(results) > 1:
+        table(results)
+    if args.save:
+        with open(args.save, "w") as f:
+            json.dump(results, f, indent=2)
+
+
+def impairment_from(args):
+    settings = {}
+    for key in ("delay", "loss", "burst", "rto", "rate", "disconnect_every", "disconnect", "half_open_for"):
+        value = getattr(args, key)
+        if value is not None:
+            settings[key] = value
+    for key in ("spike", "reorder"):
+        value = getattr(args, key)
+        if value is not None:
+            settings[key] = [float(v) for v in value.split(",")]
+    try:
+        return Impairment(settings)
+    except ValueError as e:
+        sys.exit(str(e))
+
+
+def cmd_proxy(args):
+    impairment = impairment_from(args)
+    proxies = []
+    for forward in args.forward:
+        try:
+            listen, host, port = forward.split(":")
+            proxy = Proxy("0.0.0.0", int(listen), host, int(port), impairment, args.seed)
+        except ValueError:
+            sys.exit("bad forward '%s', expected LISTEN:HOST:PORT" % forward)
+        proxy.start()
+        proxies.append((forward, proxy))
+        print("[impair] ✅ :%s -> %s:%s, impairment %s" % (listen, host, port, impairment.describe()))
+    try:
+        while True:
+            time.sleep(1)
+    except KeyboardInterrupt:
+        pass
+    for forward, proxy in proxies:
+        proxy.stop()
+        print("[impair] %s" % forward)
+        stats = proxy.stats.snapshot()
+        for name in sorted(stats):
+            print("  %-23s %s" % (name, "%.1f" % stats[name] if isinstance(stats[name], float) else stats[name]))
+
+
+def add_impairments(p):
+    p.add_argument("--delay", help="none | const:MS | uniform:LO,HI | normal:MEAN,SD | pareto:MIN,SHAPE")
+    p.add_argument("--spike", help="PROBABILITY,MS extra delay")
+    p.add_argument("--loss", type=float, help="segment loss probability")
+    p.add_argument("--burst", type=float, help="mean loss burst length in segments")
+    p.add_argument("--rto", type=float, help="first retransmission timeout in ms (200)")
+    p.add_argument("--rate", type=float, help="bandwidth cap in kbit/s per direction")
+    p.add_argument("--reorder", help="PROBABILITY,MS a segment is held back")
+    p.add_argument("--disconnect-every", dest="disconnect_every", type=float,
+                   help="mean seconds between random disconnects")
+    p.add_argument("--disconnect", choices=MODES, help="how random disconnects happen (reset)")
+    p.add_argument("--half-open-for", dest="half_open_for", type=float,
+                   help="seconds a half-open link stays silent (10)")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    commands = parser.add_subparsers(dest="command")
+    commands.required = True
+
+    p = commands.add_parser("proxy", help="forward ports with impairments")
+    p.add_argument("--forward", action="append", required=True, metavar="LISTEN:HOST:PORT",
+                   help="listen port and target (repeatable)")
+    p.add_argument("--seed", default="1")
+    add_impairments(p)
+    p.set_defaults(run=cmd_proxy)
+
+    p = commands.add_parser("run", help="play scenarios against a vehicle")
+    p.add_argument("scenario", nargs="+", help="scenario JSON files")
+    p.add_argument("--host", required=True, help="vehicle address, e.g. factory_agv_01.local")
+    p.add_argument("--http-port", type=int, default=80)
+    p.add_argument("--ws-port", type=int, default=81)
+    p.add_argument("--user", default="admin")
+    p.add_argument("--password", help="omit for builds without authentication")
+    p.add_argument("--seed", help="override the scenarios' seeds")
+    p.add_argument("--duration", type=float, help="override the scenarios' durations in s")
+    p.add_argument("--rate", type=float, help="override the scenarios' command rates")
+    p.add_argument("--settle", type=float, default=3.0, help="seconds to wait after the last command")
+    p.add_argument("--save", help="write the results as JSON")
+    p.set_defaults(run=cmd_run)
+
+    args = parser.parse_args()
+    args.run(args)
+
+
+if __name__ == "__main__":
+    main()
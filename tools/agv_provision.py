@@ -0,0 +1,345 @@
+#!/usr/bin/env python3
+"""Provision new AGVs in parallel: WiFi credentials and device name.
+
+    tools/agv_provision.py udp --key-file fleet.key --ssid Factory --password secret123 \\
+        --names fleet.csv --count 40
+    tools/agv_provision.py udp --key-file fleet.key --ssid Factory --password secret123 \\
+        --name-template "agv_{index:02d}" --first 1 --timeout 300 --verify
+    tools/agv_provision.py serial --key-file fleet.key --ssid Factory --password secret123 \\
+        --names fleet.csv /dev/ttyUSB0 /dev/ttyUSB1 /dev/ttyUSB2
+
+Vehicles built with a provisioning key (setProvisioningKey()) listen while
+in setup mode or without credentials. Each one announces its MAC and a
+per-boot nonce by UDP broadcast on port 4210 (on its setup AP and, if the
+firmware sets AGVNET_PROVISION_SSID, on that commissioning network) and
+answers "PROVISION" on serial. This tool answers every announcement with a
+config encrypted and signed for that vehicle and nonce, and reports the
+acknowledgements. The vehicles join the network without restarting.
+
+Names come from a CSV of "mac,name" lines (vehicles not listed are left
+alone) or from --name-template, numbered in the order vehicles appear.
+Standard library only.
+"""
+
+import argparse
+import hashlib
+import hmac
+import os
+import re
+import socket
+import struct
+import sys
+import termios
+import threading
+import time
+
+PORT = 4210
+MAGIC = b"AGVP"
+VERSION = 1
+HELLO, CONFIG, ACK = 1, 2, 3
+HEADER = struct.Struct("<4sBB6sI")  # magic, version, type, MAC, nonce
+TAG = 16
+STATUS = {0: "ok", 1: "malformed", 2: "bad signature", 3: "stale nonce", 4: "other vehicle",
+          5: "no provisioning key"}
+NAME = re.compile(r"^[A-Za-z0-9_-]{1,31}$")
+
+
+def mac_text(mac):
+    return ":".join("%02x" % b for b in mac)
+
+
+def parse_mac(text):
+    digits = re.sub(r"[^0-9a-fA-F]", "", text)
+    if len(digits) != 12:
+        raise ValueError("bad MAC address '%s'" % text)
+    return bytes.fromhex(digits)
+
+
+def sign(key, data):
+    return hmac.new(key, data, hashlib.sha256).digest()
+
+
+def config_packet(key, mac, nonce, ssid, password, name):
+    """The CONFIG packet for one vehicle and boot (see AGVProvision.h)."""
+    body = b"".join(bytes([len(field)]) + field for field in (ssid, password, name))
+    stream = b""
+    while len(stream) < len(body):
+        block = len(stream) // 32
+        stream += sign(key, b"AGVK" + mac + struct.pack("<IB", nonce, block))
+    header = HEADER.pack(MAGIC, VERSION, CONFIG, mac, nonce)
+    signed = header + bytes(a ^ b for a, b in zip(body, stream))
+    return signed + sign(key, signed)[:TAG]
+
+
+class Names:
+    """Device name per MAC, from a CSV or a numbered template."""
+
+    def __init__(self, csv_path, template, first):
+        self.table = {}
+        self.template = template
+        self.next = first
+        self.lock = threading.Lock()
+        if csv_path:
+            with open(csv_path) as f:
+                for number, line in enumerate(f, 1):
+                    line = line.split("#")[0].strip()
+                    if not line:
+                        continue
+                    mac, _, name = line.partition(",")
+                    name = name.strip()
+                    if not NAME.match(name):
+                        sys.exit("%s:%d: bad device name '%s'" % (csv_path, number, name))
+                    self.table[parse_mac(mac)] = name
+
+    def expected(self):
+        return len(self.table) if not self.template else None
+
+    def get(self, mac):
+        with self.lock:
+            if mac not in self.table and self.template:
+                name = self.template.format(index=self.next, mac=mac.hex())
+                if not NAME.match(name):
+                    sys.exit("template gives bad device name '%s'" % name)
+                self.table[mac] = name
+                self.next += 1
+            return self.table.get(mac)
+
+
+def read_key(args):
+    if args.key_file:
+        with open(args.key_file) as f:
+            key = f.read().strip()
+    else:
+        key = args.key or os.environ.get("AGV_PROVISION_KEY", "")
+    if not key or len(key.encode()) > 64:
+        sys.exit("provisioning key missing or longer than 64 bytes (--key-file, --key or AGV_PROVISION_KEY)")
+    return key.encode()
+
+
+def credentials(args):
+    ssid, password = args.ssid.encode(), args.password.encode()
+    if not 0 < len(ssid) <= 32:
+        sys.exit("SSID must be 1..32 bytes")
+    if password and not 8 <= len(password) <= 63:
+        sys.exit("password must be empty (open network) or 8..63 bytes")
+    return ssid, password
+
+
+class Vehicle:
+    def __init__(self, mac, address, nonce, current):
+        self.mac = mac
+        self.address = address
+        self.nonce = nonce
+        self.current = current  # name the vehicle announced
+        self.name = None
+        self.packet = None
+        self.sent = 0
+        self.last_sent = 0.0
+        self.result = "waiting"
+        self.done = False
+
+
+def cmd_udp(args):
+    key = read_key(args)
+    ssid, password = credentials(args)
+    names = Names(args.names, args.name_template, args.first)
+    expected = args.count or names.expected()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM, socket.IPPROTO_UDP)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_BROADCAST, 1)
+    sock.bind((args.bind, args.port))
+    sock.settimeout(0.1)
+
+    vehicles = {}
+    start = time.monotonic()
+    print("Listening on UDP %d for %s vehicle(s), up to %.0f s" % (args.port, expected or "any", args.timeout))
+    while time.monotonic() - start < args.timeout:
+        if expected and sum(1 for v in vehicles.values() if v.done and v.result == "ok") >= expected:
+            break
+        try:
+            data, (address, _) = sock.recvfrom(512)
+        except socket.timeout:
+            data = None
+        if data and len(data) >= HEADER.size + 1:
+            magic, version, kind, mac, nonce = HEADER.unpack_from(data)
+            if magic == MAGIC and version == VERSION and kind == HELLO:
+                length = data[HEADER.size]
+                current = data[HEADER.size + 1:HEADER.size + 1 + length].decode("utf-8", "replace")
+                vehicle = vehicles.get(mac)
+                if vehicle is None or (vehicle.nonce != nonce and not vehicle.done):
+                    # New vehicle, or restarted before it was provisioned
+                    vehicle = Vehicle(mac, address, nonce, current)
+                    vehicle.name = names.get(mac)
+                    if vehicle.name:
+                        vehicle.packet = config_packet(key, mac, nonce, ssid, password, vehicle.name.encode())
+                    else:
+                        vehicle.result = "not listed"
+                        vehicle.done = True
+                    if mac not in vehicles:
+                        print("  found %s at %-15s (%s)" % (mac_text(mac), address, current or "-"))
+                    vehicles[mac] = vehicle
+            elif magic == MAGIC and kind == ACK and mac in vehicles:
+                vehicle = vehicles[mac]
+                vehicle.result = STATUS.get(data[HEADER.size], "status %d" % data[HEADER.size])
+                vehicle.done = vehicle.result not in ("stale nonce",)
+                if vehicle.result == "ok":
+                    print("  %s provisioned as %s" % (mac_text(mac), vehicle.name))
+
+        # Send or resend the config to every vehicle that has not answered
+        now = time.monotonic()
+        for vehicle in vehicles.values():
+            if vehicle.done or not vehicle.packet or now - vehicle.last_sent < args.retry:
+                continue
+            if vehicle.sent >= args.attempts:
+                vehicle.result = "no answer"
+                vehicle.done = True
+                continue
+            sock.sendto(vehicle.packet, (vehicle.address, args.port))
+            vehicle.sent += 1
+            vehicle.last_sent = now
+    sock.close()
+    report(vehicles.values(), time.monotonic() - start, args.verify)
+
+
+def report(vehicles, elapsed, verify):
+    vehicles = sorted(vehicles, key=lambda v: v.name or "~" + mac_text(v.mac))
+    print()
+    print("%-17s %-15s %-20s %s" % ("mac", "address", "name", "result"))
+    for v in vehicles:
+        print("%-17s %-15s %-20s %s" % (mac_text(v.mac), v.address, v.name or "-", v.result))
+    ok = [v for v in vehicles if v.result == "ok"]
+    print("%d of %d vehicle(s) provisioned in %.1f s" % (len(ok), len(vehicles), elapsed))
+
+    if verify and ok:
+        # The vehicles now join the network and publish _agv._tcp
+        sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+        from agv_scan import scan
+        wanted = set(v.name for v in ok)
+        seen = set()
+        deadline = time.monotonic() + 30
+        while seen != wanted and time.monotonic() < deadline:
+            seen |= set(agv["name"] for agv in scan(2.0)) & wanted
+        for name in sorted(wanted - seen):
+            print("  %s did not appear on the network" % name)
+        print("%d of %d visible by mDNS" % (len(seen), len(wanted)))
+    if any(v.result not in ("ok", "not listed") for v in vehicles):
+        sys.exit(1)
+
+
+def open_serial(path, baud):
+    fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+    attrs = termios.tcgetattr(fd)
+    speed = getattr(termios, "B%d" % baud)
+    attrs[0] = 0                                                   # iflag
+    attrs[1] = 0                                                   # oflag
+    attrs[2] = termios.CS8 | termios.CREAD | termios.CLOCAL        # cflag
+    attrs[3] = 0                                                   # lflag
+    attrs[4] = attrs[5] = speed
+    attrs[6][termios.VMIN] = 0
+    attrs[6][termios.VTIME] = 1                                    # reads return after 0.1 s
+    termios.tcsetattr(fd, termios.TCSANOW, attrs)
+    termios.tcflush(fd, termios.TCIOFLUSH)
+    return fd
+
+
+def wait_line(fd, prefix, timeout):
+    """Returns the text after `prefix` on the first line containing it."""
+    buffered = b""
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        buffered += os.read(fd, 256)
+        while b"\n" in buffered:
+            line, buffered = buffered.split(b"\n", 1)
+            text = line.decode("utf-8", "replace").strip()
+            if prefix in text:
+                return text.split(prefix, 1)[1].strip()
+    return None
+
+
+def provision_serial(path, args, key, ssid, password, names, results):
+    vehicle = Vehicle(b"\0" * 6, path, 0, "")
+    results.append(vehicle)
+    try:
+        fd = open_serial(path, args.baud)
+    except OSError as e:
+        vehicle.result = "cannot open: %s" % e.strerror
+        return
+    try:
+        hello = None
+        for _ in range(args.attempts):
+            os.write(fd, b"\nPROVISION\n")
+            hello = wait_line(fd, "PROVISION: ", args.retry * 4)
+            if hello:
+                break
+        if not hello or not hello.startswith("HELLO "):
+            vehicle.result = hello or "no answer"
+            return
+        fields = hello.split()
+        vehicle.mac = parse_mac(fields[1])
+        vehicle.nonce = int(fields[2], 16)
+        vehicle.current = fields[3] if len(fields) > 3 else ""
+        vehicle.name = names.get(vehicle.mac)
+        if not vehicle.name:
+            vehicle.result = "not listed"
+            return
+        packet = config_packet(key, vehicle.mac, vehicle.nonce, ssid, password, vehicle.name.encode())
+        os.write(fd, b"PROVISION " + packet.hex().encode() + b"\n")
+        answer = wait_line(fd, "PROVISION: ", args.retry * 4)
+        vehicle.result = "ok" if answer and answer.startswith("OK") else (answer or "no answer")
+    finally:
+        os.close(fd)
+
+
+def cmd_serial(args):
+    key = read_key(args)
+    ssid, password = credentials(args)
+    names = Names(args.names, args.name_template, args.first)
+    results = []
+    start = time.monotonic()
+    threads = [threading.Thread(target=provision_serial, args=(path, args, key, ssid, password, names, results))
+               for path in args.ports]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    report(results, time.monotonic() - start, args.verify)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    commands = parser.add_subparsers(dest="command")
+    commands.required = True
+
+    common = argparse.ArgumentParser(add_help=False)
+    common.add_argument("--key-file", help="file holding the fleet provisioning key")
+    common.add_argument("--key", help="fleet provisioning key (or AGV_PROVISION_KEY)")
+    common.add_argument("--ssid", required=True, help="network the vehicles join")
+    common.add_argument("--password", default="", help="network password (empty for an open network)")
+    common.add_argument("--names", help='CSV of "mac,name" lines')
+    common.add_argument("--name-template", help='e.g. "agv_{index:02d}" or "agv_{mac}"')
+    common.add_argument("--first", type=int, default=1, help="first {index} of --name-template")
+    common.add_argument("--attempts", type=int, default=5, help="sends per vehicle before giving up")
+    common.add_argument("--retry", type=float, default=0.5, help="seconds between attempts")
+    common.add_argument("--verify", action="store_true", help="wait for the vehicles to appear by mDNS")
+
+    p = commands.add_parser("udp", parents=[common], help="answer announcements on the local network")
+    p.add_argument("--port", type=int, default=PORT)
+    p.add_argument("--bind", default="", help="local address to listen on")
+    p.add_argument("--count", type=int, help="stop once this many vehicles are provisioned")
+    p.add_argument("--timeout", type=float, default=120.0, help="seconds to keep listening")
+    p.set_defaults(run=cmd_udp)
+
+    p = commands.add_parser("serial", parents=[common], help="provision vehicles on serial ports, all at once")
+    p.add_argument("ports", nargs="+", help="serial devices, e.g. /dev/ttyUSB0")
+    p.add_argument("--baud", type=int, default=115200)
+    p.set_defaults(run=cmd_serial)
+
+    args = parser.parse_args()
+    if not args.names and not args.name_template:
+        parser.error("--names or --name-template is required")
+    args.run(args)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,145 @@
+#!/usr/bin/env python3
+"""Decode an AGVCoreNetwork flight recorder dump.
+
+    tools/agv_recorder.py http://factory_agv_01.local/recorder
+    tools/agv_recorder.py agv-recorder.bin --last 50
+    curl -s http://agv.local/recorder | tools/agv_recorder.py -
+
+Events are printed oldest first. Each BOOT line starts a new session and
+the line before it is the last thing the vehicle recorded before the reset.
+"""
+
+import argparse
+import struct
+import sys
+import urllib.request
+
+MAGIC = 0x52564741
+HEADER = struct.Struct("<IBBHII")   # magic, version, eventSize, capacity, nextSeq, nowUs
+EVENT = struct.Struct("<IIBBHI")    # seq, timeUs, type, source, arg, data
+
+EVENTS = {
+    1: "BOOT", 2: "CMD_RX", 3: "CMD_EXEC", 4: "CMD_DROP", 5: "STATUS",
+    6: "EMERGENCY", 7: "WS_CONNECT", 8: "WS_DISCONNECT", 9: "LINK",
+    10: "MUTEX_TIMEOUT", 11: "LOOP_STALL", 12: "MISSION", 13: "RESTART",
+    14: "TIMED_EXEC", 15: "AUTH_REJECT", 16: "ISR_OVERFLOW",
+}
+SOURCES = {0: "ws", 1: "serial", 2: "http", 3: "internal", 4: "mqtt"}
+CLASSES = {0: "critical", 1: "control", 2: "normal", 3: "bulk"}
+AUTH = {1: "no token", 2: "malformed token", 3: "bad signature", 4: "token expired"}
+DROPS = {1: "rate limited", 2: "queue full", 0xFD: "handler queue full", 0xFE: "too long", 0xFF: "pool exhausted"}
+RESETS = {
+    0: "unknown", 1: "power-on", 2: "external pin", 3: "software restart",
+    4: "panic", 5: "interrupt watchdog", 6: "task watchdog", 7: "other watchdog",
+    8: "deep sleep", 9: "brown-out", 10: "SDIO",
+}
+LOCKS = {0: "commands", 1: "clients", 2: "config"}
+
+
+def load(source):
+    if source == "-":
+        return sys.stdin.buffer.read()
+    if source.startswith("http://") or source.startswith("https://"):
+        with urllib.request.urlopen(source, timeout=10) as response:
+            return response.read()
+    with open(source, "rb") as f:
+        return f.read()
+
+
+def text(data, length):
+    raw = struct.pack("<I", data)[:min(length, 4)]
+    shown = "".join(chr(b) if 32 <= b < 127 else "." for b in raw)
+    return "'%s%s'" % (shown, "..." if length > 4 else "")
+
+
+def describe(kind, arg, data):
+    if kind == 1:
+        return "boot %d, reset reason: %s" % (arg, RESETS.get(data, data))
+    if kind in (2, 5, 6):
+        return "%s (%d bytes)" % (text(data, arg), arg)
+    if kind == 3:
+        return "%s priority %d, class %s" % (text(data, 4), arg & 0xFF,
+                                              CLASSES.get(arg >> 8, arg >> 8))
+    if kind == 4:
+        return "%s %s" % (text(data, 4), DROPS.get(arg, "reason %d" % arg))
+    if kind == 7:
+        ip = ".".join(str(b) for b in struct.pack("<I", data))
+        return "client #%d from %s" % (arg, ip)
+    if kind == 8:
+        return "client #%d" % arg
+    if kind == 9:
+        return "%s, %d operators" % ("up" if data else "LOST", arg)
+    if kind == 10:
+        return "%s lock, AGVCoreNetwork.cpp:%d" % (LOCKS.get(data, data), arg)
+    if kind == 11:
+        return "network loop blocked %d ms" % data
+    if kind == 12:
+        return "mission #%d, %d waypoints" % (data, arg)
+    if kind == 13:
+        return "planned restart (AGVCoreNetwork.cpp:%d)" % arg
+    if kind == 14:
+        skew = data - (1 << 32) if data & 0x80000000 else data
+        return "AT command fired, skew %+d us, priority %d, class %s" % (
+            skew, arg & 0xFF, CLASSES.get(arg >> 8, arg >> 8))
+    if kind == 15:
+        return "session rejected: %s" % AUTH.get(arg, arg)
+    if kind == 16:
+        return "%d interrupt event(s) lost, ring full" % data
+    return "arg=%d data=0x%08x" % (arg, data)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("source", help="dump file, /recorder URL or - for stdin")
+    parser.add_argument("--last", type=int, default=0, help="only show the last N events")
+    parser.add_argument("--save", help="also write the raw dump to this file")
+    args = parser.parse_args()
+
+    blob = load(args.source)
+    if args.save:
+        with open(args.save, "wb") as f:
+            f.write(blob)
+
+    if len(blob) < HEADER.size:
+        sys.exit("dump too short")
+    magic, version, size, capacity, next_seq, now_us = HEADER.unpack_from(blob)
+    if magic != MAGIC or version != 1 or size != EVENT.size:
+        sys.exit("not an AGV recorder dump (magic %08x, version %d)" % (magic, version))
+
+    events = []
+    for i in range(capacity):
+        offset = HEADER.size + i * EVENT.size
+        if offset + EVENT.size > len(blob):
+            break
+        seq, time_us, kind, source, arg, data = EVENT.unpack_from(blob, offset)
+        if kind == 0 or seq >= next_seq:
+            continue
+        if seq % capacity != i:
+            continue  # torn while the dump was taken
+        events.append((seq, time_us, kind, source, arg, data))
+    events.sort()
+    if args.last:
+        events = events[-args.last:]
+
+    print("%d events (capacity %d), device uptime %.3f s" % (len(events), capacity, now_us / 1e6))
+    print("%8s %12s %10s  %-14s %-8s %s" % ("seq", "time s", "delta ms", "event", "source", "details"))
+    previous = None
+    for seq, time_us, kind, source, arg, data in events:
+        if kind == 1:
+            if previous is not None:
+                print("%s ^ last event before reset" % (" " * 8))
+            print("-" * 72)
+            delta = ""
+        elif previous is None or seq != previous[0] + 1:
+            delta = "gap"
+        else:
+            delta = "%.3f" % (((time_us - previous[1]) & 0xFFFFFFFF) / 1000.0)
+        name = EVENTS.get(kind, "USER_%02X" % kind if kind >= 0x80 else "TYPE_%d" % kind)
+        print("%8d %12.6f %10s  %-14s %-8s %s" % (seq, time_us / 1e6, delta, name,
+                                                  SOURCES.get(source, source),
+                                                  describe(kind, arg, data)))
+        previous = (seq, time_us)
+
+
+if __name__ == "__main__":
+    main()
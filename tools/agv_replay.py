@@ -0,0 +1,297 @@
+#!/usr/bin/env python3
+"""Record, replay and compare AGVCoreNetwork sessions.
+
+    tools/agv_replay.py show agv-capture.bin
+    tools/agv_replay.py replay agv-capture.bin --host factory_agv_01.local \\
+        --password agv_secure_pass --speed 4 --save replayed.bin
+    tools/agv_replay.py compare before.bin after.bin
+
+A capture is taken on the vehicle (POST /capture?action=start, run the
+session, GET /capture). `replay` feeds its inbound frames back through the
+WebSocket at the recorded pace (--speed 1), N times faster (--speed N) or
+as fast as possible (--speed 0), capturing on the vehicle meanwhile, and
+compares the new capture with the original: run the same capture against
+two builds to see throughput and latency deltas. Frames that originally
+came from serial or MQTT are replayed over the WebSocket too; past the
+receive path they take the same scheduler and dispatch pipeline.
+"""
+
+import argparse
+import base64
+import json
+import os
+import socket
+import struct
+import sys
+import threading
+import time
+import urllib.request
+
+MAGIC = 0x43564741
+HEADER = struct.Struct("<IBBHIIII")  # magic, version, reserved, recordHeader, records, bytes, lost, durationUs
+RECORD = struct.Struct("<IBBH")      # timeUs, kind, source, length
+EXEC = struct.Struct("<II")          # waitUs, runUs
+
+KINDS = {1: "RX", 2: "STATUS", 3: "EMERGENCY", 4: "EXEC"}
+SOURCES = {0: "ws", 1: "serial", 2: "http", 3: "internal", 4: "mqtt"}
+
+
+def load(source):
+    if source.startswith("http://") or source.startswith("https://"):
+        with urllib.request.urlopen(source, timeout=10) as response:
+            return response.read()
+    with open(source, "rb") as f:
+        return f.read()
+
+
+def parse(blob):
+    """Returns (header dict, [(timeUs, kind, source, payload bytes)])."""
+    if len(blob) < HEADER.size:
+        sys.exit("capture too short")
+    magic, version, _, record_header, records, size, lost, duration_us = HEADER.unpack_from(blob)
+    if magic != MAGIC or version != 1 or record_header != RECORD.size:
+        sys.exit("not an AGV capture (magic %08x, version %d)" % (magic, version))
+
+    out = []
+    offset = HEADER.size
+    end = min(len(blob), HEADER.size + size)
+    while offset + RECORD.size <= end:
+        time_us, kind, source, length = RECORD.unpack_from(blob, offset)
+        offset += RECORD.size
+        if offset + length > end:
+            break
+        out.append((time_us, kind, source, blob[offset:offset + length]))
+        offset += length
+    header = {"records": records, "bytes": size, "lost": lost, "duration_us": duration_us}
+    return header, out
+
+
+def show(text):
+    return text.decode("utf-8", "replace")
+
+
+def percentile(values, p):
+    if not values:
+        return 0
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, int(len(ordered) * p / 100.0))]
+
+
+def summarize(header, records):
+    rx = [r for r in records if r[1] == 1]
+    execs = [r for r in records if r[1] == 4 and len(r[3]) >= EXEC.size]
+    wait = [EXEC.unpack_from(r[3])[0] for r in execs]
+    run = [EXEC.unpack_from(r[3])[1] for r in execs]
+    statuses = sum(1 for r in records if r[1] in (2, 3))
+    span_us = (execs[-1][0] - rx[0][0]) if rx and execs and execs[-1][0] > rx[0][0] else 0
+    return {
+        "frames in": len(rx),
+        "commands run": len(execs),
+        "broadcasts": statuses,
+        "lost records": header["lost"],
+        "commands/s": len(execs) * 1e6 / span_us if span_us else 0.0,
+        "wait p50 us": percentile(wait, 50),
+        "wait p95 us": percentile(wait, 95),
+        "wait max us": max(wait) if wait else 0,
+        "run p50 us": percentile(run, 50),
+        "run p95 us": percentile(run, 95),
+        "run max us": max(run) if run else 0,
+    }
+
+
+def report(before, after, labels):
+    print("%-16s %14s %14s %10s" % ("", labels[0], labels[1], "delta"))
+    for key in before:
+        a, b = before[key], after[key]
+        if isinstance(a, float) or isinstance(b, float):
+            delta = "%+.1f%%" % ((b - a) * 100.0 / a) if a else "-"
+            print("%-16s %14.1f %14.1f %10s" % (key, a, b, delta))
+        else:
+            delta = "%+.1f%%" % ((b - a) * 100.0 / a) if a else "%+d" % (b - a)
+            print("%-16s %14d %14d %10s" % (key, a, b, delta))
+
+
+def cmd_show(args):
+    header, records = parse(load(args.capture))
+    print("%d records, %d bytes, %d lost, %.3f s" % (len(records), header["bytes"], header["lost"],
+                                                     header["duration_us"] / 1e6))
+    print("%12s  %-9s %-8s %s" % ("time s", "kind", "source", "details"))
+    for time_us, kind, source, payload in records:
+        if kind == 4 and len(payload) >= EXEC.size:
+            wait_us, run_us = EXEC.unpack_from(payload)
+            details = "%s (waited %d us, ran %d us)" % (show(payload[EXEC.size:]), wait_us, run_us)
+        else:
+            details = show(payload)
+        print("%12.6f  %-9s %-8s %s" % (time_us / 1e6, KINDS.get(kind, kind),
+                                        SOURCES.get(source, source), details))
+    print()
+    for key, value in summarize(header, records).items():
+        print("%-16s %s" % (key, "%.1f" % value if isinstance(value, float) else value))
+
+
+class Vehicle:
+    """Login, capture control and a minimal WebSocket client (text frames)."""
+
+    def __init__(self, host, http_port, ws_port, user, password):
+        self.base = "http://%s:%d" % (host, http_port)
+        self.host = host
+        self.ws_port = ws_port
+        self.token = self.login(user, password)
+        self.sock = None
+        self.received = 0
+
+    def request(self, method, path, body=None):
+        headers = {"Authorization": "Bearer " + self.token} if getattr(self, "token", None) else {}
+        if body is not None:
+            headers["Content-Type"] = "application/json"
+        req = urllib.request.Request(self.base + path, data=body, method=method, headers=headers)
+        with urllib.request.urlopen(req, timeout=10) as response:
+            return response.read()
+
+    def login(self, user, password):
+        body = json.dumps({"username": user, "password": password}).encode()
+        answer = json.loads(self.request("POST", "/login", body))
+        if not answer.get("success"):
+            sys.exit("login failed")
+        return answer["token"]
+
+    def connect(self):
+        self.sock = socket.create_connection((self.host, self.ws_port), timeout=10)
+        key = base64.b64encode(os.urandom(16)).decode()
+        self.sock.sendall(("GET / HTTP/1.1\r\nHost: %s:%d\r\nUpgrade: websocket\r\n"
+                           "Connection: Upgrade\r\nSec-WebSocket-Key: %s\r\n"
+                           "Sec-WebSocket-Version: 13\r\n"
+                           "Sec-WebSocket-Protocol: agv.v1, agv-token.%s\r\n\r\n"
+                           % (self.host, self.ws_port, key, self.token)).encode())
+        response = b""
+        while b"\r\n\r\n" not in response:
+            chunk = self.sock.recv(1024)
+            if not chunk:
+                break
+            response += chunk
+        if not response.startswith(b"HTTP/1.1 101"):
+            sys.exit("WebSocket upgrade rejected: %s" % response.split(b"\r\n")[0].decode())
+        self.sock.settimeout(None)
+        threading.Thread(target=self.drain, daemon=True).start()
+
+    def frame(self, opcode, payload):
+        mask = os.urandom(4)
+        length = len(payload)
+        if length < 126:
+            head = struct.pack("!BB", 0x80 | opcode, 0x80 | length)
+        elif length < 65536:
+            head = struct.pack("!BBH", 0x80 | opcode, 0x80 | 126, length)
+        else:
+            head = struct.pack("!BBQ", 0x80 | opcode, 0x80 | 127, length)
+        masked = bytes(b ^ mask[i % 4] for i, b in enumerate(payload))
+        self.sock.sendall(head + mask + masked)
+
+    def send(self, text):
+        self.frame(0x1, text)
+
+    def recv_exact(self, n):
+        data = b""
+        while len(data) < n:
+            chunk = self.sock.recv(n - len(data))
+            if not chunk:
+                raise ConnectionError("closed")
+            data += chunk
+        return data
+
+    # Read (and answer pings) so the vehicle never blocks on a full socket
+    def drain(self):
+        try:
+            while True:
+                b0, b1 = self.recv_exact(2)
+                length = b1 & 0x7F
+                if length == 126:
+                    length = struct.unpack("!H", self.recv_exact(2))[0]
+                elif length == 127:
+                    length = struct.unpack("!Q", self.recv_exact(8))[0]
+                payload = self.recv_exact(length)
+                opcode = b0 & 0x0F
+                if opcode == 0x9:
+                    self.frame(0xA, payload)
+                elif opcode == 0x8:
+                    return
+                else:
+                    self.received += 1
+        except (OSError, ConnectionError):
+            return
+
+
+def cmd_replay(args):
+    header, records = parse(load(args.capture))
+    frames = [(t, payload) for t, kind, source, payload in records
+              if kind == 1 and (not args.source or SOURCES.get(source) in args.source)]
+    if not frames:
+        sys.exit("no inbound frames to replay")
+
+    vehicle = Vehicle(args.host, args.http_port, args.ws_port, args.user, args.password)
+    vehicle.connect()
+    time.sleep(0.5)  # greeting and telemetry snapshot
+    vehicle.request("POST", "/capture?action=start")
+
+    print("Replaying %d frames at %s" % (len(frames), "full speed" if args.speed == 0 else "%gx" % args.speed))
+    start = time.monotonic()
+    first_us = frames[0][0]
+    for time_us, payload in frames:
+        if args.speed > 0:
+            due = start + (time_us - first_us) / 1e6 / args.speed
+            delay = due - time.monotonic()
+            if delay > 0:
+                time.sleep(delay)
+        vehicle.send(payload)
+    sent_s = time.monotonic() - start
+    time.sleep(args.settle)
+
+    blob = vehicle.request("GET", "/capture")
+    if args.save:
+        with open(args.save, "wb") as f:
+            f.write(blob)
+    replayed_header, replayed = parse(blob)
+    print("Sent %d frames in %.3f s (%.1f frames/s), %d frames received\n"
+          % (len(frames), sent_s, len(frames) / sent_s if sent_s else 0.0, vehicle.received))
+    report(summarize(header, records), summarize(replayed_header, replayed), ("recorded", "replayed"))
+
+
+def cmd_compare(args):
+    before = summarize(*parse(load(args.before)))
+    after = summarize(*parse(load(args.after)))
+    report(before, after, (os.path.basename(args.before)[:14], os.path.basename(args.after)[:14]))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    commands = parser.add_subparsers(dest="command")
+    commands.required = True
+
+    p = commands.add_parser("show", help="print a capture")
+    p.add_argument("capture", help="capture file or /capture URL")
+    p.set_defaults(run=cmd_show)
+
+    p = commands.add_parser("replay", help="replay a capture against a vehicle")
+    p.add_argument("capture", help="capture file or /capture URL")
+    p.add_argument("--host", required=True, help="vehicle address, e.g. factory_agv_01.local")
+    p.add_argument("--http-port", type=int, default=80)
+    p.add_argument("--ws-port", type=int, default=81)
+    p.add_argument("--user", default="admin")
+    p.add_argument("--password", required=True)
+    p.add_argument("--speed", type=float, default=1.0, help="1 = recorded pace, N = N times faster, 0 = no pauses")
+    p.add_argument("--source", action="append", choices=sorted(SOURCES.values()),
+                   help="only replay frames from this source (repeatable)")
+    p.add_argument("--settle", type=float, default=1.0, help="seconds to wait after the last frame")
+    p.add_argument("--save", help="write the replay's capture to this file")
+    p.set_defaults(run=cmd_replay)
+
+    p = commands.add_parser("compare", help="compare two captures")
+    p.add_argument("before")
+    p.add_argument("after")
+    p.set_defaults(run=cmd_compare)
+
+    args = parser.parse_args()
+    args.run(args)
+
+
+if __name__ == "__main__":
+    main()
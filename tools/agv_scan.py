@@ -0,0 +1,200 @@
+#!/usr/bin/env python3
+"""List the AGVCoreNetwork fleet from one mDNS query.
+
+    tools/agv_scan.py                 # table of every vehicle on the LAN
+    tools/agv_scan.py --timeout 0.5 --json
+
+Every vehicle publishes a _agv._tcp service whose TXT record carries its
+firmware, WebSocket port, capabilities and a state summary (mode, battery
+in tens of percent, fault flag, operator link). One multicast query
+answers for the whole fleet, so no connection to any vehicle is opened.
+Standard library only; works next to avahi-daemon (the port is shared).
+"""
+
+import argparse
+import json
+import socket
+import struct
+import sys
+import time
+
+GROUP = "224.0.0.251"
+PORT = 5353
+SERVICE = "_agv._tcp.local"
+TYPE_A, TYPE_PTR, TYPE_TXT, TYPE_SRV = 1, 12, 16, 33
+
+
+def encode_name(name):
+    out = b""
+    for label in name.strip(".").split("."):
+        out += bytes([len(label)]) + label.encode()
+    return out + b"\0"
+
+
+def query():
+    header = struct.pack("!HHHHHH", 0, 0, 1, 0, 0, 0)
+    return header + encode_name(SERVICE) + struct.pack("!HH", TYPE_PTR, 1)
+
+
+def read_name(packet, offset):
+    labels = []
+    jumped = False
+    end = offset
+    for _ in range(64):  # bound compression loops
+        length = packet[offset]
+        if length == 0:
+            offset += 1
+            break
+        if length & 0xC0 == 0xC0:
+            pointer = struct.unpack_from("!H", packet, offset)[0] & 0x3FFF
+            if not jumped:
+                end = offset + 2
+            jumped = True
+            offset = pointer
+            continue
+        labels.append(packet[offset + 1:offset + 1 + length].decode("utf-8", "replace"))
+        offset += 1 + length
+    return ".".join(labels), (end if jumped else offset)
+
+
+def parse(packet):
+    """Returns [(name, type, rdata)] of every record in a response."""
+    if len(packet) < 12:
+        return []
+    _, flags, qd, an, ns, ar = struct.unpack_from("!HHHHHH", packet)
+    if not flags & 0x8000:
+        return []  # a query, maybe our own
+    offset = 12
+    for _ in range(qd):
+        _, offset = read_name(packet, offset)
+        offset += 4
+    records = []
+    for _ in range(an + ns + ar):
+        name, offset = read_name(packet, offset)
+        rtype, _, _, length = struct.unpack_from("!HHIH", packet, offset)
+        offset += 10
+        start = offset
+        offset += length
+        if rtype == TYPE_PTR:
+            records.append((name, rtype, read_name(packet, start)[0]))
+        elif rtype == TYPE_SRV:
+            port = struct.unpack_from("!H", packet, start + 4)[0]
+            records.append((name, rtype, (read_name(packet, start + 6)[0], port)))
+        elif rtype == TYPE_TXT:
+            txt = {}
+            at = start
+            while at < offset:
+                size = packet[at]
+                item = packet[at + 1:at + 1 + size].decode("utf-8", "replace")
+                key, _, value = item.partition("=")
+                if key:
+                    txt[key] = value
+                at += 1 + size
+            records.append((name, rtype, txt))
+        elif rtype == TYPE_A and length == 4:
+            records.append((name, rtype, socket.inet_ntoa(packet[start:offset])))
+    return records
+
+
+def open_socket():
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM, socket.IPPROTO_UDP)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    if hasattr(socket, "SO_REUSEPORT"):
+        try:
+            sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEPORT, 1)
+        except OSError:
+            pass
+    try:
+        sock.bind(("", PORT))
+        membership = struct.pack("4s4s", socket.inet_aton(GROUP), socket.inet_aton("0.0.0.0"))
+        sock.setsockopt(socket.IPPROTO_IP, socket.IP_ADD_MEMBERSHIP, membership)
+    except OSError:
+        # 5353 taken exclusively: a query from another port is answered by unicast
+        sock.close()
+        sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM, socket.IPPROTO_UDP)
+        sock.bind(("", 0))
+    sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_TTL, 255)
+    return sock
+
+
+def scan(timeout):
+    sock = open_socket()
+    packet = query()
+    instances, services, texts, addresses = set(), {}, {}, {}
+    start = time.monotonic()
+    # Second query covers a response lost to a busy vehicle or access point
+    resend = [start, start + min(0.25, timeout / 3)]
+    while True:
+        now = time.monotonic()
+        while resend and resend[0] <= now:
+            sock.sendto(packet, (GROUP, PORT))
+            resend.pop(0)
+        remaining = start + timeout - now
+        if remaining <= 0:
+            break
+        sock.settimeout(min(remaining, resend[0] - now) if resend else remaining)
+        try:
+            data, _ = sock.recvfrom(9000)
+        except socket.timeout:
+            continue
+        for name, rtype, value in parse(data):
+            lower = name.lower()
+            if rtype == TYPE_PTR and lower == SERVICE.lower():
+                instances.add(value)
+            elif rtype == TYPE_SRV:
+                services[lower] = value
+            elif rtype == TYPE_TXT and lower.endswith(SERVICE.lower()):
+                texts[lower] = value
+            elif rtype == TYPE_A:
+                addresses[lower] = value
+    sock.close()
+
+    fleet = []
+    for instance in sorted(instances):
+        host, port = services.get(instance.lower(), ("", 0))
+        txt = texts.get(instance.lower(), {})
+        fleet.append({
+            "name": instance[:-len(SERVICE) - 1] if instance.lower().endswith(SERVICE.lower()) else instance,
+            "host": host,
+            "address": addresses.get(host.lower(), ""),
+            "http": port,
+            "txt": txt,
+        })
+    return fleet
+
+
+def battery(bucket):
+    if not bucket.isdigit():
+        return "?"
+    return "100%" if bucket == "10" else "%s0%%+" % bucket
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--timeout", type=float, default=0.8, help="seconds to collect answers")
+    parser.add_argument("--json", action="store_true", help="print JSON instead of a table")
+    args = parser.parse_args()
+
+    started = time.monotonic()
+    fleet = scan(args.timeout)
+    elapsed = time.monotonic() - started
+
+    if args.json:
+        json.dump(fleet, sys.stdout, indent=2)
+        print()
+        return
+
+    print("%-20s %-15s %-12s %-5s %-5s %-5s %-4s %-8s %s" % (
+        "vehicle", "address", "mode", "bat", "fault", "link", "ws", "fw", "caps"))
+    for agv in fleet:
+        txt = agv["txt"]
+        print("%-20s %-15s %-12s %-5s %-5s %-5s %-4s %-8s %s" % (
+            agv["name"][:20], agv["address"] or agv["host"], txt.get("mode", "?")[:12],
+            battery(txt.get("bat", "")), "FAULT" if txt.get("fault") == "1" else "ok",
+            "up" if txt.get("link") == "1" else "-", txt.get("ws", "-"),
+            txt.get("fw", "?")[:8], txt.get("caps", "")))
+    print("%d vehicle(s) in %.2f s" % (len(fleet), elapsed))
+
+
+if __name__ == "__main__":
+    main()
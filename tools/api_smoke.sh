@@ -0,0 +1,57 @@
+#!/bin/bash
+# Send full command batches to the REST API and check every result.
+#
+#   tools/api_smoke.sh [host] [user] [password]   (default factory_agv_01.local, no login)
+#
+# Two connections each POST a batch of 32 commands (AGV_API_BATCH_MAX) at
+# the same time, as two PLCs would. With the default rate limit (20/s,
+# burst 10) every command must still come back "accepted": each API
+# connection has its own bucket that holds a full batch, and full class
+# queues are dispatched between commands. Needs curl and python3.
+
+set -e
+
+HOST="${1:-factory_agv_01.local}"
+USER="${2:-admin}"
+PASS="$3"
+PORT="${API_PORT:-8080}"
+BATCH="${BATCH:-32}"
+
+AUTH=()
+if [ -n "$PASS" ]; then
+  TOKEN=$(curl -s -X POST "http://$HOST/login" -H "Content-Type: application/json" \
+          -d "{\"username\":\"$USER\",\"password\":\"$PASS\"}" |
+          python3 -c 'import json, sys; print(json.load(sys.stdin).get("token", ""))')
+  [ -n "$TOKEN" ] || { echo "[api] ❌ Login failed"; exit 1; }
+  AUTH=(-H "Authorization: Bearer $TOKEN")
+fi
+
+BODY=$(python3 -c "import json; print(json.dumps(['PING %d' % i for i in range($BATCH)]))")
+OUT=$(mktemp -d)
+trap 'rm -rf "$OUT"' EXIT
+
+echo "[api] -> 2 x $BATCH commands to http://$HOST:$PORT/api/v1/commands"
+for plc in 1 2; do
+  curl -s -X POST "http://$HOST:$PORT/api/v1/commands" "${AUTH[@]}" \
+       -H "Content-Type: application/json" -d "$BODY" > "$OUT/$plc.json" &
+done
+wait
+
+rc=0
+for plc in 1 2; do
+  python3 - "$OUT/$plc.json" "$BATCH" "$plc" <<'EOF' || rc=1
+import json, sys
+path, batch, plc = sys.argv[1], int(sys.argv[2]), sys.argv[3]
+try:
+    answer = json.load(open(path))
+except ValueError:
+    sys.exit("[api] ❌ PLC %s: no JSON answer" % plc)
+results = answer.get("results", [])
+refused = [r for r in results if r != "accepted"]
+if len(results) != batch or refused:
+    sys.exit("[api] ❌ PLC %s: %d/%d accepted (%s)" % (plc, answer.get("accepted", 0), batch,
+                                                  ", ".join(sorted(set(refused))) or "results missing"))
+print("[api] ✅ PLC %s: %d/%d accepted" % (plc, len(results), batch))
+EOF
+done
+exit $rc
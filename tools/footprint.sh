@@ -0,0 +1,36 @@
+#!/bin/bash
+# Compile the example sketch once per build profile and print flash/RAM use.
+#
+#   tools/footprint.sh [fqbn]     (default esp32:esp32:esp32)
+#
+# Needs arduino-cli with the esp32 core installed. Extra profiles can be
+# appended to PROFILES as "name|build flags".
+
+set -e
+cd "$(dirname "$0")/.."
+
+FQBN="${1:-esp32:esp32:esp32}"
+SKETCH="test"
+PROFILES=(
+  "full|"
+  "controller|-DAGVNET_PROFILE_CONTROLLER"
+  "headless|-DAGVNET_PROFILE_HEADLESS"
+)
+
+printf "%-12s %10s %10s\n" "profile" "flash" "ram"
+for entry in "${PROFILES[@]}"; do
+  name="${entry%%|*}"
+  flags="${entry#*|}"
+  # compiler.*.extra_flags are empty by default; build.extra_flags carries
+  # the board and core defines and must not be replaced
+  out=$(arduino-cli compile --fqbn "$FQBN" --library . \
+        --build-property "compiler.cpp.extra_flags=$flags" \
+        --build-property "compiler.c.extra_flags=$flags" "$SKETCH" 2>&1) || {
+    echo "$out"
+    echo "[footprint] ❌ $name failed to build"
+    exit 1
+  }
+  flash=$(echo "$out" | sed -n 's/^Sketch uses \([0-9]*\) bytes.*/\1/p')
+  ram=$(echo "$out" | sed -n 's/^Global variables use \([0-9]*\) bytes.*/\1/p')
+  printf "%-12s %10s %10s\n" "$name" "$flash" "$ram"
+done
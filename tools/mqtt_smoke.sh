@@ -0,0 +1,29 @@
+#!/bin/bash
+# Exercise the MQTT bridge against a broker (e.g. a local `mosquitto -v`).
+#
+#   tools/mqtt_smoke.sh [broker host] [device name]   (default localhost factory_agv_01)
+#
+# The vehicle must run agvNetwork.beginMqtt("mqtt://<broker>:1883"). Needs
+# mosquitto_pub / mosquitto_sub. Prints everything the vehicle publishes
+# while it sends a telemetry query, a command and a timed command.
+
+set -e
+
+BROKER="${1:-localhost}"
+NAME="${2:-factory_agv_01}"
+BASE="agv/$NAME"
+
+echo "[mqtt] Listening on $BASE/# at $BROKER"
+mosquitto_sub -h "$BROKER" -t "$BASE/#" -v -W 8 &
+SUB=$!
+sleep 1
+
+for cmd in "GET" "START" "AT +500000 STOP"; do
+  echo "[mqtt] -> $BASE/cmd: $cmd"
+  mosquitto_pub -h "$BROKER" -q 1 -t "$BASE/cmd" -m "$cmd"
+  sleep 1
+done
+
+wait $SUB || true
+echo "[mqtt] Done - expect availability 'online', a reply to GET, START/STOP"
+echo "[mqtt] statuses in status batches and the AT execution on $BASE/reply"